@@ -0,0 +1,567 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Box helpers.  "Area" is half the surface area, which is
+// all the insertion and rotation costs need to compare.
+// --------------------------------------------------------
+static float Area(const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	float x = max.x - min.x;
+	float y = max.y - min.y;
+	float z = max.z - min.z;
+	return x * y + y * z + z * x;
+}
+
+static float UnionArea(const AABBTreeNode& a, const AABBTreeNode& b)
+{
+	return Area(
+		XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z)),
+		XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z)));
+}
+
+static bool Contains(const AABBTreeNode& node, const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	return
+		node.Min.x <= min.x && node.Min.y <= min.y && node.Min.z <= min.z &&
+		node.Max.x >= max.x && node.Max.y >= max.y && node.Max.z >= max.z;
+}
+
+static bool Overlaps(const AABBTreeNode& node, const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	return
+		node.Min.x <= max.x && node.Min.y <= max.y && node.Min.z <= max.z &&
+		node.Max.x >= min.x && node.Max.y >= min.y && node.Max.z >= min.z;
+}
+
+// --------------------------------------------------------
+// Slab test of a ray against a node's box, giving the
+// distance the ray enters it (0 if it starts inside)
+// --------------------------------------------------------
+static bool RayHitsBox(const AABBTreeNode& node, const float origin[3], const float direction[3], float maxDistance, float* entry)
+{
+	const float* min = &node.Min.x;
+	const float* max = &node.Max.x;
+
+	float entryDistance = 0.0f;
+	float exitDistance = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// Parallel to this slab - either always in it or never
+		if (direction[axis] == 0.0f)
+		{
+			if (origin[axis] < min[axis] || origin[axis] > max[axis])
+				return false;
+			continue;
+		}
+
+		float t1 = (min[axis] - origin[axis]) / direction[axis];
+		float t2 = (max[axis] - origin[axis]) / direction[axis];
+		if (t1 > t2) std::swap(t1, t2);
+		entryDistance = std::max(entryDistance, t1);
+		exitDistance = std::min(exitDistance, t2);
+		if (entryDistance > exitDistance)
+			return false;
+	}
+
+	*entry = entryDistance;
+	return true;
+}
+
+AABBTree::AABBTree(float margin)
+{
+	this->margin = margin;
+	root = NullNode;
+	freeList = NullNode;
+	proxyCount = 0;
+}
+
+// --------------------------------------------------------
+// Adds a proxy for an object with the given bounds
+//
+// Returns the proxy's id, for Move() and Remove()
+// --------------------------------------------------------
+int AABBTree::Insert(const XMFLOAT3& min, const XMFLOAT3& max, unsigned int payload)
+{
+	int leaf = AllocateNode();
+	AABBTreeNode& node = nodes[leaf];
+	node.Min = XMFLOAT3(min.x - margin, min.y - margin, min.z - margin);
+	node.Max = XMFLOAT3(max.x + margin, max.y + margin, max.z + margin);
+	node.Child1 = NullNode;
+	node.Child2 = NullNode;
+	node.Height = 0;
+	node.Payload = payload;
+
+	InsertLeaf(leaf);
+	proxyCount++;
+	return leaf;
+}
+
+void AABBTree::Remove(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+// --------------------------------------------------------
+// Updates a proxy's bounds.  Nothing happens while the new
+// bounds still fit in the proxy's fattened box; otherwise
+// the proxy is taken out and reinserted.
+//
+// Returns true if the tree changed
+// --------------------------------------------------------
+bool AABBTree::Move(int proxy, const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	if (Contains(nodes[proxy], min, max))
+		return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].Min = XMFLOAT3(min.x - margin, min.y - margin, min.z - margin);
+	nodes[proxy].Max = XMFLOAT3(max.x + margin, max.y + margin, max.z + margin);
+	InsertLeaf(proxy);
+	return true;
+}
+
+// --------------------------------------------------------
+// Removes every proxy
+// --------------------------------------------------------
+void AABBTree::Clear()
+{
+	nodes.clear();
+	root = NullNode;
+	freeList = NullNode;
+	proxyCount = 0;
+}
+
+// --------------------------------------------------------
+// Finds every proxy at least partly inside a frustum.
+// Each traversal entry carries the planes its node still
+// straddles, so once a node is fully inside a plane none of
+// its descendants test that plane again.
+// --------------------------------------------------------
+void AABBTree::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>* results)
+{
+	results->clear();
+	if (root == NullNode)
+		return;
+
+	// Node and plane mask, interleaved
+	stack.clear();
+	stack.push_back(root);
+	stack.push_back(0x3F);
+	while (!stack.empty())
+	{
+		unsigned int planes = (unsigned int)stack.back();
+		stack.pop_back();
+		int index = stack.back();
+		stack.pop_back();
+
+		const AABBTreeNode& node = nodes[index];
+		XMFLOAT3 center(
+			(node.Min.x + node.Max.x) * 0.5f,
+			(node.Min.y + node.Max.y) * 0.5f,
+			(node.Min.z + node.Max.z) * 0.5f);
+		XMFLOAT3 extents(
+			node.Max.x - center.x,
+			node.Max.y - center.y,
+			node.Max.z - center.z);
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			if (!(planes & (1 << p)))
+				continue;
+
+			const XMFLOAT4& plane = frustum.Planes[p];
+			float dist = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+			float reach = extents.x * fabsf(plane.x) + extents.y * fabsf(plane.y) + extents.z * fabsf(plane.z);
+			if (dist < -reach)
+				outside = true;
+			else if (dist >= reach)
+				planes &= ~(1 << p);
+		}
+
+		if (outside)
+			continue;
+
+		if (node.Height == 0)
+		{
+			results->push_back(node.Payload);
+			continue;
+		}
+
+		stack.push_back(node.Child1);
+		stack.push_back((int)planes);
+		stack.push_back(node.Child2);
+		stack.push_back((int)planes);
+	}
+}
+
+// --------------------------------------------------------
+// Finds every proxy whose box overlaps the given box
+// --------------------------------------------------------
+void AABBTree::QueryOverlap(const XMFLOAT3& min, const XMFLOAT3& max, std::vector<unsigned int>* results)
+{
+	results->clear();
+	if (root == NullNode)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		const AABBTreeNode& node = nodes[index];
+		if (!Overlaps(node, min, max))
+			continue;
+
+		if (node.Height == 0)
+		{
+			results->push_back(node.Payload);
+			continue;
+		}
+
+		stack.push_back(node.Child1);
+		stack.push_back(node.Child2);
+	}
+}
+
+// --------------------------------------------------------
+// Finds every proxy a ray passes through before maxDistance.
+// Distances are in multiples of direction's length.
+// --------------------------------------------------------
+void AABBTree::QueryRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, std::vector<unsigned int>* results)
+{
+	results->clear();
+	if (root == NullNode)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		const AABBTreeNode& node = nodes[index];
+		float entry;
+		if (!RayHitsBox(node, &origin.x, &direction.x, maxDistance, &entry))
+			continue;
+
+		if (node.Height == 0)
+		{
+			results->push_back(node.Payload);
+			continue;
+		}
+
+		stack.push_back(node.Child1);
+		stack.push_back(node.Child2);
+	}
+}
+
+// --------------------------------------------------------
+// Finds the first proxy a ray enters before maxDistance.
+// Distances are in multiples of direction's length.
+//
+// payload  - Set to the payload of the proxy that was hit
+// distance - Set to the distance the ray enters its box
+//
+// Returns false if nothing was hit
+// --------------------------------------------------------
+bool AABBTree::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, unsigned int* payload, float* distance)
+{
+	if (root == NullNode)
+		return false;
+
+	bool hit = false;
+	float closest = maxDistance;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		// Anything entered after the closest hit so far can't beat it
+		const AABBTreeNode& node = nodes[index];
+		float entry;
+		if (!RayHitsBox(node, &origin.x, &direction.x, closest, &entry))
+			continue;
+
+		if (node.Height == 0)
+		{
+			hit = true;
+			closest = entry;
+			*payload = node.Payload;
+			continue;
+		}
+
+		stack.push_back(node.Child1);
+		stack.push_back(node.Child2);
+	}
+
+	if (hit)
+		*distance = closest;
+	return hit;
+}
+
+// --------------------------------------------------------
+// Sum of the internal nodes' areas - the lower it is, the
+// cheaper the tree is to query
+// --------------------------------------------------------
+float AABBTree::GetTotalArea()
+{
+	float total = 0.0f;
+	for (const AABBTreeNode& node : nodes)
+	{
+		if (node.Height > 0)
+			total += Area(node.Min, node.Max);
+	}
+	return total;
+}
+
+int AABBTree::AllocateNode()
+{
+	if (freeList == NullNode)
+	{
+		nodes.push_back(AABBTreeNode());
+		freeList = (int)nodes.size() - 1;
+		nodes[freeList].Parent = NullNode;
+	}
+
+	int index = freeList;
+	freeList = nodes[index].Parent;
+	nodes[index].Parent = NullNode;
+	nodes[index].Child1 = NullNode;
+	nodes[index].Child2 = NullNode;
+	nodes[index].Height = 0;
+	nodes[index].Payload = 0;
+	return index;
+}
+
+void AABBTree::FreeNode(int node)
+{
+	nodes[node].Parent = freeList;
+	nodes[node].Height = -1;
+	freeList = node;
+}
+
+// --------------------------------------------------------
+// Puts a leaf next to the sibling that costs the least to
+// pair it with, then refits and rotates the way back up
+// --------------------------------------------------------
+void AABBTree::InsertLeaf(int leaf)
+{
+	if (root == NullNode)
+	{
+		root = leaf;
+		nodes[leaf].Parent = NullNode;
+		return;
+	}
+
+	// Walk down while it's cheaper to push the leaf into a
+	// child than to pair it with the current node
+	int index = root;
+	while (nodes[index].Height > 0)
+	{
+		const AABBTreeNode& node = nodes[index];
+		const AABBTreeNode& newLeaf = nodes[leaf];
+		float area = Area(node.Min, node.Max);
+		float combinedArea = UnionArea(node, newLeaf);
+
+		// Cost of making a new parent for this node and the leaf,
+		// and the growth every ancestor pays if we go further down
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.Child1, node.Child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			const AABBTreeNode& child = nodes[children[i]];
+			if (child.Height == 0)
+				childCost[i] = UnionArea(child, newLeaf) + inheritance;
+			else
+				childCost[i] = UnionArea(child, newLeaf) - Area(child.Min, child.Max) + inheritance;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	// Give the sibling and the leaf a new parent
+	int sibling = index;
+	int oldParent = nodes[sibling].Parent;
+	int newParent = AllocateNode();
+	nodes[newParent].Parent = oldParent;
+	nodes[newParent].Child1 = sibling;
+	nodes[newParent].Child2 = leaf;
+	nodes[sibling].Parent = newParent;
+	nodes[leaf].Parent = newParent;
+
+	if (oldParent == NullNode)
+		root = newParent;
+	else if (nodes[oldParent].Child1 == sibling)
+		nodes[oldParent].Child1 = newParent;
+	else
+		nodes[oldParent].Child2 = newParent;
+
+	for (index = newParent; index != NullNode; index = nodes[index].Parent)
+	{
+		Refit(index);
+		Rotate(index);
+	}
+}
+
+// --------------------------------------------------------
+// Takes a leaf out of the tree, replacing its parent with
+// its sibling, then refits and rotates the way back up
+// --------------------------------------------------------
+void AABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NullNode;
+		return;
+	}
+
+	int parent = nodes[leaf].Parent;
+	int grandParent = nodes[parent].Parent;
+	int sibling = nodes[parent].Child1 == leaf ? nodes[parent].Child2 : nodes[parent].Child1;
+	FreeNode(parent);
+
+	nodes[sibling].Parent = grandParent;
+	if (grandParent == NullNode)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].Child1 == parent)
+		nodes[grandParent].Child1 = sibling;
+	else
+		nodes[grandParent].Child2 = sibling;
+
+	for (int index = grandParent; index != NullNode; index = nodes[index].Parent)
+	{
+		Refit(index);
+		Rotate(index);
+	}
+}
+
+// --------------------------------------------------------
+// Recomputes an internal node's box and height from its
+// children
+// --------------------------------------------------------
+void AABBTree::Refit(int node)
+{
+	AABBTreeNode& n = nodes[node];
+	const AABBTreeNode& a = nodes[n.Child1];
+	const AABBTreeNode& b = nodes[n.Child2];
+
+	n.Min = XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z));
+	n.Max = XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z));
+	n.Height = 1 + std::max(a.Height, b.Height);
+}
+
+// --------------------------------------------------------
+// Tries swapping each child of a node with each child of the
+// other child, and each grandchild with each grandchild on
+// the other side.  The node's own box can't change, so only
+// the children's areas do - we make the swap that shrinks
+// them the most, if any does.
+// --------------------------------------------------------
+void AABBTree::Rotate(int node)
+{
+	if (nodes[node].Height < 2)
+		return;
+
+	int children[2] = { nodes[node].Child1, nodes[node].Child2 };
+
+	float bestChange = 0.0f;
+	int bestFirst = NullNode;	// The pair of nodes to swap
+	int bestSecond = NullNode;
+	for (int i = 0; i < 2; i++)
+	{
+		const AABBTreeNode& stay = nodes[children[1 - i]];
+		if (stay.Height == 0)
+			continue;
+
+		// Swapping children[i] with one of stay's children leaves
+		// stay holding children[i] and its other child
+		const AABBTreeNode& moving = nodes[children[i]];
+		float stayArea = Area(stay.Min, stay.Max);
+		int grandChildren[2] = { stay.Child1, stay.Child2 };
+		for (int j = 0; j < 2; j++)
+		{
+			float change = UnionArea(moving, nodes[grandChildren[1 - j]]) - stayArea;
+			if (change < bestChange)
+			{
+				bestChange = change;
+				bestFirst = children[i];
+				bestSecond = grandChildren[j];
+			}
+		}
+	}
+
+	// Grandchild with grandchild changes both children
+	const AABBTreeNode& left = nodes[children[0]];
+	const AABBTreeNode& right = nodes[children[1]];
+	if (left.Height > 0 && right.Height > 0)
+	{
+		float areas = Area(left.Min, left.Max) + Area(right.Min, right.Max);
+		int leftChildren[2] = { left.Child1, left.Child2 };
+		int rightChildren[2] = { right.Child1, right.Child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				float change =
+					UnionArea(nodes[rightChildren[j]], nodes[leftChildren[1 - i]]) +
+					UnionArea(nodes[leftChildren[i]], nodes[rightChildren[1 - j]]) -
+					areas;
+				if (change < bestChange)
+				{
+					bestChange = change;
+					bestFirst = leftChildren[i];
+					bestSecond = rightChildren[j];
+				}
+			}
+		}
+	}
+
+	if (bestFirst == NullNode)
+		return;
+
+	// Swap the two, fixing up both parents' links
+	int firstParent = nodes[bestFirst].Parent;
+	int secondParent = nodes[bestSecond].Parent;
+	if (nodes[firstParent].Child1 == bestFirst)
+		nodes[firstParent].Child1 = bestSecond;
+	else
+		nodes[firstParent].Child2 = bestSecond;
+
+	if (nodes[secondParent].Child1 == bestSecond)
+		nodes[secondParent].Child1 = bestFirst;
+	else
+		nodes[secondParent].Child2 = bestFirst;
+
+	nodes[bestFirst].Parent = secondParent;
+	nodes[bestSecond].Parent = firstParent;
+
+	// Both parents are this node or its children
+	Refit(secondParent);
+	if (firstParent != node)
+		Refit(firstParent);
+	Refit(node);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+// --------------------------------------------------------
+// A node of the tree.  Leaves hold a proxy's (fattened)
+// bounds and payload, internal nodes the union of their
+// children.  Freed nodes are chained through Parent.
+// --------------------------------------------------------
+struct AABBTreeNode
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	int Parent;
+	int Child1;		// -1 for leaves
+	int Child2;
+	int Height;		// 0 for leaves, -1 for free nodes
+	unsigned int Payload;
+};
+
+// --------------------------------------------------------
+// Dynamic AABB tree for indexing moving objects.
+//
+// Each proxy is a leaf whose box is the object's bounds grown
+// by a margin, so small moves don't touch the tree at all.
+// New leaves go next to the sibling that grows the tree's
+// surface area the least, and nodes on the way back up are
+// rotated whenever swapping a child with a grandchild makes
+// the tree's total surface area smaller.
+//
+// Proxies are identified by node index, which stays the same
+// for the proxy's whole life (even when Move() reinserts it).
+// Queries report payloads, and are answered against the
+// fattened boxes, so callers wanting exact results should
+// test the objects they get back.
+// --------------------------------------------------------
+class AABBTree
+{
+public:
+	static const int NullNode = -1;
+
+	AABBTree(float margin = 0.1f);
+
+	// Proxy management
+	int Insert(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, unsigned int payload);
+	void Remove(int proxy);
+	bool Move(int proxy, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max);
+	void Clear();
+
+	// Queries - each fills results with payloads
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>* results);
+	void QueryOverlap(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, std::vector<unsigned int>* results);
+	void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, std::vector<unsigned int>* results);
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, unsigned int* payload, float* distance);
+
+	// Getters
+	unsigned int GetPayload(int proxy) { return nodes[proxy].Payload; }
+	unsigned int GetProxyCount() { return proxyCount; }
+	int GetHeight() { return root == NullNode ? 0 : nodes[root].Height; }
+	float GetTotalArea();
+
+private:
+	std::vector<AABBTreeNode> nodes;
+	int root;
+	int freeList;
+	unsigned int proxyCount;
+	float margin;
+
+	// Reused traversal stack, so queries don't allocate
+	std::vector<int> stack;
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void Refit(int node);
+	void Rotate(int node);
+};
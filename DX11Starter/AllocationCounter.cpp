@@ -0,0 +1,244 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<unsigned long long> allocations(0);
+static std::atomic<unsigned long long> bytesAllocated(0);
+
+static thread_local unsigned long long threadAllocations = 0;
+static thread_local unsigned long long threadBytesAllocated = 0;
+static thread_local long long threadBytesLive = 0;
+static thread_local long long threadPeakBytes = 0;
+
+// Each block starts with its size, so frees can be counted.
+// Kept a whole alignment unit, so what's handed out stays as
+// aligned as malloc's own blocks.
+static const size_t HeaderSize = 16;
+
+bool AllocationCounter::IsEnabled()
+{
+#ifdef ALLOCATION_COUNTING
+	return true;
+#else
+	return false;
+#endif
+}
+
+unsigned long long AllocationCounter::GetAllocations()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+unsigned long long AllocationCounter::GetBytesAllocated()
+{
+	return bytesAllocated.load(std::memory_order_relaxed);
+}
+
+unsigned long long AllocationCounter::GetThreadAllocations()
+{
+	return threadAllocations;
+}
+
+unsigned long long AllocationCounter::GetThreadBytesAllocated()
+{
+	return threadBytesAllocated;
+}
+
+long long AllocationCounter::GetThreadBytesLive()
+{
+	return threadBytesLive;
+}
+
+long long AllocationCounter::GetThreadPeakBytes()
+{
+	return threadPeakBytes;
+}
+
+void AllocationCounter::ResetThreadPeak()
+{
+	threadPeakBytes = threadBytesLive;
+}
+
+#ifdef ALLOCATION_COUNTING
+
+// --------------------------------------------------------
+// Replacements for the global allocation functions.  The
+// array, nothrow and aligned forms are replaced too, so
+// nothing goes around the count.
+// --------------------------------------------------------
+static void Count(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+	threadAllocations++;
+	threadBytesAllocated += size;
+	threadBytesLive += size;
+	if (threadBytesLive > threadPeakBytes)
+		threadPeakBytes = threadBytesLive;
+}
+
+static void* CountedAllocate(size_t size)
+{
+	size_t* block = (size_t*)malloc(HeaderSize + size);
+	if (!block)
+		return 0;
+
+	Count(size);
+	*block = size;
+	return (unsigned char*)block + HeaderSize;
+}
+
+static void CountedFree(void* memory)
+{
+	if (!memory)
+		return;
+
+	size_t* block = (size_t*)((unsigned char*)memory - HeaderSize);
+	threadBytesLive -= *block;
+	free(block);
+}
+
+void* operator new(size_t size)
+{
+	void* memory = CountedAllocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	CountedFree(memory);
+}
+
+#ifdef __cpp_aligned_new
+
+// --------------------------------------------------------
+// Over-aligned blocks are placed inside a bigger malloc'd
+// one, with the header just before them holding the size
+// and where the outer block starts
+// --------------------------------------------------------
+static void* CountedAllocateAligned(size_t size, std::align_val_t alignment)
+{
+	size_t align = (size_t)alignment < HeaderSize ? HeaderSize : (size_t)alignment;
+	unsigned char* outer = (unsigned char*)malloc(HeaderSize + align + size);
+	if (!outer)
+		return 0;
+
+	uintptr_t start = ((uintptr_t)outer + HeaderSize + align - 1) & ~(uintptr_t)(align - 1);
+	size_t* header = (size_t*)(start - HeaderSize);
+	header[0] = size;
+	header[1] = (size_t)(start - (uintptr_t)outer);
+
+	Count(size);
+	return (void*)start;
+}
+
+static void CountedFreeAligned(void* memory)
+{
+	if (!memory)
+		return;
+
+	size_t* header = (size_t*)((unsigned char*)memory - HeaderSize);
+	threadBytesLive -= header[0];
+	free((unsigned char*)memory - header[1]);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* memory = CountedAllocateAligned(size, alignment);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	CountedFreeAligned(memory);
+}
+
+#endif
+#endif
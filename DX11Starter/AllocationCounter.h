@@ -0,0 +1,33 @@
+#pragma once
+
+// --------------------------------------------------------
+// Counts every heap allocation made through the global
+// operator new - so every container, string and stream -
+// which AllocationCounter.cpp replaces when built with
+// ALLOCATION_COUNTING defined (as the tests are).  Without
+// it, new and delete are left alone and every count is 0.
+//
+// Take the count before and after some code to see how many
+// allocations it made, on any thread in the meantime.
+//
+// The thread counts only cover the calling thread, so they
+// can measure work like an import while other threads run.
+// Memory is charged to whichever thread frees it, so live
+// and peak bytes are only exact for memory that stays on
+// one thread.
+// --------------------------------------------------------
+class AllocationCounter
+{
+public:
+	static bool IsEnabled();
+
+	static unsigned long long GetAllocations();
+	static unsigned long long GetBytesAllocated();
+
+	// This thread only
+	static unsigned long long GetThreadAllocations();
+	static unsigned long long GetThreadBytesAllocated();
+	static long long GetThreadBytesLive();
+	static long long GetThreadPeakBytes();
+	static void ResetThreadPeak();	// Peak starts again from what's live now
+};
@@ -0,0 +1,245 @@
+#include "Benchmark.h"
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Script
+// --------------------------------------------------------
+bool BenchmarkScript::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	cameraKeys.clear();
+	entitySwitches.clear();
+	environmentSwitches.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string command;
+		if (!(words >> command))
+			continue;
+
+		if (command == "camera")
+		{
+			BenchmarkCameraKey key;
+			if (!(words >> key.Time >> key.Position.x >> key.Position.y >> key.Position.z >> key.Pitch >> key.Yaw))
+				return false;
+			if (!cameraKeys.empty() && key.Time < cameraKeys.back().Time)
+				return false;
+			cameraKeys.push_back(key);
+		}
+		else if (command == "entity" || command == "environment")
+		{
+			BenchmarkSwitch s;
+			if (!(words >> s.Time >> s.Index))
+				return false;
+			(command == "entity" ? entitySwitches : environmentSwitches).push_back(s);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	// Switches can be listed in any order
+	auto earlier = [](const BenchmarkSwitch& a, const BenchmarkSwitch& b) { return a.Time < b.Time; };
+	std::stable_sort(entitySwitches.begin(), entitySwitches.end(), earlier);
+	std::stable_sort(environmentSwitches.begin(), environmentSwitches.end(), earlier);
+	return !cameraKeys.empty();
+}
+
+void BenchmarkScript::BuildDefault()
+{
+	cameraKeys.clear();
+	entitySwitches.clear();
+	environmentSwitches.clear();
+
+	// Twice around at a distance of 5, looking at the origin,
+	// rising and falling as it goes
+	const unsigned int keys = 64;
+	const float duration = 16.0f;
+	for (unsigned int i = 0; i <= keys; i++)
+	{
+		float t = (float)i / keys;
+		float angle = t * XM_2PI * 2.0f;
+
+		BenchmarkCameraKey key;
+		key.Time = t * duration;
+		key.Position = XMFLOAT3(-sinf(angle) * 5.0f, sinf(t * XM_2PI) * 2.0f, -cosf(angle) * 5.0f);
+		key.Pitch = atan2f(key.Position.y, 5.0f);
+		key.Yaw = angle;
+		cameraKeys.push_back(key);
+	}
+
+	// Show every environment, and a few different entities
+	for (unsigned int i = 0; i < 3; i++)
+		environmentSwitches.push_back({ i * duration / 3, i });
+	for (unsigned int i = 0; i < 4; i++)
+		entitySwitches.push_back({ i * duration / 4, i * 2 + 1 });
+}
+
+void BenchmarkScript::SampleCamera(float time, XMFLOAT3* position, float* pitch, float* yaw)
+{
+	if (cameraKeys.empty())
+		return;
+
+	// First key after time, if any
+	unsigned int next = 0;
+	while (next < cameraKeys.size() && cameraKeys[next].Time <= time)
+		next++;
+
+	if (next == 0 || next == cameraKeys.size())
+	{
+		const BenchmarkCameraKey& key = cameraKeys[next == 0 ? 0 : next - 1];
+		*position = key.Position;
+		*pitch = key.Pitch;
+		*yaw = key.Yaw;
+		return;
+	}
+
+	const BenchmarkCameraKey& a = cameraKeys[next - 1];
+	const BenchmarkCameraKey& b = cameraKeys[next];
+	float t = (time - a.Time) / (b.Time - a.Time);
+	XMStoreFloat3(position, XMVectorLerp(XMLoadFloat3(&a.Position), XMLoadFloat3(&b.Position), t));
+	*pitch = a.Pitch + (b.Pitch - a.Pitch) * t;
+	*yaw = a.Yaw + (b.Yaw - a.Yaw) * t;
+}
+
+unsigned int BenchmarkScript::FindSwitch(const std::vector<BenchmarkSwitch>& switches, float time, unsigned int current)
+{
+	for (unsigned int i = 0; i < switches.size() && switches[i].Time <= time; i++)
+		current = switches[i].Index;
+	return current;
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+static long long Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Benchmark::Benchmark(const BenchmarkScript& script, unsigned int frameCount, float timeStep)
+{
+	this->script = script;
+	this->frameCount = frameCount;
+	this->timeStep = timeStep;
+	frame = 0;
+	lastFrameEnd = -1;
+
+	frameTimes.reserve(frameCount);
+	drawCalls.reserve(frameCount);
+	bytesUploaded.reserve(frameCount);
+	heapAllocations.reserve(frameCount);
+}
+
+void Benchmark::RecordFrame(unsigned int drawCalls, unsigned int bytesUploaded, unsigned int heapAllocations)
+{
+	long long now = Now();
+	if (lastFrameEnd < 0 || IsFinished())
+	{
+		lastFrameEnd = now;
+		return;
+	}
+
+	frameTimes.push_back((now - lastFrameEnd) / 1000000.0f);
+	this->drawCalls.push_back(drawCalls);
+	this->bytesUploaded.push_back(bytesUploaded);
+	this->heapAllocations.push_back(heapAllocations);
+	lastFrameEnd = now;
+	frame++;
+
+	if (!Profiler::IsEnabled())
+		return;
+
+	// Scopes are matched by name, and ordered by when each
+	// name first finished
+	Profiler::GetLastFrameScopes(&scopes);
+	for (const ProfileEvent& e : scopes)
+	{
+		unsigned int p = 0;
+		while (p < passes.size() && strcmp(passes[p].Name, e.Name) != 0)
+			p++;
+		if (p == passes.size())
+			passes.push_back({ e.Name, e.Depth, 0.0, 0.0f, 0 });
+
+		float ms = (e.End - e.Start) / 1000000.0f;
+		passes[p].TotalTime += ms;
+		passes[p].MaxTime = std::max(passes[p].MaxTime, ms);
+		passes[p].Calls++;
+	}
+}
+
+// Average, nearest rank percentiles and max of some samples
+template<typename T>
+static void WriteDistribution(std::ofstream& out, const std::vector<T>& samples)
+{
+	std::vector<T> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (T s : sorted)
+		total += s;
+
+	unsigned int count = (unsigned int)sorted.size();
+	out << "{\"average\":" << (count ? total / count : 0.0);
+	if (count)
+	{
+		out << ",\"p50\":" << NearestRank(sorted.data(), count, 0.50f) <<
+			",\"p95\":" << NearestRank(sorted.data(), count, 0.95f) <<
+			",\"p99\":" << NearestRank(sorted.data(), count, 0.99f) <<
+			",\"max\":" << sorted.back();
+	}
+	out << "}";
+}
+
+bool Benchmark::WriteReport(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	out << "{\n";
+	out << "\"frames\":" << frame << ",\n";
+	out << "\"timeStep\":" << timeStep << ",\n";
+	out << "\"frameTimeMs\":"; WriteDistribution(out, frameTimes); out << ",\n";
+	out << "\"drawCalls\":"; WriteDistribution(out, drawCalls); out << ",\n";
+	out << "\"bytesUploaded\":"; WriteDistribution(out, bytesUploaded); out << ",\n";
+
+	// Heap allocations are only known in builds that count them
+	if (AllocationCounter::IsEnabled())
+	{
+		out << "\"heapAllocations\":"; WriteDistribution(out, heapAllocations); out << ",\n";
+		out << "\"allocatingFrames\":" << std::count_if(heapAllocations.begin(), heapAllocations.end(), [](unsigned int n) { return n > 0; }) << ",\n";
+	}
+
+	// Per frame averages, so passes that don't run every frame
+	// still add up against the frame time
+	out << "\"passes\":[";
+	for (unsigned int i = 0; i < passes.size(); i++)
+	{
+		const PassTotal& p = passes[i];
+		out << (i > 0 ? ",\n" : "\n") <<
+			"{\"name\":\"" << p.Name << "\"" <<
+			",\"depth\":" << p.Depth <<
+			",\"callsPerFrame\":" << (frame ? (double)p.Calls / frame : 0.0) <<
+			",\"averageMs\":" << (frame ? p.TotalTime / frame : 0.0) <<
+			",\"maxMs\":" << p.MaxTime << "}";
+	}
+	out << "\n]\n}\n";
+	return (bool)out;
+}
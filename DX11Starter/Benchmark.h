@@ -0,0 +1,111 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "Profiler.h"
+
+// --------------------------------------------------------
+// Where the camera is at one point in a benchmark, with
+// rotations in radians (as Camera::Rotate takes them)
+// --------------------------------------------------------
+struct BenchmarkCameraKey
+{
+	float Time;
+	DirectX::XMFLOAT3 Position;
+	float Pitch;
+	float Yaw;
+};
+
+// --------------------------------------------------------
+// Switches to an entity or environment at a given time
+// --------------------------------------------------------
+struct BenchmarkSwitch
+{
+	float Time;
+	unsigned int Index;
+};
+
+// --------------------------------------------------------
+// A camera path, plus when to switch the shown entity and
+// environment.  Scripts are text, one command per line:
+//
+//   camera <time> <x> <y> <z> <pitch> <yaw>
+//   entity <time> <index>
+//   environment <time> <index>
+//
+// Anything after a # is ignored.  The camera moves in a
+// straight line between keys (which must be in time order),
+// and holds still before the first and after the last.
+// --------------------------------------------------------
+class BenchmarkScript
+{
+public:
+	bool Load(const std::string& path);
+
+	// A slow loop around the origin, used when there's no script
+	void BuildDefault();
+
+	void SampleCamera(float time, DirectX::XMFLOAT3* position, float* pitch, float* yaw);
+
+	// The last switch at or before time, or current if none
+	unsigned int GetEntity(float time, unsigned int current) { return FindSwitch(entitySwitches, time, current); }
+	unsigned int GetEnvironment(float time, unsigned int current) { return FindSwitch(environmentSwitches, time, current); }
+
+private:
+	std::vector<BenchmarkCameraKey> cameraKeys;
+	std::vector<BenchmarkSwitch> entitySwitches;
+	std::vector<BenchmarkSwitch> environmentSwitches;
+
+	unsigned int FindSwitch(const std::vector<BenchmarkSwitch>& switches, float time, unsigned int current);
+};
+
+// --------------------------------------------------------
+// Runs a script for a set number of frames at a fixed time
+// step, collecting what each frame cost.  Call RecordFrame()
+// once every frame, then WriteReport() once IsFinished().
+// --------------------------------------------------------
+class Benchmark
+{
+public:
+	Benchmark(const BenchmarkScript& script, unsigned int frameCount, float timeStep);
+
+	BenchmarkScript* GetScript() { return &script; }
+	float GetTimeStep() { return timeStep; }
+	bool IsFinished() { return frame >= frameCount; }
+
+	// Stats for the frame that just finished, whose scopes
+	// come from the profiler (if enabled), and moves on to the
+	// next.  The first call only starts the clock.
+	void RecordFrame(unsigned int drawCalls, unsigned int bytesUploaded, unsigned int heapAllocations);
+
+	// Frame time percentiles, draw calls, upload bytes, heap
+	// allocations and the time spent in each profiled scope,
+	// as JSON
+	bool WriteReport(const std::string& path);
+
+private:
+	// Time and calls for every scope with the same name
+	struct PassTotal
+	{
+		const char* Name;
+		unsigned int Depth;
+		double TotalTime;
+		float MaxTime;
+		unsigned int Calls;
+	};
+
+	BenchmarkScript script;
+	unsigned int frameCount;
+	unsigned int frame;
+	float timeStep;
+
+	long long lastFrameEnd;
+	std::vector<float> frameTimes;
+	std::vector<unsigned int> drawCalls;
+	std::vector<unsigned int> bytesUploaded;
+	std::vector<unsigned int> heapAllocations;
+	std::vector<PassTotal> passes;
+	std::vector<ProfileEvent> scopes;
+};
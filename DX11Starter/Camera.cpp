@@ -11,6 +11,9 @@ Camera::Camera(float x, float y, float z)
 	XMStoreFloat4(&rotation, XMQuaternionIdentity());
 	xRotation = 0;
 	yRotation = 0;
+	farClip = 100.0f;
+	previousPosition = position;
+	previousRotation = rotation;
 
 	XMStoreFloat4x4(&viewMatrix, XMMatrixIdentity());
 	XMStoreFloat4x4(&projMatrix, XMMatrixIdentity());
@@ -54,26 +57,37 @@ void Camera::Rotate(float x, float y)
 	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(xRotation, yRotation, 0));
 }
 
+// Jumps straight to a position and rotation, for anything
+// driving the camera other than the keyboard and mouse
+void Camera::SetPose(XMFLOAT3 position, float xRotation, float yRotation)
+{
+	this->position = position;
+	this->xRotation = 0;
+	this->yRotation = 0;
+	Rotate(xRotation, yRotation);
+	UpdateViewMatrix();
+}
+
 // Camera's update, which looks for key presses
-void Camera::Update(float dt)
+void Camera::Update(float dt, Input* input)
 {
 	// Current speed
 	float speed = dt * 3;
 
 	// Speed up or down as necessary
-	if (GetAsyncKeyState(VK_SHIFT)) { speed *= 5; }
-	if (GetAsyncKeyState(VK_CONTROL)) { speed *= 0.1f; }
+	if (input->IsKeyDown(VK_SHIFT)) { speed *= 5; }
+	if (input->IsKeyDown(VK_CONTROL)) { speed *= 0.1f; }
 
 	// Movement
-	if (GetAsyncKeyState('W') & 0x8000) { MoveRelative(0, 0, speed); }
-	if (GetAsyncKeyState('S') & 0x8000) { MoveRelative(0, 0, -speed); }
-	if (GetAsyncKeyState('A') & 0x8000) { MoveRelative(-speed, 0, 0); }
-	if (GetAsyncKeyState('D') & 0x8000) { MoveRelative(speed, 0, 0); }
-	if (GetAsyncKeyState('X') & 0x8000) { MoveAbsolute(0, -speed, 0); }
-	if (GetAsyncKeyState(' ') & 0x8000) { MoveAbsolute(0, speed, 0); }
+	if (input->IsKeyDown('W')) { MoveRelative(0, 0, speed); }
+	if (input->IsKeyDown('S')) { MoveRelative(0, 0, -speed); }
+	if (input->IsKeyDown('A')) { MoveRelative(-speed, 0, 0); }
+	if (input->IsKeyDown('D')) { MoveRelative(speed, 0, 0); }
+	if (input->IsKeyDown('X')) { MoveAbsolute(0, -speed, 0); }
+	if (input->IsKeyDown(' ')) { MoveAbsolute(0, speed, 0); }
 
 	// Check for reset
-	if (GetAsyncKeyState('R') & 0x8000)
+	if (input->IsKeyDown('R'))
 	{
 		position = startPosition;
 		xRotation = 0;
@@ -87,13 +101,32 @@ void Camera::Update(float dt)
 
 // Creates a new view matrix based on current position and orientation
 void Camera::UpdateViewMatrix()
+{
+	BuildView(XMLoadFloat3(&position), XMLoadFloat4(&rotation));
+}
+
+void Camera::BeginStep()
+{
+	previousPosition = position;
+	previousRotation = rotation;
+}
+
+// Views from part way between the saved and current poses
+void Camera::Interpolate(float alpha)
+{
+	BuildView(
+		XMVectorLerp(XMLoadFloat3(&previousPosition), XMLoadFloat3(&position), alpha),
+		XMQuaternionSlerp(XMLoadFloat4(&previousRotation), XMLoadFloat4(&rotation), alpha));
+}
+
+void Camera::BuildView(FXMVECTOR position, FXMVECTOR rotation)
 {
 	// Rotate the standard "forward" matrix by our rotation
 	// This gives us our "look direction"
-	XMVECTOR dir = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMLoadFloat4(&rotation));
+	XMVECTOR dir = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), rotation);
 
 	XMMATRIX view = XMMatrixLookToLH(
-		XMLoadFloat3(&position),
+		position,
 		dir,
 		XMVectorSet(0, 1, 0, 0));
 
@@ -103,10 +136,19 @@ void Camera::UpdateViewMatrix()
 // Updates the projection matrix
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
+	farClip = 100.0f;
 	XMMATRIX P = XMMatrixPerspectiveFovLH(
 		0.25f * XM_PI,		// Field of View Angle
 		aspectRatio,		// Aspect ratio
 		0.1f,				// Near clip plane distance
-		100.0f);			// Far clip plane distance
+		farClip);			// Far clip plane distance
 	XMStoreFloat4x4(&projMatrix, XMMatrixTranspose(P)); // Transpose for HLSL!
 }
+
+// Extracts the view frustum from our (transposed) matrices
+Frustum Camera::GetFrustum()
+{
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix));
+	XMMATRIX proj = XMMatrixTranspose(XMLoadFloat4x4(&projMatrix));
+	return Frustum::FromViewProjection(XMMatrixMultiply(view, proj));
+}
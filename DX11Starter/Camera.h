@@ -1,5 +1,7 @@
 #pragma once
 #include <DirectXMath.h>
+#include "FrustumCuller.h"
+#include "Input.h"
 
 
 class Camera
@@ -12,21 +14,30 @@ public:
 	void MoveRelative(float x, float y, float z);
 	void MoveAbsolute(float x, float y, float z);
 	void Rotate(float x, float y);
+	void SetPose(DirectX::XMFLOAT3 position, float xRotation, float yRotation);
 
 	// Updating
-	void Update(float dt);
+	void Update(float dt, Input* input);
 	void UpdateViewMatrix();
 	void UpdateProjectionMatrix(float aspectRatio);
 
+	// Fixed step support - saves the pose before a step, and
+	// builds the view from between that and the current pose
+	void BeginStep();
+	void Interpolate(float alpha);
+
 	// Getters
 	DirectX::XMFLOAT3 GetPosition() { return position; }
 	DirectX::XMFLOAT4X4 GetView() { return viewMatrix; }
 	DirectX::XMFLOAT4X4 GetProjection() { return projMatrix; }
+	float GetFarClip() { return farClip; }
+	Frustum GetFrustum();
 
 private:
 	// Camera matrices
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
+	float farClip;
 
 	// Transformations
 	DirectX::XMFLOAT3 startPosition;
@@ -34,5 +45,11 @@ private:
 	DirectX::XMFLOAT4 rotation;
 	float xRotation;
 	float yRotation;
+
+	// Pose as of the last BeginStep()
+	DirectX::XMFLOAT3 previousPosition;
+	DirectX::XMFLOAT4 previousRotation;
+
+	void BuildView(DirectX::FXMVECTOR position, DirectX::FXMVECTOR rotation);
 };
 
@@ -0,0 +1,62 @@
+#include "ConstantDirtyRange.h"
+
+#include <string.h>
+
+ConstantDirtyRange::ConstantDirtyRange()
+{
+	MarkClean();
+}
+
+void ConstantDirtyRange::MarkAll(unsigned int size)
+{
+	dirty = true;
+	start = 0;
+	end = size;
+}
+
+void ConstantDirtyRange::MarkClean()
+{
+	dirty = false;
+	start = 0;
+	end = 0;
+}
+
+bool ConstantDirtyRange::Write(unsigned char* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	unsigned char* dest = buffer + offset;
+	if (memcmp(dest, data, size) == 0)
+		return false;
+
+	memcpy(dest, data, size);
+
+	// Grow the range to cover this write
+	if (!dirty)
+	{
+		dirty = true;
+		start = offset;
+		end = offset + size;
+		return true;
+	}
+	if (offset < start)
+		start = offset;
+	if (offset + size > end)
+		end = offset + size;
+	return true;
+}
+
+bool ConstantDirtyRange::GetUploadRange(unsigned int size, bool partial, unsigned int* start, unsigned int* end) const
+{
+	if (!dirty)
+		return false;
+
+	*start = 0;
+	*end = size;
+	if (!partial)
+		return true;
+
+	// Expand the range to whole 16-byte constants
+	*start = this->start & ~15u;
+	*end = (this->end + 15u) & ~15u;
+	if (*end > size) *end = size;
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// --------------------------------------------------------
+// Tracks which bytes of a constant buffer's local copy have
+// changed since it was last uploaded.  Writes that don't
+// change anything leave it alone, so re-setting the same
+// values costs a compare rather than an upload.  It never
+// touches the GPU, so it can run anywhere.
+// --------------------------------------------------------
+class ConstantDirtyRange
+{
+public:
+	ConstantDirtyRange();
+
+	// The whole buffer needs to go up (say, the GPU copy
+	// starts uninitialized or was lost)
+	void MarkAll(unsigned int size);
+
+	// All caught up, after an upload
+	void MarkClean();
+
+	// Copies size bytes of data to buffer + offset, covering
+	// them with the range if anything differed.  Returns false
+	// if the bytes were already the same.
+	bool Write(unsigned char* buffer, unsigned int offset, const void* data, unsigned int size);
+
+	// What to upload of a buffer of the given size: the range
+	// widened to whole 16 byte constants when partial uploads
+	// are possible, or else all of it.  False if it's clean.
+	bool GetUploadRange(unsigned int size, bool partial, unsigned int* start, unsigned int* end) const;
+
+	// Getters
+	bool IsDirty() const { return dirty; }
+	unsigned int GetStart() const { return start; }
+	unsigned int GetEnd() const { return end; }
+
+private:
+	bool dirty;
+	unsigned int start;
+	unsigned int end;
+};
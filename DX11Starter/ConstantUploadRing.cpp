@@ -0,0 +1,161 @@
+#include "ConstantUploadRing.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Constructor - creates the shared dynamic buffer and the
+// queries used as frame fences
+//
+// sizeInBytes  - Total size of the ring (should comfortably hold
+//                a few frames' worth of constant data)
+// renderDevice - If set, slices are written through this rather
+//                than by mapping the buffer on the context directly
+// --------------------------------------------------------
+ConstantUploadRing::ConstantUploadRing(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int sizeInBytes, IRenderDevice* renderDevice)
+	: ring(sizeInBytes, 256)
+{
+	this->context = context;
+	this->renderDevice = renderDevice;
+	context1 = 0;
+	buffer = 0;
+	mappedOnce = false;
+	frameFence = 1;
+	completedFence = 0;
+	for (unsigned int i = 0; i < MaxFramesInFlight; i++)
+		fenceQueries[i] = 0;
+
+	// Offset binding and NO_OVERWRITE maps of constant
+	// buffers both need 11.1 runtime and driver support
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	supported =
+		SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferOffsetting &&
+		options.MapNoOverwriteOnDynamicConstantBuffer &&
+		SUCCEEDED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1));
+	if (!supported)
+		return;
+
+	// Create the shared buffer itself
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = ring.GetCapacity();
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	device->CreateBuffer(&desc, 0, &buffer);
+
+	// One event query per frame that can be in flight
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < MaxFramesInFlight; i++)
+		device->CreateQuery(&queryDesc, &fenceQueries[i]);
+
+	supported = buffer != 0;
+}
+
+// --------------------------------------------------------
+// Destructor - Release all DirectX objects
+// --------------------------------------------------------
+ConstantUploadRing::~ConstantUploadRing()
+{
+	for (unsigned int i = 0; i < MaxFramesInFlight; i++)
+		if (fenceQueries[i]) { fenceQueries[i]->Release(); }
+
+	if (buffer) { buffer->Release(); }
+	if (context1) { context1->Release(); }
+}
+
+// --------------------------------------------------------
+// Recycles the slices of any frames the GPU has finished
+// --------------------------------------------------------
+void ConstantUploadRing::BeginFrame()
+{
+	if (!supported) return;
+	PollFences(false);
+}
+
+// --------------------------------------------------------
+// Signals this frame's fence and moves on to the next frame.
+// Blocks if too many frames are already in flight.
+// --------------------------------------------------------
+void ConstantUploadRing::EndFrame()
+{
+	if (!supported) return;
+
+	// Make room for another fence if we've run out
+	if (frameFence - completedFence > MaxFramesInFlight)
+		PollFences(true);
+
+	context->End(fenceQueries[frameFence % MaxFramesInFlight]);
+	ring.EndFrame(frameFence);
+	frameFence++;
+}
+
+// --------------------------------------------------------
+// Checks outstanding fences in order, retiring any that have
+// completed.  Optionally waits on the oldest one.
+// --------------------------------------------------------
+void ConstantUploadRing::PollFences(bool waitForOldest)
+{
+	while (completedFence + 1 < frameFence)
+	{
+		ID3D11Query* query = fenceQueries[(completedFence + 1) % MaxFramesInFlight];
+		BOOL done = FALSE;
+		HRESULT hr = context->GetData(query, &done, sizeof(done), waitForOldest ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+
+		if (hr == S_OK && done)
+		{
+			completedFence++;
+			waitForOldest = false;
+			continue;
+		}
+
+		// Keep spinning only if we must free something up
+		if (!waitForOldest)
+			break;
+	}
+
+	ring.Retire(completedFence);
+}
+
+// --------------------------------------------------------
+// Copies constant data into a new slice of the ring
+//
+// data, size    - The constant data to copy
+// firstConstant - Receives the slice offset in 16-byte constants
+// numConstants  - Receives the slice size in 16-byte constants
+//
+// Returns false if the ring is unsupported or out of space,
+// in which case the caller should fall back to its own buffer
+// --------------------------------------------------------
+bool ConstantUploadRing::Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* numConstants)
+{
+	if (!supported) return false;
+
+	unsigned int offset;
+	if (!ring.Allocate(size, &offset))
+		return false;
+
+	// NO_OVERWRITE is safe since the ring never hands out memory
+	// the GPU might still be reading, but the very first map
+	// of a dynamic buffer has to be a DISCARD
+	if (renderDevice)
+	{
+		if (!renderDevice->WriteBuffer(buffer, offset, data, size, !mappedOnce))
+			return false;
+	}
+	else
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		D3D11_MAP mapType = mappedOnce ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD;
+		if (FAILED(context->Map(buffer, 0, mapType, 0, &mapped)))
+			return false;
+		memcpy((unsigned char*)mapped.pData + offset, data, size);
+		context->Unmap(buffer, 0);
+	}
+	mappedOnce = true;
+
+	// Offsets and sizes are in constants, and must be multiples of 16 of them
+	*firstConstant = offset / 16;
+	*numConstants = ((size + 255) & ~255u) / 16;
+	return true;
+}
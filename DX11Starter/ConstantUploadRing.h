@@ -0,0 +1,59 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+
+#include "UploadRing.h"
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// One large dynamic constant buffer shared by many shaders.
+// Constant data is written into 256-byte aligned slices with
+// MAP_WRITE_NO_OVERWRITE and bound with offsets (11.1), so
+// per-draw updates don't each need their own buffer update.
+//
+// Event queries act as frame fences - a frame's slices are
+// only recycled once the GPU has finished with that frame.
+// --------------------------------------------------------
+class ConstantUploadRing
+{
+public:
+	ConstantUploadRing(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int sizeInBytes, IRenderDevice* renderDevice = 0);
+	~ConstantUploadRing();
+
+	// Is the 11.1 functionality we need available?
+	bool IsSupported() { return supported; }
+
+	// Frame boundaries
+	void BeginFrame();
+	void EndFrame();
+
+	// Copies data into a fresh slice, returning its position in
+	// 16-byte constants for the *SetConstantBuffers1 calls
+	bool Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* numConstants);
+
+	// Getters
+	ID3D11Buffer* GetBuffer() { return buffer; }
+	ID3D11DeviceContext1* GetContext1() { return context1; }
+	unsigned long long GetFrame() { return frameFence; }
+	UploadRing* GetRing() { return &ring; }
+
+private:
+	static const unsigned int MaxFramesInFlight = 4;
+
+	bool supported;
+	ID3D11DeviceContext* context;
+	ID3D11DeviceContext1* context1;
+	IRenderDevice* renderDevice;	// Optional, for writing slices
+	ID3D11Buffer* buffer;
+	bool mappedOnce;
+
+	UploadRing ring;
+
+	// Frame fences
+	ID3D11Query* fenceQueries[MaxFramesInFlight];
+	unsigned long long frameFence;		// Fence value of the frame being recorded
+	unsigned long long completedFence;	// Newest fence the GPU is known to have finished
+
+	void PollFences(bool waitForOldest);
+};
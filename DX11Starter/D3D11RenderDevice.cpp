@@ -0,0 +1,241 @@
+#include "D3D11RenderDevice.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Constructor - grabs the 11.1 interface too, if there is one,
+// for offset constant buffer binds and partial updates
+// --------------------------------------------------------
+D3D11RenderDevice::D3D11RenderDevice(ID3D11DeviceContext* context)
+{
+	this->context = context;
+	context1 = 0;
+	context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1);
+}
+
+// --------------------------------------------------------
+// Destructor - Release the 11.1 interface if we got one
+// --------------------------------------------------------
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	if (context1) { context1->Release(); }
+}
+
+
+// ------ INPUT ASSEMBLER ---------------------------------
+
+void D3D11RenderDevice::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderDevice::IASetPrimitiveTopology(unsigned int topology)
+{
+	context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderDevice::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void D3D11RenderDevice::IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+	context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset);
+}
+
+
+// ------ SHADER STAGES -----------------------------------
+
+void D3D11RenderDevice::VSSetShader(ID3D11VertexShader* shader)
+{
+	context->VSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderDevice::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderDevice::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	// Only reachable with 11.1 support, since that's what gave out the offsets
+	context1->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+}
+
+void D3D11RenderDevice::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->VSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11RenderDevice::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->VSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11RenderDevice::PSSetShader(ID3D11PixelShader* shader)
+{
+	context->PSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderDevice::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderDevice::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	context1->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+}
+
+void D3D11RenderDevice::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11RenderDevice::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+
+// ------ RASTERIZER AND OUTPUT MERGER --------------------
+
+void D3D11RenderDevice::RSSetState(ID3D11RasterizerState* state)
+{
+	context->RSSetState(state);
+}
+
+void D3D11RenderDevice::RSSetViewports(unsigned int numViewports, const RenderViewport* viewports)
+{
+	context->RSSetViewports(numViewports, (const D3D11_VIEWPORT*)viewports);
+}
+
+void D3D11RenderDevice::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void D3D11RenderDevice::OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+	context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void D3D11RenderDevice::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil)
+{
+	context->OMSetRenderTargets(numViews, renderTargets, depthStencil);
+}
+
+
+// ------ UPLOADS -----------------------------------------
+
+void D3D11RenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+void D3D11RenderDevice::UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end)
+{
+	D3D11_BOX box = {};
+	box.left = start;
+	box.right = end;
+	box.bottom = 1;
+	box.back = 1;
+	context1->UpdateSubresource1(buffer, 0, &box, data, 0, 0, 0);
+}
+
+bool D3D11RenderDevice::WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	D3D11_MAP mapType = discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(context->Map(buffer, 0, mapType, 0, &mapped)))
+		return false;
+
+	memcpy((unsigned char*)mapped.pData + offset, data, size);
+	context->Unmap(buffer, 0);
+	return true;
+}
+
+
+// ------ CLEARS, DRAWING AND MISC ------------------------
+
+void D3D11RenderDevice::ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4])
+{
+	context->ClearRenderTargetView(renderTarget, color);
+}
+
+void D3D11RenderDevice::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil)
+{
+	context->ClearDepthStencilView(depthStencil, clearFlags, depth, stencil);
+}
+
+void D3D11RenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderDevice::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderDevice::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	context->GenerateMips(view);
+}
+
+void D3D11RenderDevice::Flush()
+{
+	context->Flush();
+}
+
+
+// ------ DEFERRED COMMAND LISTS --------------------------
+
+D3D11CommandList::D3D11CommandList(ID3D11Device* device, ID3D11DeviceContext* immediateContext)
+{
+	this->immediateContext = immediateContext;
+	deferredContext = 0;
+	recorder = 0;
+	commandList = 0;
+
+	if (SUCCEEDED(device->CreateDeferredContext(0, &deferredContext)))
+		recorder = new D3D11RenderDevice(deferredContext);
+}
+
+D3D11CommandList::~D3D11CommandList()
+{
+	delete recorder;
+	if (commandList) { commandList->Release(); }
+	if (deferredContext) { deferredContext->Release(); }
+}
+
+IRenderDevice* D3D11CommandList::Begin()
+{
+	if (commandList) { commandList->Release(); commandList = 0; }
+	return recorder;
+}
+
+// --------------------------------------------------------
+// Closes the recording - the deferred context is left
+// blank for the next one
+// --------------------------------------------------------
+void D3D11CommandList::Finish()
+{
+	deferredContext->FinishCommandList(FALSE, &commandList);
+}
+
+void D3D11CommandList::Execute(IRenderDevice* target)
+{
+	if (!commandList)
+		return;
+
+	immediateContext->ExecuteCommandList(commandList, TRUE);
+	commandList->Release();
+	commandList = 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+
+#include "RenderDevice.h"
+
+static_assert(sizeof(RenderViewport) == sizeof(D3D11_VIEWPORT), "RenderViewport must match D3D11_VIEWPORT");
+
+// --------------------------------------------------------
+// Lets D3D viewports be handed straight to a render device
+// --------------------------------------------------------
+inline const RenderViewport* AsRenderViewport(const D3D11_VIEWPORT* viewport)
+{
+	return (const RenderViewport*)viewport;
+}
+
+// --------------------------------------------------------
+// Render device that forwards everything to a real D3D11
+// device context
+// --------------------------------------------------------
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(ID3D11DeviceContext* context);
+	~D3D11RenderDevice();
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer and output merger
+	void RSSetState(ID3D11RasterizerState* state);
+	void RSSetViewports(unsigned int numViewports, const RenderViewport* viewports);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil);
+
+	// Uploads
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end);
+	bool WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard);
+
+	// Clears
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil);
+
+	// Drawing and misc
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void GenerateMips(ID3D11ShaderResourceView* view);
+	void Flush();
+
+	ID3D11DeviceContext* GetContext() { return context; }
+
+private:
+	ID3D11DeviceContext* context;
+	ID3D11DeviceContext1* context1;	// Null without the 11.1 runtime
+};
+
+// --------------------------------------------------------
+// Command list recorded on a D3D11 deferred context, and run
+// with ExecuteCommandList() on the immediate one.
+//
+// A deferred context starts each list with nothing bound,
+// and the immediate context's state is put back once the
+// list has run, so the main thread's state cache stays
+// valid either way.
+// --------------------------------------------------------
+class D3D11CommandList : public IRenderCommandList
+{
+public:
+	D3D11CommandList(ID3D11Device* device, ID3D11DeviceContext* immediateContext);
+	~D3D11CommandList();
+
+	// False if the deferred context couldn't be made
+	bool IsValid() { return recorder != 0; }
+
+	IRenderDevice* Begin();
+	void Finish();
+	void Execute(IRenderDevice* target);
+	bool StartsBlank() { return true; }
+
+private:
+	ID3D11DeviceContext* immediateContext;
+	ID3D11DeviceContext* deferredContext;
+	D3D11RenderDevice* recorder;
+	ID3D11CommandList* commandList;
+};
@@ -1,4 +1,6 @@
 #include "DXCore.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
 
 #include <WindowsX.h>
 #include <sstream>
@@ -52,6 +54,11 @@ DXCore::DXCore(
 	// Initialize fields
 	fpsFrameCount = 0;
 	fpsTimeElapsed = 0.0f;
+	cpuTime = -1.0f;
+	frameAllocations = 0;
+	fastForwardSteps = 0;
+	pipelined = false;
+	jobs = 0;
 	
 	device = 0;
 	context = 0;
@@ -426,7 +433,19 @@ HRESULT DXCore::Run()
 	previousTime = now;
 
 	// Give subclass a chance to initialize
-	Init();
+	{
+		PROFILE_SCOPE("Init");
+		Init();
+	}
+
+	// Run any steps asked for ahead of time, without drawing
+	for (unsigned int i = 0; i < fastForwardSteps; i++)
+		RunSimulationStep();
+
+	// Don't count loading as part of the first frame
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	currentTime = now;
+	previousTime = now;
 
 	// Our overall game and message loop
 	MSG msg = {};
@@ -444,12 +463,30 @@ HRESULT DXCore::Run()
 		{
 			// Update timer and title bar (if necessary)
 			UpdateTimer();
+			RecordFrameTime();
 			if(titleBarStats)
 				UpdateTitleBarStats();
+			UpdateInput();
+			unsigned long long allocationsBefore = AllocationCounter::GetAllocations();
 
 			// The game loop
-			Update(deltaTime, totalTime);
-			Draw(deltaTime, totalTime);
+			if (pipelined && jobs)
+			{
+				RunPipelinedFrame();
+			}
+			else
+			{
+				framePipeline.BeginSerialFrame();
+				SimulateFrame();
+				PROFILE_SCOPE("Draw");
+				Draw(deltaTime, totalTime);
+			}
+			Profiler::EndFrame();
+			frameAllocations = (unsigned int)(AllocationCounter::GetAllocations() - allocationsBefore);
+
+			__int64 frameEnd;
+			QueryPerformanceCounter((LARGE_INTEGER*)&frameEnd);
+			cpuTime = (float)((frameEnd - currentTime) * perfCounterSeconds * 1000.0);
 		}
 	}
 
@@ -459,6 +496,93 @@ HRESULT DXCore::Run()
 }
 
 
+// --------------------------------------------------------
+// Saves every frame's input to a file, or plays a saved
+// file back in place of the keyboard and mouse
+// --------------------------------------------------------
+bool DXCore::RecordInput(std::string path)
+{
+	return input.StartRecording(path);
+}
+
+bool DXCore::ReplayInput(std::string path)
+{
+	return input.StartReplay(path);
+}
+
+
+// --------------------------------------------------------
+// Sets how many simulation steps run per second.  Zero runs
+// one step per frame instead, as long as the frame.
+// --------------------------------------------------------
+void DXCore::SetSimulationRate(float stepsPerSecond)
+{
+	simulation.SetRate(stepsPerSecond);
+}
+
+// --------------------------------------------------------
+// Runs this many steps straight after Init(), before the
+// first frame is drawn
+// --------------------------------------------------------
+void DXCore::FastForward(unsigned int steps)
+{
+	fastForwardSteps = steps;
+}
+
+// --------------------------------------------------------
+// Overlaps each frame's simulation with drawing the one
+// before it.  Takes effect from the next frame.
+// --------------------------------------------------------
+void DXCore::SetPipelined(bool pipelined)
+{
+	this->pipelined = pipelined;
+	framePipeline.Reset();
+}
+
+// --------------------------------------------------------
+// As many steps as fit in the time that's passed, then the
+// frame to draw, from between the last two
+// --------------------------------------------------------
+void DXCore::SimulateFrame()
+{
+	unsigned int steps = simulation.Advance(deltaTime);
+	for (unsigned int i = 0; i < steps; i++)
+		RunSimulationStep();
+	if (simulation.IsInterpolating())
+		Interpolate(simulation.GetAlpha());
+	PrepareFrame();
+}
+
+void DXCore::SimulateFrameJob(void* core)
+{
+	((DXCore*)core)->SimulateFrame();
+}
+
+// --------------------------------------------------------
+// Prepares this frame on a worker while this thread draws
+// the last one, one frame behind.  Messages aren't pumped
+// until both are done, so input can't change under the
+// simulation either.
+// --------------------------------------------------------
+void DXCore::RunPipelinedFrame()
+{
+	if (framePipeline.BeginFrame(jobs, SimulateFrameJob, this))
+	{
+		PROFILE_SCOPE("Draw");
+		Draw(deltaTime, totalTime);
+	}
+	framePipeline.EndFrame(jobs);
+}
+
+void DXCore::RunSimulationStep()
+{
+	PROFILE_SCOPE("Update");
+	Update(simulation.GetStep(), (float)simulation.GetTime());
+	simulation.CompleteStep();
+	input.ConsumeFrame();
+}
+
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -493,6 +617,44 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Takes this frame's input snapshot, polling the whole
+// keyboard at once.  Replayed input brings its own delta
+// time, and ends the game once it runs out.
+// --------------------------------------------------------
+void DXCore::UpdateInput()
+{
+	unsigned char keyStates[256];
+	if (!GetKeyboardState(keyStates))
+		memset(keyStates, 0, sizeof(keyStates));
+
+	bool wasReplaying = input.IsReplaying();
+	input.BeginFrame(keyStates, deltaTime);
+	deltaTime = input.GetDeltaTime();
+
+	if (wasReplaying && input.ReplayFinished())
+		Quit();
+}
+
+
+// --------------------------------------------------------
+// Hands the frame that just finished to the frame time
+// recorder, reporting it in the console if it stuttered
+// --------------------------------------------------------
+void DXCore::RecordFrameTime()
+{
+	// Nothing's finished yet on the first frame
+	if (cpuTime < 0.0f)
+		return;
+
+	if (frameTimes.Record(deltaTime * 1000.0f, cpuTime))
+	{
+		const FrameSpike& spike = frameTimes.GetSpikes().back();
+		printf("Frame %u took %.2fms (median %.2fms)\n", spike.Frame, spike.FrameTime, spike.Median);
+	}
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -534,6 +696,9 @@ void DXCore::UpdateTitleBarStats()
 	default:                     output << "    DX ???";  break;
 	}
 
+	// Anything the game wants to add
+	output << GetTitleBarStats();
+
 	// Actually update the title bar and reset fps data
 	SetWindowText(hWnd, output.str().c_str());
 	fpsFrameCount = 0;
@@ -582,6 +747,25 @@ void DXCore::CreateConsoleWindow(int bufferLines, int bufferColumns, int windowL
 
 
 
+// --------------------------------------------------------
+// Which button a mouse button message is about
+// --------------------------------------------------------
+MouseButton DXCore::GetMessageButton(UINT msg)
+{
+	switch (msg)
+	{
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+		return MOUSE_RIGHT;
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONUP:
+		return MOUSE_MIDDLE;
+	default:
+		return MOUSE_LEFT;
+	}
+}
+
+
 // --------------------------------------------------------
 // Handles messages that are sent to our window by the
 // operating system.  Ignoring these messages would cause
@@ -631,6 +815,8 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	case WM_LBUTTONDOWN:
 	case WM_MBUTTONDOWN:
 	case WM_RBUTTONDOWN:
+		input.OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		input.OnMouseButton(GetMessageButton(uMsg), true);
 		OnMouseDown(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 
@@ -638,18 +824,28 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	case WM_LBUTTONUP:
 	case WM_MBUTTONUP:
 	case WM_RBUTTONUP:
+		input.OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		input.OnMouseButton(GetMessageButton(uMsg), false);
 		OnMouseUp(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 
 	// Cursor moves over the window (or outside, while we're currently capturing it)
 	case WM_MOUSEMOVE:
+		input.OnMouseMove(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		OnMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 
 	// Mouse wheel is scrolled
 	case WM_MOUSEWHEEL:
+		input.OnMouseWheel(GET_WHEEL_DELTA_WPARAM(wParam) / (float)WHEEL_DELTA);
 		OnMouseWheel(GET_WHEEL_DELTA_WPARAM(wParam) / (float)WHEEL_DELTA, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+
+	// F9 saves the frame times so far
+	case WM_KEYDOWN:
+		if (wParam == VK_F9 && frameTimes.WriteCSV("frametimes.csv", "frametimes_histogram.csv"))
+			printf("Saved %u frame times to frametimes.csv\n", frameTimes.GetFrameCount());
+		break;
 	}
 
 	// Let Windows handle any messages we're not touching
@@ -4,6 +4,12 @@
 #include <d3d11.h>
 #include <string>
 
+#include "FrameTimeRecorder.h"
+#include "Input.h"
+#include "FixedStepLoop.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
+
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
@@ -37,12 +43,31 @@ public:
 	HRESULT Run();				
 	void Quit();
 	virtual void OnResize();
+
+	// Input streams, for repeatable runs
+	bool RecordInput(std::string path);
+	bool ReplayInput(std::string path);
+
+	// Simulation timing
+	void SetSimulationRate(float stepsPerSecond);
+	void FastForward(unsigned int steps);
+	void SetPipelined(bool pipelined);
 	
 	// Pure virtual methods for setup and game functionality
 	virtual void Init()										= 0;
 	virtual void Update(float deltaTime, float totalTime)	= 0;
 	virtual void Draw(float deltaTime, float totalTime)		= 0;
 
+	// Called before drawing when there's time left over after
+	// the last fixed step, with how far into the next it is
+	virtual void Interpolate(float alpha) { }
+
+	// Called after the simulation, to gather what Draw() needs
+	// into the framePipeline's prepare slot.  When pipelined,
+	// this and Update() run on a worker, alongside Draw()
+	// drawing its submit slot.
+	virtual void PrepareFrame() { }
+
 	// Convenience methods for handling mouse input, since we
 	// can easily grab mouse input from OS-level messages
 	virtual void OnMouseDown (WPARAM buttonState, int x, int y) { }
@@ -72,9 +97,30 @@ protected:
 	ID3D11ShaderResourceView* occlusionSRV;
 	D3D11_VIEWPORT viewport;
 
+	// Keyboard and mouse as of the start of this frame
+	Input input;
+
+	// Decides how many times Update() runs each frame
+	FixedStepLoop simulation;
+
+	// Workers for the game to share, which also run the
+	// simulation when pipelined (the game creates them)
+	JobSystem* jobs;
+
+	// Which of two frames is being prepared, and which drawn
+	FramePipeline framePipeline;
+
+	// Heap allocations made during the last frame's update and
+	// draw, on any thread (the title bar's own aren't counted).
+	// Always 0 unless AllocationCounter::IsEnabled().
+	unsigned int frameAllocations;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
+	// Optional extra text for the title bar stats
+	virtual std::string GetTitleBarStats() { return ""; }
+
 private:
 	// Timing related data
 	double perfCounterSeconds;
@@ -87,8 +133,22 @@ private:
 	// FPS calculation
 	int fpsFrameCount;
 	float fpsTimeElapsed;
-	
+
+	// Every frame's time, and how much of it was update and draw
+	FrameTimeRecorder frameTimes;
+	float cpuTime;
+
 	void UpdateTimer();			// Updates the timer for this frame
+	void RecordFrameTime();		// Tracks the last frame's time and any stutter
+	void UpdateInput();			// Takes this frame's input snapshot
+	void RunSimulationStep();	// Calls Update() once, with a step's time
+	void SimulateFrame();		// Runs this frame's steps and prepares it
+	void RunPipelinedFrame();	// Prepares this frame while drawing the last
+	static void SimulateFrameJob(void* core);
+
+	unsigned int fastForwardSteps;
+	bool pipelined;
+	static MouseButton GetMessageButton(UINT msg);
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
 };
 
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "RenderDevice.h"
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// What a list that starts blank needs bound before its draws:
+// everything in the cache, plus what the cache doesn't track
+// or may have forgotten since it was last bound
+// --------------------------------------------------------
+struct DrawListSetup
+{
+	StateCache* Cache;
+	ID3D11RenderTargetView* RenderTarget;
+	ID3D11DepthStencilView* DepthStencil;
+	unsigned int Topology;
+};
+
+// --------------------------------------------------------
+// Records runCount draw runs across lists on the job system,
+// each list taking an even, in-order share through
+// record(target, first, last).  Playing the lists back in
+// order draws the same as recording every run on one device.
+// --------------------------------------------------------
+template<typename Record>
+void RecordDrawLists(JobSystem* jobs, const std::vector<IRenderCommandList*>& lists, const DrawListSetup& setup, unsigned int runCount, const Record& record)
+{
+	unsigned int listCount = (unsigned int)lists.size();
+	jobs->ParallelFor(listCount, 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			PROFILE_SCOPE("Record Draw List");
+
+			IRenderCommandList* list = lists[i];
+			IRenderDevice* target = list->Begin();
+			if (list->StartsBlank())
+			{
+				// Topology is only bound once at startup, so the
+				// cache forgets it whenever it's invalidated
+				setup.Cache->ApplyTo(target);
+				target->IASetPrimitiveTopology(setup.Topology);
+				target->OMSetRenderTargets(1, &setup.RenderTarget, setup.DepthStencil);
+			}
+
+			record(target, runCount * i / listCount, runCount * (i + 1) / listCount);
+			list->Finish();
+		}
+	});
+}
@@ -0,0 +1,31 @@
+#include "DrawRun.h"
+
+// --------------------------------------------------------
+// Walks the queue, cutting a new run wherever the mesh or
+// material changes
+// --------------------------------------------------------
+unsigned int BuildDrawRuns(const RenderQueueEntry* queued, unsigned int count, const OpaqueDraw* draws,
+	DirectX::XMFLOAT4X4* instances, DrawRun* runs)
+{
+	unsigned int runCount = 0;
+	unsigned int first = 0;
+	while (first < count)
+	{
+		const OpaqueDraw& draw = draws[queued[first].Payload];
+
+		// Find the end of this run of matching draws
+		unsigned int end = first;
+		while (end < count)
+		{
+			const OpaqueDraw& next = draws[queued[end].Payload];
+			if (next.SubMesh != draw.SubMesh || next.Material != draw.Material)
+				break;
+			instances[end++] = next.World;
+		}
+
+		DrawRun run = { draw.SubMesh, draw.Entity, draw.Material, first, end - first };
+		runs[runCount++] = run;
+		first = end;
+	}
+	return runCount;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "RenderQueue.h"
+
+class Mesh;
+class GameEntity;
+
+// --------------------------------------------------------
+// Payload of a queued opaque draw
+// --------------------------------------------------------
+struct OpaqueDraw
+{
+	Mesh* SubMesh;
+	GameEntity* Entity;
+	unsigned int Material;	// Textures and AO map
+	DirectX::XMFLOAT4X4 World;	// Transposed, including the mesh's node
+};
+
+// --------------------------------------------------------
+// Queued draws sharing a mesh and material, drawn as one
+// instanced call
+// --------------------------------------------------------
+struct DrawRun
+{
+	Mesh* SubMesh;
+	GameEntity* Entity;		// Any of them, for the textures
+	unsigned int Material;
+	unsigned int FirstInstance;
+	unsigned int InstanceCount;
+};
+
+// --------------------------------------------------------
+// Groups sorted queue entries (whose payloads index draws)
+// into runs of the same mesh and material.  Each entry's
+// world matrix goes to instances, in queue order, and each
+// run to runs - both need room for count.  Returns the
+// number of runs.
+// --------------------------------------------------------
+unsigned int BuildDrawRuns(const RenderQueueEntry* queued, unsigned int count, const OpaqueDraw* draws,
+	DirectX::XMFLOAT4X4* instances, DrawRun* runs);
@@ -0,0 +1,53 @@
+#include "FixedStepLoop.h"
+
+FixedStepLoop::FixedStepLoop(float rate, unsigned int maxSteps)
+{
+	this->maxSteps = maxSteps;
+	lockstep = false;
+	accumulator = 0.0;
+	time = 0.0;
+	alpha = 1.0f;
+	steps = 0;
+	droppedSteps = 0;
+	SetRate(rate);
+}
+
+void FixedStepLoop::SetRate(float rate)
+{
+	this->rate = rate > 0.0f ? rate : 0.0f;
+	step = rate > 0.0f ? 1.0f / rate : 0.0f;
+	accumulator = 0.0;
+	alpha = 1.0f;
+}
+
+unsigned int FixedStepLoop::Advance(double elapsed)
+{
+	if (elapsed < 0.0)
+		elapsed = 0.0;
+
+	// Variable length steps
+	if (rate == 0.0f)
+	{
+		step = (float)elapsed;
+		alpha = 1.0f;
+		return 1;
+	}
+
+	if (lockstep)
+	{
+		alpha = 1.0f;
+		return 1;
+	}
+
+	accumulator += elapsed;
+	unsigned int count = (unsigned int)(accumulator / step);
+	accumulator -= count * (double)step;
+	if (count > maxSteps)
+	{
+		droppedSteps += count - maxSteps;
+		count = maxSteps;
+	}
+
+	alpha = (float)(accumulator / step);
+	return count;
+}
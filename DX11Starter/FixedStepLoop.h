@@ -0,0 +1,51 @@
+#pragma once
+
+// --------------------------------------------------------
+// Decides how many fixed length simulation steps to run each
+// frame, and how far between the last two steps to draw.
+//
+// Real time goes in through Advance(), so the caller picks
+// the clock - a performance counter, recorded frame times,
+// or anything a test wants.  Time left over after the last
+// step carries into the next frame, and past MaxSteps in
+// one frame it's dropped instead, so a slow frame can't
+// snowball into ever more steps.
+//
+// With a rate of zero there's one step per frame, as long
+// as the frame.  In lockstep there's one step per frame, as
+// long as a fixed step - for runs that should play out the
+// same however fast frames are.
+// --------------------------------------------------------
+class FixedStepLoop
+{
+public:
+	FixedStepLoop(float rate = 60.0f, unsigned int maxSteps = 8);
+
+	void SetRate(float rate);
+	void SetLockstep(bool lockstep) { this->lockstep = lockstep; }
+	bool IsInterpolating() { return rate > 0.0f && !lockstep; }
+
+	// Returns how many steps to run for this much real time
+	unsigned int Advance(double elapsed);
+
+	// Call after each step, to move simulation time on
+	void CompleteStep() { time += step; steps++; }
+
+	float GetStep() { return step; }
+	double GetTime() { return time; }
+	float GetAlpha() { return alpha; }	// 0 is the previous step, 1 the last
+	unsigned int GetStepCount() { return steps; }
+	unsigned int GetDroppedSteps() { return droppedSteps; }
+
+private:
+	float rate;
+	bool lockstep;
+	unsigned int maxSteps;
+
+	float step;
+	double accumulator;
+	double time;
+	float alpha;
+	unsigned int steps;
+	unsigned int droppedSteps;
+};
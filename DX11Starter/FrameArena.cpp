@@ -0,0 +1,97 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Threads are numbered as they first allocate, from any arena
+static std::atomic<unsigned int> nextThreadIndex(0);
+
+unsigned int FrameArena::GetThreadIndex()
+{
+	static thread_local unsigned int index = nextThreadIndex++;
+	return index;
+}
+
+FrameArena::FrameArena()
+{
+	for (ThreadChunks& t : threads)
+	{
+		t.Current = 0;
+		t.Used = 0;
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for (ThreadChunks& t : threads)
+	{
+		for (Chunk& chunk : t.Chunks)
+			::operator delete(chunk.Memory);
+	}
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	unsigned int index = GetThreadIndex();
+	if (index < MaxThreads - 1)
+		return Allocate(&threads[index], size, alignment);
+
+	std::lock_guard<std::mutex> lock(sharedMutex);
+	return Allocate(&threads[MaxThreads - 1], size, alignment);
+}
+
+// --------------------------------------------------------
+// Bumps through the current chunk, moving on to the next
+// kept one (or a new one, big enough for this) when full
+// --------------------------------------------------------
+void* FrameArena::Allocate(ThreadChunks* t, size_t size, size_t alignment)
+{
+	for (;;)
+	{
+		if (t->Current < t->Chunks.size())
+		{
+			const Chunk& chunk = t->Chunks[t->Current];
+			size_t start = (size_t)chunk.Memory;
+			size_t aligned = (start + t->Used + alignment - 1) & ~(alignment - 1);
+			if (aligned + size <= start + chunk.Size)
+			{
+				t->Used = aligned + size - start;
+				return (void*)aligned;
+			}
+
+			if (t->Current + 1 < t->Chunks.size())
+			{
+				t->Current++;
+				t->Used = 0;
+				continue;
+			}
+		}
+
+		Chunk chunk;
+		chunk.Size = std::max(ChunkSize, size + alignment);
+		chunk.Memory = (unsigned char*)::operator new(chunk.Size);
+		t->Chunks.push_back(chunk);
+		t->Current = (unsigned int)t->Chunks.size() - 1;
+		t->Used = 0;
+	}
+}
+
+void FrameArena::Reset()
+{
+	for (ThreadChunks& t : threads)
+	{
+		t.Current = 0;
+		t.Used = 0;
+	}
+}
+
+size_t FrameArena::GetCapacity()
+{
+	size_t total = 0;
+	for (ThreadChunks& t : threads)
+	{
+		for (Chunk& chunk : t.Chunks)
+			total += chunk.Size;
+	}
+	return total;
+}
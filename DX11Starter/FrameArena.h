@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// --------------------------------------------------------
+// Bump allocator for data that only lives for one frame.
+//
+// Each thread takes memory from its own chunks, so workers
+// never contend, and Reset() hands everything back at once.
+// Chunks are kept across resets, so once they've grown to
+// fit a frame, later frames never touch the heap.
+//
+// Nothing allocated here is ever destructed, so only keep
+// plain data in it.  Reset() must only be called while no
+// thread is using the arena.
+// --------------------------------------------------------
+class FrameArena
+{
+public:
+	static const size_t ChunkSize = 256 * 1024;
+	static const unsigned int MaxThreads = 64;	// Any more share the last slot
+
+	FrameArena();
+	~FrameArena();
+
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	template<typename T>
+	T* AllocateArray(unsigned int count) { return (T*)Allocate(count * sizeof(T), alignof(T)); }
+
+	void Reset();
+
+	// Bytes in every thread's chunks (so, the high water mark)
+	size_t GetCapacity();
+
+private:
+	struct Chunk
+	{
+		unsigned char* Memory;
+		size_t Size;
+	};
+
+	// One thread's chunks - Current is being bumped through,
+	// and any after it are free for reuse
+	struct ThreadChunks
+	{
+		std::vector<Chunk> Chunks;
+		unsigned int Current;
+		size_t Used;
+	};
+
+	ThreadChunks threads[MaxThreads];
+	std::mutex sharedMutex;	// Guards the last slot
+
+	static void* Allocate(ThreadChunks* chunks, size_t size, size_t alignment);
+	static unsigned int GetThreadIndex();
+};
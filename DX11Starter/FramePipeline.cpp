@@ -0,0 +1,41 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline()
+{
+	prepareSlot = 0;
+	submitSlot = 0;
+	framePrepared = false;
+	prepared = 0;
+}
+
+void FramePipeline::Reset()
+{
+	framePrepared = false;
+}
+
+// --------------------------------------------------------
+// Preparing always goes to the slot that isn't being drawn,
+// so the job can start before the draw does
+// --------------------------------------------------------
+bool FramePipeline::BeginFrame(JobSystem* jobs, JobFunction prepare, void* data)
+{
+	prepareSlot = submitSlot ^ 1;
+	jobs->Run(prepare, data, &prepared);
+	return framePrepared;
+}
+
+void FramePipeline::EndFrame(JobSystem* jobs)
+{
+	jobs->Wait(&prepared);
+	submitSlot = prepareSlot;
+	framePrepared = true;
+}
+
+// A serial frame's draw consumes what it prepared, so
+// there's nothing left over for a pipelined frame after it
+void FramePipeline::BeginSerialFrame()
+{
+	prepareSlot = 0;
+	submitSlot = 0;
+	framePrepared = false;
+}
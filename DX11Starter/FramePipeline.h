@@ -0,0 +1,47 @@
+#pragma once
+
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Double buffered handoff between preparing frames and
+// drawing them.
+//
+// Frame data lives in two slots.  Each pipelined frame, the
+// next one is prepared into one slot on a worker while the
+// last is drawn from the other, and the two sides only meet
+// at the job counter - so neither needs locks, as long as
+// preparing only writes GetPrepareSlot()'s data and drawing
+// only reads GetSubmitSlot()'s.  Serial frames prepare and
+// draw slot 0 in turn.
+// --------------------------------------------------------
+class FramePipeline
+{
+public:
+	FramePipeline();
+
+	// Drops any prepared frame, so the next pipelined frame
+	// has nothing to draw
+	void Reset();
+
+	// Queues prepare(data) for the other slot, and returns
+	// whether there's a prepared frame to draw meanwhile
+	bool BeginFrame(JobSystem* jobs, JobFunction prepare, void* data);
+
+	// Waits for the prepare job, then makes its slot the one
+	// drawn next
+	void EndFrame(JobSystem* jobs);
+
+	// Points both slots at 0, for preparing then drawing on
+	// one thread
+	void BeginSerialFrame();
+
+	// Getters
+	unsigned int GetPrepareSlot() { return prepareSlot; }
+	unsigned int GetSubmitSlot() { return submitSlot; }
+
+private:
+	unsigned int prepareSlot;
+	unsigned int submitSlot;
+	bool framePrepared;
+	JobCounter prepared;
+};
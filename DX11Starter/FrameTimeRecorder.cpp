@@ -0,0 +1,118 @@
+#include "FrameTimeRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+const float FrameTimeRecorder::FirstBinTime = 0.125f;
+
+FrameTimeRecorder::FrameTimeRecorder()
+{
+	frameCount = 0;
+	spikeMultiplier = 2.0f;
+	for (unsigned int i = 0; i < BinCount; i++)
+		histogram[i] = 0;
+}
+
+bool FrameTimeRecorder::Record(float frameTime, float cpuTime)
+{
+	// Compare against the frames before this one, so a long
+	// stutter can't raise its own bar
+	float median = RecentMedian();
+
+	FrameRecord record = { frameTime, cpuTime };
+	if (frames.size() < Capacity)
+		frames.push_back(record);
+	else
+		frames[frameCount % Capacity] = record;
+
+	// Everything under the first bin goes in it, and everything
+	// over the last in that
+	int bin = 0;
+	if (frameTime > FirstBinTime)
+		bin = (int)(log2f(frameTime / FirstBinTime) * BinsPerDoubling);
+	histogram[std::min(std::max(bin, 0), (int)BinCount - 1)]++;
+
+	unsigned int frame = frameCount++;
+	if (median <= 0.0f || frameTime <= median * spikeMultiplier)
+		return false;
+
+	if (spikes.size() == MaxSpikes)
+		spikes.erase(spikes.begin());
+
+	FrameSpike spike;
+	spike.Frame = frame;
+	spike.FrameTime = frameTime;
+	spike.Median = median;
+	if (Profiler::IsEnabled())
+		Profiler::GetLastFrameScopes(&spike.Scopes);
+	spikes.push_back(spike);
+	return true;
+}
+
+// Zero until there are enough frames to go on
+float FrameTimeRecorder::RecentMedian()
+{
+	if (frameCount < MedianWindow)
+		return 0.0f;
+
+	medianScratch.resize(MedianWindow);
+	for (unsigned int i = 0; i < MedianWindow; i++)
+		medianScratch[i] = frames[(frameCount - 1 - i) % Capacity].FrameTime;
+
+	std::nth_element(medianScratch.begin(), medianScratch.begin() + MedianWindow / 2, medianScratch.end());
+	return medianScratch[MedianWindow / 2];
+}
+
+float FrameTimeRecorder::GetBinStart(unsigned int bin)
+{
+	return FirstBinTime * powf(2.0f, (float)bin / BinsPerDoubling);
+}
+
+bool FrameTimeRecorder::WriteCSV(const std::string& framePath, const std::string& histogramPath)
+{
+	std::ofstream frameFile(framePath);
+	if (!frameFile)
+		return false;
+
+	// Spikes are in frame order, so walk them alongside
+	unsigned int kept = (unsigned int)frames.size();
+	unsigned int first = frameCount - kept;
+	unsigned int nextSpike = 0;
+	while (nextSpike < spikes.size() && spikes[nextSpike].Frame < first)
+		nextSpike++;
+
+	frameFile << "Frame,FrameMs,CpuMs,Spike,Scopes\n";
+	for (unsigned int frame = first; frame < frameCount; frame++)
+	{
+		const FrameRecord& record = frames[frame % Capacity];
+		frameFile << frame << "," << record.FrameTime << "," << record.CpuTime << ",";
+
+		if (nextSpike < spikes.size() && spikes[nextSpike].Frame == frame)
+		{
+			// Scopes as "Name ms" pairs, indented by depth
+			frameFile << "1,\"";
+			const FrameSpike& spike = spikes[nextSpike++];
+			for (unsigned int i = 0; i < spike.Scopes.size(); i++)
+			{
+				const ProfileEvent& e = spike.Scopes[i];
+				frameFile << (i > 0 ? "; " : "") << std::string(e.Depth, '>') << e.Name << " " << (e.End - e.Start) / 1000000.0f;
+			}
+			frameFile << "\"\n";
+		}
+		else
+		{
+			frameFile << "0,\n";
+		}
+	}
+
+	std::ofstream histogramFile(histogramPath);
+	if (!histogramFile)
+		return false;
+
+	histogramFile << "FromMs,ToMs,Frames\n";
+	for (unsigned int bin = 0; bin < BinCount; bin++)
+		histogramFile << (bin == 0 ? 0.0f : GetBinStart(bin)) << "," << GetBinStart(bin + 1) << "," << histogram[bin] << "\n";
+
+	return (bool)frameFile && (bool)histogramFile;
+}
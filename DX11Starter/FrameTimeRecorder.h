@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Profiler.h"
+
+// --------------------------------------------------------
+// A frame that took much longer than the frames around it,
+// along with the scopes the profiler recorded during it (if
+// it was enabled)
+// --------------------------------------------------------
+struct FrameSpike
+{
+	unsigned int Frame;
+	float FrameTime;	// Milliseconds
+	float Median;		// Of the frames just before it
+	std::vector<ProfileEvent> Scopes;
+};
+
+// --------------------------------------------------------
+// Keeps the time of every recent frame, a log scale histogram
+// of every frame so far, and the frames that stuttered.
+//
+// A frame is a spike when it takes more than SpikeMultiplier
+// times the median of the last MedianWindow frames.  Frame
+// times are milliseconds throughout.
+// --------------------------------------------------------
+class FrameTimeRecorder
+{
+public:
+	// Frames kept for the CSV (ten minutes at 60hz)
+	static const unsigned int Capacity = 36000;
+
+	// Four bins per doubling, from 1/8ms up to about 8s
+	static const unsigned int BinsPerDoubling = 4;
+	static const unsigned int BinCount = 64;
+	static const float FirstBinTime;
+
+	static const unsigned int MedianWindow = 120;
+	static const unsigned int MaxSpikes = 256;
+
+	FrameTimeRecorder();
+
+	void SetSpikeMultiplier(float multiplier) { spikeMultiplier = multiplier; }
+
+	// Frame time is start to start, CPU time just the update
+	// and draw.  Returns true if the frame was a spike.
+	bool Record(float frameTime, float cpuTime);
+
+	// Lower edge of a histogram bin
+	static float GetBinStart(unsigned int bin);
+	const unsigned int* GetHistogram() { return histogram; }
+	const std::vector<FrameSpike>& GetSpikes() { return spikes; }
+	unsigned int GetFrameCount() { return frameCount; }
+
+	// Writes one row per kept frame, with the scopes of any
+	// spikes, and a second file with the histogram
+	bool WriteCSV(const std::string& framePath, const std::string& histogramPath);
+
+private:
+	struct FrameRecord
+	{
+		float FrameTime;
+		float CpuTime;
+	};
+
+	std::vector<FrameRecord> frames;	// Ring of the last Capacity frames
+	unsigned int frameCount;
+	unsigned int histogram[BinCount];
+
+	float spikeMultiplier;
+	std::vector<FrameSpike> spikes;		// Oldest first
+	std::vector<float> medianScratch;
+
+	float RecentMedian();
+};
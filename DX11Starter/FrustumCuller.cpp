@@ -0,0 +1,217 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Gribb/Hartmann plane extraction.  With row vectors each
+// plane is a sum or difference of the matrix's columns.
+// --------------------------------------------------------
+Frustum Frustum::FromViewProjection(FXMMATRIX viewProj)
+{
+	XMMATRIX columns = XMMatrixTranspose(viewProj);
+
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(columns.r[3], columns.r[0]),		// Left
+		XMVectorSubtract(columns.r[3], columns.r[0]),	// Right
+		XMVectorAdd(columns.r[3], columns.r[1]),		// Bottom
+		XMVectorSubtract(columns.r[3], columns.r[1]),	// Top
+		columns.r[2],									// Near (D3D depth starts at 0)
+		XMVectorSubtract(columns.r[3], columns.r[2]),	// Far
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+	return frustum;
+}
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+}
+
+// --------------------------------------------------------
+// Removes all bounds (keeping the memory)
+// --------------------------------------------------------
+void FrustumCuller::Clear()
+{
+	count = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+	radius.clear();
+}
+
+void FrustumCuller::Reserve(unsigned int capacity)
+{
+	unsigned int padded = (capacity + 3) & ~3u;
+	centerX.reserve(padded);
+	centerY.reserve(padded);
+	centerZ.reserve(padded);
+	extentX.reserve(padded);
+	extentY.reserve(padded);
+	extentZ.reserve(padded);
+	radius.reserve(padded);
+}
+
+// --------------------------------------------------------
+// Adds a world space bound
+// --------------------------------------------------------
+unsigned int FrustumCuller::Add(const XMFLOAT3& center, const XMFLOAT3& extents, float sphereRadius)
+{
+	// Grow a whole group of four at a time, so Cull() never
+	// reads past the end.  The padding is never reported.
+	if ((count & 3) == 0)
+	{
+		unsigned int padded = count + 4;
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		extentX.resize(padded, 0.0f);
+		extentY.resize(padded, 0.0f);
+		extentZ.resize(padded, 0.0f);
+		radius.resize(padded, 0.0f);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	extentX[count] = extents.x;
+	extentY[count] = extents.y;
+	extentZ[count] = extents.z;
+	radius[count] = sphereRadius;
+	return count++;
+}
+
+// --------------------------------------------------------
+// Adds a local space bound, moved into world space by a
+// (non-transposed) world matrix.  The AABB is refit around
+// the transformed box and the sphere grows with the largest
+// scale, so both stay conservative under rotation.
+// --------------------------------------------------------
+unsigned int FrustumCuller::AddTransformed(const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, float localRadius, FXMMATRIX world)
+{
+	XMFLOAT3 center;
+	XMFLOAT3 worldExtents;
+	TransformBox(localCenter, localExtents, world, &center, &worldExtents);
+
+	XMVECTOR scaleSq = XMVectorMax(
+		XMVector3LengthSq(world.r[0]),
+		XMVectorMax(XMVector3LengthSq(world.r[1]), XMVector3LengthSq(world.r[2])));
+	float worldRadius = localRadius * sqrtf(XMVectorGetX(scaleSq));
+
+	return Add(center, worldExtents, worldRadius);
+}
+
+// --------------------------------------------------------
+// Each world axis extent is the sum of the box's axes
+// projected onto it
+// --------------------------------------------------------
+void FrustumCuller::TransformBox(const XMFLOAT3& center, const XMFLOAT3& extents, FXMMATRIX world, XMFLOAT3* worldCenter, XMFLOAT3* worldExtents)
+{
+	XMStoreFloat3(worldCenter, XMVector3Transform(XMLoadFloat3(&center), world));
+
+	XMVECTOR result = XMVectorMultiply(XMVectorAbs(world.r[0]), XMVectorReplicate(extents.x));
+	result = XMVectorMultiplyAdd(XMVectorAbs(world.r[1]), XMVectorReplicate(extents.y), result);
+	result = XMVectorMultiplyAdd(XMVectorAbs(world.r[2]), XMVectorReplicate(extents.z), result);
+	XMStoreFloat3(worldExtents, result);
+}
+
+// --------------------------------------------------------
+// Tests four bounds at a time against each plane
+// --------------------------------------------------------
+unsigned int FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>* visible)
+{
+	visible->clear();
+
+	// Splat each plane once, up front
+	XMVECTOR normalX[6], normalY[6], normalZ[6], distance[6];
+	XMVECTOR absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.Planes[p];
+		normalX[p] = XMVectorReplicate(plane.x);
+		normalY[p] = XMVectorReplicate(plane.y);
+		normalZ[p] = XMVectorReplicate(plane.z);
+		distance[p] = XMVectorReplicate(plane.w);
+		absX[p] = XMVectorReplicate(fabsf(plane.x));
+		absY[p] = XMVectorReplicate(fabsf(plane.y));
+		absZ[p] = XMVectorReplicate(fabsf(plane.z));
+	}
+
+	for (unsigned int i = 0; i < count; i += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)&centerX[i]);
+		XMVECTOR cy = XMLoadFloat4((const XMFLOAT4*)&centerY[i]);
+		XMVECTOR cz = XMLoadFloat4((const XMFLOAT4*)&centerZ[i]);
+		XMVECTOR ex = XMLoadFloat4((const XMFLOAT4*)&extentX[i]);
+		XMVECTOR ey = XMLoadFloat4((const XMFLOAT4*)&extentY[i]);
+		XMVECTOR ez = XMLoadFloat4((const XMFLOAT4*)&extentZ[i]);
+		XMVECTOR r = XMLoadFloat4((const XMFLOAT4*)&radius[i]);
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR dist = XMVectorMultiplyAdd(cx, normalX[p], distance[p]);
+			dist = XMVectorMultiplyAdd(cy, normalY[p], dist);
+			dist = XMVectorMultiplyAdd(cz, normalZ[p], dist);
+
+			XMVECTOR reach = XMVectorMultiply(ex, absX[p]);
+			reach = XMVectorMultiplyAdd(ey, absY[p], reach);
+			reach = XMVectorMultiplyAdd(ez, absZ[p], reach);
+			reach = XMVectorMin(reach, r);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(dist, XMVectorNegate(reach)));
+		}
+
+		uint32_t lanes[4];
+		XMStoreInt4(lanes, outside);
+		unsigned int lanesUsed = std::min(4u, count - i);
+		for (unsigned int lane = 0; lane < lanesUsed; lane++)
+		{
+			if (!lanes[lane])
+				visible->push_back(i + lane);
+		}
+	}
+
+	return (unsigned int)visible->size();
+}
+
+// --------------------------------------------------------
+// Scalar version of Cull(), doing the math in the same order
+// --------------------------------------------------------
+unsigned int FrustumCuller::CullReference(const Frustum& frustum, std::vector<unsigned int>* visible)
+{
+	visible->clear();
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			const XMFLOAT4& plane = frustum.Planes[p];
+			float dist = centerX[i] * plane.x + plane.w;
+			dist = centerY[i] * plane.y + dist;
+			dist = centerZ[i] * plane.z + dist;
+
+			float reach = extentX[i] * fabsf(plane.x);
+			reach = extentY[i] * fabsf(plane.y) + reach;
+			reach = extentZ[i] * fabsf(plane.z) + reach;
+			reach = std::min(reach, radius[i]);
+
+			outside = dist < -reach;
+		}
+
+		if (!outside)
+			visible->push_back(i);
+	}
+
+	return (unsigned int)visible->size();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// The six planes of a view volume as (normal, d), with unit
+// normals facing inward, so dot(normal, p) + d is the signed
+// distance of p from the plane
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];	// Left, right, bottom, top, near, far
+
+	// Extracts the planes from a (non-transposed) D3D style
+	// view * projection matrix, with depth from 0 to 1
+	static Frustum FromViewProjection(DirectX::FXMMATRIX viewProj);
+};
+
+// --------------------------------------------------------
+// Culls world space bounds against a frustum.
+//
+// Each bound is an AABB plus a sphere around the AABB's
+// center, and is culled when it's entirely behind one of the
+// planes - measuring its reach toward each plane with the
+// smaller of the two.  Bounds are stored structure-of-arrays
+// (padded to a multiple of 4) so Cull() can test four at a
+// time against each plane.  CullReference() is the same test
+// one bound at a time, for checking the SIMD version.
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Clear();
+	void Reserve(unsigned int capacity);
+
+	// Both return the new bound's index
+	unsigned int Add(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, float sphereRadius);
+	unsigned int AddTransformed(const DirectX::XMFLOAT3& localCenter, const DirectX::XMFLOAT3& localExtents, float localRadius, DirectX::FXMMATRIX world);
+
+	// Fill visible with the indices of bounds at least partly
+	// inside the frustum, in order, and return how many there are
+	unsigned int Cull(const Frustum& frustum, std::vector<unsigned int>* visible);
+	unsigned int CullReference(const Frustum& frustum, std::vector<unsigned int>* visible);
+
+	unsigned int GetCount() { return count; }
+
+	// Moves a box into world space by a (non-transposed) world
+	// matrix, refitting an axis aligned box around the result
+	static void TransformBox(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, DirectX::FXMMATRIX world, DirectX::XMFLOAT3* worldCenter, DirectX::XMFLOAT3* worldExtents);
+
+private:
+	unsigned int count;
+
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<float> radius;
+};
@@ -1,9 +1,18 @@
 #include "Game.h"
 #include "Vertex.h"
+#include "D3D11RenderDevice.h"
+#include "AllocationCounter.h"
 
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <chrono>
+#include <random>
 #include <DirectXTex.h>
 
 // For the DirectX Math library
@@ -29,8 +38,31 @@ Game::Game(HINSTANCE hInstance)
 	vertexBuffer = 0;
 	indexBuffer = 0;
 	vertexShader = 0;
+	instancedVS = 0;
 	pixelShader = 0;
 	camera = 0;
+	sphereFieldCount = 0;
+	rayBenchmarkRays = 0;
+	drawThreads = 1;
+	opaqueDraws = 0;
+	opaqueDrawCount = 0;
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+	constantRing = 0;
+	backendDevice = 0;
+	commandRecorder = 0;
+	commandLogWritten = false;
+	benchmark = 0;
+	benchmarkSteps = 0;
+	stateCache = 0;
+	renderDevice = 0;
+	lastUploadStats = {};
+	lastStateStats = {};
+	lastCommandStats = {};
+	lastMeshesTested = 0;
+	lastMeshesVisible = 0;
+	lastEntitiesOccluded = 0;
+	lastOccluderTriangles = 0;
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -77,6 +109,7 @@ Game::~Game()
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
 	delete vertexShader;
+	delete instancedVS;
 	delete pixelShader;
 	delete equirectangularToCubemapVS;
 	delete equirectangularToCubemapPS;
@@ -89,6 +122,11 @@ Game::~Game()
 	delete sunVS;
 	delete fillscreenVS;
 	delete crepsecularPS;
+	delete constantRing;
+	if (instanceBuffer) instanceBuffer->Release();
+	for (auto& list : drawLists) delete list;
+	delete stateCache;
+	delete backendDevice;
 	sunDepthState->Release();
 	sunBlendState->Release();
 
@@ -101,16 +139,41 @@ Game::~Game()
 	{ 
 		delete e; 
 	}
+	for (auto& e : sphereField)
+	{
+		delete e;
+	}
 	delete camera;
+	delete benchmark;
+	delete jobs;
+
+	// Every worker's gone, so the profile is complete
+	if (!profileTracePath.empty())
+	{
+		FrameTimeSummary summary = Profiler::GetFrameTimeSummary();
+		printf("\nFrames: %u  Average: %.2fms  p50: %.2fms  p95: %.2fms  p99: %.2fms  Max: %.2fms\n",
+			summary.Frames, summary.Average, summary.P50, summary.P95, summary.P99, summary.Max);
+		Profiler::WriteChromeTrace(profileTracePath);
+	}
+	Profiler::Shutdown();
 }
 
 void Game::Init()
 {
+	// One worker per hardware thread, this one included
+	Profiler::SetThreadName("Main");
+	jobs = new JobSystem();
+
+	CreateRenderDevice();
 	LoadShaders();
+	CreateUploadRing();
 	CreateMatrices();
 	LoadModels();
 	LoadTextures();
 	CreateGameEntities();
+	IndexScene();
+	if (rayBenchmarkRays > 0)
+		RunRayBenchmark();
 
 	// Create a sampler state that holds options for sampling
 	// The descriptions should always just be local variables
@@ -158,28 +221,33 @@ void Game::Init()
 
 	device->CreateBlendState(&bsd, &sunBlendState);
 
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	renderDevice->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// Convert equirectangular maps to all the necessary parts for a PBR environment 
 	ConvertEquisToEnvironments(0);
-	context->Flush();
+	renderDevice->Flush();
 	ConvertEquisToEnvironments(1);
-	context->Flush();
+	renderDevice->Flush();
 	ConvertEquisToEnvironments(2);
-	context->Flush();
+	renderDevice->Flush();
 	currentEnv = 0;
 
 	CreateBRDFLUT();
 
-	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
-	context->RSSetViewports(1, &viewport);
+	renderDevice->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
+	renderDevice->RSSetViewports(1, AsRenderViewport(&viewport));
 }
 
 void Game::LoadShaders()
 {
+	PROFILE_SCOPE("Load Shaders");
+
 	vertexShader = new SimpleVertexShader(device, context);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
 
+	instancedVS = new SimpleVertexShader(device, context);
+	instancedVS->LoadShaderFile(L"InstancedVS.cso");
+
 	pixelShader = new SimplePixelShader(device, context);
 	pixelShader->LoadShaderFile(L"PixelShader.cso");
 
@@ -215,6 +283,180 @@ void Game::LoadShaders()
 
 	crepsecularPS = new SimplePixelShader(device, context);
 	crepsecularPS->LoadShaderFile(L"crepsecularPS.cso");
+
+	const char* geometryTextures[8] = { "AlbedoMap", "NormalMap", "MetallicMap", "RoughnessMap", "AOMap", "BRDFLookup", "EnvIrradianceMap", "EnvPrefilterMap" };
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		const SimpleSRV* srv = pixelShader->GetShaderResourceViewInfo(geometryTextures[i]);
+		geometryTextureSlots[i] = srv ? srv->BindIndex : 0xFFFFFFFF;
+	}
+	const SimpleSRV* occlusionTexture = crepsecularPS->GetShaderResourceViewInfo("OcclusionTexture");
+	occlusionTextureSlot = occlusionTexture ? occlusionTexture->BindIndex : 0xFFFFFFFF;
+
+	// Everything set per frame, in the order UploadPerFrameData() sets it
+	SimpleVertexShader* cameraShaders[4] = { vertexShader, instancedVS, sunVS, skyVS };
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		frameVariables.View[i] = cameraShaders[i]->GetVariableInfo("view");
+		frameVariables.Projection[i] = cameraShaders[i]->GetVariableInfo("projection");
+	}
+	const char* lightPositions[4] = { "LightPos1", "LightPos2", "LightPos3", "LightPos4" };
+	for (unsigned int i = 0; i < 4; i++)
+		frameVariables.LightPositions[i] = pixelShader->GetVariableInfo(lightPositions[i]);
+	frameVariables.LightColor = pixelShader->GetVariableInfo("LightColor1");
+	frameVariables.CameraPosition = pixelShader->GetVariableInfo("CameraPosition");
+	frameVariables.SunScreenPosition = crepsecularPS->GetVariableInfo("screenSpaceLightPos");
+	frameVariables.RayDensity = crepsecularPS->GetVariableInfo("density");
+	frameVariables.RayWeight = crepsecularPS->GetVariableInfo("weight");
+	frameVariables.RayDecay = crepsecularPS->GetVariableInfo("decay");
+	frameVariables.RayExposure = crepsecularPS->GetVariableInfo("exposure");
+	frameVariables.RaySamples = crepsecularPS->GetVariableInfo("numSamples");
+	frameVariables.OccluderWorld = vertexShader->GetVariableInfo("world");
+	frameVariables.SunWorld = sunVS->GetVariableInfo("world");
+	frameVariables.SunColor = sunPS->GetVariableInfo("color");
+}
+
+// --------------------------------------------------------
+// Switches to the null render backend, which records every
+// command instead of drawing anything.  The commands from
+// Init and the first frame are written to logPath.
+// Must be called before Run().
+// --------------------------------------------------------
+void Game::RecordCommands(std::string logPath)
+{
+	commandLogPath = logPath;
+}
+
+// --------------------------------------------------------
+// Turns the profiler on for the whole run, saving a Chrome
+// trace of it when the game shuts down
+// --------------------------------------------------------
+void Game::ProfileToTrace(std::string tracePath)
+{
+	profileTracePath = tracePath;
+	Profiler::SetEnabled(true);
+}
+
+// --------------------------------------------------------
+// Replaces the keyboard with a scripted camera path (or the
+// default loop, if the script can't be loaded) for the given
+// number of 60hz frames, then saves a report and quits
+// --------------------------------------------------------
+void Game::RunBenchmark(std::string scriptPath, unsigned int frames, std::string reportPath)
+{
+	BenchmarkScript script;
+	if (scriptPath.empty() || !script.Load(scriptPath))
+		script.BuildDefault();
+
+	delete benchmark;
+	benchmark = new Benchmark(script, frames, 1.0f / 60.0f);
+	benchmarkReportPath = reportPath;
+
+	// Exactly one step per frame, however long frames take
+	SetSimulationRate(60.0f);
+	simulation.SetLockstep(true);
+
+	// Per pass times come from the profiler's scopes
+	Profiler::SetEnabled(true);
+}
+
+// --------------------------------------------------------
+// Adds a grid of spheres behind the current entity, drawn
+// with a few different materials.  Used to stress the
+// opaque pass.  Must be called before Run().
+// --------------------------------------------------------
+void Game::SpawnSphereField(unsigned int count)
+{
+	sphereFieldCount = count;
+}
+
+// --------------------------------------------------------
+// Times mesh tree builds and raycasts against the starting
+// entity once everything's loaded, printing the results.
+// Must be called before Run().
+// --------------------------------------------------------
+void Game::BenchmarkRaycasts(unsigned int rays)
+{
+	rayBenchmarkRays = rays;
+}
+
+// --------------------------------------------------------
+// Splits the opaque pass between this many command lists,
+// recorded at the same time on the job system's workers.
+// Zero means one per worker, and one draws directly.  Must
+// be called before Run().
+// --------------------------------------------------------
+void Game::SetDrawThreads(unsigned int count)
+{
+	drawThreads = count;
+}
+
+// --------------------------------------------------------
+// Caps the CPU copies of mesh geometry kept for picking and
+// occlusion culling.  Must be called before Run().
+// --------------------------------------------------------
+void Game::SetCpuMeshBudget(size_t bytes)
+{
+	Mesh::SetCpuBudget(bytes);
+}
+
+// --------------------------------------------------------
+// Sends every constant buffer whole on every copy, as before
+// they were split by frequency and only sent when changed,
+// so the two can be compared with the same benchmark
+// --------------------------------------------------------
+void Game::SetUploadEverything(bool enabled)
+{
+	ISimpleShader::SetUploadEverything(enabled);
+}
+
+// --------------------------------------------------------
+// Creates the backend everything is drawn through, behind a
+// state cache that drops redundant binds
+// --------------------------------------------------------
+void Game::CreateRenderDevice()
+{
+	if (commandLogPath.empty())
+		backendDevice = new D3D11RenderDevice(context);
+	else
+		backendDevice = commandRecorder = new NullRenderDevice();
+
+	stateCache = new StateCache(backendDevice);
+	renderDevice = stateCache;
+	ISimpleShader::SetRenderDevice(renderDevice);
+
+	// Deferred contexts when drawing with D3D, and our own
+	// lists for the recorder (or if they can't be made)
+	unsigned int lists = drawThreads ? drawThreads : jobs->GetThreadCount();
+	for (unsigned int i = 0; lists > 1 && i < lists; i++)
+	{
+		if (!commandRecorder)
+		{
+			D3D11CommandList* list = new D3D11CommandList(device, context);
+			if (list->IsValid())
+			{
+				drawLists.push_back(list);
+				continue;
+			}
+			delete list;
+		}
+		drawLists.push_back(new RenderCommandList());
+	}
+}
+
+// --------------------------------------------------------
+// Creates the shared ring that the per-frame shaders write
+// their constant data into, if the driver supports it
+// --------------------------------------------------------
+void Game::CreateUploadRing()
+{
+	constantRing = new ConstantUploadRing(device, context, 1024 * 1024, renderDevice);
+	if (!constantRing->IsSupported())
+		return;
+
+	ISimpleShader* frameShaders[] = { vertexShader, instancedVS, pixelShader, skyVS, sunVS, sunPS, crepsecularPS };
+	for (ISimpleShader* shader : frameShaders)
+		shader->SetUploadRing(constantRing);
 }
 
 void Game::CreateMatrices()
@@ -225,18 +467,71 @@ void Game::CreateMatrices()
 
 void Game::LoadModels()
 {
-	models[0] = new Model("Models/cube.obj", device);
-	models[1] = new Model("Models/quad.obj", device);
-	models[2] = new Model("Models/sphere.obj", device);
-	models[3] = new Model("Models/helix.obj", device);
-	models[4] = new Model("Models/cone.obj", device);
-	models[5] = new Model("Models/cylinder.obj", device);
-	models[6] = new Model("Models/torus.obj", device);
-	models[7] = new Model("Models/Cerberus_Model.FBX", device);
+	PROFILE_SCOPE("Load Models");
+
+	const char* paths[8] =
+	{
+		"Models/cube.obj",
+		"Models/quad.obj",
+		"Models/sphere.obj",
+		"Models/helix.obj",
+		"Models/cone.obj",
+		"Models/cylinder.obj",
+		"Models/torus.obj",
+		"Models/Cerberus_Model.FBX",
+	};
+
+	// The simple shapes are small and make good occluders, so
+	// keep them exact.  The gun is only ever picked, and is by
+	// far the biggest, so quantized positions are plenty.
+	MeshResidency residency[8] =
+	{
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_FULL,
+		MESH_RESIDENCY_QUANTIZED,
+	};
+
+	// Each import gets its own Importer, and the device is free
+	// threaded, so the files can all load at once
+	jobs->ParallelFor(8, 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			models[i] = new Model(paths[i], device, residency[i]);
+	});
+
+	// One mesh at a time, as each tree is built across every worker
+	{
+		PROFILE_SCOPE("Build BVHs");
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			for (Mesh* mesh : models[i]->meshes)
+				mesh->BuildBVH(jobs);
+		}
+	}
+
+	if (Profiler::IsEnabled())
+	{
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			const ModelImportStats& stats = models[i]->GetImportStats();
+			printf("\nImported %s: %zu bytes scratch, %zu bytes CPU, %zu bytes GPU",
+				paths[i], stats.ScratchBytes, models[i]->GetCpuBytes(), models[i]->GetGpuBytes());
+			if (AllocationCounter::IsEnabled())
+				printf(", %llu allocations, %llu bytes allocated, %lld bytes peak", stats.Allocations, stats.BytesAllocated, stats.PeakBytes);
+		}
+		printf("\nCPU mesh data: %zu bytes\n", Mesh::GetTotalCpuBytes());
+	}
 }
 
 void Game::LoadTextures()
 {
+	PROFILE_SCOPE("Load Textures");
+
 	CreateWICTextureFromFile(device, context, L"Textures/AluminiumInsulator_Albedo.png", 0, &albedoMapSRVs[0]);
 	CreateWICTextureFromFile(device, context, L"Textures/AluminiumInsulator_Normal.png", 0, &normalMapSRVs[0]);
 	CreateWICTextureFromFile(device, context, L"Textures/AluminiumInsulator_Metallic.png", 0, &metalnessMapSRVs[0]);
@@ -326,13 +621,15 @@ void Game::LoadTextures()
 
 void Game::CreateGameEntities()
 {
+	PROFILE_SCOPE("Create Entities");
+
 	// Make some entities
-	GameEntity* cube = new GameEntity(0, 1, 0);
-	GameEntity* quad = new GameEntity(1, 0, 0);
-	GameEntity* sphere = new GameEntity(2, 1, 0);
-	GameEntity* sunSphere = new GameEntity(2, 1, 0);
-	GameEntity* helix = new GameEntity(3, 3, 0);
-	GameEntity* cerberus = new GameEntity(7, 10, 1);
+	GameEntity* cube = new GameEntity(&transforms, 0, 1, 0);
+	GameEntity* quad = new GameEntity(&transforms, 1, 0, 0);
+	GameEntity* sphere = new GameEntity(&transforms, 2, 1, 0);
+	GameEntity* sunSphere = new GameEntity(&transforms, 2, 1, 0);
+	GameEntity* helix = new GameEntity(&transforms, 3, 3, 0);
+	GameEntity* cerberus = new GameEntity(&transforms, 7, 10, 1);
 	entities.push_back(cube);
 	entities.push_back(sunSphere);
 	entities.push_back(quad);
@@ -345,16 +642,253 @@ void Game::CreateGameEntities()
 	sphere->SetPosition(0.f, 1.5f, -16.f);
 	sunSphere->SetPosition(-.98, 0.8, .2);
 	sunSphere->SetScale(.2f, .2f, .2f);
-	sunSphere->UpdateWorldMatrix();
 	helix->SetScale(1.5f, 1.5f, 1.5f);
 	cerberus->SetScale(.1f, .1f, .1f);
 	cerberus->SetRotation(-1.57f, 0.f, 0.f);
 
 	currentEntity = 3;
+
+	// Optional stress test scene - same model, a few materials
+	unsigned int side = (unsigned int)ceilf(sqrtf((float)sphereFieldCount));
+	for (unsigned int i = 0; i < sphereFieldCount; i++)
+	{
+		GameEntity* ge = new GameEntity(&transforms, 2, i % 3, 0);
+		ge->SetPosition(
+			((float)(i % side) - side * 0.5f) * 3.0f,
+			-4.0f,
+			10.0f + (i / side) * 3.0f);
+		sphereField.push_back(ge);
+	}
+
+	// Build every world matrix before the scene is indexed
+	transforms.Update(jobs);
+}
+
+// --------------------------------------------------------
+// Puts the current entity and the sphere field into the
+// scene tree
+// --------------------------------------------------------
+void Game::IndexScene()
+{
+	PROFILE_SCOPE("Index Scene");
+
+	sceneTree.Clear();
+	sceneEntities.clear();
+	sceneProxies.clear();
+
+	sceneEntities.push_back(entities[currentEntity]);
+	sceneEntities.insert(sceneEntities.end(), sphereField.begin(), sphereField.end());
+	for (unsigned int i = 0; i < sceneEntities.size(); i++)
+	{
+		XMFLOAT3 min, max;
+		GetEntityBounds(sceneEntities[i], &min, &max);
+		sceneProxies.push_back(sceneTree.Insert(min, max, i));
+	}
+}
+
+// --------------------------------------------------------
+// World space AABB around all of an entity's meshes
+// --------------------------------------------------------
+void Game::GetEntityBounds(GameEntity* ge, XMFLOAT3* min, XMFLOAT3* max)
+{
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(ge->GetWorldMatrix()));
+	XMVECTOR lo = world.r[3];
+	XMVECTOR hi = world.r[3];
+
+	Model* model = models[ge->GetModel()];
+	for (unsigned int i = 0; i < model->meshes.size(); i++)
+	{
+		XMFLOAT3 center, extents;
+		XMMATRIX meshWorld = XMMatrixMultiply(model->GetMeshTransform(i), world);
+		FrustumCuller::TransformBox(model->meshes[i]->GetBoundsCenter(), model->meshes[i]->GetBoundsExtents(), meshWorld, &center, &extents);
+
+		XMVECTOR c = XMLoadFloat3(&center);
+		XMVECTOR e = XMLoadFloat3(&extents);
+		if (i == 0)
+		{
+			lo = XMVectorSubtract(c, e);
+			hi = XMVectorAdd(c, e);
+		}
+		else
+		{
+			lo = XMVectorMin(lo, XMVectorSubtract(c, e));
+			hi = XMVectorMax(hi, XMVectorAdd(c, e));
+		}
+	}
+
+	XMStoreFloat3(min, lo);
+	XMStoreFloat3(max, hi);
+}
+
+// --------------------------------------------------------
+// Casts a ray from the camera through a pixel and reports
+// the first entity it hits
+// --------------------------------------------------------
+void Game::PickEntity(int x, int y)
+{
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&camera->GetView()));
+	XMMATRIX proj = XMMatrixTranspose(XMLoadFloat4x4(&camera->GetProjection()));
+	XMMATRIX invViewProj = XMMatrixInverse(0, XMMatrixMultiply(view, proj));
+
+	// Unproject the pixel at the near and far planes
+	float ndcX = 2.0f * x / width - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / height;
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0, 1), invViewProj);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1, 1), invViewProj);
+
+	XMFLOAT3 origin, direction;
+	XMStoreFloat3(&origin, nearPoint);
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint)));
+	float length = XMVectorGetX(XMVector3Length(XMVectorSubtract(farPoint, nearPoint)));
+
+	// The tree only knows boxes, so test everything whose box
+	// the ray passes through
+	std::vector<unsigned int> candidates;
+	sceneTree.QueryRay(origin, direction, length, &candidates);
+
+	bool picked = false;
+	unsigned int pickedEntity = 0;
+	EntityRayHit hit = {};
+	float closest = length;
+	for (unsigned int candidate : candidates)
+	{
+		GameEntity* ge = sceneEntities[candidate];
+		if (ge->Raycast(models[ge->GetModel()], origin, direction, closest, &hit))
+		{
+			picked = true;
+			pickedEntity = candidate;
+			closest = hit.MeshHit.Distance;
+		}
+	}
+
+	if (picked)
+		printf("Picked scene entity %u (mesh %u, triangle %u) at distance %f\n", pickedEntity, hit.Mesh, hit.MeshHit.Triangle, closest);
+}
+
+// --------------------------------------------------------
+// Rebuilds the starting entity's mesh trees (keeping the
+// fastest of a few builds), then casts rays at it on this
+// thread: a coherent grid across its bounds from in front,
+// then incoherent rays between random points around it and
+// inside it.  Rays are made up front, so only casting counts.
+// --------------------------------------------------------
+void Game::RunRayBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	GameEntity* target = entities[currentEntity];
+	Model* model = models[target->GetModel()];
+
+	unsigned int triangles = 0;
+	double buildSeconds = 0.0;
+	for (Mesh* mesh : model->meshes)
+	{
+		const MeshGeometry& geometry = mesh->GetGeometry();
+		if (geometry.IsEmpty())
+			continue;
+
+		double best = 1e30;
+		for (unsigned int i = 0; i < 5; i++)
+		{
+			MeshBVH bvh;
+			Clock::time_point start = Clock::now();
+			bvh.Build(&geometry, jobs);
+			best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+		}
+		triangles += geometry.GetTriangleCount();
+		buildSeconds += best;
+	}
+	printf("\nBVH build: %u triangles in %.2fms, %.1fms per million triangles\n",
+		triangles, buildSeconds * 1000.0, triangles ? buildSeconds * 1000.0 * 1000000.0 / triangles : 0.0);
+
+	XMFLOAT3 min, max;
+	GetEntityBounds(target, &min, &max);
+	XMVECTOR lo = XMLoadFloat3(&min);
+	XMVECTOR hi = XMLoadFloat3(&max);
+	XMVECTOR center = XMVectorScale(XMVectorAdd(lo, hi), 0.5f);
+	float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(hi, lo))) * 0.5f;
+
+	std::vector<XMFLOAT3> origins(rayBenchmarkRays);
+	std::vector<XMFLOAT3> directions(rayBenchmarkRays);
+	auto run = [&](const char* name)
+	{
+		unsigned int hits = 0;
+		EntityRayHit hit;
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < rayBenchmarkRays; i++)
+		{
+			if (target->Raycast(model, origins[i], directions[i], FLT_MAX, &hit))
+				hits++;
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		printf("%s: %.2f Mrays/s, %u of %u hit\n", name, rayBenchmarkRays / seconds / 1000000.0, hits, rayBenchmarkRays);
+	};
+
+	// A grid over the bounds' front face, row by row
+	unsigned int side = (unsigned int)ceilf(sqrtf((float)rayBenchmarkRays));
+	XMVECTOR eye = XMVectorSubtract(center, XMVectorSet(0, 0, radius * 3.0f, 0));
+	for (unsigned int i = 0; i < rayBenchmarkRays; i++)
+	{
+		XMVECTOR t = XMVectorSet(((i % side) + 0.5f) / side, ((i / side) + 0.5f) / side, 0.5f, 0);
+		XMVECTOR point = XMVectorAdd(lo, XMVectorMultiply(XMVectorSubtract(hi, lo), t));
+		XMStoreFloat3(&origins[i], eye);
+		XMStoreFloat3(&directions[i], XMVector3Normalize(XMVectorSubtract(point, eye)));
+	}
+	run("Coherent rays");
+
+	// From anywhere on a sphere around it, to anywhere inside
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (unsigned int i = 0; i < rayBenchmarkRays; i++)
+	{
+		float z = unit(random) * 2.0f - 1.0f;
+		float angle = unit(random) * XM_2PI;
+		float r = sqrtf(1.0f - z * z);
+		XMVECTOR from = XMVectorAdd(center, XMVectorScale(XMVectorSet(r * cosf(angle), r * sinf(angle), z, 0), radius * 2.0f));
+		XMVECTOR to = XMVectorAdd(lo, XMVectorMultiply(XMVectorSubtract(hi, lo), XMVectorSet(unit(random), unit(random), unit(random), 0)));
+		XMStoreFloat3(&origins[i], from);
+		XMStoreFloat3(&directions[i], XMVector3Normalize(XMVectorSubtract(to, from)));
+	}
+	run("Incoherent rays");
+}
+
+// --------------------------------------------------------
+// Makes sure the instance buffer can hold at least count
+// world matrices, growing it if needed
+// --------------------------------------------------------
+void Game::ReserveInstances(unsigned int count)
+{
+	if (count <= instanceCapacity)
+		return;
+
+	// Grow geometrically so a growing scene doesn't reallocate every frame
+	unsigned int capacity = instanceCapacity > 0 ? instanceCapacity * 2 : 64;
+	while (capacity < count)
+		capacity *= 2;
+
+	if (instanceBuffer)
+	{
+		instanceBuffer->Release();
+		instanceBuffer = 0;
+		instanceCapacity = 0;
+
+		// The old buffer may still be bound, and a new one
+		// could get the same address
+		stateCache->Invalidate();
+	}
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = capacity * sizeof(XMFLOAT4X4);
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (SUCCEEDED(device->CreateBuffer(&desc, 0, &instanceBuffer)))
+		instanceCapacity = capacity;
 }
 
 void Game::ConvertEquisToEnvironments(int hdrInd)
 {
+	PROFILE_SCOPE("Bake Environment");
+
 	/* Set up the texture to render to */
 	ID3D11Texture2D* captureTexture;
 	D3D11_TEXTURE2D_DESC captureTextureDesc = {};
@@ -419,12 +953,12 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 		captureRTVDesc.Texture2DArray.FirstArraySlice = i; // Create a render target to hold each face
 		device->CreateRenderTargetView(captureTexture, &captureRTVDesc, &captureRTVs[i]);
 
-		context->OMSetRenderTargets(1, &captureRTVs[i], 0);
-		context->RSSetViewports(1, &captureViewport);
-		context->ClearRenderTargetView(captureRTVs[i], color);
+		renderDevice->OMSetRenderTargets(1, &captureRTVs[i], 0);
+		renderDevice->RSSetViewports(1, AsRenderViewport(&captureViewport));
+		renderDevice->ClearRenderTargetView(captureRTVs[i], color);
 
-		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
-		context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
+		renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 		equirectangularToCubemapVS->SetMatrix4x4("view", captureViews[i]); // Vertex 
 		equirectangularToCubemapVS->SetMatrix4x4("projection", projection);
@@ -436,16 +970,16 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 		equirectangularToCubemapPS->CopyAllBufferData();
 		equirectangularToCubemapPS->SetShader();
 
-		context->RSSetState(skyRasterState);
-		context->OMSetDepthStencilState(skyDepthState, 0);
+		renderDevice->RSSetState(skyRasterState);
+		renderDevice->OMSetDepthStencilState(skyDepthState, 0);
 
-		context->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
+		renderDevice->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
 	}
 
 	/* Generate mips then transfer to usable cubemap */
 	device->CreateShaderResourceView(captureTexture, &srvDesc, &hdrCubeSRVs[hdrInd]);
 
-	context->GenerateMips(hdrCubeSRVs[hdrInd]);
+	renderDevice->GenerateMips(hdrCubeSRVs[hdrInd]);
 	//ScratchImage hdrScratch;
 	//CaptureTexture(device, context, captureTexture, hdrScratch);
 
@@ -476,12 +1010,12 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 		{
 			captureRTVDesc.Texture2DArray.FirstArraySlice = i; // Create a render target to hold each face
 			device->CreateRenderTargetView(captureTexture, &captureRTVDesc, &captureRTVs[i]);
-			context->OMSetRenderTargets(1, &captureRTVs[i], 0);
-			context->RSSetViewports(1, &captureViewport);
-			context->ClearRenderTargetView(captureRTVs[i], color);
+			renderDevice->OMSetRenderTargets(1, &captureRTVs[i], 0);
+			renderDevice->RSSetViewports(1, AsRenderViewport(&captureViewport));
+			renderDevice->ClearRenderTargetView(captureRTVs[i], color);
 
-			context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
-			context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+			renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
+			renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 			equirectangularToCubemapVS->SetMatrix4x4("view", captureViews[i]); // Vertex 
 			equirectangularToCubemapVS->SetMatrix4x4("projection", projection);
@@ -493,10 +1027,10 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 			irradianceConvolutionPS->CopyAllBufferData();
 			irradianceConvolutionPS->SetShader();
 
-			context->RSSetState(skyRasterState);
-			context->OMSetDepthStencilState(skyDepthState, 0);
+			renderDevice->RSSetState(skyRasterState);
+			renderDevice->OMSetDepthStencilState(skyDepthState, 0);
 
-			context->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
+			renderDevice->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
 		}
 
 		device->CreateShaderResourceView(captureTexture, &srvDesc, &irradianceMapSRVs[hdrInd]);
@@ -542,12 +1076,12 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 		{
 			captureRTVDesc.Texture2DArray.FirstArraySlice = i; // Create a render target to hold each face
 			device->CreateRenderTargetView(captureTexture, &captureRTVDesc, &captureRTVs[i]);
-			context->OMSetRenderTargets(1, &captureRTVs[i], 0);
-			context->RSSetViewports(1, &captureViewport);
-			context->ClearRenderTargetView(captureRTVs[i], color);
+			renderDevice->OMSetRenderTargets(1, &captureRTVs[i], 0);
+			renderDevice->RSSetViewports(1, AsRenderViewport(&captureViewport));
+			renderDevice->ClearRenderTargetView(captureRTVs[i], color);
 
-			context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
-			context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+			renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); // Set buffers
+			renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 			equirectangularToCubemapVS->SetMatrix4x4("view", captureViews[i]); // Vertex 
 			equirectangularToCubemapVS->SetMatrix4x4("projection", projection);
@@ -559,10 +1093,10 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 			prefilterEnvironmentPS->CopyAllBufferData();
 			prefilterEnvironmentPS->SetShader();
 
-			context->RSSetState(skyRasterState);
-			context->OMSetDepthStencilState(skyDepthState, 0);
+			renderDevice->RSSetState(skyRasterState);
+			renderDevice->OMSetDepthStencilState(skyDepthState, 0);
 
-			context->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
+			renderDevice->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
 		}
 		captureRTVs[0]->Release();
 		captureRTVs[1]->Release();
@@ -581,12 +1115,14 @@ void Game::ConvertEquisToEnvironments(int hdrInd)
 
 	/* Clean Up */
 	captureTexture->Release();
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
+	renderDevice->RSSetState(0);
+	renderDevice->OMSetDepthStencilState(0, 0);
 }
 
 void Game::CreateBRDFLUT()
 {
+	PROFILE_SCOPE("Bake BRDF LUT");
+
 	/* Capture Texture */
 	ID3D11Texture2D* captureTexture;
 	D3D11_TEXTURE2D_DESC captureDesc = {};
@@ -631,9 +1167,9 @@ void Game::CreateBRDFLUT()
 	XMStoreFloat4x4(&captureView, XMMatrixTranspose(XMMatrixLookToLH(XMVectorSet(0, 0, -1, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0))));
 	XMFLOAT4X4 world;
 	XMStoreFloat4x4(&world, XMMatrixIdentity());
-	context->OMSetRenderTargets(1, &captureRTV, 0);
-	context->RSSetViewports(1, &captureViewport);
-	context->ClearRenderTargetView(captureRTV, color);
+	renderDevice->OMSetRenderTargets(1, &captureRTV, 0);
+	renderDevice->RSSetViewports(1, AsRenderViewport(&captureViewport));
+	renderDevice->ClearRenderTargetView(captureRTV, color);
 
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
@@ -641,8 +1177,8 @@ void Game::CreateBRDFLUT()
 	// Grab the data from the mesh
 	vertexBuffer = model->meshes[0]->GetVertexBuffer();
 	indexBuffer = model->meshes[0]->GetIndexBuffer();
-	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	vertexShader->SetMatrix4x4("world", world);
 	vertexShader->SetMatrix4x4("view", captureView);
@@ -654,7 +1190,7 @@ void Game::CreateBRDFLUT()
 	integrateBRDFPS->SetShader();
 
 
-	context->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
+	renderDevice->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
 
 	device->CreateShaderResourceView(captureTexture, &captureSRVDesc, &brdfLUTSRV);
 
@@ -667,6 +1203,10 @@ void Game::OnResize()
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
+	// The base class rebinds render targets and viewports directly
+	if (stateCache)
+		stateCache->Invalidate();
+
 	// Update the projection matrix assuming the camera exists
 	if (camera)
 		camera->UpdateProjectionMatrix((float)width / height);
@@ -675,167 +1215,563 @@ void Game::OnResize()
 void Game::Update(float deltaTime, float totalTime)
 {
 	// Quit if the escape key is pressed
-	if (GetAsyncKeyState(VK_ESCAPE))
+	if (input.IsKeyDown(VK_ESCAPE))
 		Quit();
 
-	// Update the camera
-	camera->Update(deltaTime);
+	// Keep where everything was, to draw from between that
+	// and where this step leaves it
+	transforms.BeginStep();
+	camera->BeginStep();
 
-	// Check for entity swap
-	bool currentTab = (GetAsyncKeyState(VK_TAB) & 0x8000) != 0;
-	if (currentTab && !prevTab)
-		currentEntity = (currentEntity + 1) % entities.size();
-	prevTab = currentTab;
-
-	bool currentB = (GetAsyncKeyState(0x42) & 0x8000) != 0;
-	if (currentB && !prevB)
-		currentEnv = (currentEnv + 1) % 3;
-	prevB = currentB;
+	if (benchmark)
+	{
+		UpdateBenchmark();
+	}
+	else
+	{
+		// Update the camera
+		camera->Update(deltaTime, &input);
+
+		// Dragging with the left button looks around, and
+		// clicking picks whatever is under the cursor
+		if (input.WasButtonPressed(MOUSE_LEFT))
+			PickEntity(input.GetMouseX(), input.GetMouseY());
+		else if (input.IsButtonDown(MOUSE_LEFT))
+			camera->Rotate(input.GetMouseDeltaY() * 0.005f, input.GetMouseDeltaX() * 0.005f);
+
+		// Check for entity swap
+		if (input.WasKeyPressed(VK_TAB))
+			currentEntity = (currentEntity + 1) % entities.size();
+		if (input.WasKeyPressed('B'))
+			currentEnv = (currentEnv + 1) % 3;
+	}
 
 	// Spin current entity
 	//entities[currentEntity]->Rotate(0, deltaTime * 0.2f, 0);
 	
-	// Always update current entity's world matrix
-	entities[currentEntity]->UpdateWorldMatrix();
-	entities[3]->UpdateWorldMatrix();
+	// Rebuild the world matrices of anything that changed
+	{
+		PROFILE_SCOPE("Update Transforms");
+		transforms.Update(jobs);
+	}
+
+	// Keep its spot in the scene tree up to date
+	XMFLOAT3 min, max;
+	sceneEntities[0] = entities[currentEntity];
+	GetEntityBounds(sceneEntities[0], &min, &max);
+	sceneTree.Move(sceneProxies[0], min, max);
 
 }
 
+// --------------------------------------------------------
+// Places everything part way between the last two steps
+// --------------------------------------------------------
+void Game::Interpolate(float alpha)
+{
+	PROFILE_SCOPE("Interpolate");
+	transforms.Interpolate(alpha, jobs);
+	camera->Interpolate(alpha);
+}
+
+// --------------------------------------------------------
+// Moves the benchmark's script on a fixed step, regardless
+// of how long frames really take
+// --------------------------------------------------------
+void Game::UpdateBenchmark()
+{
+	float time = benchmarkSteps++ * benchmark->GetTimeStep();
+	BenchmarkScript* script = benchmark->GetScript();
+
+	XMFLOAT3 position;
+	float pitch, yaw;
+	script->SampleCamera(time, &position, &pitch, &yaw);
+	camera->SetPose(position, pitch, yaw);
+
+	currentEntity = script->GetEntity(time, currentEntity) % entities.size();
+	currentEnv = script->GetEnvironment(time, currentEnv) % 3;
+}
+
+// --------------------------------------------------------
+// Records the frame just drawn, and ends the run once there
+// have been enough.  Kept apart from UpdateBenchmark(), as
+// the next frame may be updating while this one's drawn.
+// Heap allocations are only counted once a frame ends, so
+// they trail the other stats by one frame.
+// --------------------------------------------------------
+void Game::RecordBenchmarkFrame()
+{
+	if (benchmark->IsFinished())
+		return;
+
+	benchmark->RecordFrame(lastStateStats.DrawCalls, lastUploadStats.BytesUploaded, frameAllocations);
+	if (benchmark->IsFinished())
+	{
+		if (benchmark->WriteReport(benchmarkReportPath))
+			printf("\nBenchmark report saved to %s\n", benchmarkReportPath.c_str());
+		Quit();
+	}
+}
+
+// --------------------------------------------------------
+// Gathers everything Draw() needs into the frame being
+// prepared - camera, visible draws and their world matrices
+// - so none of it has to be touched again while drawing
+// --------------------------------------------------------
+void Game::PrepareFrame()
+{
+	PROFILE_SCOPE("Prepare Frame");
+
+	// The last frame drawn from this slot is done with
+	FrameData& frame = frames[framePipeline.GetPrepareSlot()];
+	frame.Arena.Reset();
+	frame.View = camera->GetView();
+	frame.Projection = camera->GetProjection();
+	frame.CameraPosition = camera->GetPosition();
+	frame.SunScreenPosition = CalculateSunScreenPos();
+	frame.SunWorld = *entities[1]->GetWorldMatrix();
+	frame.Focus = entities[currentEntity];
+	frame.FocusWorld = *frame.Focus->GetWorldMatrix();
+	frame.Environment = currentEnv;
+
+	BuildOpaqueDraws(&frame);
+}
+
 void Game::Draw(float deltaTime, float totalTime)
 {
-	context->RSSetViewports(1, &viewport);
+	const FrameData& frame = frames[framePipeline.GetSubmitSlot()];
+
+	// Start counting this frame's constant buffer traffic and
+	// recycle any ring space the GPU is done with
+	ISimpleShader::ResetFrameStats();
+	stateCache->ResetStats();
+	constantRing->BeginFrame();
+	UploadPerFrameData(frame);
+
+	renderDevice->RSSetViewports(1, AsRenderViewport(&viewport));
 	const float color[4] = { 0,0,0,1 };
 
-	/* Draw the occlusion pass */
-	context->OMSetRenderTargets(1, &occlusionRTV, depthStencilView);
-	context->ClearRenderTargetView(occlusionRTV, color);
-	context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	RenderOcclusionPass(frame);
+
+	/* Draw the main render pass */
+	renderDevice->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
+	renderDevice->ClearRenderTargetView(backBufferRTV, color);
+	renderDevice->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	RenderGeometry(frame);
+	RenderSkybox(frame);
+	RenderSun(frame);
+
+	/* Draw the post process crepsecular rays as an additive layer with the occlusion render to cover the source */
+	{
+		PROFILE_SCOPE("Post Process");
+
+		UINT stride = sizeof(Vertex);
+		UINT offset = 0;
+		float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		renderDevice->OMSetBlendState(sunBlendState, blendFactor, 0xffffffff);
+		fillscreenVS->SetShader();
+
+		if (occlusionTextureSlot != 0xFFFFFFFF)
+			renderDevice->PSSetShaderResources(occlusionTextureSlot, 1, &occlusionSRV);
+		crepsecularPS->SetSamplerState("Sampler", sampler);
+		crepsecularPS->SetShader();
+
+		ID3D11Buffer* blank = 0;
+		renderDevice->IASetVertexBuffers(0, 1, &blank, &stride, &offset);
+		renderDevice->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+
+		renderDevice->Draw(3, 0); // Draw one heckin big triangle
+		renderDevice->OMSetBlendState(0, blendFactor, 0xffffffff);
+	}
+
+	{
+		PROFILE_SCOPE("Present");
+		swapChain->Present(0, 0);
+	}
+	constantRing->EndFrame();
+
+	renderDevice->PSSetShaderResources(0, 16, emptySRVs); // Clear up objects for reuse
+
+	// Keep this frame's traffic around for the title bar
+	lastUploadStats = ISimpleShader::GetFrameStats();
+	lastStateStats = stateCache->GetStats();
+	lastMeshesTested = frame.MeshesTested;
+	lastMeshesVisible = frame.MeshesVisible;
+	lastEntitiesOccluded = frame.EntitiesOccluded;
+	lastOccluderTriangles = frame.OccluderTriangles;
+
+	// Save the first frame's command stream when recording
+	if (commandRecorder)
+	{
+		if (!commandLogWritten)
+		{
+			std::ofstream log(commandLogPath);
+			commandRecorder->WriteLog(log);
+			commandLogWritten = true;
+		}
+		lastCommandStats = commandRecorder->GetStats();
+		commandRecorder->Clear();
+	}
+
+	if (benchmark)
+		RecordBenchmarkFrame();
+}
+
+// --------------------------------------------------------
+// Draws the current entity in black and the sun in color,
+// for the crepuscular rays to sample
+// --------------------------------------------------------
+void Game::RenderOcclusionPass(const FrameData& frame)
+{
+	PROFILE_SCOPE("Occlusion Pass");
+
+	const float color[4] = { 0,0,0,1 };
+	renderDevice->OMSetRenderTargets(1, &occlusionRTV, depthStencilView);
+	renderDevice->ClearRenderTargetView(occlusionRTV, color);
+	renderDevice->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 
-	GameEntity* ge = entities[currentEntity];
-	Model* model = models[ge->GetModel()];
+	Model* model = models[frame.Focus->GetModel()];
+
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&frame.FocusWorld));
+	sunPS->SetFloat3(frameVariables.SunColor, XMFLOAT3(0, 0, 0));
+
 	for (unsigned int i = 0; i < model->meshes.size(); i++)
 	{
+		// Each mesh sits at its own node within the model
+		XMFLOAT4X4 meshWorld;
+		XMStoreFloat4x4(&meshWorld, XMMatrixTranspose(XMMatrixMultiply(model->GetMeshTransform(i), world)));
+		vertexShader->SetMatrix4x4(frameVariables.OccluderWorld, meshWorld);
+
 		// Grab the data from the mesh
 		vertexBuffer = model->meshes[i]->GetVertexBuffer();
 		indexBuffer = model->meshes[i]->GetIndexBuffer();
 
 		// Set buffers in the input assembler
-		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-		context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
-		vertexShader->SetMatrix4x4("world", *ge->GetWorldMatrix());
-		vertexShader->SetMatrix4x4("view", camera->GetView());
-		vertexShader->SetMatrix4x4("projection", camera->GetProjection());
+		renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
-		vertexShader->CopyAllBufferData();
+		vertexShader->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_OBJECT);
 		vertexShader->SetShader();
 
-		sunPS->SetFloat3("color", XMFLOAT3(0, 0, 0));
-		sunPS->CopyAllBufferData();
+		sunPS->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_MATERIAL);
 		sunPS->SetShader();
 
 		// Finally do the actual drawing
-		context->DrawIndexed(model->meshes[i]->GetIndexCount(), 0, 0);
+		renderDevice->DrawIndexed(model->meshes[i]->GetIndexCount(), 0, 0);
 	}
 
-	RenderSun();
+	RenderSun(frame);
+}
 
-	/* Draw the main render pass */
-	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
-	context->ClearRenderTargetView(backBufferRTV, color);
-	context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-	RenderGeometry();
-	RenderSkybox();
-	RenderSun();
+// --------------------------------------------------------
+// Sets and uploads everything that only changes once per
+// frame (camera matrices, lights, post process settings) so
+// the draw loops below only need to send per-object data
+// --------------------------------------------------------
+void Game::UploadPerFrameData(const FrameData& frame)
+{
+	PROFILE_SCOPE("Upload Per-Frame Data");
 
-	/* Draw the post process crepsecular rays as an additive layer with the occlusion render to cover the source */
-	float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	context->OMSetBlendState(sunBlendState, blendFactor, 0xffffffff);
-	fillscreenVS->SetShader();
+	SimpleVertexShader* cameraShaders[] = { vertexShader, instancedVS, sunVS, skyVS };
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		cameraShaders[i]->SetMatrix4x4(frameVariables.View[i], frame.View);
+		cameraShaders[i]->SetMatrix4x4(frameVariables.Projection[i], frame.Projection);
+		cameraShaders[i]->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_FRAME);
+	}
+
+	pixelShader->SetFloat3(frameVariables.LightPositions[0], XMFLOAT3(2, 0, 0));
+	pixelShader->SetFloat3(frameVariables.LightPositions[1], XMFLOAT3(0, 2, 0));
+	pixelShader->SetFloat3(frameVariables.LightPositions[2], XMFLOAT3(0, 0, 2));
+	pixelShader->SetFloat3(frameVariables.LightPositions[3], XMFLOAT3(0, -2, 0));
+	pixelShader->SetFloat3(frameVariables.LightColor, XMFLOAT3(0.95f, 0.95f, 0.95f));
+	pixelShader->SetFloat3(frameVariables.CameraPosition, frame.CameraPosition);
+	pixelShader->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_FRAME);
+
+	crepsecularPS->SetFloat2(frameVariables.SunScreenPosition, frame.SunScreenPosition);
+	crepsecularPS->SetFloat(frameVariables.RayDensity, 1.0f);
+	crepsecularPS->SetFloat(frameVariables.RayWeight, 0.01f);
+	crepsecularPS->SetFloat(frameVariables.RayDecay, 1.0f);
+	crepsecularPS->SetFloat(frameVariables.RayExposure, 1.0f);
+	crepsecularPS->SetInt(frameVariables.RaySamples, 100);
+	crepsecularPS->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_FRAME);
+}
+
+// --------------------------------------------------------
+// Adds the world space bounds of each mesh of an entity to
+// the opaque culler
+// --------------------------------------------------------
+void Game::CullOpaque(GameEntity* ge)
+{
+	Model* model = models[ge->GetModel()];
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(ge->GetWorldMatrix()));
+	unsigned int material = (ge->GetTextures() << 4) | ge->GetAO();
+
+	for (unsigned int i = 0; i < model->meshes.size(); i++)
+	{
+		Mesh* mesh = model->meshes[i];
+		XMMATRIX meshWorld = XMMatrixMultiply(model->GetMeshTransform(i), world);
 
-	crepsecularPS->SetFloat2("screenSpaceLightPos", CalculateSunScreenPos());
-	crepsecularPS->SetFloat("density", 1.0f);
-	crepsecularPS->SetFloat("weight", 0.01f);
-	crepsecularPS->SetFloat("decay", 1.0f);
-	crepsecularPS->SetFloat("exposure", 1.0f);
-	crepsecularPS->SetInt("numSamples", 100);
-	crepsecularPS->CopyAllBufferData();
+		OpaqueDraw candidate = { mesh, ge, material, XMFLOAT4X4() };
+		XMStoreFloat4x4(&candidate.World, XMMatrixTranspose(meshWorld));
+		opaqueCuller.AddTransformed(mesh->GetBoundsCenter(), mesh->GetBoundsExtents(), mesh->GetBoundsRadius(), meshWorld);
+		cullCandidates.push_back(candidate);
+	}
+}
 
-	crepsecularPS->SetShaderResourceView("OcclusionTexture", occlusionSRV);
-	crepsecularPS->SetSamplerState("Sampler", sampler);
-	crepsecularPS->SetShader();
+// --------------------------------------------------------
+// Adds a mesh that passed culling to the opaque queue
+// --------------------------------------------------------
+void Game::QueueOpaque(const OpaqueDraw& draw)
+{
+	XMVECTOR position = XMVectorSet(draw.World._14, draw.World._24, draw.World._34, 0);
+	XMVECTOR offset = XMVectorSubtract(position, XMLoadFloat3(&camera->GetPosition()));
+	float depth = XMVectorGetX(XMVector3Length(offset)) / camera->GetFarClip();
+
+	opaqueQueue.Add(
+		RenderQueue::MakeKey(0, pixelShader->GetId(), draw.Material, draw.SubMesh->GetId(), depth),
+		opaqueDrawCount);
+	opaqueDraws[opaqueDrawCount++] = draw;
+}
 
+// --------------------------------------------------------
+// Removes entities hidden behind the biggest ones on screen
+// from visibleEntities.  Occluders themselves always stay.
+// --------------------------------------------------------
+void Game::CullOccluded(FrameData* frame)
+{
+	PROFILE_SCOPE("Occlusion Cull");
 
-	ID3D11Buffer* blank = 0;
-	context->IASetVertexBuffers(0, 1, &blank, &stride, &offset);
-	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+	const unsigned int MaxOccluders = 16;
+	const float MinOccluderSize = 0.1f;	// Bounds radius over distance
 
-	context->Draw(3, 0); // Draw one heckin big triangle
-	context->OMSetBlendState(0, blendFactor, 0xffffffff);
+	XMFLOAT3 eye = camera->GetPosition();
+	XMVECTOR eyePos = XMLoadFloat3(&eye);
+	unsigned int count = (unsigned int)visibleEntities.size();
 
+	// Score every visible entity by roughly how much of the
+	// screen it covers.  Anything around the camera can't be
+	// drawn, since it crosses the near plane.
+	visibleBounds.resize(count * 2);
+	jobs->ParallelFor(count, 256, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			GetEntityBounds(sceneEntities[visibleEntities[i]], &visibleBounds[i * 2], &visibleBounds[i * 2 + 1]);
+	});
 
-	swapChain->Present(0, 0);
+	occluderCandidates.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR min = XMLoadFloat3(&visibleBounds[i * 2]);
+		XMVECTOR max = XMLoadFloat3(&visibleBounds[i * 2 + 1]);
+		float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(max, min))) * 0.5f;
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMVectorScale(XMVectorAdd(min, max), 0.5f), eyePos)));
+		if (distance > radius && radius >= distance * MinOccluderSize)
+			occluderCandidates.push_back(std::make_pair(radius / distance, i));
+	}
+
+	if (occluderCandidates.size() > MaxOccluders)
+	{
+		std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + MaxOccluders, occluderCandidates.end(),
+			[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+		occluderCandidates.resize(MaxOccluders);
+	}
+
+	// Draw the occluders
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&camera->GetView()));
+	XMMATRIX proj = XMMatrixTranspose(XMLoadFloat4x4(&camera->GetProjection()));
+	occlusionRasterizer.ResetStats();
+	occlusionRasterizer.Begin(XMMatrixMultiply(view, proj));
+
+	isOccluder.assign(count, false);
+	for (const std::pair<float, unsigned int>& candidate : occluderCandidates)
+	{
+		GameEntity* ge = sceneEntities[visibleEntities[candidate.second]];
+		XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(ge->GetWorldMatrix()));
+		Model* model = models[ge->GetModel()];
+		for (unsigned int i = 0; i < model->meshes.size(); i++)
+		{
+			const MeshGeometry& geometry = model->meshes[i]->GetGeometry();
+			if (!geometry.IsEmpty())
+				occlusionRasterizer.RenderOccluder(geometry, XMMatrixMultiply(model->GetMeshTransform(i), world));
+		}
+		isOccluder[candidate.second] = true;
+	}
 
-	context->PSSetShaderResources(0, 16, emptySRVs); // Clear up objects for reuse
+	// Keep whatever's still visible, in order
+	unsigned int kept = 0;
+	if (!occluderCandidates.empty())
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (isOccluder[i] || occlusionRasterizer.IsVisible(visibleBounds[i * 2], visibleBounds[i * 2 + 1]))
+				visibleEntities[kept++] = visibleEntities[i];
+		}
+		visibleEntities.resize(kept);
+	}
+
+	frame->EntitiesOccluded = occlusionRasterizer.GetStats().BoxesHidden;
+	frame->OccluderTriangles = occlusionRasterizer.GetStats().TrianglesRasterized;
 }
 
-void Game::RenderGeometry()
+// --------------------------------------------------------
+// Culls the opaque meshes against the camera, then queues
+// and sorts the rest so draws sharing a mesh and material
+// are adjacent (and roughly front to back).  Each such run
+// becomes one instanced draw, with the world matrices laid
+// out in the frame in the same order.
+// --------------------------------------------------------
+void Game::BuildOpaqueDraws(FrameData* frame)
 {
-	// Grab the data from the first entity's mesh
-	UINT stride = sizeof(Vertex);
+	PROFILE_SCOPE("Build Opaque Draws");
+
+	opaqueCuller.Clear();
+	cullCandidates.clear();
+
+	// The tree rejects whole groups of entities, then each
+	// mesh of the rest is tested on its own
+	Frustum frustum = camera->GetFrustum();
+	sceneTree.QueryFrustum(frustum, &visibleEntities);
+	CullOccluded(frame);
+	for (unsigned int index : visibleEntities)
+		CullOpaque(sceneEntities[index]);
+
+	opaqueCuller.Cull(frustum, &visibleCandidates);
+	frame->MeshesTested = opaqueCuller.GetCount();
+	frame->MeshesVisible = (unsigned int)visibleCandidates.size();
+
+	// Room for every visible mesh, in the frame's arena
+	unsigned int visibleCount = (unsigned int)visibleCandidates.size();
+	opaqueQueue.Begin(&frame->Arena, visibleCount);
+	opaqueDraws = frame->Arena.AllocateArray<OpaqueDraw>(visibleCount);
+	opaqueDrawCount = 0;
+	for (unsigned int index : visibleCandidates)
+		QueueOpaque(cullCandidates[index]);
+
+	opaqueQueue.Sort();
+
+	unsigned int count = opaqueQueue.GetCount();
+	const RenderQueueEntry* queued = opaqueQueue.GetEntries();
+	frame->Instances = frame->Arena.AllocateArray<XMFLOAT4X4>(count);
+	frame->InstanceCount = count;
+	frame->Runs = frame->Arena.AllocateArray<DrawRun>(count);
+	frame->RunCount = BuildDrawRuns(queued, count, opaqueDraws, frame->Instances, frame->Runs);
+}
+
+// --------------------------------------------------------
+// Draws a prepared frame's opaque runs, one instanced draw
+// each
+// --------------------------------------------------------
+void Game::RenderGeometry(const FrameData& frame)
+{
+	PROFILE_SCOPE("Render Geometry");
+
+	unsigned int count = frame.InstanceCount;
+	if (count == 0)
+		return;
+
+	// Upload every world matrix in sorted order, so each run
+	// of draws is a contiguous block of instances
+	ReserveInstances(count);
+	if (count > instanceCapacity)
+		return;
+	renderDevice->WriteBuffer(instanceBuffer, 0, frame.Instances, count * sizeof(XMFLOAT4X4), true);
+
+	// Everything in the queue uses the same PBR shaders
+	UINT stride = sizeof(XMFLOAT4X4);
 	UINT offset = 0;
+	renderDevice->IASetVertexBuffers(1, 1, &instanceBuffer, &stride, &offset);
+	instancedVS->SetShader(); // Camera went up with the per-frame data
+	pixelShader->SetSamplerState("BasicSampler", sampler);
+	pixelShader->SetShader(); // Lights and camera went up with the per-frame data
 
-	GameEntity* ge = entities[currentEntity];
-	Model* model = models[ge->GetModel()];
-	for (unsigned int i = 0; i < model->meshes.size(); i++)
+	unsigned int runCount = frame.RunCount;
+	if (drawLists.empty())
 	{
-		// Grab the data from the mesh
-		vertexBuffer = model->meshes[i]->GetVertexBuffer();
-		indexBuffer = model->meshes[i]->GetIndexBuffer();
+		RecordDrawRuns(renderDevice, frame, 0, runCount);
+		return;
+	}
 
-		// Set buffers in the input assembler
-		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-		context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	// Each list gets an even share of the runs
+	DrawListSetup setup = { stateCache, backBufferRTV, depthStencilView, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+	RecordDrawLists(jobs, drawLists, setup, runCount, [&](IRenderDevice* target, unsigned int first, unsigned int last)
+	{
+		RecordDrawRuns(target, frame, first, last);
+	});
 
-		vertexShader->SetMatrix4x4("world", *ge->GetWorldMatrix());
-		vertexShader->SetMatrix4x4("view", camera->GetView());
-		vertexShader->SetMatrix4x4("projection", camera->GetProjection());
+	{
+		PROFILE_SCOPE("Execute Draw Lists");
+		for (IRenderCommandList* list : drawLists)
+			list->Execute(renderDevice);
+	}
 
-		vertexShader->CopyAllBufferData();
-		vertexShader->SetShader();
+	// Native lists went around the cache
+	if (drawLists[0]->StartsBlank())
+		stateCache->AddDrawCalls(runCount);
+}
 
-		pixelShader->SetFloat3("LightPos1", XMFLOAT3(2, 0, 0));
-		pixelShader->SetFloat3("LightPos2", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat3("LightPos3", XMFLOAT3(0, 0, 2));
-		pixelShader->SetFloat3("LightPos4", XMFLOAT3(0, -2, 0));
-		pixelShader->SetFloat3("LightColor1", XMFLOAT3(0.95f, 0.95f, 0.95f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
-
-		// Send texture-related stuff
-		int ind = ge->GetTextures();
-		pixelShader->SetShaderResourceView("AlbedoMap", albedoMapSRVs[ind]);
-		pixelShader->SetShaderResourceView("NormalMap", normalMapSRVs[ind]);
-		pixelShader->SetShaderResourceView("MetallicMap", metalnessMapSRVs[ind]);
-		pixelShader->SetShaderResourceView("RoughnessMap", roughnessMapSRVs[ind]);
-		pixelShader->SetShaderResourceView("AOMap", aoMapSRVs[ge->GetAO()]);
-		pixelShader->SetShaderResourceView("BRDFLookup", brdfLUTSRV);
-		pixelShader->SetShaderResourceView("EnvIrradianceMap", irradianceMapSRVs[currentEnv]);
-		pixelShader->SetShaderResourceView("EnvPrefilterMap", envPrefilterSRVs[currentEnv]);
-		pixelShader->SetSamplerState("BasicSampler", sampler);
-
-		pixelShader->CopyAllBufferData(); // Remember to copy to the GPU!!!!
-		pixelShader->SetShader();
+// --------------------------------------------------------
+// Records draw runs [first, last) onto target, binding the
+// textures and mesh buffers whenever they change.  Only
+// touches the frame and target, so any thread can call it.
+// --------------------------------------------------------
+void Game::RecordDrawRuns(IRenderDevice* target, const FrameData& frame, unsigned int first, unsigned int last)
+{
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+
+	unsigned int currentMaterial = 0xFFFFFFFF;
+	Mesh* currentMesh = 0;
+	for (unsigned int r = first; r < last; r++)
+	{
+		const DrawRun& run = frame.Runs[r];
+
+		// Textures only change with the material
+		if (run.Material != currentMaterial)
+		{
+			GameEntity* ge = run.Entity;
+			currentMaterial = run.Material;
+
+			int ind = ge->GetTextures();
+			ID3D11ShaderResourceView* textures[8] =
+			{
+				albedoMapSRVs[ind],
+				normalMapSRVs[ind],
+				metalnessMapSRVs[ind],
+				roughnessMapSRVs[ind],
+				aoMapSRVs[ge->GetAO()],
+				brdfLUTSRV,
+				irradianceMapSRVs[frame.Environment],
+				envPrefilterSRVs[frame.Environment]
+			};
+			for (unsigned int t = 0; t < 8; t++)
+			{
+				if (geometryTextureSlots[t] != 0xFFFFFFFF)
+					target->PSSetShaderResources(geometryTextureSlots[t], 1, &textures[t]);
+			}
+		}
+
+		// Set buffers in the input assembler when the mesh changes
+		if (run.SubMesh != currentMesh)
+		{
+			currentMesh = run.SubMesh;
+			ID3D11Buffer* vb = currentMesh->GetVertexBuffer();
+			ID3D11Buffer* ib = currentMesh->GetIndexBuffer();
+			target->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+			target->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+		}
 
 		// Finally do the actual drawing
-		context->DrawIndexed(model->meshes[i]->GetIndexCount(), 0, 0);
+		target->DrawIndexedInstanced(currentMesh->GetIndexCount(), run.InstanceCount, 0, 0, run.FirstInstance);
 	}
 }
 
-void Game::RenderSkybox()
+void Game::RenderSkybox(const FrameData& frame)
 {
+	PROFILE_SCOPE("Render Skybox");
+
 	// Grab the data from the first entity's mesh
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
@@ -847,58 +1783,54 @@ void Game::RenderSkybox()
 	ID3D11Buffer* skyIB = models[0]->meshes[0]->GetIndexBuffer();
 
 	// Set the buffers
-	context->IASetVertexBuffers(0, 1, &skyVB, &stride, &offset);
-	context->IASetIndexBuffer(skyIB, DXGI_FORMAT_R32_UINT, 0);
+	renderDevice->IASetVertexBuffers(0, 1, &skyVB, &stride, &offset);
+	renderDevice->IASetIndexBuffer(skyIB, DXGI_FORMAT_R32_UINT, 0);
 
-	// Set up the sky shaders
-	skyVS->SetMatrix4x4("view", camera->GetView());
-	skyVS->SetMatrix4x4("projection", camera->GetProjection());
-	skyVS->CopyAllBufferData();
+	// Set up the sky shaders (view and projection went up with the per-frame data)
 	skyVS->SetShader();
 
-	skyPS->SetShaderResourceView("SkyTexture", hdrCubeSRVs[currentEnv]);
+	skyPS->SetShaderResourceView("SkyTexture", hdrCubeSRVs[frame.Environment]);
 	skyPS->SetSamplerState("BasicSampler", sampler);
 	skyPS->SetShader();
 
 	// Set up the render state options
-	context->RSSetState(skyRasterState);
-	context->OMSetDepthStencilState(skyDepthState, 0);
+	renderDevice->RSSetState(skyRasterState);
+	renderDevice->OMSetDepthStencilState(skyDepthState, 0);
 
 	// Finally do the actual drawing
-	context->DrawIndexed(models[0]->meshes[0]->GetIndexCount(), 0, 0);
+	renderDevice->DrawIndexed(models[0]->meshes[0]->GetIndexCount(), 0, 0);
 
 
 	// Reset any states we've changed for the next frame!
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
+	renderDevice->RSSetState(0);
+	renderDevice->OMSetDepthStencilState(0, 0);
 }
 
-void Game::RenderSun()
-{	// Grab the data from the first entity's mesh
+void Game::RenderSun(const FrameData& frame)
+{
+	PROFILE_SCOPE("Render Sun");
+
+	// Grab the data from the first entity's mesh
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 
-	context->OMSetDepthStencilState(skyDepthState, 0);
-	GameEntity* ge = entities[1];
-	Model* model = models[ge->GetModel()];
+	renderDevice->OMSetDepthStencilState(skyDepthState, 0);
+	Model* model = models[entities[1]->GetModel()];
 	vertexBuffer = model->meshes[0]->GetVertexBuffer();
 	indexBuffer = model->meshes[0]->GetIndexBuffer();
 
-	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	sunVS->SetMatrix4x4("world", *ge->GetWorldMatrix());
-	sunVS->SetMatrix4x4("view", camera->GetView());
-	sunVS->SetMatrix4x4("projection", camera->GetProjection());
-
-	sunVS->CopyAllBufferData();
+	renderDevice->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	renderDevice->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	sunVS->SetMatrix4x4(frameVariables.SunWorld, frame.SunWorld);
+	sunVS->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_OBJECT);
 	sunVS->SetShader();
 
-	sunPS->SetFloat3("color", XMFLOAT3(1, 1, 1));
-	sunPS->CopyAllBufferData();
+	sunPS->SetFloat3(frameVariables.SunColor, XMFLOAT3(1, 1, 1));
+	sunPS->CopyBuffersByFrequency(BUFFER_FREQUENCY_PER_MATERIAL);
 	sunPS->SetShader();
 
-	context->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
-	context->OMSetDepthStencilState(0, 0);
+	renderDevice->DrawIndexed(model->meshes[0]->GetIndexCount(), 0, 0);
+	renderDevice->OMSetDepthStencilState(0, 0);
 }
 
 XMFLOAT2 Game::CalculateSunScreenPos() // Calculate the screen space position of the sun object
@@ -926,6 +1858,44 @@ XMFLOAT2 Game::CalculateSunScreenPos() // Calculate the screen space position of
 	return ssLP;
 }
 
+// --------------------------------------------------------
+// Adds last frame's constant buffer traffic and bind counts
+// to the title bar
+// --------------------------------------------------------
+std::string Game::GetTitleBarStats()
+{
+	std::ostringstream output;
+	output <<
+		"    CB Bytes: "	<< lastUploadStats.BytesUploaded <<
+		"    CB Uploads: "	<< lastUploadStats.UploadsIssued <<
+		"    CB Skipped: "	<< lastUploadStats.UploadsSkipped <<
+		"    CB Frame/Material/Object: " <<
+			lastUploadStats.FrequencyBytes[BUFFER_FREQUENCY_PER_FRAME] << "/" <<
+			lastUploadStats.FrequencyBytes[BUFFER_FREQUENCY_PER_MATERIAL] << "/" <<
+			lastUploadStats.FrequencyBytes[BUFFER_FREQUENCY_PER_OBJECT] <<
+		"    Binds Issued/Filtered: " <<
+			lastStateStats.CallsIssued << "/" <<
+			lastStateStats.CallsFiltered <<
+		"    Meshes Visible/Tested: " <<
+			lastMeshesVisible << "/" <<
+			lastMeshesTested <<
+		"    Entities Occluded: " << lastEntitiesOccluded <<
+		"    Occluder Tris: " << lastOccluderTriangles;
+
+	if (AllocationCounter::IsEnabled())
+		output << "    Heap Allocs/Frame: " << frameAllocations;
+
+	if (Profiler::IsEnabled())
+	{
+		FrameTimeSummary summary = Profiler::GetFrameTimeSummary(1000);
+		output.precision(3);
+		output << "    Frame p50/p95/p99: " << summary.P50 << "/" << summary.P95 << "/" << summary.P99 << "ms";
+	}
+	if (commandRecorder)
+		output << "    Recorded Draws/Instances: " << lastCommandStats.DrawCalls << "/" << lastCommandStats.InstancesDrawn;
+	return output.str();
+}
+
 #pragma region Mouse Input
 
 // --------------------------------------------------------
@@ -935,11 +1905,8 @@ XMFLOAT2 Game::CalculateSunScreenPos() // Calculate the screen space position of
 // --------------------------------------------------------
 void Game::OnMouseDown(WPARAM buttonState, int x, int y)
 {
-	// Add any custom code here...
-
-	// Save the previous mouse position, so we have it for the future
-	prevMousePos.x = x;
-	prevMousePos.y = y;
+	// Clicks and drags are read from the input snapshot in
+	// Update(), so they can be recorded and replayed
 
 	// Caputure the mouse so we keep getting mouse move
 	// events even if the mouse leaves the window.  we'll be
@@ -966,17 +1933,7 @@ void Game::OnMouseUp(WPARAM buttonState, int x, int y)
 // --------------------------------------------------------
 void Game::OnMouseMove(WPARAM buttonState, int x, int y)
 {
-	// Check left mouse button
-	if (buttonState & 0x0001)
-	{
-		float xDiff = (x - prevMousePos.x) * 0.005f;
-		float yDiff = (y - prevMousePos.y) * 0.005f;
-		camera->Rotate(yDiff, xDiff);
-	}
-
-	// Save the previous mouse position, so we have it for the future
-	prevMousePos.x = x;
-	prevMousePos.y = y;
+	// Add any custom code here...
 }
 
 // --------------------------------------------------------
@@ -2,6 +2,19 @@
 
 #include "DXCore.h"
 #include "SimpleShader.h"
+#include "ConstantUploadRing.h"
+#include "StateCache.h"
+#include "NullRenderDevice.h"
+#include "RenderCommandList.h"
+#include "RenderQueue.h"
+#include "DrawRun.h"
+#include "DrawLists.h"
+#include "FrameArena.h"
+#include "FrustumCuller.h"
+#include "AABBTree.h"
+#include "OcclusionRasterizer.h"
+#include "Profiler.h"
+#include "Benchmark.h"
 #include <DirectXMath.h>
 
 #include "Mesh.h"
@@ -9,6 +22,58 @@
 #include "Camera.h"
 #include "Model.h"
 
+// --------------------------------------------------------
+// Everything Draw() needs from the simulation, gathered by
+// PrepareFrame().  There are two, so one can be drawn while
+// the next is being prepared.
+// --------------------------------------------------------
+struct FrameData
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT3 CameraPosition;
+	DirectX::XMFLOAT2 SunScreenPosition;
+	DirectX::XMFLOAT4X4 SunWorld;
+	GameEntity* Focus;		// The current entity
+	DirectX::XMFLOAT4X4 FocusWorld;
+	unsigned int Environment;
+
+	// Allocated from Arena, which is reset each time the
+	// frame is prepared
+	FrameArena Arena;
+	DirectX::XMFLOAT4X4* Instances;	// World matrices, in run order
+	unsigned int InstanceCount;
+	DrawRun* Runs;
+	unsigned int RunCount;
+
+	unsigned int MeshesTested;
+	unsigned int MeshesVisible;
+	unsigned int EntitiesOccluded;
+	unsigned int OccluderTriangles;
+};
+
+// --------------------------------------------------------
+// Shader variables set every frame, looked up once after
+// loading so drawing never goes through their names
+// --------------------------------------------------------
+struct FrameShaderVariables
+{
+	const SimpleShaderVariable* View[4];		// One per camera shader
+	const SimpleShaderVariable* Projection[4];
+	const SimpleShaderVariable* LightPositions[4];
+	const SimpleShaderVariable* LightColor;
+	const SimpleShaderVariable* CameraPosition;
+	const SimpleShaderVariable* SunScreenPosition;
+	const SimpleShaderVariable* RayDensity;
+	const SimpleShaderVariable* RayWeight;
+	const SimpleShaderVariable* RayDecay;
+	const SimpleShaderVariable* RayExposure;
+	const SimpleShaderVariable* RaySamples;
+	const SimpleShaderVariable* OccluderWorld;	// vertexShader's
+	const SimpleShaderVariable* SunWorld;		// sunVS's
+	const SimpleShaderVariable* SunColor;		// sunPS's
+};
+
 class Game 
 	: public DXCore
 {
@@ -20,37 +85,71 @@ public:
 	// Overridden setup and game loop methods, which
 	// will be called automatically
 	void Init();
+	void RecordCommands(std::string logPath);
+	void ProfileToTrace(std::string tracePath);
+	void RunBenchmark(std::string scriptPath, unsigned int frames, std::string reportPath);
+	void SpawnSphereField(unsigned int count);
+	void SetDrawThreads(unsigned int count);
+	void SetCpuMeshBudget(size_t bytes);
+	void SetUploadEverything(bool enabled);
+	void BenchmarkRaycasts(unsigned int rays);
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
+	void UpdateBenchmark();
+	void RecordBenchmarkFrame();
+	void Interpolate(float alpha);
+	void PrepareFrame();
 	void Draw(float deltaTime, float totalTime);
-	void RenderGeometry();
-	void RenderSkybox();
-	void RenderSun();
+	void UploadPerFrameData(const FrameData& frame);
+	void BuildOpaqueDraws(FrameData* frame);
+	void CullOccluded(FrameData* frame);
+	void CullOpaque(GameEntity* ge);
+	void QueueOpaque(const OpaqueDraw& draw);
+	void RenderOcclusionPass(const FrameData& frame);
+	void RenderGeometry(const FrameData& frame);
+	void RecordDrawRuns(IRenderDevice* target, const FrameData& frame, unsigned int first, unsigned int last);
+	void RenderSkybox(const FrameData& frame);
+	void RenderSun(const FrameData& frame);
 
 	// Overridden mouse input helper methods
 	void OnMouseDown (WPARAM buttonState, int x, int y);
 	void OnMouseUp	 (WPARAM buttonState, int x, int y);
 	void OnMouseMove (WPARAM buttonState, int x, int y);
 	void OnMouseWheel(float wheelDelta,   int x, int y);
+
+protected:
+	std::string GetTitleBarStats();
+
 private:
 
-	// Input and mesh swapping
-	bool prevTab;
+	// Mesh and environment swapping
 	unsigned int currentEntity;
-	bool prevB;
 	unsigned int currentEnv;
 
+	// Every entity's position, rotation, scale and world matrix
+	TransformSystem transforms;
+
 	// Keep track of "stuff" to clean up
 	Model* models[8];
 	std::vector<GameEntity*> entities;
+	std::vector<GameEntity*> sphereField;
+	unsigned int sphereFieldCount;
+	unsigned int rayBenchmarkRays;	// Rays per test, if benchmarking picking
 	Camera* camera;
 
 	// Initialization helper methods - feel free to customize, combine, etc.
+	void CreateRenderDevice();
 	void LoadShaders(); 
+	void CreateUploadRing();
 	void CreateMatrices();
 	void LoadModels();
 	void LoadTextures();
 	void CreateGameEntities();
+	void IndexScene();
+	void GetEntityBounds(GameEntity* ge, DirectX::XMFLOAT3* min, DirectX::XMFLOAT3* max);
+	void PickEntity(int x, int y);
+	void RunRayBenchmark();
+	void ReserveInstances(unsigned int count);
 	void CreateBRDFLUT();
 	void ConvertEquisToEnvironments(int hdrInd);
 
@@ -60,6 +159,7 @@ private:
 
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* instancedVS;
 	SimplePixelShader* pixelShader;
 	SimpleVertexShader* equirectangularToCubemapVS;
 	SimplePixelShader* equirectangularToCubemapPS;
@@ -106,7 +206,80 @@ private:
 	// Needed for sampling options (like filter and address modes)
 	ID3D11SamplerState* sampler;
 
-	// Keeps track of the old mouse position.  Useful for 
-	// determining how far the mouse moved in a single frame.
-	POINT prevMousePos;
+	// Shared ring for per-draw constant data
+	ConstantUploadRing* constantRing;
+
+	// Everything is drawn through renderDevice, which is a state
+	// cache in front of the real backend (D3D11 or the recorder)
+	IRenderDevice* backendDevice;
+	StateCache* stateCache;
+	IRenderDevice* renderDevice;
+
+	// The opaque pass's draw runs are split between these and
+	// recorded on the workers, then run in order.  Empty when
+	// drawThreads is 1, so everything's drawn directly.
+	unsigned int drawThreads;
+	std::vector<IRenderCommandList*> drawLists;
+
+	// Pixel shader slots of the opaque pass's textures (in the
+	// order RecordDrawRuns() binds them), so draws can be
+	// recorded without going through the shader
+	unsigned int geometryTextureSlots[8];
+	unsigned int occlusionTextureSlot;	// crepsecularPS's
+	FrameShaderVariables frameVariables;
+
+	// Null backend, only used when recording commands
+	NullRenderDevice* commandRecorder;
+	std::string commandLogPath;
+	bool commandLogWritten;
+
+	// Where the profile goes on shutdown, if profiling
+	std::string profileTracePath;
+
+	// Drives the camera instead of input, while benchmarking
+	Benchmark* benchmark;
+	std::string benchmarkReportPath;
+	unsigned int benchmarkSteps;
+
+	// Prepared frames, indexed by framePipeline's slots
+	FrameData frames[2];
+
+	// Spatial index of everything that can be drawn.  The
+	// current entity is always sceneEntities[0].
+	AABBTree sceneTree;
+	std::vector<GameEntity*> sceneEntities;
+	std::vector<int> sceneProxies;
+	std::vector<unsigned int> visibleEntities;
+
+	// The biggest visible entities on screen are drawn into a
+	// small CPU depth buffer, and the rest are tested against it.
+	// Bounds are kept as (min, max) pairs per visible entity.
+	OcclusionRasterizer occlusionRasterizer;
+	std::vector<DirectX::XMFLOAT3> visibleBounds;
+	std::vector<std::pair<float, unsigned int>> occluderCandidates;
+	std::vector<bool> isOccluder;
+
+	// Opaque meshes tested against the camera, and the
+	// sorted draws for those that pass, rebuilt every frame
+	// (only while preparing, so one set is enough).  The queue
+	// and draws are in the prepared frame's arena.
+	FrustumCuller opaqueCuller;
+	std::vector<OpaqueDraw> cullCandidates;
+	std::vector<unsigned int> visibleCandidates;
+	RenderQueue opaqueQueue;
+	OpaqueDraw* opaqueDraws;
+	unsigned int opaqueDrawCount;
+
+	// World matrices for instanced draws, in queue order
+	ID3D11Buffer* instanceBuffer;
+	unsigned int instanceCapacity;
+
+	// Constant buffer traffic, bind calls and recorded commands from the last full frame
+	SimpleShaderUploadStats lastUploadStats;
+	StateCacheStats lastStateStats;
+	RenderCommandStats lastCommandStats;
+	unsigned int lastMeshesTested;
+	unsigned int lastMeshesVisible;
+	unsigned int lastEntitiesOccluded;
+	unsigned int lastOccluderTriangles;
 };
\ No newline at end of file
@@ -2,33 +2,43 @@
 
 using namespace DirectX;
 
-GameEntity::GameEntity(int modelInd, int textureInd, int aoInd)
+GameEntity::GameEntity(TransformSystem* transforms, int modelInd, int textureInd, int aoInd)
 {
 	// Save the mesh
 	modelIndex = modelInd;
 	textureIndex = textureInd;
 	aoIndex = aoInd;
 
-	// Set up transform
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	position = XMFLOAT3(0, 0, 0);
-	rotation = XMFLOAT3(0, 0, 0);
-	scale = XMFLOAT3(1, 1, 1);
+	// Set up transform - starts out as identity
+	this->transforms = transforms;
+	transform = transforms->Create();
 }
 
 GameEntity::~GameEntity(void)
 {
 }
 
-// Update the world matrix
-void GameEntity::UpdateWorldMatrix()
+bool GameEntity::Raycast(Model* model, const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, EntityRayHit* hit)
 {
-	XMMATRIX trans = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX rotX = XMMatrixRotationX(rotation.x);
-	XMMATRIX rotY = XMMatrixRotationY(rotation.y);
-	XMMATRIX rotZ = XMMatrixRotationZ(rotation.z);
-	XMMATRIX sc = XMMatrixScaling(scale.x, scale.y, scale.z);
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(GetWorldMatrix()));
 
-	XMMATRIX total = sc * rotZ * rotY * rotX * trans;
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(total));
+	bool found = false;
+	float closest = maxDistance;
+	for (unsigned int i = 0; i < model->meshes.size(); i++)
+	{
+		// Into the mesh's space, leaving the direction unnormalized
+		// so distances along it stay in world units
+		XMMATRIX toLocal = XMMatrixInverse(0, XMMatrixMultiply(model->GetMeshTransform(i), world));
+		XMFLOAT3 localOrigin, localDirection;
+		XMStoreFloat3(&localOrigin, XMVector3TransformCoord(XMLoadFloat3(&origin), toLocal));
+		XMStoreFloat3(&localDirection, XMVector3TransformNormal(XMLoadFloat3(&direction), toLocal));
+
+		if (model->meshes[i]->Raycast(localOrigin, localDirection, closest, &hit->MeshHit))
+		{
+			found = true;
+			hit->Mesh = i;
+			closest = hit->MeshHit.Distance;
+		}
+	}
+	return found;
 }
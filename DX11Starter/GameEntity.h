@@ -3,37 +3,53 @@
 #include <DirectXMath.h>
 #include "Mesh.h"
 #include "Model.h"
+#include "TransformSystem.h"
+
+// --------------------------------------------------------
+// Where a ray hit an entity - which of its model's meshes,
+// and where on that mesh.  Distance is in world units.
+// --------------------------------------------------------
+struct EntityRayHit
+{
+	unsigned int Mesh;
+	MeshRayHit MeshHit;
+};
 
 class GameEntity
 {
 public:
-	GameEntity(int modelInd, int textureInd, int aoInd);
+	GameEntity(TransformSystem* transforms, int modelInd, int textureInd, int aoInd);
 	~GameEntity(void);
 
-	void UpdateWorldMatrix();
+	void Move(float x, float y, float z)		{ transforms->Move(transform, x, y, z); }
+	void Rotate(float x, float y, float z)		{ transforms->Rotate(transform, x, y, z); }
 
-	void Move(float x, float y, float z)		{ position.x += x;	position.y += y;	position.z += z; }
-	void Rotate(float x, float y, float z)		{ rotation.x += x;	rotation.y += y;	rotation.z += z; }
-
-	void SetPosition(float x, float y, float z) { position.x = x;	position.y = y;		position.z = z; }
-	void SetRotation(float x, float y, float z) { rotation.x = x;	rotation.y = y;		rotation.z = z; }
-	void SetScale(float x, float y, float z)	{ scale.x = x;		scale.y = y;		scale.z = z;	}
+	void SetPosition(float x, float y, float z) { transforms->SetPosition(transform, x, y, z); }
+	void SetRotation(float x, float y, float z) { transforms->SetRotation(transform, x, y, z); }
+	void SetScale(float x, float y, float z)	{ transforms->SetScale(transform, x, y, z); }
 
 	int GetModel() { return modelIndex; }
 	int GetTextures() { return textureIndex; }
 	int GetAO() { return aoIndex; }
-	DirectX::XMFLOAT4X4* GetWorldMatrix() { return &worldMatrix; }
-	DirectX::XMFLOAT3 GetPosition() { return position; }
+
+	// Only up to date after the transform system's last Update()
+	DirectX::XMFLOAT4X4* GetWorldMatrix() { return transforms->GetWorldMatrix(transform); }
+	DirectX::XMFLOAT3 GetPosition() { return transforms->GetPosition(transform); }
+
+	// Nearest hit on any of the model's meshes, placed by this
+	// entity's world matrix, along a world space ray with a
+	// normalized direction
+	bool Raycast(Model* model, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, EntityRayHit* hit);
 private:
 
 	int textureIndex;
 	int modelIndex;
 	int aoIndex;
 
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;
-	DirectX::XMFLOAT3 scale;
+	// Position, rotation, scale and world matrix all live in
+	// the transform system
+	TransformSystem* transforms;
+	unsigned int transform;
 
 };
 
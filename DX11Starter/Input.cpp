@@ -0,0 +1,106 @@
+#include "Input.h"
+
+#include <cstring>
+
+// Start of every input stream, followed by whole frames
+static const char StreamTag[4] = { 'I', 'N', 'P', '1' };
+
+Input::Input()
+{
+	current = {};
+	previous = {};
+	pending = {};
+	replaying = false;
+	replayFinished = false;
+}
+
+void Input::OnMouseMove(int x, int y)
+{
+	pending.MouseX = x;
+	pending.MouseY = y;
+}
+
+void Input::OnMouseButton(MouseButton button, bool down)
+{
+	if (down)
+		pending.MouseButtons |= 1u << button;
+	else
+		pending.MouseButtons &= ~(1u << button);
+}
+
+void Input::OnMouseWheel(float delta)
+{
+	pending.WheelDelta += delta;
+}
+
+void Input::BeginFrame(const unsigned char keyStates[256], float deltaTime)
+{
+	if (replaying)
+	{
+		// Live wheel movement meanwhile is dropped, rather than
+		// all arriving at once when the replay ends
+		if (replay.read((char*)&current, sizeof(InputFrame)))
+		{
+			pending.WheelDelta = 0.0f;
+			return;
+		}
+
+		// Out of frames - hand back to the user, with nothing held
+		replaying = false;
+		replayFinished = true;
+		replay.close();
+		current = {};
+	}
+
+	for (unsigned int i = 0; i < 8; i++)
+		current.Keys[i] = 0;
+	for (unsigned int key = 0; key < 256; key++)
+	{
+		if (keyStates[key] & 0x80)
+			current.Keys[key >> 5] |= 1u << (key & 31);
+	}
+
+	current.MouseX = pending.MouseX;
+	current.MouseY = pending.MouseY;
+	current.MouseButtons = pending.MouseButtons;
+	current.WheelDelta += pending.WheelDelta;
+	current.DeltaTime = deltaTime;
+	pending.WheelDelta = 0.0f;
+
+	if (recording.is_open())
+		recording.write((const char*)&current, sizeof(InputFrame));
+}
+
+void Input::ConsumeFrame()
+{
+	previous = current;
+	current.WheelDelta = 0.0f;
+}
+
+bool Input::StartRecording(const std::string& path)
+{
+	recording.open(path, std::ios::binary | std::ios::trunc);
+	if (!recording)
+		return false;
+
+	recording.write(StreamTag, sizeof(StreamTag));
+	return (bool)recording;
+}
+
+bool Input::StartReplay(const std::string& path)
+{
+	replay.open(path, std::ios::binary);
+	if (!replay)
+		return false;
+
+	char tag[sizeof(StreamTag)];
+	if (!replay.read(tag, sizeof(tag)) || memcmp(tag, StreamTag, sizeof(tag)) != 0)
+	{
+		replay.close();
+		return false;
+	}
+
+	replaying = true;
+	replayFinished = false;
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+// --------------------------------------------------------
+// Mouse buttons tracked by Input
+// --------------------------------------------------------
+enum MouseButton
+{
+	MOUSE_LEFT,
+	MOUSE_RIGHT,
+	MOUSE_MIDDLE
+};
+
+// --------------------------------------------------------
+// Everything the game can see of the user for one frame.
+// Plain data, so it's recorded and replayed as is.
+// --------------------------------------------------------
+struct InputFrame
+{
+	unsigned int Keys[8];		// One bit per virtual key
+	int MouseX;
+	int MouseY;
+	unsigned int MouseButtons;	// One bit per MouseButton
+	float WheelDelta;			// Since the last ConsumeFrame()
+	float DeltaTime;			// Seconds
+};
+
+// --------------------------------------------------------
+// Per frame snapshot of the keyboard and mouse.
+//
+// DXCore fills it once at the start of each frame from the
+// keyboard state and the mouse messages since the last one,
+// and the game reads only the snapshot - so it's the same
+// for the whole frame, costs one poll no matter how many
+// keys are checked, and can be recorded and played back.
+// While replaying, live input is ignored and each frame
+// (including its delta time) comes from the recording.
+// --------------------------------------------------------
+class Input
+{
+public:
+	Input();
+
+	// Mouse messages, as they arrive
+	void OnMouseMove(int x, int y);
+	void OnMouseButton(MouseButton button, bool down);
+	void OnMouseWheel(float delta);
+
+	// Starts a frame from live input (keyStates has the high
+	// bit set for each virtual key that's down), or the next
+	// recorded frame when replaying
+	void BeginFrame(const unsigned char keyStates[256], float deltaTime);
+
+	// Marks everything so far as seen, once a simulation step
+	// has read it.  Presses and mouse movement are measured
+	// from here, so a frame with no steps doesn't lose them and
+	// a frame with several doesn't repeat them.
+	void ConsumeFrame();
+
+	// Saving and loading input streams
+	bool StartRecording(const std::string& path);
+	bool StartReplay(const std::string& path);
+	bool IsReplaying() { return replaying; }
+	bool ReplayFinished() { return replayFinished; }
+
+	// Keyboard, by virtual key code
+	bool IsKeyDown(unsigned char key) { return IsDown(current, key); }
+	bool WasKeyPressed(unsigned char key) { return IsDown(current, key) && !IsDown(previous, key); }
+	bool WasKeyReleased(unsigned char key) { return !IsDown(current, key) && IsDown(previous, key); }
+
+	// Mouse
+	bool IsButtonDown(MouseButton button) { return (current.MouseButtons >> button) & 1; }
+	bool WasButtonPressed(MouseButton button) { return IsButtonDown(button) && !((previous.MouseButtons >> button) & 1); }
+	int GetMouseX() { return current.MouseX; }
+	int GetMouseY() { return current.MouseY; }
+	int GetMouseDeltaX() { return current.MouseX - previous.MouseX; }
+	int GetMouseDeltaY() { return current.MouseY - previous.MouseY; }
+	float GetWheelDelta() { return current.WheelDelta; }
+
+	// Live, or the recorded one when replaying
+	float GetDeltaTime() { return current.DeltaTime; }
+
+private:
+	InputFrame current;
+	InputFrame previous;
+
+	// Mouse state built up from messages between frames
+	InputFrame pending;
+
+	std::ofstream recording;
+	std::ifstream replay;
+	bool replaying;
+	bool replayFinished;
+
+	static bool IsDown(const InputFrame& frame, unsigned char key) { return (frame.Keys[key >> 5] >> (key & 31)) & 1; }
+};
@@ -0,0 +1,66 @@
+
+// Camera matrices, shared with the regular vertex shader
+cbuffer perFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// Struct representing a single vertex worth of data, plus
+// the world matrix of the instance it belongs to.  The
+// "_PER_INSTANCE" semantic puts the matrix in input slot 1,
+// stepping once per instance.  The matrices are stored the
+// same (transposed) way as in a constant buffer, so each
+// row here is a column of the world matrix.
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 uv			: TEXCOORD;
+	float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+	float3 worldPos		: POSITION; // The world position of this vertex
+};
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	// Rebuild this instance's world matrix
+	matrix world = transpose(matrix(input.world0, input.world1, input.world2, input.world3));
+
+	// Calculate output position
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(input.position, 1.0f), worldViewProj);
+
+	// Calculate the world position of this vertex (to be used
+	// in the pixel shader when we do point/spot lights)
+	output.worldPos = mul(float4(input.position, 1.0f), world).xyz;
+
+	// Make sure the normal is in WORLD space, not "local" space
+	output.normal = normalize(mul(input.normal, (float3x3)world));
+
+	// Make sure the tangent is in WORLD space and a unit vector
+	output.tangent = normalize(mul(input.tangent, (float3x3)world));
+
+	// Pass through the uv
+	output.uv = input.uv;
+
+	return output;
+}
@@ -0,0 +1,213 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+// Which system (if any) the current thread works for, and
+// its worker index there
+static thread_local JobSystem* currentSystem = 0;
+static thread_local unsigned int currentWorker = 0;
+
+// Failed attempts to find a job before a worker sleeps
+static const unsigned int IdleSpins = 64;
+
+// --------------------------------------------------------
+// Queue
+//
+// Follows Le, Pop, Cohen and Zappa Nardelli's "Correct and
+// Efficient Work-Stealing for Weak Memory Models", without
+// the resizing.
+// --------------------------------------------------------
+JobQueue::JobQueue()
+{
+	top = 0;
+	bottom = 0;
+}
+
+bool JobQueue::Push(const Job& job)
+{
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	if (b - t >= (long long)Capacity)
+		return false;
+
+	slots[b & (Capacity - 1)] = job;
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobQueue::Pop(Job* job)
+{
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Already empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	*job = slots[b & (Capacity - 1)];
+	if (t == b)
+	{
+		// Last one - race any thieves for it
+		bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+bool JobQueue::Steal(Job* job)
+{
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return false;
+
+	// Copy before claiming it - once top moves on, the owner
+	// is free to reuse the slot
+	*job = slots[t & (Capacity - 1)];
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------
+// System
+// --------------------------------------------------------
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	queuedJobs = 0;
+	sleepingWorkers = 0;
+	quit = false;
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		queues.push_back(new JobQueue());
+
+	currentSystem = this;
+	currentWorker = 0;
+	for (unsigned int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto& t : threads)
+		t.join();
+
+	for (auto& q : queues)
+		delete q;
+	if (currentSystem == this)
+		currentSystem = 0;
+}
+
+void JobSystem::Run(JobFunction function, void* data, JobCounter* counter)
+{
+	if (counter)
+		counter->fetch_add(1);
+
+	// Threads we don't own have no queue
+	if (currentSystem != this)
+	{
+		Execute({ function, data, counter });
+		return;
+	}
+
+	// Count it first, so a thief can't take it off the count
+	// before it's on there
+	Job job = { function, data, counter };
+	queuedJobs.fetch_add(1);
+	if (!queues[currentWorker]->Push(job))
+	{
+		queuedJobs.fetch_sub(1);
+		Execute(job);
+		return;
+	}
+
+	if (sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	while (counter->load(std::memory_order_acquire) > 0)
+	{
+		Job job;
+		if (currentSystem == this && FindJob(currentWorker, &job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// Takes a job from the worker's own queue, or steals one
+// from the next worker along that has any
+bool JobSystem::FindJob(unsigned int index, Job* job)
+{
+	bool found = queues[index]->Pop(job);
+	unsigned int count = (unsigned int)queues.size();
+	for (unsigned int i = 1; !found && i < count; i++)
+		found = queues[(index + i) % count]->Steal(job);
+
+	if (found)
+		queuedJobs.fetch_sub(1);
+	return found;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	job.Function(job.Data);
+	if (job.Counter)
+		job.Counter->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	currentSystem = this;
+	currentWorker = index;
+	if (Profiler::IsEnabled())
+		Profiler::SetThreadName("Worker");
+
+	unsigned int spins = 0;
+	while (!quit.load())
+	{
+		Job job;
+		if (FindJob(index, &job))
+		{
+			Execute(job);
+			spins = 0;
+			continue;
+		}
+
+		if (++spins < IdleSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Nothing around for a while - sleep until there is.  The
+		// timeout covers a job queued between the check and the wait.
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return quit.load() || queuedJobs.load() > 0; });
+		sleepingWorkers.fetch_sub(1);
+		spins = 0;
+	}
+}
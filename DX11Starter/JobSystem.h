@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*JobFunction)(void* data);
+
+// Counts unfinished jobs - Run() adds one, finishing takes
+// one away, and Wait() returns once it's back at zero
+typedef std::atomic<int> JobCounter;
+
+struct Job
+{
+	JobFunction Function;
+	void* Data;
+	JobCounter* Counter;
+};
+
+// --------------------------------------------------------
+// Fixed size Chase-Lev work stealing deque.
+//
+// Only its owner pushes and pops, at the bottom; any thread
+// can steal from the top.  Jobs are stored by value, and
+// taking one copies it out before claiming it, so a slot is
+// never read after the owner is free to reuse it.
+// --------------------------------------------------------
+class JobQueue
+{
+public:
+	static const unsigned int Capacity = 4096;
+
+	JobQueue();
+
+	bool Push(const Job& job);
+	bool Pop(Job* job);
+	bool Steal(Job* job);
+
+private:
+	// Thieves write top and the owner writes bottom, so keep
+	// them on separate cache lines
+	std::atomic<long long> top;
+	char padding[64];
+	std::atomic<long long> bottom;
+	Job slots[Capacity];
+};
+
+// --------------------------------------------------------
+// Work stealing job scheduler.
+//
+// The thread that creates it is worker 0 and only runs jobs
+// while it waits; the rest are background threads.  Each
+// worker pushes the jobs it runs onto its own queue and takes
+// from it first, stealing from the others when it's empty.
+// Idle workers spin briefly, then sleep until more work shows
+// up.
+//
+// Dependencies are expressed with counters: a job that needs
+// other jobs finished just Wait()s on their counter, which
+// runs queued jobs (rather than blocking) until it's done.
+// Jobs queued from threads outside the system, or when the
+// queue is full, run immediately on the calling thread.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	// Zero means one worker per hardware thread
+	JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	void Run(JobFunction function, void* data, JobCounter* counter);
+	void Wait(JobCounter* counter);
+
+	// Calls body(begin, end) over [0, count) in chunks of
+	// grain, spread across the workers, and returns when every
+	// chunk is done
+	template<typename Body>
+	void ParallelFor(unsigned int count, unsigned int grain, const Body& body);
+
+	unsigned int GetThreadCount() { return (unsigned int)queues.size(); }
+
+private:
+	std::vector<JobQueue*> queues;
+	std::vector<std::thread> threads;
+
+	// Queued jobs, for waking and putting workers to sleep
+	std::atomic<int> queuedJobs;
+	std::atomic<int> sleepingWorkers;
+	std::atomic<bool> quit;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	void WorkerLoop(unsigned int index);
+	bool FindJob(unsigned int index, Job* job);
+	static void Execute(const Job& job);
+
+	// Shared state of one ParallelFor() call
+	template<typename Body>
+	struct ParallelForState
+	{
+		const Body* Loop;
+		unsigned int Count;
+		unsigned int Grain;
+		std::atomic<unsigned int> NextChunk;
+
+		static void Work(void* data)
+		{
+			ParallelForState* state = (ParallelForState*)data;
+			for (;;)
+			{
+				unsigned int begin = state->NextChunk.fetch_add(1) * state->Grain;
+				if (begin >= state->Count)
+					return;
+				unsigned int end = begin + state->Grain < state->Count ? begin + state->Grain : state->Count;
+				(*state->Loop)(begin, end);
+			}
+		}
+	};
+};
+
+// Queues one job per worker (counting this thread), each
+// grabbing chunks until they run out, so fast workers take
+// more of them
+template<typename Body>
+void JobSystem::ParallelFor(unsigned int count, unsigned int grain, const Body& body)
+{
+	if (grain == 0)
+		grain = 1;
+	unsigned int chunks = (count + grain - 1) / grain;
+	if (chunks == 0)
+		return;
+
+	ParallelForState<Body> state;
+	state.Loop = &body;
+	state.Count = count;
+	state.Grain = grain;
+	state.NextChunk = 0;
+
+	JobCounter counter(0);
+	unsigned int helpers = GetThreadCount() < chunks ? GetThreadCount() : chunks;
+	for (unsigned int i = 1; i < helpers; i++)
+		Run(&ParallelForState<Body>::Work, &state, &counter);
+
+	ParallelForState<Body>::Work(&state);
+	Wait(&counter);
+}
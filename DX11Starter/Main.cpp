@@ -48,6 +48,70 @@ int WINAPI WinMain(
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
 
+	// "-record" draws through the null backend instead, saving
+	// the command stream so it can be compared between builds
+	if (strstr(lpCmdLine, "-record"))
+		dxGame.RecordCommands("commands.log");
+
+	// "-spheres" adds a field of 10k instanced spheres to the
+	// scene, or as many as given with "-spheres=N"
+	if (const char* spheres = strstr(lpCmdLine, "-spheres"))
+		dxGame.SpawnSphereField(spheres[8] == '=' ? (unsigned int)atoi(spheres + 9) : 10000);
+
+	// "-profile" times the whole run, saving a Chrome trace on exit,
+	// and prints what each model import allocated
+	if (strstr(lpCmdLine, "-profile"))
+		dxGame.ProfileToTrace("profile.json");
+
+	// "-variablestep" runs one update per frame, as long as the
+	// frame, instead of fixed 60hz steps
+	if (strstr(lpCmdLine, "-variablestep"))
+		dxGame.SetSimulationRate(0.0f);
+
+	// "-fastforward" simulates a minute of steps before drawing
+	if (strstr(lpCmdLine, "-fastforward"))
+		dxGame.FastForward(3600);
+
+	// "-pipelined" simulates each frame while drawing the last
+	if (strstr(lpCmdLine, "-pipelined"))
+		dxGame.SetPipelined(true);
+
+	// "-drawthreads" records the opaque pass on every worker at
+	// once, or split between N command lists with "-drawthreads=N"
+	if (const char* drawThreads = strstr(lpCmdLine, "-drawthreads"))
+		dxGame.SetDrawThreads(drawThreads[12] == '=' ? (unsigned int)atoi(drawThreads + 13) : 0);
+
+	// "-meshbudget=N" keeps at most N MB of mesh geometry on the
+	// CPU, quantizing or dropping whatever doesn't fit
+	if (const char* meshBudget = strstr(lpCmdLine, "-meshbudget="))
+		dxGame.SetCpuMeshBudget((size_t)atoi(meshBudget + 12) * 1024 * 1024);
+
+	// "-raybench" times building the gun's mesh trees, and 1M
+	// coherent and incoherent raycasts against it (or N each,
+	// with "-raybench=N"), once it's loaded
+	if (const char* rayBench = strstr(lpCmdLine, "-raybench"))
+		dxGame.BenchmarkRaycasts(rayBench[9] == '=' ? (unsigned int)atoi(rayBench + 10) : 1000000);
+
+	// "-uploadall" sends every constant buffer in full each time
+	// a shader's constants are copied, as before per-frame data
+	// was split out and unchanged buffers were skipped - compare
+	// bytesUploaded in "-benchmark" reports with and without it
+	if (strstr(lpCmdLine, "-uploadall"))
+		dxGame.SetUploadEverything(true);
+
+	// "-benchmark" flies benchmark.txt's camera path (or a default
+	// loop) for 3600 fixed-step frames, or N with "-benchmark=N",
+	// saving benchmark.json
+	if (const char* benchmark = strstr(lpCmdLine, "-benchmark"))
+		dxGame.RunBenchmark("benchmark.txt", benchmark[10] == '=' ? (unsigned int)atoi(benchmark + 11) : 3600, "benchmark.json");
+
+	// "-saveinput" records every frame's input to input.rec, and
+	// "-replayinput" plays it back (timing included), then quits
+	if (strstr(lpCmdLine, "-saveinput"))
+		dxGame.RecordInput("input.rec");
+	if (strstr(lpCmdLine, "-replayinput"))
+		dxGame.ReplayInput("input.rec");
+
 	// Result variable for function calls below
 	HRESULT hr = S_OK;
 
@@ -3,37 +3,147 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <string.h>
+#include <atomic>
+#include <limits>
+#include <algorithm>
 
 using namespace DirectX;
 
-Mesh::Mesh(Vertex* vertArray, unsigned int numVerts, unsigned int* indexArray, unsigned int numIndices, ID3D11Device* device)
+// Shared by every mesh, and models load in parallel
+static std::atomic<unsigned int> nextId(0);
+static std::atomic<size_t> cpuBudget(std::numeric_limits<size_t>::max());
+static std::atomic<size_t> cpuBytes(0);
+
+static bool ReserveBytes(size_t bytes)
+{
+	size_t used = cpuBytes;
+	while (used + bytes <= cpuBudget)
+	{
+		if (cpuBytes.compare_exchange_weak(used, used + bytes))
+			return true;
+	}
+	return false;
+}
+
+size_t MeshImportScratch::GetCapacity()
+{
+	return File.capacity() * sizeof(char) +
+		Positions.capacity() * sizeof(XMFLOAT3) +
+		Normals.capacity() * sizeof(XMFLOAT3) +
+		UVs.capacity() * sizeof(XMFLOAT2) +
+		Verts.capacity() * sizeof(Vertex);
+}
+
+Mesh::Mesh(Vertex* vertArray, unsigned int numVerts, unsigned int* indexArray, unsigned int numIndices, ID3D11Device* device, MeshResidency residency)
 {
+	id = nextId.fetch_add(1);
+	CalculateBounds(0, 0);
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
+	bvhBytes = 0;
+
+	this->residency = ReserveCpuBytes(numVerts, numIndices, residency);
+	if (this->residency != MESH_RESIDENCY_NONE)
+		geometry.Build(&vertArray[0].Position, sizeof(Vertex), numVerts, indexArray, numIndices, this->residency == MESH_RESIDENCY_QUANTIZED);
+}
+
+Mesh::Mesh(Vertex* vertArray, unsigned int numVerts, std::vector<unsigned int>&& indices, ID3D11Device* device, MeshResidency residency)
+{
+	id = nextId.fetch_add(1);
+	CalculateBounds(0, 0);
+	CreateBuffers(vertArray, numVerts, indices.data(), (unsigned int)indices.size(), device);
+	bvhBytes = 0;
+
+	this->residency = ReserveCpuBytes(numVerts, (unsigned int)indices.size(), residency);
+	if (this->residency != MESH_RESIDENCY_NONE)
+		geometry.Build(&vertArray[0].Position, sizeof(Vertex), numVerts, std::move(indices), this->residency == MESH_RESIDENCY_QUANTIZED);
 }
 
-Mesh::Mesh(const char* objFile, ID3D11Device* device)
+Mesh::Mesh(const char* objFile, ID3D11Device* device, MeshImportScratch* scratch, MeshResidency residency)
 {
+	id = nextId.fetch_add(1);
+	vb = 0;
+	ib = 0;
+	numIndices = 0;
+	gpuBytes = 0;
+	bvhBytes = 0;
+	this->residency = MESH_RESIDENCY_NONE;
+	CalculateBounds(0, 0);
+
 	// File input object
-	std::ifstream obj(objFile);
+	std::ifstream obj(objFile, std::ios::binary);
 
 	// Check for successful open
 	if (!obj.is_open())	return;
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	MeshImportScratch localScratch;
+	if (!scratch)
+		scratch = &localScratch;
+
+	// Read the whole file at once, with a terminator at the end
+	obj.seekg(0, std::ios::end);
+	size_t fileSize = (size_t)obj.tellg();
+	obj.seekg(0, std::ios::beg);
+	std::vector<char>& file = scratch->File;
+	file.resize(fileSize + 1);
+	obj.read(file.data(), fileSize);
+	file[fileSize] = 0;
+	obj.close();
+
+	// Count everything first, so every list is allocated once
+	// at its final size.  Lines are split in place as we go.
+	unsigned int positionCount = 0;
+	unsigned int normalCount = 0;
+	unsigned int uvCount = 0;
+	unsigned int vertCount = 0;
+	for (char* line = file.data(); line < file.data() + fileSize;)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		char* lineEnd = line;
+		while (*lineEnd && *lineEnd != '\n')
+			lineEnd++;
+		*lineEnd = 0;
+
+		if (line[0] == 'v' && line[1] == 'n')
+			normalCount++;
+		else if (line[0] == 'v' && line[1] == 't')
+			uvCount++;
+		else if (line[0] == 'v')
+			positionCount++;
+		else if (line[0] == 'f')
+		{
+			// A triangle, or a quad split into two
+			unsigned int corners = 0;
+			for (char* c = line + 1; c < lineEnd; c++)
+			{
+				if (*c != ' ' && *c != '\t' && *c != '\r' && (c[-1] == ' ' || c[-1] == '\t'))
+					corners++;
+			}
+			vertCount += corners >= 4 ? 6 : 3;
+		}
 
+		line = lineEnd + 1;
+	}
+
+	// Variables used while reading the file
+	std::vector<XMFLOAT3>& positions = scratch->Positions;  // Positions from the file
+	std::vector<XMFLOAT3>& normals = scratch->Normals;      // Normals from the file
+	std::vector<XMFLOAT2>& uvs = scratch->UVs;              // UVs from the file
+	std::vector<Vertex>& verts = scratch->Verts;            // Verts we're assembling
+	std::vector<UINT> indices;                              // Indices of these verts (may be kept by the mesh)
+	unsigned int vertCounter = 0;                           // Count of vertices/indices
+	positions.clear();
+	normals.clear();
+	uvs.clear();
+	verts.clear();
+	positions.reserve(positionCount);
+	normals.reserve(normalCount);
+	uvs.reserve(uvCount);
+	verts.reserve(vertCount);
+	indices.reserve(vertCount);
+
+	// Every line, now terminated where its newline was
+	for (char* chars = file.data(); chars < file.data() + fileSize; chars += strlen(chars) + 1)
+	{
 		// Check the type of line
 		if (chars[0] == 'v' && chars[1] == 'n')
 		{
@@ -165,17 +275,109 @@ Mesh::Mesh(const char* objFile, ID3D11Device* device)
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	// Create the actual buffers, then hand the indices over
+	CreateBuffers(verts.data(), vertCounter, indices.data(), vertCounter, device);
+
+	this->residency = ReserveCpuBytes(vertCounter, vertCounter, residency);
+	if (this->residency != MESH_RESIDENCY_NONE)
+		geometry.Build(&verts.data()->Position, sizeof(Vertex), vertCounter, std::move(indices), this->residency == MESH_RESIDENCY_QUANTIZED);
 }
 
 
 
 Mesh::~Mesh(void)
 {
-	vb->Release(); vb = 0;
-	ib->Release(); ib = 0;
+	if (vb) { vb->Release(); vb = 0; }
+	if (ib) { ib->Release(); ib = 0; }
+	cpuBytes -= MeshGeometry::GetMemoryUsage(geometry.GetVertexCount(), geometry.GetIndexCount(), geometry.IsQuantized()) + bvhBytes;
+}
+
+void Mesh::SetCpuBudget(size_t bytes)
+{
+	cpuBudget = bytes;
+}
+
+size_t Mesh::GetTotalCpuBytes()
+{
+	return cpuBytes;
+}
+
+MeshResidency Mesh::ReserveCpuBytes(unsigned int numVerts, unsigned int numIndices, MeshResidency wanted)
+{
+	// Nothing to keep, and nothing to build it from
+	if (numVerts == 0)
+		return MESH_RESIDENCY_NONE;
+
+	for (int form = wanted; form > MESH_RESIDENCY_NONE; form--)
+	{
+		if (ReserveBytes(MeshGeometry::GetMemoryUsage(numVerts, numIndices, form == MESH_RESIDENCY_QUANTIZED)))
+			return (MeshResidency)form;
+	}
+	return MESH_RESIDENCY_NONE;
+}
+
+// The tree's size is only known once it's built, so it's
+// built first and thrown away if it doesn't fit
+void Mesh::BuildBVH(JobSystem* jobs)
+{
+	if (geometry.IsEmpty() || !bvh.IsEmpty())
+		return;
+
+	bvh.Build(&geometry, jobs);
+	if (ReserveBytes(bvh.GetMemoryUsage()))
+		bvhBytes = bvh.GetMemoryUsage();
+	else
+		bvh.Clear();
+}
+
+// Distance along a ray to a box, if it's hit within maxDistance
+static bool RayHitsBox(const XMFLOAT3& center, const XMFLOAT3& extents, const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float* entry)
+{
+	const float* c = &center.x;
+	const float* e = &extents.x;
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = c[axis] - e[axis];
+		float hi = c[axis] + e[axis];
+		if (d[axis] == 0.0f)
+		{
+			if (o[axis] < lo || o[axis] > hi)
+				return false;
+			continue;
+		}
+
+		float t1 = (lo - o[axis]) / d[axis];
+		float t2 = (hi - o[axis]) / d[axis];
+		tMin = std::max(tMin, std::min(t1, t2));
+		tMax = std::min(tMax, std::max(t1, t2));
+		if (tMin > tMax)
+			return false;
+	}
+
+	*entry = tMin;
+	return true;
+}
+
+bool Mesh::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshRayHit* hit)
+{
+	if (!bvh.IsEmpty())
+		return bvh.Raycast(origin, direction, maxDistance, hit);
+	if (!geometry.IsEmpty())
+		return geometry.Raycast(origin, direction, maxDistance, hit);
+
+	float distance;
+	if (!RayHitsBox(boundsCenter, boundsExtents, origin, direction, maxDistance, &distance))
+		return false;
+
+	hit->Triangle = MeshRayHit::NoTriangle;
+	hit->U = 0.0f;
+	hit->V = 0.0f;
+	hit->Distance = distance;
+	return true;
 }
 
 
@@ -183,6 +385,7 @@ void Mesh::CreateBuffers(Vertex* vertArray, unsigned int numVerts, unsigned int*
 {
 	// Make sure we have tangents for normal mapping
 	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	CalculateBounds(vertArray, numVerts);
 
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd;
@@ -210,6 +413,42 @@ void Mesh::CreateBuffers(Vertex* vertArray, unsigned int numVerts, unsigned int*
 
 	// Save the indices
 	this->numIndices = numIndices;
+	gpuBytes = vbd.ByteWidth + ibd.ByteWidth;
+}
+
+// Calculates the local space bounds of a mesh: an AABB, and
+// a sphere around the AABB's center that reaches the farthest
+// vertex (often much tighter than the AABB's corners)
+void Mesh::CalculateBounds(Vertex* verts, unsigned int numVerts)
+{
+	if (numVerts == 0)
+	{
+		boundsCenter = XMFLOAT3(0, 0, 0);
+		boundsExtents = XMFLOAT3(0, 0, 0);
+		boundsRadius = 0;
+		return;
+	}
+
+	XMVECTOR minPos = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR maxPos = minPos;
+	for (unsigned int i = 1; i < numVerts; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+		minPos = XMVectorMin(minPos, pos);
+		maxPos = XMVectorMax(maxPos, pos);
+	}
+
+	XMVECTOR center = XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f);
+	XMStoreFloat3(&boundsCenter, center);
+	XMStoreFloat3(&boundsExtents, XMVectorScale(XMVectorSubtract(maxPos, minPos), 0.5f));
+
+	XMVECTOR maxDistSq = XMVectorZero();
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&verts[i].Position), center);
+		maxDistSq = XMVectorMax(maxDistSq, XMVector3LengthSq(offset));
+	}
+	boundsRadius = sqrtf(XMVectorGetX(maxDistSq));
 }
 
 // Calculates the tangents of the vertices in a mesh
@@ -1,26 +1,97 @@
 #pragma once
 
 #include <d3d11.h>
+#include <vector>
 
 #include "Vertex.h"
+#include "MeshGeometry.h"
+#include "MeshBVH.h"
 
+// --------------------------------------------------------
+// Working memory for building meshes.  Reuse one across a
+// run of imports and, once it has grown to fit the largest,
+// the rest don't allocate for anything that's thrown away.
+// Only one thread may use it at a time.
+// --------------------------------------------------------
+struct MeshImportScratch
+{
+	std::vector<char> File;
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<DirectX::XMFLOAT2> UVs;
+	std::vector<Vertex> Verts;
+
+	// Bytes held, which is the most any import needed
+	size_t GetCapacity();
+};
 
 class Mesh
 {
 public:
-	Mesh(Vertex* vertArray, unsigned int numVerts, unsigned int* indexArray, unsigned int numIndices, ID3D11Device* device);
-	Mesh(const char* objFile, ID3D11Device* device);
+	Mesh(Vertex* vertArray, unsigned int numVerts, unsigned int* indexArray, unsigned int numIndices, ID3D11Device* device, MeshResidency residency = MESH_RESIDENCY_FULL);
+	// Takes the indices over, rather than copying them
+	Mesh(Vertex* vertArray, unsigned int numVerts, std::vector<unsigned int>&& indices, ID3D11Device* device, MeshResidency residency = MESH_RESIDENCY_FULL);
+	Mesh(const char* objFile, ID3D11Device* device, MeshImportScratch* scratch = 0, MeshResidency residency = MESH_RESIDENCY_FULL);
 	~Mesh(void);
 
+	// Caps the CPU geometry all meshes keep between them.  A
+	// mesh that doesn't fit as asked is quantized instead, and
+	// if that doesn't fit either, keeps nothing.  Only affects
+	// meshes created after.
+	static void SetCpuBudget(size_t bytes);
+	static size_t GetTotalCpuBytes();
+
 	ID3D11Buffer* GetVertexBuffer() { return vb; }
 	ID3D11Buffer* GetIndexBuffer() { return ib; }
 	int GetIndexCount() { return numIndices; }
+	unsigned int GetId() { return id; }
+
+	// Local space bounds - an AABB and a sphere around its center
+	DirectX::XMFLOAT3 GetBoundsCenter() { return boundsCenter; }
+	DirectX::XMFLOAT3 GetBoundsExtents() { return boundsExtents; }
+	float GetBoundsRadius() { return boundsRadius; }
+
+	// CPU copy of the triangles, for picking and occlusion
+	// culling - empty unless the mesh is resident
+	const MeshGeometry& GetGeometry() { return geometry; }
+	MeshResidency GetResidency() { return residency; }
+
+	// Builds a tree over the CPU geometry to speed up Raycast(),
+	// if there's geometry and room in the budget for the tree
+	void BuildBVH(JobSystem* jobs);
+	const MeshBVH& GetBVH() { return bvh; }
+
+	// Nearest hit along a local space ray, within maxDistance
+	// (in units of direction's length).  Meshes without CPU
+	// geometry can only be hit on their bounds.
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshRayHit* hit);
+
+	// Memory held for this mesh, on each side
+	size_t GetCpuBytes() { return geometry.GetMemoryUsage() + bvh.GetMemoryUsage(); }
+	size_t GetGpuBytes() { return gpuBytes; }
 
 private:
+	unsigned int id;	// Small unique number, for sort keys and such
+
 	ID3D11Buffer* vb;
 	ID3D11Buffer* ib;
 	int numIndices;
+	size_t gpuBytes;
+
+	DirectX::XMFLOAT3 boundsCenter;
+	DirectX::XMFLOAT3 boundsExtents;	// Half size on each axis
+	float boundsRadius;
+
+	MeshGeometry geometry;
+	MeshResidency residency;	// What was actually kept
+	MeshBVH bvh;
+	size_t bvhBytes;			// Taken from the budget for the tree
+
+	// Takes room from the budget for the most detailed form that
+	// fits, up to the one asked for
+	static MeshResidency ReserveCpuBytes(unsigned int numVerts, unsigned int numIndices, MeshResidency wanted);
 
+	void CalculateBounds(Vertex* verts, unsigned int numVerts);
 	void CalculateTangents(Vertex* verts, unsigned int numVerts, unsigned int* indices, unsigned int numIndices);
 	void CreateBuffers(Vertex* vertArray, unsigned int numVerts, unsigned int* indexArray, unsigned int numIndices, ID3D11Device* device);
 };
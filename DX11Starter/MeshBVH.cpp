@@ -0,0 +1,425 @@
+#include "MeshBVH.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Subtrees below this depth are built as their own jobs
+static const unsigned int SerialDepth = 2;
+
+// Meshes with fewer triangles aren't worth splitting up
+static const unsigned int ParallelTriangles = 4096;
+
+// Past this depth nodes split in the middle, which bounds
+// how deep the tree (and so the traversal stack) can get
+static const unsigned int MaxSAHDepth = 48;
+static const unsigned int StackSize = 256;
+
+static const unsigned int BinCount = 12;
+
+// Half the surface area, which is all the heuristic needs
+static float HalfArea(const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	float x = max.x - min.x;
+	float y = max.y - min.y;
+	float z = max.z - min.z;
+	return x * y + y * z + z * x;
+}
+
+MeshBVH::MeshBVH()
+{
+	geometry = 0;
+}
+
+void MeshBVH::Build(const MeshGeometry* geometry, JobSystem* jobs)
+{
+	Clear();
+	this->geometry = geometry;
+
+	unsigned int count = geometry->GetTriangleCount();
+	if (count == 0)
+		return;
+
+	// Every triangle's bounds and center
+	std::vector<BuildTriangle> bounds(count);
+	triangles.resize(count);
+	auto measure = [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int t = begin; t < end; t++)
+		{
+			XMFLOAT3 corners[3];
+			for (unsigned int k = 0; k < 3; k++)
+				corners[k] = geometry->GetPosition(geometry->GetIndex(t * 3 + k));
+			XMVECTOR a = XMLoadFloat3(&corners[0]);
+			XMVECTOR b = XMLoadFloat3(&corners[1]);
+			XMVECTOR c = XMLoadFloat3(&corners[2]);
+			XMVECTOR min = XMVectorMin(a, XMVectorMin(b, c));
+			XMVECTOR max = XMVectorMax(a, XMVectorMax(b, c));
+			XMStoreFloat3(&bounds[t].Min, min);
+			XMStoreFloat3(&bounds[t].Max, max);
+			XMStoreFloat3(&bounds[t].Center, XMVectorScale(XMVectorAdd(min, max), 0.5f));
+			triangles[t] = t;
+		}
+	};
+
+	bool parallel = jobs && count >= ParallelTriangles;
+	if (parallel)
+		jobs->ParallelFor(count, 1024, measure);
+	else
+		measure(0, count);
+
+	// The top of the tree, leaving the rest as subtrees
+	std::vector<Subtree> subtrees;
+	BuildNode(&nodes, bounds, 0, count, 0, parallel ? &subtrees : 0);
+	if (subtrees.empty())
+	{
+		nodes.shrink_to_fit();
+		return;
+	}
+
+	// Each subtree owns its range of the triangle list, so
+	// they can all be built at once
+	jobs->ParallelFor((unsigned int)subtrees.size(), 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			BuildNode(&subtrees[i].Nodes, bounds, subtrees[i].Begin, subtrees[i].End, SerialDepth, 0);
+	});
+
+	// Then appended, with their node indices moved along
+	size_t total = nodes.size();
+	for (const Subtree& s : subtrees)
+		total += s.Nodes.size();
+	nodes.reserve(total);
+
+	for (Subtree& s : subtrees)
+	{
+		unsigned int offset = (unsigned int)nodes.size();
+		for (Node& node : s.Nodes)
+		{
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				if (node.Count[i] == 0 && node.Child[i] != EmptyChild)
+					node.Child[i] += offset;
+			}
+		}
+		nodes.insert(nodes.end(), s.Nodes.begin(), s.Nodes.end());
+		nodes[s.Parent].Child[s.Slot] = offset;
+	}
+}
+
+void MeshBVH::Clear()
+{
+	geometry = 0;
+	std::vector<Node>().swap(nodes);
+	std::vector<unsigned int>().swap(triangles);
+}
+
+size_t MeshBVH::GetMemoryUsage() const
+{
+	return nodes.capacity() * sizeof(Node) + triangles.capacity() * sizeof(unsigned int);
+}
+
+// --------------------------------------------------------
+// Adds a node over [begin, end) of the triangle list, split
+// into up to four children, and returns its index.  Children
+// at the serial depth are left to subtrees (if given).
+// --------------------------------------------------------
+unsigned int MeshBVH::BuildNode(std::vector<Node>* nodes, const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end, unsigned int depth, std::vector<Subtree>* subtrees)
+{
+	unsigned int index = (unsigned int)nodes->size();
+	nodes->push_back(Node());
+
+	// Halve, then halve each half if it's still too big
+	unsigned int ranges[5] = { begin, end };
+	unsigned int rangeCount = 1;
+	if (end - begin > MaxLeafSize)
+	{
+		unsigned int mid = depth < MaxSAHDepth ? Split(bounds, begin, end) : begin + (end - begin) / 2;
+		unsigned int halves[2][2] = { { begin, mid }, { mid, end } };
+		rangeCount = 0;
+		for (unsigned int h = 0; h < 2; h++)
+		{
+			unsigned int b = halves[h][0];
+			unsigned int e = halves[h][1];
+			ranges[rangeCount++] = b;
+			if (e - b > MaxLeafSize)
+				ranges[rangeCount++] = depth < MaxSAHDepth ? Split(bounds, b, e) : b + (e - b) / 2;
+		}
+		ranges[rangeCount] = end;
+	}
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		Node& node = (*nodes)[index];
+		if (i >= rangeCount)
+		{
+			node.MinX[i] = node.MinY[i] = node.MinZ[i] = 0.0f;
+			node.MaxX[i] = node.MaxY[i] = node.MaxZ[i] = 0.0f;
+			node.Child[i] = EmptyChild;
+			node.Count[i] = 0;
+			continue;
+		}
+
+		unsigned int b = ranges[i];
+		unsigned int e = ranges[i + 1];
+		SetChildBounds(&node, i, bounds, b, e);
+		if (e - b <= MaxLeafSize)
+		{
+			node.Child[i] = b;
+			node.Count[i] = e - b;
+		}
+		else if (subtrees && depth + 1 >= SerialDepth)
+		{
+			Subtree s = { b, e, index, i, std::vector<Node>() };
+			subtrees->push_back(std::move(s));
+			node.Child[i] = EmptyChild;
+			node.Count[i] = 0;
+		}
+		else
+		{
+			// Building the child may move the node list
+			unsigned int child = BuildNode(nodes, bounds, b, e, depth + 1, subtrees);
+			(*nodes)[index].Child[i] = child;
+			(*nodes)[index].Count[i] = 0;
+		}
+	}
+	return index;
+}
+
+// --------------------------------------------------------
+// Sorts triangle centers into bins along each axis, finds
+// the bin boundary with the lowest area times count on both
+// sides, and partitions [begin, end) there.  Returns where
+// the second half starts.
+// --------------------------------------------------------
+unsigned int MeshBVH::Split(const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end)
+{
+	XMVECTOR centerMin = XMLoadFloat3(&bounds[triangles[begin]].Center);
+	XMVECTOR centerMax = centerMin;
+	for (unsigned int i = begin + 1; i < end; i++)
+	{
+		XMVECTOR c = XMLoadFloat3(&bounds[triangles[i]].Center);
+		centerMin = XMVectorMin(centerMin, c);
+		centerMax = XMVectorMax(centerMax, c);
+	}
+	XMFLOAT3 lo, hi;
+	XMStoreFloat3(&lo, centerMin);
+	XMStoreFloat3(&hi, centerMax);
+
+	struct Bin
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+		unsigned int Count;
+	};
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	unsigned int bestBin = 0;
+	float bestScale = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = (&hi.x)[axis] - (&lo.x)[axis];
+		if (extent <= 0.0f)
+			continue;
+		float scale = BinCount / extent;
+
+		Bin bins[BinCount];
+		for (Bin& bin : bins)
+		{
+			bin.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			bin.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			bin.Count = 0;
+		}
+
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const BuildTriangle& t = bounds[triangles[i]];
+			unsigned int b = std::min(BinCount - 1, (unsigned int)(((&t.Center.x)[axis] - (&lo.x)[axis]) * scale));
+			XMStoreFloat3(&bins[b].Min, XMVectorMin(XMLoadFloat3(&bins[b].Min), XMLoadFloat3(&t.Min)));
+			XMStoreFloat3(&bins[b].Max, XMVectorMax(XMLoadFloat3(&bins[b].Max), XMLoadFloat3(&t.Max)));
+			bins[b].Count++;
+		}
+
+		// Area and count of everything left of each boundary...
+		float leftArea[BinCount - 1];
+		unsigned int leftCount[BinCount - 1];
+		XMVECTOR min = XMLoadFloat3(&bins[0].Min);
+		XMVECTOR max = XMLoadFloat3(&bins[0].Max);
+		unsigned int count = 0;
+		for (unsigned int b = 0; b < BinCount - 1; b++)
+		{
+			min = XMVectorMin(min, XMLoadFloat3(&bins[b].Min));
+			max = XMVectorMax(max, XMLoadFloat3(&bins[b].Max));
+			count += bins[b].Count;
+			XMFLOAT3 boxMin, boxMax;
+			XMStoreFloat3(&boxMin, min);
+			XMStoreFloat3(&boxMax, max);
+			leftArea[b] = count ? HalfArea(boxMin, boxMax) : 0.0f;
+			leftCount[b] = count;
+		}
+
+		// ...then sweep back from the right, costing each one
+		min = XMLoadFloat3(&bins[BinCount - 1].Min);
+		max = XMLoadFloat3(&bins[BinCount - 1].Max);
+		count = 0;
+		for (unsigned int b = BinCount - 1; b > 0; b--)
+		{
+			min = XMVectorMin(min, XMLoadFloat3(&bins[b].Min));
+			max = XMVectorMax(max, XMLoadFloat3(&bins[b].Max));
+			count += bins[b].Count;
+			if (count == 0 || leftCount[b - 1] == 0)
+				continue;
+
+			XMFLOAT3 boxMin, boxMax;
+			XMStoreFloat3(&boxMin, min);
+			XMStoreFloat3(&boxMax, max);
+			float cost = leftArea[b - 1] * leftCount[b - 1] + HalfArea(boxMin, boxMax) * count;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b - 1;
+				bestScale = scale;
+			}
+		}
+	}
+
+	// Every center in the same place - any split is as good
+	if (bestAxis < 0)
+		return begin + (end - begin) / 2;
+
+	float axisMin = (&lo.x)[bestAxis];
+	unsigned int* mid = std::partition(&triangles[begin], &triangles[begin] + (end - begin), [&](unsigned int t)
+	{
+		float c = (&bounds[t].Center.x)[bestAxis];
+		return std::min(BinCount - 1, (unsigned int)((c - axisMin) * bestScale)) <= bestBin;
+	});
+	return (unsigned int)(mid - triangles.data());
+}
+
+void MeshBVH::SetChildBounds(Node* node, unsigned int slot, const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end)
+{
+	XMVECTOR min = XMLoadFloat3(&bounds[triangles[begin]].Min);
+	XMVECTOR max = XMLoadFloat3(&bounds[triangles[begin]].Max);
+	for (unsigned int i = begin + 1; i < end; i++)
+	{
+		min = XMVectorMin(min, XMLoadFloat3(&bounds[triangles[i]].Min));
+		max = XMVectorMax(max, XMLoadFloat3(&bounds[triangles[i]].Max));
+	}
+
+	XMFLOAT3 lo, hi;
+	XMStoreFloat3(&lo, min);
+	XMStoreFloat3(&hi, max);
+	node->MinX[slot] = lo.x;
+	node->MinY[slot] = lo.y;
+	node->MinZ[slot] = lo.z;
+	node->MaxX[slot] = hi.x;
+	node->MaxY[slot] = hi.y;
+	node->MaxZ[slot] = hi.z;
+}
+
+// --------------------------------------------------------
+// Slab tests all four children of a node at once, pushing
+// the ones hit farthest first, so the nearest is taken next
+// and can shrink the ray before the others are looked at
+// --------------------------------------------------------
+bool MeshBVH::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshRayHit* hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Flat directions are nudged off zero, so every slab gives
+	// a (huge) finite distance rather than NaN
+	float inverse[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float d = (&direction.x)[axis];
+		if (fabsf(d) < 1e-20f)
+			d = d < 0.0f ? -1e-20f : 1e-20f;
+		inverse[axis] = 1.0f / d;
+	}
+
+	XMVECTOR ox = XMVectorReplicate(origin.x);
+	XMVECTOR oy = XMVectorReplicate(origin.y);
+	XMVECTOR oz = XMVectorReplicate(origin.z);
+	XMVECTOR ix = XMVectorReplicate(inverse[0]);
+	XMVECTOR iy = XMVectorReplicate(inverse[1]);
+	XMVECTOR iz = XMVectorReplicate(inverse[2]);
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR d = XMLoadFloat3(&direction);
+
+	struct Entry
+	{
+		unsigned int Child;
+		unsigned int Count;
+		float Near;
+	};
+	Entry stack[StackSize];
+	unsigned int size = 0;
+	stack[size++] = { 0, 0, 0.0f };
+
+	bool found = false;
+	float closest = maxDistance;
+	while (size > 0)
+	{
+		Entry entry = stack[--size];
+		if (entry.Near > closest)
+			continue;
+
+		if (entry.Count > 0)
+		{
+			for (unsigned int i = entry.Child; i < entry.Child + entry.Count; i++)
+			{
+				if (geometry->IntersectTriangle(triangles[i], o, d, closest, hit))
+				{
+					found = true;
+					closest = hit->Distance;
+				}
+			}
+			continue;
+		}
+
+		const Node& node = nodes[entry.Child];
+		XMVECTOR t1x = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MinX), ox), ix);
+		XMVECTOR t2x = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MaxX), ox), ix);
+		XMVECTOR t1y = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MinY), oy), iy);
+		XMVECTOR t2y = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MaxY), oy), iy);
+		XMVECTOR t1z = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MinZ), oz), iz);
+		XMVECTOR t2z = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)node.MaxZ), oz), iz);
+
+		XMVECTOR nearT = XMVectorMax(
+			XMVectorMax(XMVectorMin(t1x, t2x), XMVectorMin(t1y, t2y)),
+			XMVectorMax(XMVectorMin(t1z, t2z), XMVectorZero()));
+		XMVECTOR farT = XMVectorMin(
+			XMVectorMin(XMVectorMax(t1x, t2x), XMVectorMax(t1y, t2y)),
+			XMVectorMin(XMVectorMax(t1z, t2z), XMVectorReplicate(closest)));
+
+		XMFLOAT4 nears, fars;
+		XMStoreFloat4(&nears, nearT);
+		XMStoreFloat4(&fars, farT);
+
+		// Children hit, sorted nearest last
+		Entry hits[4];
+		unsigned int hitCount = 0;
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			float n = (&nears.x)[i];
+			if (node.Child[i] == EmptyChild || n > (&fars.x)[i])
+				continue;
+
+			unsigned int j = hitCount++;
+			for (; j > 0 && hits[j - 1].Near < n; j--)
+				hits[j] = hits[j - 1];
+			hits[j] = { node.Child[i], node.Count[i], n };
+		}
+
+		for (unsigned int i = 0; i < hitCount && size < StackSize; i++)
+			stack[size++] = hits[i];
+	}
+
+	return found;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "MeshGeometry.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Four wide bounding volume hierarchy over a mesh's
+// triangles, for ray queries.
+//
+// Each node holds the boxes of up to four children side by
+// side (all the min x's, then all the min y's and so on), so
+// a ray is tested against all four with one set of vector
+// operations, and children are visited nearest first.  A
+// child is either another node or a leaf of a few triangles.
+//
+// Nodes are split with a binned surface area heuristic: each
+// split sorts triangle centers into bins along every axis
+// and takes the boundary with the lowest area times count on
+// both sides.  Each node is split into two, then each half
+// into two again, giving up to four children.  Below the
+// first couple of levels, subtrees are built as separate
+// jobs and joined at the end.
+//
+// The geometry is read during queries rather than copied, so
+// it must outlive the tree and not be rebuilt under it.
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	static const unsigned int MaxLeafSize = 4;
+
+	MeshBVH();
+
+	// Jobs may be null, to build on this thread only
+	void Build(const MeshGeometry* geometry, JobSystem* jobs);
+	void Clear();
+
+	// Nearest hit along a local space ray, within maxDistance
+	// (in units of direction's length)
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshRayHit* hit) const;
+
+	// Getters
+	bool IsEmpty() const { return nodes.empty(); }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	size_t GetMemoryUsage() const;
+
+private:
+	// Marks an unused child slot
+	static const unsigned int EmptyChild = 0xFFFFFFFF;
+
+	// Count is zero for child nodes, whose index is in Child,
+	// and the number of triangles for leaves, whose first
+	// entry in the triangle list is in Child
+	struct Node
+	{
+		float MinX[4];
+		float MinY[4];
+		float MinZ[4];
+		float MaxX[4];
+		float MaxY[4];
+		float MaxZ[4];
+		unsigned int Child[4];
+		unsigned int Count[4];
+	};
+
+	// A subtree left to build as its own job, and the child
+	// slot waiting for it
+	struct Subtree
+	{
+		unsigned int Begin;
+		unsigned int End;
+		unsigned int Parent;
+		unsigned int Slot;
+		std::vector<Node> Nodes;
+	};
+
+	// Per triangle bounds and centers, only kept while building
+	struct BuildTriangle
+	{
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+		DirectX::XMFLOAT3 Center;
+	};
+
+	const MeshGeometry* geometry;
+	std::vector<Node> nodes;				// Root first
+	std::vector<unsigned int> triangles;	// Leaves' triangles, in leaf order
+
+	unsigned int BuildNode(std::vector<Node>* nodes, const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end, unsigned int depth, std::vector<Subtree>* subtrees);
+	unsigned int Split(const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end);
+	void SetChildBounds(Node* node, unsigned int slot, const std::vector<BuildTriangle>& bounds, unsigned int begin, unsigned int end);
+};
@@ -0,0 +1,187 @@
+#include "MeshGeometry.h"
+
+#include <cmath>
+#include <utility>
+
+using namespace DirectX;
+
+MeshGeometry::MeshGeometry()
+{
+	Clear();
+}
+
+void MeshGeometry::Build(const XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, bool quantize)
+{
+	Clear();
+	BuildPositions(positions, stride, vertexCount, quantize);
+
+	this->indexCount = indexCount;
+	if (vertexCount <= 65536)
+		shortIndices.assign(indices, indices + indexCount);
+	else
+		this->indices.assign(indices, indices + indexCount);
+}
+
+void MeshGeometry::Build(const XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, std::vector<unsigned int>&& indices, bool quantize)
+{
+	if (vertexCount <= 65536)
+	{
+		Build(positions, stride, vertexCount, indices.data(), (unsigned int)indices.size(), quantize);
+		return;
+	}
+
+	Clear();
+	BuildPositions(positions, stride, vertexCount, quantize);
+	indexCount = (unsigned int)indices.size();
+	this->indices = std::move(indices);
+
+	// Only the indices count against the mesh budget, so drop
+	// any room the caller had reserved past them
+	this->indices.shrink_to_fit();
+}
+
+void MeshGeometry::Clear()
+{
+	vertexCount = 0;
+	indexCount = 0;
+	offset = XMFLOAT3(0, 0, 0);
+	scale = XMFLOAT3(1, 1, 1);
+
+	// Swapped out, so the memory is actually given back
+	std::vector<XMFLOAT3>().swap(positions);
+	std::vector<QuantizedPosition>().swap(quantizedPositions);
+	std::vector<unsigned int>().swap(indices);
+	std::vector<unsigned short>().swap(shortIndices);
+}
+
+// --------------------------------------------------------
+// Quantizing maps each axis of the bounds onto 0 to 65535,
+// rounding to the nearest step
+// --------------------------------------------------------
+void MeshGeometry::BuildPositions(const XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, bool quantize)
+{
+	this->vertexCount = vertexCount;
+	const unsigned char* read = (const unsigned char*)positions;
+
+	if (!quantize)
+	{
+		this->positions.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			this->positions[i] = *(const XMFLOAT3*)(read + i * stride);
+		return;
+	}
+
+	XMVECTOR minPos = XMVectorReplicate(0.0f);
+	XMVECTOR maxPos = minPos;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3((const XMFLOAT3*)(read + i * stride));
+		minPos = i == 0 ? p : XMVectorMin(minPos, p);
+		maxPos = i == 0 ? p : XMVectorMax(maxPos, p);
+	}
+
+	// A flat axis keeps a scale of 1, so every point maps to 0
+	XMVECTOR size = XMVectorSubtract(maxPos, minPos);
+	XMVECTOR flat = XMVectorLessOrEqual(size, XMVectorZero());
+	XMVECTOR step = XMVectorSelect(XMVectorScale(size, 1.0f / 65535.0f), XMVectorReplicate(1.0f), flat);
+	XMVECTOR invStep = XMVectorSelect(XMVectorDivide(XMVectorReplicate(65535.0f), size), XMVectorZero(), flat);
+	XMStoreFloat3(&offset, minPos);
+	XMStoreFloat3(&scale, step);
+
+	quantizedPositions.resize(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3((const XMFLOAT3*)(read + i * stride));
+		XMFLOAT3 q;
+		XMStoreFloat3(&q, XMVectorMultiply(XMVectorSubtract(p, minPos), invStep));
+		quantizedPositions[i].X = (unsigned short)std::fmin(q.x + 0.5f, 65535.0f);
+		quantizedPositions[i].Y = (unsigned short)std::fmin(q.y + 0.5f, 65535.0f);
+		quantizedPositions[i].Z = (unsigned short)std::fmin(q.z + 0.5f, 65535.0f);
+	}
+}
+
+size_t MeshGeometry::GetMemoryUsage(unsigned int vertexCount, unsigned int indexCount, bool quantize)
+{
+	size_t positionSize = quantize ? sizeof(QuantizedPosition) : sizeof(XMFLOAT3);
+	size_t indexSize = vertexCount <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	return vertexCount * positionSize + indexCount * indexSize;
+}
+
+size_t MeshGeometry::GetMemoryUsage() const
+{
+	return positions.capacity() * sizeof(XMFLOAT3) +
+		quantizedPositions.capacity() * sizeof(QuantizedPosition) +
+		indices.capacity() * sizeof(unsigned int) +
+		shortIndices.capacity() * sizeof(unsigned short);
+}
+
+XMMATRIX MeshGeometry::GetDequantizeMatrix() const
+{
+	return XMMatrixMultiply(
+		XMMatrixScaling(scale.x, scale.y, scale.z),
+		XMMatrixTranslation(offset.x, offset.y, offset.z));
+}
+
+XMFLOAT3 MeshGeometry::GetPosition(unsigned int vertex) const
+{
+	if (quantizedPositions.empty())
+		return positions[vertex];
+
+	const QuantizedPosition& q = quantizedPositions[vertex];
+	return XMFLOAT3(
+		offset.x + q.X * scale.x,
+		offset.y + q.Y * scale.y,
+		offset.z + q.Z * scale.z);
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore
+// --------------------------------------------------------
+bool MeshGeometry::IntersectTriangle(unsigned int triangle, FXMVECTOR origin, FXMVECTOR direction, float maxDistance, MeshRayHit* hit) const
+{
+	XMFLOAT3 a = GetPosition(GetIndex(triangle * 3));
+	XMFLOAT3 b = GetPosition(GetIndex(triangle * 3 + 1));
+	XMFLOAT3 c = GetPosition(GetIndex(triangle * 3 + 2));
+	XMVECTOR v0 = XMLoadFloat3(&a);
+	XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&b), v0);
+	XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&c), v0);
+
+	XMVECTOR p = XMVector3Cross(direction, e2);
+	float det = XMVectorGetX(XMVector3Dot(e1, p));
+	if (det == 0.0f)
+		return false;
+	float invDet = 1.0f / det;
+
+	XMVECTOR s = XMVectorSubtract(origin, v0);
+	float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	XMVECTOR q = XMVector3Cross(s, e1);
+	float v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	float t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+	if (t < 0.0f || t >= maxDistance)
+		return false;
+
+	hit->Triangle = triangle;
+	hit->U = u;
+	hit->V = v;
+	hit->Distance = t;
+	return true;
+}
+
+bool MeshGeometry::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshRayHit* hit) const
+{
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR d = XMLoadFloat3(&direction);
+	bool found = false;
+	for (unsigned int t = 0; t < GetTriangleCount(); t++)
+	{
+		if (IntersectTriangle(t, o, d, found ? hit->Distance : maxDistance, hit))
+			found = true;
+	}
+	return found;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// How much of a mesh stays in memory for the CPU once its
+// buffers are uploaded
+// --------------------------------------------------------
+enum MeshResidency
+{
+	MESH_RESIDENCY_NONE,		// Nothing - the mesh can't be picked or occlude
+	MESH_RESIDENCY_QUANTIZED,	// 16 bit positions within the mesh's bounds
+	MESH_RESIDENCY_FULL			// Float positions, exactly as uploaded
+};
+
+// A position as a fraction of its mesh's bounds, 0 to 65535
+struct QuantizedPosition
+{
+	unsigned short X;
+	unsigned short Y;
+	unsigned short Z;
+};
+
+// --------------------------------------------------------
+// Where a ray hit a mesh - the triangle (whose indices start
+// at Triangle * 3), barycentrics of the hit against its
+// second and third vertices, and the distance along the ray
+// --------------------------------------------------------
+struct MeshRayHit
+{
+	static const unsigned int NoTriangle = 0xFFFFFFFF;	// Only the bounds were hit
+
+	unsigned int Triangle;
+	float U;
+	float V;
+	float Distance;
+};
+
+// --------------------------------------------------------
+// Compact CPU copy of a mesh's triangles - positions and
+// indices only.
+//
+// Positions are either floats or quantized to 16 bits per
+// axis across the mesh's bounds, which halves them for an
+// error of 1/131070th of the bounds at most.  Indices are
+// 16 bit whenever every vertex can be reached with them.
+// GetDequantizeMatrix() takes quantized positions (as
+// floats) to local space, so anything already transforming
+// them can fold decoding into its matrix for free.
+// --------------------------------------------------------
+class MeshGeometry
+{
+public:
+	MeshGeometry();
+
+	// Keeps the positions (read every stride bytes) and indices
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, bool quantize);
+
+	// Same, but takes the indices over when they must stay 32 bit
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, std::vector<unsigned int>&& indices, bool quantize);
+
+	void Clear();
+
+	// What Build() would keep, in bytes, without building it
+	static size_t GetMemoryUsage(unsigned int vertexCount, unsigned int indexCount, bool quantize);
+
+	// Getters
+	bool IsEmpty() const { return indexCount == 0; }
+	bool IsQuantized() const { return !quantizedPositions.empty(); }
+	bool HasShortIndices() const { return !shortIndices.empty(); }
+	unsigned int GetVertexCount() const { return vertexCount; }
+	unsigned int GetIndexCount() const { return indexCount; }
+	size_t GetMemoryUsage() const;
+
+	// Raw data, in whichever form it was kept
+	const DirectX::XMFLOAT3* GetPositions() const { return positions.data(); }
+	const QuantizedPosition* GetQuantizedPositions() const { return quantizedPositions.data(); }
+	const unsigned short* GetShortIndices() const { return shortIndices.data(); }
+	const unsigned int* GetIndices() const { return indices.data(); }
+	DirectX::XMMATRIX GetDequantizeMatrix() const;
+
+	// Decoded, one at a time
+	DirectX::XMFLOAT3 GetPosition(unsigned int vertex) const;
+	unsigned int GetIndex(unsigned int index) const { return shortIndices.empty() ? indices[index] : shortIndices[index]; }
+	unsigned int GetTriangleCount() const { return indexCount / 3; }
+
+	// Tests one triangle against a local space ray, filling hit
+	// if it's closer than maxDistance (in units of direction's
+	// length).  Either side counts.
+	bool IntersectTriangle(unsigned int triangle, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, MeshRayHit* hit) const;
+
+	// Nearest hit, testing every triangle
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshRayHit* hit) const;
+
+private:
+	unsigned int vertexCount;
+	unsigned int indexCount;
+
+	// Only one of each pair is ever filled
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<QuantizedPosition> quantizedPositions;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned short> shortIndices;
+
+	// Quantized positions decode to offset + q * scale
+	DirectX::XMFLOAT3 offset;
+	DirectX::XMFLOAT3 scale;
+
+	void BuildPositions(const DirectX::XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, bool quantize);
+};
@@ -1,6 +1,7 @@
 #include "Model.h"
 #include <iostream>
 #include "Vertex.h"
+#include "AllocationCounter.h"
 
 using namespace DirectX;
 
@@ -14,6 +15,12 @@ Model::~Model()
 
 void Model::loadModel(std::string path, ID3D11Device* device)
 {
+	unsigned long long allocationsBefore = AllocationCounter::GetThreadAllocations();
+	unsigned long long bytesBefore = AllocationCounter::GetThreadBytesAllocated();
+	long long liveBefore = AllocationCounter::GetThreadBytesLive();
+	AllocationCounter::ResetThreadPeak();
+	importStats = {};
+
 	Assimp::Importer importer;
 	const aiScene *scene = importer.ReadFile(path, 0); // May need to not flip UVs here, that may just be an opengl thing
 
@@ -24,32 +31,76 @@ void Model::loadModel(std::string path, ID3D11Device* device)
 	}
 	directory = path.substr(0, path.find_last_of('/'));
 
-	processNode(scene->mRootNode, scene, device);
+	// Every mesh is built in the same scratch, which only ever
+	// grows to fit the largest
+	MeshImportScratch scratch;
+	processNode(scene->mRootNode, SceneGraph::NoParent, scene, &scratch, device);
+	nodes.Update();
+
+	importStats.Allocations = AllocationCounter::GetThreadAllocations() - allocationsBefore;
+	importStats.BytesAllocated = AllocationCounter::GetThreadBytesAllocated() - bytesBefore;
+	importStats.PeakBytes = AllocationCounter::GetThreadPeakBytes() - liveBefore;
+	importStats.ScratchBytes = scratch.GetCapacity();
+}
+
+size_t Model::GetCpuBytes()
+{
+	size_t total = 0;
+	for (Mesh* m : meshes)
+		total += m->GetCpuBytes();
+	return total;
+}
+
+size_t Model::GetGpuBytes()
+{
+	size_t total = 0;
+	for (Mesh* m : meshes)
+		total += m->GetGpuBytes();
+	return total;
 }
 
+XMMATRIX Model::GetMeshTransform(unsigned int mesh)
+{
+	return XMLoadFloat4x4(&nodes.GetWorldTransform(meshNodes[mesh]));
+}
 
-void Model::processNode(aiNode *node, const aiScene *scene, ID3D11Device* device)
+void Model::processNode(aiNode *node, int parent, const aiScene *scene, MeshImportScratch* scratch, ID3D11Device* device)
 {
+	// Assimp matrices are column-vector style, so transpose
+	const aiMatrix4x4& m = node->mTransformation;
+	XMFLOAT4X4 local(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4);
+	unsigned int index = nodes.AddNode(parent, local);
+
+	meshes.reserve(meshes.size() + node->mNumMeshes);
+	meshNodes.reserve(meshNodes.size() + node->mNumMeshes);
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) // Bring in the node's meshes
 	{
 		aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene, device));
+		meshes.push_back(processMesh(mesh, scene, scratch, device));
+		meshNodes.push_back(index);
 	}
 	for (unsigned int i = 0; i < node->mNumChildren; i++) // Recursively process child nodes until done
 	{
-		processNode(node->mChildren[i], scene, device);
+		processNode(node->mChildren[i], (int)index, scene, scratch, device);
 	}
 }
 
-Mesh* Model::processMesh(aiMesh *mesh, const aiScene *scene, ID3D11Device* device)
+Mesh* Model::processMesh(aiMesh *mesh, const aiScene *scene, MeshImportScratch* scratch, ID3D11Device* device)
 {
-	std::vector<Vertex> vertices;
+	// Vertices only live until they're uploaded, so they go in
+	// the scratch, but the mesh keeps the indices
+	std::vector<Vertex>& vertices = scratch->Verts;
 	std::vector<unsigned int> indices;
+	vertices.resize(mesh->mNumVertices);
 	//std::cout << "NumVerts: " << mesh->mNumVertices << std::endl;
 
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) // Process vertex data
 	{
-		Vertex vertex;
+		Vertex& vertex = vertices[i];
 		vertex.Position = XMFLOAT3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
 		//std::cout << "Vertex: " << vertex.Position.x << ", " << vertex.Position.y << ", " << vertex.Position.z << std::endl;
 		vertex.Normal = XMFLOAT3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
@@ -58,12 +109,16 @@ Mesh* Model::processMesh(aiMesh *mesh, const aiScene *scene, ID3D11Device* devic
 			vertex.UV = XMFLOAT2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 		}
 		else vertex.UV = XMFLOAT2(0.0f, 0.0f);
-		vertices.push_back(vertex);
 	}
 
+	unsigned int indexCount = 0;
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		indexCount += mesh->mFaces[i].mNumIndices;
+	indices.reserve(indexCount);
+
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++) // Grab the indices
 	{
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 		{
 			indices.push_back(face.mIndices[j]);
@@ -83,5 +138,5 @@ Mesh* Model::processMesh(aiMesh *mesh, const aiScene *scene, ID3D11Device* devic
 	//}
 	//std::cout << "Vert size: " << vertices.size() << std::endl;
 	//std::cout << "Ind size: " << vertices.size() << std::endl;
-	return new Mesh(vertices.data(), vertices.size(), indices.data(), indices.size(), device);
+	return new Mesh(vertices.data(), (unsigned int)vertices.size(), std::move(indices), device, residency);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "Mesh.h"
+#include "SceneGraph.h"
 #include <DirectXMath.h>
 #include <vector>
 #include <string>
@@ -8,20 +9,49 @@
 #include <assimp/postprocess.h>
 #include <d3d11.h>
 
+// --------------------------------------------------------
+// What loading a model cost the thread that loaded it
+// --------------------------------------------------------
+struct ModelImportStats
+{
+	unsigned long long Allocations;
+	unsigned long long BytesAllocated;
+	long long PeakBytes;	// Most held at once, over what was held before
+	size_t ScratchBytes;	// Working memory shared by the meshes
+};
+
 class Model
 {
 public:
-	Model(char* path, ID3D11Device* device)
+	// Residency is how much of each mesh to keep for the CPU,
+	// which Mesh::SetCpuBudget() may lower
+	Model(const char* path, ID3D11Device* device, MeshResidency residency = MESH_RESIDENCY_FULL)
 	{
+		this->residency = residency;
 		loadModel(path, device);
 	}
 	~Model();
 
 	std::vector<Mesh*> meshes;
+
+	// The file's node hierarchy, and the node each mesh hangs off
+	SceneGraph nodes;
+	std::vector<unsigned int> meshNodes;
+
+	// A mesh's transform within the model (not transposed)
+	DirectX::XMMATRIX GetMeshTransform(unsigned int mesh);
+
+	const ModelImportStats& GetImportStats() { return importStats; }
+
+	// Memory held by all of the meshes, on each side
+	size_t GetCpuBytes();
+	size_t GetGpuBytes();
 private:
 	std::string directory;
+	MeshResidency residency;
+	ModelImportStats importStats;
 	void loadModel(std::string path, ID3D11Device* device);
-	void processNode(aiNode *node, const aiScene *scene, ID3D11Device* device);
-	Mesh* processMesh(aiMesh *mesh, const aiScene *scene, ID3D11Device* device);
+	void processNode(aiNode *node, int parent, const aiScene *scene, MeshImportScratch* scratch, ID3D11Device* device);
+	Mesh* processMesh(aiMesh *mesh, const aiScene *scene, MeshImportScratch* scratch, ID3D11Device* device);
 };
 
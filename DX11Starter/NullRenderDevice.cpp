@@ -0,0 +1,311 @@
+#include "NullRenderDevice.h"
+
+// --------------------------------------------------------
+// Constructor - starts with an empty log
+// --------------------------------------------------------
+NullRenderDevice::NullRenderDevice()
+{
+	commands.reserve(4096);
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Empties the log for the next frame
+// --------------------------------------------------------
+void NullRenderDevice::Clear()
+{
+	commands.clear();
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Gets the handle for a D3D object, assigning the next
+// number the first time an object is seen (0 is null)
+// --------------------------------------------------------
+unsigned int NullRenderDevice::Handle(const void* object)
+{
+	if (!object) return 0;
+
+	auto it = handles.find(object);
+	if (it != handles.end())
+		return it->second;
+
+	unsigned int handle = (unsigned int)handles.size() + 1;
+	handles.insert(std::pair<const void*, unsigned int>(object, handle));
+	return handle;
+}
+
+// --------------------------------------------------------
+// Adds a command to the log and counts it
+// --------------------------------------------------------
+void NullRenderDevice::Record(RenderCommandType type, unsigned int a, unsigned int b, unsigned int c, unsigned int d, unsigned int e)
+{
+	RenderCommand command;
+	command.Type = type;
+	command.Args[0] = a;
+	command.Args[1] = b;
+	command.Args[2] = c;
+	command.Args[3] = d;
+	command.Args[4] = e;
+	commands.push_back(command);
+
+	stats.Commands++;
+	stats.CommandCounts[type]++;
+	if (type < RENDER_COMMAND_UPDATE_BUFFER)
+		stats.Binds++;
+}
+
+// --------------------------------------------------------
+// Records an upload along with a hash of its data, so a
+// change in what was sent shows up when comparing logs
+// --------------------------------------------------------
+void NullRenderDevice::RecordUpload(RenderCommandType type, ID3D11Buffer* buffer, unsigned int a, unsigned int b, const void* data, unsigned int size)
+{
+	// 32-bit FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	Record(type, Handle(buffer), a, b, hash);
+	stats.Uploads++;
+	stats.BytesUploaded += size;
+}
+
+// --------------------------------------------------------
+// Writes the log as text, one command per line
+// --------------------------------------------------------
+void NullRenderDevice::WriteLog(std::ostream& output)
+{
+	for (const RenderCommand& command : commands)
+	{
+		output << GetCommandName(command.Type);
+		for (unsigned int arg : command.Args)
+			output << " " << arg;
+		output << "\n";
+	}
+}
+
+// --------------------------------------------------------
+// Gets a readable name for a command type
+// --------------------------------------------------------
+const char* NullRenderDevice::GetCommandName(RenderCommandType type)
+{
+	static const char* names[RENDER_COMMAND_COUNT] =
+	{
+		"InputLayout",
+		"Topology",
+		"VertexBuffer",
+		"IndexBuffer",
+		"VSShader",
+		"VSConstantBuffer",
+		"VSShaderResource",
+		"VSSampler",
+		"PSShader",
+		"PSConstantBuffer",
+		"PSShaderResource",
+		"PSSampler",
+		"RasterizerState",
+		"Viewport",
+		"DepthStencilState",
+		"BlendState",
+		"RenderTargets",
+		"UpdateBuffer",
+		"WriteBuffer",
+		"ClearRenderTarget",
+		"ClearDepthStencil",
+		"Draw",
+		"DrawIndexed",
+		"DrawIndexedInstanced",
+		"GenerateMips",
+		"Flush",
+	};
+	return type < RENDER_COMMAND_COUNT ? names[type] : "Unknown";
+}
+
+
+// ------ INPUT ASSEMBLER ---------------------------------
+
+void NullRenderDevice::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	Record(RENDER_COMMAND_INPUT_LAYOUT, Handle(inputLayout));
+}
+
+void NullRenderDevice::IASetPrimitiveTopology(unsigned int topology)
+{
+	Record(RENDER_COMMAND_TOPOLOGY, topology);
+}
+
+void NullRenderDevice::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	for (unsigned int i = 0; i < numBuffers; i++)
+		Record(RENDER_COMMAND_VERTEX_BUFFER, startSlot + i, Handle(buffers[i]), strides[i], offsets[i]);
+}
+
+void NullRenderDevice::IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+	Record(RENDER_COMMAND_INDEX_BUFFER, Handle(buffer), format, offset);
+}
+
+
+// ------ SHADER STAGES -----------------------------------
+
+void NullRenderDevice::VSSetShader(ID3D11VertexShader* shader)
+{
+	Record(RENDER_COMMAND_VS_SHADER, Handle(shader));
+}
+
+void NullRenderDevice::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	for (unsigned int i = 0; i < numBuffers; i++)
+		Record(RENDER_COMMAND_VS_CONSTANT_BUFFER, startSlot + i, Handle(buffers[i]));
+}
+
+void NullRenderDevice::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	for (unsigned int i = 0; i < numBuffers; i++)
+		Record(RENDER_COMMAND_VS_CONSTANT_BUFFER, startSlot + i, Handle(buffers[i]),
+			firstConstants ? firstConstants[i] : 0,
+			numConstants ? numConstants[i] : 0);
+}
+
+void NullRenderDevice::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	for (unsigned int i = 0; i < numViews; i++)
+		Record(RENDER_COMMAND_VS_SHADER_RESOURCE, startSlot + i, Handle(views[i]));
+}
+
+void NullRenderDevice::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	for (unsigned int i = 0; i < numSamplers; i++)
+		Record(RENDER_COMMAND_VS_SAMPLER, startSlot + i, Handle(samplers[i]));
+}
+
+void NullRenderDevice::PSSetShader(ID3D11PixelShader* shader)
+{
+	Record(RENDER_COMMAND_PS_SHADER, Handle(shader));
+}
+
+void NullRenderDevice::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	for (unsigned int i = 0; i < numBuffers; i++)
+		Record(RENDER_COMMAND_PS_CONSTANT_BUFFER, startSlot + i, Handle(buffers[i]));
+}
+
+void NullRenderDevice::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	for (unsigned int i = 0; i < numBuffers; i++)
+		Record(RENDER_COMMAND_PS_CONSTANT_BUFFER, startSlot + i, Handle(buffers[i]),
+			firstConstants ? firstConstants[i] : 0,
+			numConstants ? numConstants[i] : 0);
+}
+
+void NullRenderDevice::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	for (unsigned int i = 0; i < numViews; i++)
+		Record(RENDER_COMMAND_PS_SHADER_RESOURCE, startSlot + i, Handle(views[i]));
+}
+
+void NullRenderDevice::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	for (unsigned int i = 0; i < numSamplers; i++)
+		Record(RENDER_COMMAND_PS_SAMPLER, startSlot + i, Handle(samplers[i]));
+}
+
+
+// ------ RASTERIZER AND OUTPUT MERGER --------------------
+
+void NullRenderDevice::RSSetState(ID3D11RasterizerState* state)
+{
+	Record(RENDER_COMMAND_RASTERIZER_STATE, Handle(state));
+}
+
+void NullRenderDevice::RSSetViewports(unsigned int numViewports, const RenderViewport* viewports)
+{
+	for (unsigned int i = 0; i < numViewports; i++)
+		Record(RENDER_COMMAND_VIEWPORT, i, (unsigned int)viewports[i].Width, (unsigned int)viewports[i].Height);
+}
+
+void NullRenderDevice::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	Record(RENDER_COMMAND_DEPTH_STENCIL_STATE, Handle(state), stencilRef);
+}
+
+void NullRenderDevice::OMSetBlendState(ID3D11BlendState* state, const float /*blendFactor*/[4], unsigned int sampleMask)
+{
+	Record(RENDER_COMMAND_BLEND_STATE, Handle(state), sampleMask);
+}
+
+void NullRenderDevice::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil)
+{
+	Record(RENDER_COMMAND_RENDER_TARGETS, numViews, numViews > 0 ? Handle(renderTargets[0]) : 0, Handle(depthStencil));
+}
+
+
+// ------ UPLOADS -----------------------------------------
+
+void NullRenderDevice::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	RecordUpload(RENDER_COMMAND_UPDATE_BUFFER, buffer, 0, size, data, size);
+}
+
+void NullRenderDevice::UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end)
+{
+	RecordUpload(RENDER_COMMAND_UPDATE_BUFFER, buffer, start, end, data, end - start);
+}
+
+bool NullRenderDevice::WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool /*discard*/)
+{
+	RecordUpload(RENDER_COMMAND_WRITE_BUFFER, buffer, offset, size, data, size);
+	return true;
+}
+
+
+// ------ CLEARS, DRAWING AND MISC ------------------------
+
+void NullRenderDevice::ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float /*color*/[4])
+{
+	Record(RENDER_COMMAND_CLEAR_RENDER_TARGET, Handle(renderTarget));
+}
+
+void NullRenderDevice::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float /*depth*/, unsigned char /*stencil*/)
+{
+	Record(RENDER_COMMAND_CLEAR_DEPTH_STENCIL, Handle(depthStencil), clearFlags);
+}
+
+void NullRenderDevice::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Record(RENDER_COMMAND_DRAW, vertexCount, startVertex);
+	stats.DrawCalls++;
+	stats.VerticesDrawn += vertexCount;
+	stats.InstancesDrawn++;
+}
+
+void NullRenderDevice::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Record(RENDER_COMMAND_DRAW_INDEXED, indexCount, startIndex, (unsigned int)baseVertex);
+	stats.DrawCalls++;
+	stats.VerticesDrawn += indexCount;
+	stats.InstancesDrawn++;
+}
+
+void NullRenderDevice::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Record(RENDER_COMMAND_DRAW_INDEXED_INSTANCED, indexCount, instanceCount, startIndex, (unsigned int)baseVertex, startInstance);
+	stats.DrawCalls++;
+	stats.VerticesDrawn += indexCount * instanceCount;
+	stats.InstancesDrawn += instanceCount;
+}
+
+void NullRenderDevice::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	Record(RENDER_COMMAND_GENERATE_MIPS, Handle(view));
+}
+
+void NullRenderDevice::Flush()
+{
+	Record(RENDER_COMMAND_FLUSH);
+}
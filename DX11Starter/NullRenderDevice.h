@@ -0,0 +1,141 @@
+#pragma once
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Kinds of commands the null backend records.  Slot array
+// binds are recorded as one command per slot.
+// --------------------------------------------------------
+enum RenderCommandType : unsigned char
+{
+	RENDER_COMMAND_INPUT_LAYOUT,		// layout
+	RENDER_COMMAND_TOPOLOGY,			// topology
+	RENDER_COMMAND_VERTEX_BUFFER,		// slot, buffer, stride, offset
+	RENDER_COMMAND_INDEX_BUFFER,		// buffer, format, offset
+	RENDER_COMMAND_VS_SHADER,			// shader
+	RENDER_COMMAND_VS_CONSTANT_BUFFER,	// slot, buffer, first constant, constant count
+	RENDER_COMMAND_VS_SHADER_RESOURCE,	// slot, view
+	RENDER_COMMAND_VS_SAMPLER,			// slot, sampler
+	RENDER_COMMAND_PS_SHADER,			// shader
+	RENDER_COMMAND_PS_CONSTANT_BUFFER,	// slot, buffer, first constant, constant count
+	RENDER_COMMAND_PS_SHADER_RESOURCE,	// slot, view
+	RENDER_COMMAND_PS_SAMPLER,			// slot, sampler
+	RENDER_COMMAND_RASTERIZER_STATE,	// state
+	RENDER_COMMAND_VIEWPORT,			// index, width, height
+	RENDER_COMMAND_DEPTH_STENCIL_STATE,	// state, stencil ref
+	RENDER_COMMAND_BLEND_STATE,			// state, sample mask
+	RENDER_COMMAND_RENDER_TARGETS,		// count, first target, depth stencil
+	RENDER_COMMAND_UPDATE_BUFFER,		// buffer, start, end, data hash
+	RENDER_COMMAND_WRITE_BUFFER,		// buffer, offset, size, data hash
+	RENDER_COMMAND_CLEAR_RENDER_TARGET,	// target
+	RENDER_COMMAND_CLEAR_DEPTH_STENCIL,	// depth stencil, flags
+	RENDER_COMMAND_DRAW,				// vertex count, start vertex
+	RENDER_COMMAND_DRAW_INDEXED,		// index count, start index, base vertex
+	RENDER_COMMAND_DRAW_INDEXED_INSTANCED,	// index count, instance count, start index, base vertex, start instance
+	RENDER_COMMAND_GENERATE_MIPS,		// view
+	RENDER_COMMAND_FLUSH,
+	RENDER_COMMAND_COUNT
+};
+
+// --------------------------------------------------------
+// A single recorded command.  D3D objects are replaced by
+// small handles, numbered in the order they were first seen,
+// so logs from separate runs can be compared directly.
+// --------------------------------------------------------
+struct RenderCommand
+{
+	RenderCommandType Type;
+	unsigned int Args[5];
+};
+
+// --------------------------------------------------------
+// Totals for everything recorded since the last Clear()
+// --------------------------------------------------------
+struct RenderCommandStats
+{
+	unsigned int Commands;
+	unsigned int Binds;
+	unsigned int Uploads;
+	unsigned int BytesUploaded;
+	unsigned int DrawCalls;
+	unsigned int VerticesDrawn;	// Vertices for Draw, indices for DrawIndexed (times instances)
+	unsigned int InstancesDrawn;	// 1 per non-instanced draw
+	unsigned int CommandCounts[RENDER_COMMAND_COUNT];
+};
+
+// --------------------------------------------------------
+// Render device that doesn't render anything - it just
+// records every call into a compact command log, so frames
+// can be measured and compared without a GPU
+// --------------------------------------------------------
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	NullRenderDevice();
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer and output merger
+	void RSSetState(ID3D11RasterizerState* state);
+	void RSSetViewports(unsigned int numViewports, const RenderViewport* viewports);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil);
+
+	// Uploads
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end);
+	bool WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard);
+
+	// Clears
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil);
+
+	// Drawing and misc
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void GenerateMips(ID3D11ShaderResourceView* view);
+	void Flush();
+
+	// Recorded results
+	const std::vector<RenderCommand>& GetCommands() { return commands; }
+	const RenderCommandStats& GetStats() { return stats; }
+	void WriteLog(std::ostream& output);
+	static const char* GetCommandName(RenderCommandType type);
+
+	// Drops recorded commands and stats (handles are kept, so
+	// the same object keeps the same handle across frames)
+	void Clear();
+
+private:
+	std::vector<RenderCommand> commands;
+	RenderCommandStats stats;
+	std::unordered_map<const void*, unsigned int> handles;
+
+	unsigned int Handle(const void* object);
+	void Record(RenderCommandType type, unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0, unsigned int e = 0);
+	void RecordUpload(RenderCommandType type, ID3D11Buffer* buffer, unsigned int a, unsigned int b, const void* data, unsigned int size);
+};
@@ -0,0 +1,351 @@
+#include "OcclusionRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+OcclusionRasterizer::OcclusionRasterizer(unsigned int width, unsigned int height)
+{
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+	this->width = tilesX * TileSize;
+	this->height = tilesY * TileSize;
+
+	depth.resize(this->width * this->height, 1.0f);
+	tileMaxDepth.resize(tilesX * tilesY, 1.0f);
+	XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+	ResetStats();
+}
+
+void OcclusionRasterizer::Begin(FXMMATRIX viewProj)
+{
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+	XMStoreFloat4x4(&this->viewProj, viewProj);
+}
+
+// --------------------------------------------------------
+// Transforms every vertex once, then rasterizes each
+// triangle that's entirely beyond the near plane
+// --------------------------------------------------------
+void OcclusionRasterizer::RenderOccluder(const XMFLOAT3* positions, const unsigned int* indices, unsigned int indexCount, FXMMATRIX world)
+{
+	// Only the vertices the indices use are needed, but meshes
+	// don't have unused ones, so just find the highest index
+	unsigned int vertexCount = 0;
+	for (unsigned int i = 0; i < indexCount; i++)
+		vertexCount = std::max(vertexCount, indices[i] + 1);
+
+	TransformVertices(positions, vertexCount, XMMatrixMultiply(world, XMLoadFloat4x4(&viewProj)));
+	RasterizeTriangles(indices, indexCount);
+}
+
+// Quantized positions are decoded by the transform itself
+void OcclusionRasterizer::RenderOccluder(const MeshGeometry& geometry, FXMMATRIX world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&viewProj));
+	if (geometry.IsQuantized())
+		TransformVertices(geometry.GetQuantizedPositions(), geometry.GetVertexCount(), XMMatrixMultiply(geometry.GetDequantizeMatrix(), worldViewProj));
+	else
+		TransformVertices(geometry.GetPositions(), geometry.GetVertexCount(), worldViewProj);
+
+	if (geometry.HasShortIndices())
+		RasterizeTriangles(geometry.GetShortIndices(), geometry.GetIndexCount());
+	else
+		RasterizeTriangles(geometry.GetIndices(), geometry.GetIndexCount());
+}
+
+static XMVECTOR LoadPosition(const XMFLOAT3& p)
+{
+	return XMLoadFloat3(&p);
+}
+
+static XMVECTOR LoadPosition(const QuantizedPosition& p)
+{
+	return XMVectorSet((float)p.X, (float)p.Y, (float)p.Z, 1.0f);
+}
+
+// --------------------------------------------------------
+// Takes vertices to screen space x, y and depth, plus w
+// --------------------------------------------------------
+template<typename Position>
+void OcclusionRasterizer::TransformVertices(const Position* positions, unsigned int vertexCount, FXMMATRIX worldViewProj)
+{
+	transformed.resize(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(LoadPosition(positions[i]), worldViewProj));
+
+		// Mark anything in front of the near plane with w = 0
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+		{
+			transformed[i] = XMFLOAT4(0, 0, 0, 0);
+			continue;
+		}
+
+		float invW = 1.0f / clip.w;
+		transformed[i] = XMFLOAT4(
+			(clip.x * invW * 0.5f + 0.5f) * width,
+			(0.5f - clip.y * invW * 0.5f) * height,
+			clip.z * invW,
+			clip.w);
+	}
+}
+
+template<typename Index>
+void OcclusionRasterizer::RasterizeTriangles(const Index* indices, unsigned int indexCount)
+{
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		const XMFLOAT4& a = transformed[indices[i]];
+		const XMFLOAT4& b = transformed[indices[i + 1]];
+		const XMFLOAT4& c = transformed[indices[i + 2]];
+		if (a.w == 0.0f || b.w == 0.0f || c.w == 0.0f)
+		{
+			stats.TrianglesSkipped++;
+			continue;
+		}
+
+		RasterizeTriangle(
+			XMFLOAT3(a.x, a.y, a.z),
+			XMFLOAT3(b.x, b.y, b.z),
+			XMFLOAT3(c.x, c.y, c.z));
+	}
+}
+
+// --------------------------------------------------------
+// Writes the nearest depth of a screen space triangle into
+// every pixel whose center it covers.  Both windings are
+// drawn - back faces of closed occluders are always behind
+// their front faces, so they never change the result.
+// --------------------------------------------------------
+void OcclusionRasterizer::RasterizeTriangle(const XMFLOAT3& v0, const XMFLOAT3& v1In, const XMFLOAT3& v2In)
+{
+	XMFLOAT3 v1 = v1In;
+	XMFLOAT3 v2 = v2In;
+
+	float det = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (det == 0.0f)
+	{
+		stats.TrianglesSkipped++;
+		return;
+	}
+	if (det < 0.0f)
+	{
+		std::swap(v1, v2);
+		det = -det;
+	}
+
+	// Pixel bounds, and the tiles they touch
+	float minX = std::min(v0.x, std::min(v1.x, v2.x));
+	float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	float minY = std::min(v0.y, std::min(v1.y, v2.y));
+	float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+	{
+		stats.TrianglesSkipped++;
+		return;
+	}
+
+	unsigned int tileX0 = (unsigned int)std::max(0.0f, minX) / TileSize;
+	unsigned int tileY0 = (unsigned int)std::max(0.0f, minY) / TileSize;
+	unsigned int tileX1 = (unsigned int)std::min(maxX, width - 1.0f) / TileSize;
+	unsigned int tileY1 = (unsigned int)std::min(maxY, height - 1.0f) / TileSize;
+
+	// Edge functions, each positive on the inside: A*x + B*y + C.
+	// They're always set up from the same end of an edge, then
+	// negated if needed, so the two triangles sharing an edge get
+	// exactly opposite values and no pixel falls between them.
+	const XMFLOAT3* edgeStart[3] = { &v0, &v1, &v2 };
+	const XMFLOAT3* edgeEnd[3] = { &v1, &v2, &v0 };
+	float edgeA[3], edgeB[3], edgeC[3];
+	XMVECTOR edgeAVec[3];
+	for (int e = 0; e < 3; e++)
+	{
+		const XMFLOAT3* p = edgeStart[e];
+		const XMFLOAT3* q = edgeEnd[e];
+		bool flip = q->x < p->x || (q->x == p->x && q->y < p->y);
+		if (flip)
+			std::swap(p, q);
+
+		edgeA[e] = p->y - q->y;
+		edgeB[e] = q->x - p->x;
+		edgeC[e] = -(edgeA[e] * p->x + edgeB[e] * p->y);
+		if (flip)
+		{
+			edgeA[e] = -edgeA[e];
+			edgeB[e] = -edgeB[e];
+			edgeC[e] = -edgeC[e];
+		}
+		edgeAVec[e] = XMVectorReplicate(edgeA[e]);
+	}
+
+	// Depth is linear in screen space: z = dzdx*x + dzdy*y + zc
+	float dz1 = v1.z - v0.z;
+	float dz2 = v2.z - v0.z;
+	float dzdx = (dz1 * (v2.y - v0.y) - dz2 * (v1.y - v0.y)) / det;
+	float dzdy = (dz2 * (v1.x - v0.x) - dz1 * (v2.x - v0.x)) / det;
+	float zc = v0.z - dzdx * v0.x - dzdy * v0.y;
+	XMVECTOR dzdxVec = XMVectorReplicate(dzdx);
+	float triangleMinZ = std::min(v0.z, std::min(v1.z, v2.z));
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	bool drewAnything = false;
+
+	for (unsigned int ty = tileY0; ty <= tileY1; ty++)
+	{
+		for (unsigned int tx = tileX0; tx <= tileX1; tx++)
+		{
+			// Skip tiles where everything's already closer
+			unsigned int tile = ty * tilesX + tx;
+			if (triangleMinZ >= tileMaxDepth[tile])
+				continue;
+
+			// Skip tiles entirely outside an edge, by testing the
+			// pixel center that's farthest inside it
+			float left = tx * TileSize + 0.5f;
+			float top = ty * TileSize + 0.5f;
+			float right = left + TileSize - 1;
+			float bottom = top + TileSize - 1;
+			bool outside = false;
+			for (int e = 0; e < 3 && !outside; e++)
+			{
+				float x = edgeA[e] > 0.0f ? right : left;
+				float y = edgeB[e] > 0.0f ? bottom : top;
+				outside = edgeA[e] * x + (edgeB[e] * y + edgeC[e]) < 0.0f;
+			}
+			if (outside)
+				continue;
+
+			// Fill the tile 8 pixels (two vectors) per row
+			XMVECTOR xs[2];
+			xs[0] = XMVectorAdd(XMVectorReplicate((float)(tx * TileSize)), laneOffsets);
+			xs[1] = XMVectorAdd(xs[0], XMVectorReplicate(4.0f));
+
+			float* tileDepth = &depth[tile * TileSize * TileSize];
+			XMVECTOR tileMax = zero;
+			for (unsigned int row = 0; row < TileSize; row++)
+			{
+				float y = top + row;
+				XMVECTOR rowZ = XMVectorReplicate(dzdy * y + zc);
+				XMVECTOR rowE[3];
+				for (int e = 0; e < 3; e++)
+					rowE[e] = XMVectorReplicate(edgeB[e] * y + edgeC[e]);
+
+				for (int half = 0; half < 2; half++)
+				{
+					XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeAVec[0], xs[half], rowE[0]), zero);
+					inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeAVec[1], xs[half], rowE[1]), zero));
+					inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeAVec[2], xs[half], rowE[2]), zero));
+
+					XMFLOAT4* pixels = (XMFLOAT4*)&tileDepth[row * TileSize + half * 4];
+					XMVECTOR old = XMLoadFloat4(pixels);
+					XMVECTOR z = XMVectorMultiplyAdd(dzdxVec, xs[half], rowZ);
+					XMVECTOR result = XMVectorSelect(old, XMVectorMin(old, z), inside);
+					XMStoreFloat4(pixels, result);
+					tileMax = XMVectorMax(tileMax, result);
+				}
+			}
+
+			XMFLOAT4 maxes;
+			XMStoreFloat4(&maxes, tileMax);
+			tileMaxDepth[tile] = std::max(std::max(maxes.x, maxes.y), std::max(maxes.z, maxes.w));
+			stats.TilesRasterized++;
+			drewAnything = true;
+		}
+	}
+
+	if (drewAnything)
+		stats.TrianglesRasterized++;
+	else
+		stats.TrianglesSkipped++;
+}
+
+// --------------------------------------------------------
+// Projects a box's corners and checks whether any drawn
+// depth under its screen rectangle is behind its nearest
+// point.  Tiles whose farthest depth is in front of the box
+// are rejected without looking at their pixels.
+// --------------------------------------------------------
+bool OcclusionRasterizer::IsVisible(const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	stats.BoxesTested++;
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProj);
+
+	float minX = 1e30f, minY = 1e30f, minZ = 1e30f;
+	float maxX = -1e30f, maxY = -1e30f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMVECTOR point = XMVectorSet(
+			(corner & 1) ? max.x : min.x,
+			(corner & 2) ? max.y : min.y,
+			(corner & 4) ? max.z : min.z,
+			1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(point, matrix));
+
+		// Reaches the near plane - can't say anything about it
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y * invW * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	// Off screen boxes are the frustum culler's business
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		return true;
+
+	unsigned int x0 = (unsigned int)std::max(0.0f, minX);
+	unsigned int y0 = (unsigned int)std::max(0.0f, minY);
+	unsigned int x1 = (unsigned int)std::min(maxX, width - 1.0f);
+	unsigned int y1 = (unsigned int)std::min(maxY, height - 1.0f);
+
+	for (unsigned int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+	{
+		for (unsigned int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+		{
+			unsigned int tile = ty * tilesX + tx;
+			if (minZ > tileMaxDepth[tile])
+				continue;
+
+			// Something in this tile might be behind the box
+			unsigned int px0 = std::max(x0, tx * TileSize);
+			unsigned int px1 = std::min(x1, tx * TileSize + TileSize - 1);
+			unsigned int py0 = std::max(y0, ty * TileSize);
+			unsigned int py1 = std::min(y1, ty * TileSize + TileSize - 1);
+			const float* tileDepth = &depth[tile * TileSize * TileSize];
+			for (unsigned int py = py0; py <= py1; py++)
+			{
+				for (unsigned int px = px0; px <= px1; px++)
+				{
+					if (tileDepth[(py % TileSize) * TileSize + px % TileSize] >= minZ)
+						return true;
+				}
+			}
+		}
+	}
+
+	stats.BoxesHidden++;
+	return false;
+}
+
+float OcclusionRasterizer::GetDepth(unsigned int x, unsigned int y)
+{
+	unsigned int tile = (y / TileSize) * tilesX + x / TileSize;
+	return depth[tile * TileSize * TileSize + (y % TileSize) * TileSize + x % TileSize];
+}
+
+void OcclusionRasterizer::ResetStats()
+{
+	stats = {};
+}
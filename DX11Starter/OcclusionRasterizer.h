@@ -0,0 +1,92 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "MeshGeometry.h"
+
+// --------------------------------------------------------
+// Work done since the last ResetStats()
+// --------------------------------------------------------
+struct OcclusionStats
+{
+	unsigned int TrianglesRasterized;
+	unsigned int TrianglesSkipped;	// Crossing the near plane, degenerate or off screen
+	unsigned int TilesRasterized;
+	unsigned int BoxesTested;
+	unsigned int BoxesHidden;
+};
+
+// --------------------------------------------------------
+// Small CPU depth buffer for occlusion culling.
+//
+// A few big occluders are rasterized at low resolution, then
+// bounding boxes are tested against the result so objects
+// hidden behind them can be skipped before they're drawn.
+//
+// The buffer is split into 8x8 pixel tiles.  Triangles walk
+// the tiles their bounds touch, skipping any tile that lies
+// outside an edge or already has everything closer than the
+// triangle, and fill the rest one 8 pixel row at a time (as
+// two 4-wide vectors).  Each tile keeps its farthest depth,
+// so most box tests are answered per tile without reading
+// pixels.
+//
+// Depth is D3D style, 0 at the near plane and 1 at the far
+// plane.  Occluder triangles crossing the near plane are
+// skipped and boxes crossing it count as visible, so the
+// results can only ever err towards drawing something.
+// --------------------------------------------------------
+class OcclusionRasterizer
+{
+public:
+	static const unsigned int TileSize = 8;
+
+	// Width and height are rounded up to whole tiles
+	OcclusionRasterizer(unsigned int width = 256, unsigned int height = 144);
+
+	// Resets depth to the far plane and sets the (non-transposed)
+	// view * projection matrix for everything drawn or tested next
+	void Begin(DirectX::FXMMATRIX viewProj);
+
+	// Draws an indexed triangle list, given a (non-transposed)
+	// world matrix
+	void RenderOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, unsigned int indexCount, DirectX::FXMMATRIX world);
+
+	// Same, straight from a mesh's CPU copy in whatever form
+	// it was kept
+	void RenderOccluder(const MeshGeometry& geometry, DirectX::FXMMATRIX world);
+
+	// Tests a world space AABB against what's been drawn
+	bool IsVisible(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max);
+
+	// Getters
+	unsigned int GetWidth() { return width; }
+	unsigned int GetHeight() { return height; }
+	float GetDepth(unsigned int x, unsigned int y);
+	const OcclusionStats& GetStats() { return stats; }
+	void ResetStats();
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	// Each tile's 64 depths are stored together, row by row
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+
+	DirectX::XMFLOAT4X4 viewProj;
+	OcclusionStats stats;
+
+	// Screen space x, y and depth of each occluder vertex, plus
+	// w, reused between occluders
+	std::vector<DirectX::XMFLOAT4> transformed;
+
+	template<typename Position>
+	void TransformVertices(const Position* positions, unsigned int vertexCount, DirectX::FXMMATRIX worldViewProj);
+	template<typename Index>
+	void RasterizeTriangles(const Index* indices, unsigned int indexCount);
+	void RasterizeTriangle(const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+};
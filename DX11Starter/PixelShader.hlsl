@@ -1,4 +1,5 @@
-cbuffer externalData : register(b0)
+// Lights and camera only change once per frame
+cbuffer perFrame : register(b0)
 {
 	float3 LightPos1;
 	float3 LightPos2;
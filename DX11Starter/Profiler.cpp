@@ -0,0 +1,251 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+std::atomic<bool> Profiler::enabled(false);
+long long Profiler::lastFrameEnd = -1;
+FrameTimeHistory Profiler::frameTimes;
+unsigned int Profiler::frameEventsBegin = 0;
+unsigned int Profiler::frameEventsEnd = 0;
+
+// Every thread that's ever profiled, in the order they started
+static std::mutex registryMutex;
+static std::vector<ProfileThreadBuffer*> threadBuffers;
+static thread_local ProfileThreadBuffer* threadBuffer = 0;
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+long long Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ProfileThreadBuffer* Profiler::GetThreadBuffer()
+{
+	if (!threadBuffer)
+	{
+		threadBuffer = new ProfileThreadBuffer();
+		threadBuffer->Started = 0;
+		threadBuffer->Written = 0;
+		threadBuffer->Depth = 0;
+		threadBuffer->ThreadName = 0;
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadBuffer->ThreadIndex = (unsigned int)threadBuffers.size();
+		threadBuffers.push_back(threadBuffer);
+	}
+	return threadBuffer;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer()->ThreadName = name;
+}
+
+long long Profiler::BeginScope()
+{
+	GetThreadBuffer()->Depth++;
+	return Now();
+}
+
+void Profiler::EndScope(const char* name, long long start)
+{
+	long long end = Now();
+	ProfileThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer->Depth > 0)
+		buffer->Depth--;
+
+	// Say which slot is about to change before changing it, so
+	// readers copying it meanwhile can tell
+	unsigned int index = buffer->Written.load(std::memory_order_relaxed);
+	buffer->Started.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	ProfileEvent& e = buffer->Events[index % ProfileThreadBuffer::Capacity];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+	e.Depth = buffer->Depth;
+	buffer->Written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::EndFrame()
+{
+	if (!enabled)
+	{
+		lastFrameEnd = -1;
+		return;
+	}
+
+	long long now = Now();
+	if (lastFrameEnd >= 0)
+		frameTimes.Add((now - lastFrameEnd) / 1000000.0f);
+	lastFrameEnd = now;
+
+	frameEventsBegin = frameEventsEnd;
+	frameEventsEnd = GetThreadBuffer()->Written.load(std::memory_order_relaxed);
+}
+
+void Profiler::GetLastFrameScopes(std::vector<ProfileEvent>* scopes)
+{
+	ProfileThreadBuffer* buffer = GetThreadBuffer();
+	unsigned int written = buffer->Written.load(std::memory_order_relaxed);
+	CopyEvents(buffer, frameEventsBegin, std::min(frameEventsEnd, written), scopes);
+}
+
+// --------------------------------------------------------
+// Copies events [begin, end) of a thread's buffer (end being
+// at most what it has written), leaving out any that have
+// been, or might be being, overwritten
+// --------------------------------------------------------
+void Profiler::CopyEvents(const ProfileThreadBuffer* buffer, unsigned int begin, unsigned int end, std::vector<ProfileEvent>* events)
+{
+	events->clear();
+	if (end > ProfileThreadBuffer::Capacity)
+		begin = std::max(begin, end - ProfileThreadBuffer::Capacity);
+	for (unsigned int i = begin; i < end; i++)
+		events->push_back(buffer->Events[i % ProfileThreadBuffer::Capacity]);
+
+	// Event i shares its slot with event i + Capacity, so once
+	// that one's started, i's copy can't be trusted
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned int started = buffer->Started.load(std::memory_order_relaxed);
+	if (started > begin + ProfileThreadBuffer::Capacity)
+	{
+		unsigned int lost = std::min(started - ProfileThreadBuffer::Capacity - begin, (unsigned int)events->size());
+		events->erase(events->begin(), events->begin() + lost);
+	}
+}
+
+FrameTimeSummary Profiler::GetFrameTimeSummary(unsigned int lastFrames)
+{
+	return frameTimes.Summarize(lastFrames);
+}
+
+// Event names are our own literals, but keep the JSON valid
+static void WriteJsonString(std::ofstream& out, const char* s)
+{
+	out << '"';
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			out << '\\';
+		out << *s;
+	}
+	out << '"';
+}
+
+// --------------------------------------------------------
+// Saves every recorded scope as a complete ("X") event, with
+// a name for each thread
+// --------------------------------------------------------
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	std::vector<ProfileEvent> events;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (ProfileThreadBuffer* buffer : threadBuffers)
+	{
+		std::string threadName = buffer->ThreadName ? buffer->ThreadName : "Thread " + std::to_string(buffer->ThreadIndex);
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadIndex << ",\"args\":{\"name\":";
+		WriteJsonString(out, threadName.c_str());
+		out << "}}";
+		first = false;
+
+		// Copied first, as the thread may still be recording
+		CopyEvents(buffer, 0, buffer->Written.load(std::memory_order_acquire), &events);
+		for (const ProfileEvent& e : events)
+		{
+			out << ",\n{\"name\":";
+			WriteJsonString(out, e.Name);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->ThreadIndex <<
+				",\"ts\":" << e.Start / 1000 << "." << (e.Start % 1000) / 100 <<
+				",\"dur\":" << (e.End - e.Start) / 1000 << "." << ((e.End - e.Start) % 1000) / 100 << "}";
+		}
+	}
+
+	out << "\n]}\n";
+	return (bool)out;
+}
+
+void Profiler::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (ProfileThreadBuffer* buffer : threadBuffers)
+		delete buffer;
+	threadBuffers.clear();
+	threadBuffer = 0;
+	frameEventsBegin = 0;
+	frameEventsEnd = 0;
+	lastFrameEnd = -1;
+	frameTimes.Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ FRAME TIME HISTORY --------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+FrameTimeHistory::FrameTimeHistory()
+{
+	frameCount = 0;
+}
+
+void FrameTimeHistory::Add(float frameTime)
+{
+	if (frames.size() < Capacity)
+		frames.push_back(frameTime);
+	else
+		frames[frameCount % Capacity] = frameTime;
+	frameCount++;
+}
+
+void FrameTimeHistory::Clear()
+{
+	frames.clear();
+	frameCount = 0;
+}
+
+unsigned int FrameTimeHistory::GetCount() const
+{
+	return (unsigned int)frames.size();
+}
+
+// --------------------------------------------------------
+// Nearest rank percentiles over the chosen frames
+// --------------------------------------------------------
+FrameTimeSummary FrameTimeHistory::Summarize(unsigned int lastFrames) const
+{
+	FrameTimeSummary summary = {};
+	unsigned int count = GetCount();
+	if (lastFrames > 0 && lastFrames < count)
+		count = lastFrames;
+	if (count == 0)
+		return summary;
+
+	// The newest frame is just before where the next one goes
+	std::vector<float> sorted(count);
+	for (unsigned int i = 0; i < count; i++)
+		sorted[i] = frames[(frameCount - count + i) % Capacity];
+	std::sort(sorted.begin(), sorted.end());
+
+	float total = 0.0f;
+	for (float t : sorted)
+		total += t;
+
+	summary.Frames = count;
+	summary.Average = total / count;
+	summary.P50 = NearestRank(sorted.data(), count, 0.50f);
+	summary.P95 = NearestRank(sorted.data(), count, 0.95f);
+	summary.P99 = NearestRank(sorted.data(), count, 0.99f);
+	summary.Max = sorted.back();
+	return summary;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// One finished scope, with times in nanoseconds since the
+// profiler started
+// --------------------------------------------------------
+struct ProfileEvent
+{
+	const char* Name;	// Must be a string literal (or live as long)
+	long long Start;
+	long long End;
+	unsigned int Depth;
+};
+
+// --------------------------------------------------------
+// Frame time percentiles, in milliseconds
+// --------------------------------------------------------
+struct FrameTimeSummary
+{
+	unsigned int Frames;
+	float Average;
+	float P50;
+	float P95;
+	float P99;
+	float Max;
+};
+
+// --------------------------------------------------------
+// Nearest rank percentile (p from 0 to 1) of count samples,
+// already sorted from smallest to largest
+// --------------------------------------------------------
+template<typename T>
+T NearestRank(const T* sorted, unsigned int count, float p)
+{
+	return sorted[(unsigned int)std::max(1.0f, std::ceil(p * count)) - 1];
+}
+
+// --------------------------------------------------------
+// The times of the last Capacity frames, oldest overwritten
+// first, in milliseconds
+// --------------------------------------------------------
+class FrameTimeHistory
+{
+public:
+	// Ten minutes at 60hz
+	static const unsigned int Capacity = 36000;
+
+	FrameTimeHistory();
+
+	void Add(float frameTime);
+	void Clear();
+
+	// Frames kept, up to Capacity
+	unsigned int GetCount() const;
+
+	// Summarizes the last lastFrames frames kept, or all of
+	// them when it's zero
+	FrameTimeSummary Summarize(unsigned int lastFrames) const;
+
+private:
+	std::vector<float> frames;	// Ring of the last Capacity frames
+	unsigned int frameCount;
+};
+
+// --------------------------------------------------------
+// Each thread's finished scopes.  Only the owning thread
+// writes, and Written is published after each event, so
+// readers never need a lock.  Once full, the oldest events
+// are overwritten - readers on other threads check Started
+// after copying, and drop anything that might have been
+// overwritten meanwhile.
+// --------------------------------------------------------
+struct ProfileThreadBuffer
+{
+	static const unsigned int Capacity = 65536;
+
+	ProfileEvent Events[Capacity];
+	std::atomic<unsigned int> Started;	// Events begun, which may be one past Written
+	std::atomic<unsigned int> Written;
+	unsigned int Depth;
+	unsigned int ThreadIndex;
+	const char* ThreadName;
+};
+
+// --------------------------------------------------------
+// Scoped CPU profiler.
+//
+// PROFILE_SCOPE("Name") times the rest of the enclosing
+// block.  While disabled each scope costs one branch on the
+// way in and one on the way out.  EndFrame() marks frame
+// boundaries for the frame time summary, and everything
+// recorded can be saved as Chrome trace JSON, which loads in
+// chrome://tracing or Perfetto.
+// --------------------------------------------------------
+class Profiler
+{
+public:
+	static void SetEnabled(bool enabled) { Profiler::enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Names this thread in exported traces
+	static void SetThreadName(const char* name);
+
+	// Used by ProfileScope
+	static long long BeginScope();
+	static void EndScope(const char* name, long long start);
+
+	// Frame times are only kept while enabled, for the last
+	// FrameTimeHistory::Capacity frames.  Summarizes the last
+	// lastFrames frames, or all that are kept when it's zero.
+	static void EndFrame();
+	static FrameTimeSummary GetFrameTimeSummary(unsigned int lastFrames = 0);
+
+	// Copies the scopes finished between the last two calls to
+	// EndFrame(), from the thread that calls it
+	static void GetLastFrameScopes(std::vector<ProfileEvent>* scopes);
+
+	// Safe while other threads are still profiling - each is
+	// saved as of some point during the call
+	static bool WriteChromeTrace(const std::string& path);
+
+	// Frees every thread's buffer and forgets the frame times -
+	// only call once no other thread will profile again
+	static void Shutdown();
+
+private:
+	static std::atomic<bool> enabled;
+	static long long lastFrameEnd;
+	static FrameTimeHistory frameTimes;
+	static unsigned int frameEventsBegin;
+	static unsigned int frameEventsEnd;
+
+	static long long Now();
+	static ProfileThreadBuffer* GetThreadBuffer();
+	static void CopyEvents(const ProfileThreadBuffer* buffer, unsigned int begin, unsigned int end, std::vector<ProfileEvent>* events);
+};
+
+// --------------------------------------------------------
+// Times its own lifetime
+// --------------------------------------------------------
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name)
+	{
+		this->name = name;
+		start = Profiler::IsEnabled() ? Profiler::BeginScope() : -1;
+	}
+
+	~ProfileScope()
+	{
+		if (start >= 0)
+			Profiler::EndScope(name, start);
+	}
+
+private:
+	const char* name;
+	long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
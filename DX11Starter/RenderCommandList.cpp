@@ -0,0 +1,300 @@
+#include "RenderCommandList.h"
+
+RenderCommandList::RenderCommandList()
+{
+}
+
+// --------------------------------------------------------
+// Drops the last recording and starts a new one - the
+// arrays keep their memory, so steady frames don't allocate
+// --------------------------------------------------------
+IRenderDevice* RenderCommandList::Begin()
+{
+	calls.clear();
+	objects.clear();
+	bytes.clear();
+	return this;
+}
+
+void RenderCommandList::Record(CallType type, unsigned int a, unsigned int b, unsigned int c, unsigned int d, unsigned int e)
+{
+	Call call;
+	call.Type = type;
+	call.Args[0] = a;
+	call.Args[1] = b;
+	call.Args[2] = c;
+	call.Args[3] = d;
+	call.Args[4] = e;
+	call.FirstObject = (unsigned int)objects.size();
+	call.FirstByte = (unsigned int)bytes.size();
+	calls.push_back(call);
+}
+
+void RenderCommandList::AddBytes(const void* data, unsigned int size)
+{
+	const unsigned char* start = (const unsigned char*)data;
+	bytes.insert(bytes.end(), start, start + size);
+}
+
+// Null arrays go in as zeros, so what follows is still in place
+void RenderCommandList::AddValues(const unsigned int* values, unsigned int count)
+{
+	if (values)
+	{
+		AddBytes(values, count * sizeof(unsigned int));
+		return;
+	}
+	bytes.insert(bytes.end(), count * sizeof(unsigned int), 0);
+}
+
+// --------------------------------------------------------
+// Makes every recorded call on target, in order
+// --------------------------------------------------------
+void RenderCommandList::Execute(IRenderDevice* target)
+{
+	for (const Call& c : calls)
+	{
+		const unsigned int* a = c.Args;
+		const unsigned int* values = (const unsigned int*)Bytes(c);
+		switch (c.Type)
+		{
+		case CALL_INPUT_LAYOUT: target->IASetInputLayout(*Objects<ID3D11InputLayout>(c)); break;
+		case CALL_TOPOLOGY: target->IASetPrimitiveTopology(a[0]); break;
+		case CALL_VERTEX_BUFFERS: target->IASetVertexBuffers(a[0], a[1], Objects<ID3D11Buffer>(c), values, values + a[1]); break;
+		case CALL_INDEX_BUFFER: target->IASetIndexBuffer(*Objects<ID3D11Buffer>(c), a[0], a[1]); break;
+
+		case CALL_VS_SHADER: target->VSSetShader(*Objects<ID3D11VertexShader>(c)); break;
+		case CALL_VS_CONSTANT_BUFFERS: target->VSSetConstantBuffers(a[0], a[1], Objects<ID3D11Buffer>(c)); break;
+		case CALL_VS_CONSTANT_BUFFERS1: target->VSSetConstantBuffers1(a[0], a[1], Objects<ID3D11Buffer>(c), a[2] ? values : 0, a[3] ? values + a[1] : 0); break;
+		case CALL_VS_SHADER_RESOURCES: target->VSSetShaderResources(a[0], a[1], Objects<ID3D11ShaderResourceView>(c)); break;
+		case CALL_VS_SAMPLERS: target->VSSetSamplers(a[0], a[1], Objects<ID3D11SamplerState>(c)); break;
+
+		case CALL_PS_SHADER: target->PSSetShader(*Objects<ID3D11PixelShader>(c)); break;
+		case CALL_PS_CONSTANT_BUFFERS: target->PSSetConstantBuffers(a[0], a[1], Objects<ID3D11Buffer>(c)); break;
+		case CALL_PS_CONSTANT_BUFFERS1: target->PSSetConstantBuffers1(a[0], a[1], Objects<ID3D11Buffer>(c), a[2] ? values : 0, a[3] ? values + a[1] : 0); break;
+		case CALL_PS_SHADER_RESOURCES: target->PSSetShaderResources(a[0], a[1], Objects<ID3D11ShaderResourceView>(c)); break;
+		case CALL_PS_SAMPLERS: target->PSSetSamplers(a[0], a[1], Objects<ID3D11SamplerState>(c)); break;
+
+		case CALL_RASTERIZER_STATE: target->RSSetState(*Objects<ID3D11RasterizerState>(c)); break;
+		case CALL_VIEWPORTS: target->RSSetViewports(a[0], (const RenderViewport*)Bytes(c)); break;
+		case CALL_DEPTH_STENCIL_STATE: target->OMSetDepthStencilState(*Objects<ID3D11DepthStencilState>(c), a[0]); break;
+		case CALL_BLEND_STATE: target->OMSetBlendState(*Objects<ID3D11BlendState>(c), a[1] ? (const float*)Bytes(c) : 0, a[0]); break;
+		case CALL_RENDER_TARGETS: target->OMSetRenderTargets(a[0], Objects<ID3D11RenderTargetView>(c), *Objects<ID3D11DepthStencilView>(c, a[0])); break;
+
+		case CALL_UPDATE_BUFFER: target->UpdateBuffer(*Objects<ID3D11Buffer>(c), Bytes(c), a[0]); break;
+		case CALL_UPDATE_BUFFER_RANGE: target->UpdateBufferRange(*Objects<ID3D11Buffer>(c), Bytes(c), a[0], a[1]); break;
+		case CALL_WRITE_BUFFER: target->WriteBuffer(*Objects<ID3D11Buffer>(c), a[0], Bytes(c), a[1], a[2] != 0); break;
+
+		case CALL_CLEAR_RENDER_TARGET: target->ClearRenderTargetView(*Objects<ID3D11RenderTargetView>(c), (const float*)Bytes(c)); break;
+		case CALL_CLEAR_DEPTH_STENCIL: target->ClearDepthStencilView(*Objects<ID3D11DepthStencilView>(c), a[0], *(const float*)Bytes(c), (unsigned char)a[1]); break;
+
+		case CALL_DRAW: target->Draw(a[0], a[1]); break;
+		case CALL_DRAW_INDEXED: target->DrawIndexed(a[0], a[1], (int)a[2]); break;
+		case CALL_DRAW_INDEXED_INSTANCED: target->DrawIndexedInstanced(a[0], a[1], a[2], (int)a[3], a[4]); break;
+		case CALL_GENERATE_MIPS: target->GenerateMips(*Objects<ID3D11ShaderResourceView>(c)); break;
+		case CALL_FLUSH: target->Flush(); break;
+		}
+	}
+}
+
+
+// ------ INPUT ASSEMBLER ---------------------------------
+
+void RenderCommandList::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	Record(CALL_INPUT_LAYOUT);
+	AddObjects(&inputLayout, 1);
+}
+
+void RenderCommandList::IASetPrimitiveTopology(unsigned int topology)
+{
+	Record(CALL_TOPOLOGY, topology);
+}
+
+void RenderCommandList::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	Record(CALL_VERTEX_BUFFERS, startSlot, numBuffers);
+	AddObjects(buffers, numBuffers);
+	AddBytes(strides, numBuffers * sizeof(unsigned int));
+	AddBytes(offsets, numBuffers * sizeof(unsigned int));
+}
+
+void RenderCommandList::IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+	Record(CALL_INDEX_BUFFER, format, offset);
+	AddObjects(&buffer, 1);
+}
+
+
+// ------ SHADER STAGES -----------------------------------
+
+void RenderCommandList::VSSetShader(ID3D11VertexShader* shader)
+{
+	Record(CALL_VS_SHADER);
+	AddObjects(&shader, 1);
+}
+
+void RenderCommandList::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	Record(CALL_VS_CONSTANT_BUFFERS, startSlot, numBuffers);
+	AddObjects(buffers, numBuffers);
+}
+
+void RenderCommandList::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	// Either array can be null, so Args[2] and [3] say which
+	// were really there
+	Record(CALL_VS_CONSTANT_BUFFERS1, startSlot, numBuffers, firstConstants != 0, numConstants != 0);
+	AddObjects(buffers, numBuffers);
+	AddValues(firstConstants, numBuffers);
+	AddValues(numConstants, numBuffers);
+}
+
+void RenderCommandList::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	Record(CALL_VS_SHADER_RESOURCES, startSlot, numViews);
+	AddObjects(views, numViews);
+}
+
+void RenderCommandList::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Record(CALL_VS_SAMPLERS, startSlot, numSamplers);
+	AddObjects(samplers, numSamplers);
+}
+
+void RenderCommandList::PSSetShader(ID3D11PixelShader* shader)
+{
+	Record(CALL_PS_SHADER);
+	AddObjects(&shader, 1);
+}
+
+void RenderCommandList::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	Record(CALL_PS_CONSTANT_BUFFERS, startSlot, numBuffers);
+	AddObjects(buffers, numBuffers);
+}
+
+void RenderCommandList::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	Record(CALL_PS_CONSTANT_BUFFERS1, startSlot, numBuffers, firstConstants != 0, numConstants != 0);
+	AddObjects(buffers, numBuffers);
+	AddValues(firstConstants, numBuffers);
+	AddValues(numConstants, numBuffers);
+}
+
+void RenderCommandList::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	Record(CALL_PS_SHADER_RESOURCES, startSlot, numViews);
+	AddObjects(views, numViews);
+}
+
+void RenderCommandList::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Record(CALL_PS_SAMPLERS, startSlot, numSamplers);
+	AddObjects(samplers, numSamplers);
+}
+
+
+// ------ RASTERIZER AND OUTPUT MERGER --------------------
+
+void RenderCommandList::RSSetState(ID3D11RasterizerState* state)
+{
+	Record(CALL_RASTERIZER_STATE);
+	AddObjects(&state, 1);
+}
+
+void RenderCommandList::RSSetViewports(unsigned int numViewports, const RenderViewport* viewports)
+{
+	Record(CALL_VIEWPORTS, numViewports);
+	AddBytes(viewports, numViewports * sizeof(RenderViewport));
+}
+
+void RenderCommandList::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	Record(CALL_DEPTH_STENCIL_STATE, stencilRef);
+	AddObjects(&state, 1);
+}
+
+void RenderCommandList::OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+	Record(CALL_BLEND_STATE, sampleMask, blendFactor != 0);
+	AddObjects(&state, 1);
+	if (blendFactor)
+		AddBytes(blendFactor, 4 * sizeof(float));
+}
+
+void RenderCommandList::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil)
+{
+	// Targets, then the depth stencil after them
+	Record(CALL_RENDER_TARGETS, numViews);
+	AddObjects(renderTargets, numViews);
+	AddObjects(&depthStencil, 1);
+}
+
+
+// ------ UPLOADS -----------------------------------------
+
+void RenderCommandList::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	Record(CALL_UPDATE_BUFFER, size);
+	AddObjects(&buffer, 1);
+	AddBytes(data, size);
+}
+
+void RenderCommandList::UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end)
+{
+	Record(CALL_UPDATE_BUFFER_RANGE, start, end);
+	AddObjects(&buffer, 1);
+	AddBytes(data, end - start);
+}
+
+bool RenderCommandList::WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard)
+{
+	Record(CALL_WRITE_BUFFER, offset, size, discard);
+	AddObjects(&buffer, 1);
+	AddBytes(data, size);
+	return true;
+}
+
+
+// ------ CLEARS, DRAWING AND MISC ------------------------
+
+void RenderCommandList::ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4])
+{
+	Record(CALL_CLEAR_RENDER_TARGET);
+	AddObjects(&renderTarget, 1);
+	AddBytes(color, 4 * sizeof(float));
+}
+
+void RenderCommandList::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil)
+{
+	Record(CALL_CLEAR_DEPTH_STENCIL, clearFlags, stencil);
+	AddObjects(&depthStencil, 1);
+	AddBytes(&depth, sizeof(float));
+}
+
+void RenderCommandList::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Record(CALL_DRAW, vertexCount, startVertex);
+}
+
+void RenderCommandList::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Record(CALL_DRAW_INDEXED, indexCount, startIndex, (unsigned int)baseVertex);
+}
+
+void RenderCommandList::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Record(CALL_DRAW_INDEXED_INSTANCED, indexCount, instanceCount, startIndex, (unsigned int)baseVertex, startInstance);
+}
+
+void RenderCommandList::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	Record(CALL_GENERATE_MIPS);
+	AddObjects(&view, 1);
+}
+
+void RenderCommandList::Flush()
+{
+	Record(CALL_FLUSH);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Command list that works with any backend - it keeps every
+// call made through it, with its arrays and upload data
+// copied, and makes the same calls on the target device
+// when executed.
+//
+// Playback goes through the target like any other caller,
+// so lists executed one after another through a state cache
+// come out exactly as if the calls had been made directly.
+// Since nothing reaches a device until then, WriteBuffer()
+// always reports success.
+// --------------------------------------------------------
+class RenderCommandList : public IRenderDevice, public IRenderCommandList
+{
+public:
+	RenderCommandList();
+
+	// IRenderCommandList
+	IRenderDevice* Begin();
+	void Finish() {}
+	void Execute(IRenderDevice* target);
+	bool StartsBlank() { return false; }
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer and output merger
+	void RSSetState(ID3D11RasterizerState* state);
+	void RSSetViewports(unsigned int numViewports, const RenderViewport* viewports);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil);
+
+	// Uploads
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end);
+	bool WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard);
+
+	// Clears
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil);
+
+	// Drawing and misc
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void GenerateMips(ID3D11ShaderResourceView* view);
+	void Flush();
+
+	unsigned int GetCallCount() { return (unsigned int)calls.size(); }
+
+private:
+	enum CallType : unsigned char
+	{
+		CALL_INPUT_LAYOUT,
+		CALL_TOPOLOGY,
+		CALL_VERTEX_BUFFERS,
+		CALL_INDEX_BUFFER,
+		CALL_VS_SHADER,
+		CALL_VS_CONSTANT_BUFFERS,
+		CALL_VS_CONSTANT_BUFFERS1,
+		CALL_VS_SHADER_RESOURCES,
+		CALL_VS_SAMPLERS,
+		CALL_PS_SHADER,
+		CALL_PS_CONSTANT_BUFFERS,
+		CALL_PS_CONSTANT_BUFFERS1,
+		CALL_PS_SHADER_RESOURCES,
+		CALL_PS_SAMPLERS,
+		CALL_RASTERIZER_STATE,
+		CALL_VIEWPORTS,
+		CALL_DEPTH_STENCIL_STATE,
+		CALL_BLEND_STATE,
+		CALL_RENDER_TARGETS,
+		CALL_UPDATE_BUFFER,
+		CALL_UPDATE_BUFFER_RANGE,
+		CALL_WRITE_BUFFER,
+		CALL_CLEAR_RENDER_TARGET,
+		CALL_CLEAR_DEPTH_STENCIL,
+		CALL_DRAW,
+		CALL_DRAW_INDEXED,
+		CALL_DRAW_INDEXED_INSTANCED,
+		CALL_GENERATE_MIPS,
+		CALL_FLUSH
+	};
+
+	// One call - its plain arguments, plus where its pointer
+	// arrays and copied bytes start in the shared arrays
+	struct Call
+	{
+		CallType Type;
+		unsigned int Args[5];
+		unsigned int FirstObject;
+		unsigned int FirstByte;
+	};
+
+	std::vector<Call> calls;
+	std::vector<void*> objects;
+	std::vector<unsigned char> bytes;
+
+	// Starts a call - its pointers and bytes are added after
+	void Record(CallType type, unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0, unsigned int e = 0);
+	void AddBytes(const void* data, unsigned int size);
+	void AddValues(const unsigned int* values, unsigned int count);
+
+	template<typename T>
+	void AddObjects(T* const* list, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			objects.push_back((void*)list[i]);
+	}
+
+	template<typename T>
+	T* const* Objects(const Call& call, unsigned int offset = 0) { return (T* const*)(objects.data() + call.FirstObject + offset); }
+	const void* Bytes(const Call& call, unsigned int offset = 0) { return bytes.data() + call.FirstByte + offset; }
+};
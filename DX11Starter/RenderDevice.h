@@ -0,0 +1,115 @@
+#pragma once
+
+// D3D objects are only ever passed through by pointer, so
+// backends that never touch D3D (like the null backend) can
+// use this interface without the Windows SDK
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RasterizerState;
+struct ID3D11DepthStencilState;
+struct ID3D11BlendState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+// --------------------------------------------------------
+// Same layout as D3D11_VIEWPORT
+// --------------------------------------------------------
+struct RenderViewport
+{
+	float TopLeftX;
+	float TopLeftY;
+	float Width;
+	float Height;
+	float MinDepth;
+	float MaxDepth;
+};
+
+// --------------------------------------------------------
+// Everything the renderer asks of the device context while
+// drawing a frame: binds, buffer uploads, clears and draws.
+//
+// Calls mirror their ID3D11DeviceContext counterparts.
+// Topologies and formats are the D3D enum values passed as
+// plain integers, and depth/stencil clear flags are the
+// D3D11_CLEAR_* bits.
+// --------------------------------------------------------
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	// Input assembler
+	virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+	virtual void IASetPrimitiveTopology(unsigned int topology) = 0;
+	virtual void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset) = 0;
+
+	// Vertex shader stage
+	virtual void VSSetShader(ID3D11VertexShader* shader) = 0;
+	virtual void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) = 0;
+	virtual void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Pixel shader stage
+	virtual void PSSetShader(ID3D11PixelShader* shader) = 0;
+	virtual void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) = 0;
+	virtual void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Rasterizer and output merger
+	virtual void RSSetState(ID3D11RasterizerState* state) = 0;
+	virtual void RSSetViewports(unsigned int numViewports, const RenderViewport* viewports) = 0;
+	virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) = 0;
+	virtual void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask) = 0;
+	virtual void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil) = 0;
+
+	// Uploads - UpdateBuffer replaces a whole default usage buffer,
+	// UpdateBufferRange just bytes [start, end) of one (11.1), and
+	// WriteBuffer maps a dynamic buffer with DISCARD or NO_OVERWRITE
+	virtual void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+	virtual void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end) = 0;
+	virtual bool WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard) = 0;
+
+	// Clears
+	virtual void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4]) = 0;
+	virtual void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil) = 0;
+
+	// Drawing and misc
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+	virtual void GenerateMips(ID3D11ShaderResourceView* view) = 0;
+	virtual void Flush() = 0;
+};
+
+// --------------------------------------------------------
+// Render calls recorded on one thread, to be played back
+// later and in order on the thread that owns the device.
+//
+// Record through the device Begin() hands back, and call
+// Finish() from the same thread once done.  Lists that
+// StartBlank() (like D3D deferred contexts) can't see any
+// state bound on the main device, so everything they rely
+// on has to be recorded into them first.
+// --------------------------------------------------------
+class IRenderCommandList
+{
+public:
+	virtual ~IRenderCommandList() {}
+
+	virtual IRenderDevice* Begin() = 0;
+	virtual void Finish() = 0;
+
+	// Plays the list back through target.  Native lists skip
+	// target and go straight to its context, leaving that
+	// context's state as it was.
+	virtual void Execute(IRenderDevice* target) = 0;
+
+	virtual bool StartsBlank() = 0;
+};
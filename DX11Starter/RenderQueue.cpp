@@ -0,0 +1,101 @@
+#include "RenderQueue.h"
+
+#include <string.h>
+#include <utility>
+
+// --------------------------------------------------------
+// Constructor - empty until Begin()
+// --------------------------------------------------------
+RenderQueue::RenderQueue()
+{
+	entries = 0;
+	scratch = 0;
+	count = 0;
+	capacity = 0;
+}
+
+// --------------------------------------------------------
+// Builds a sort key from its fields
+// --------------------------------------------------------
+unsigned long long RenderQueue::MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth)
+{
+	// Quantize depth, clamping anything outside the frustum
+	if (depth < 0.0f) depth = 0.0f;
+	if (depth > 1.0f) depth = 1.0f;
+	unsigned int depthBucket = (unsigned int)(depth * 65535.0f);
+
+	return
+		((unsigned long long)(pass & 0xF) << 60) |
+		((unsigned long long)(shader & 0xFFF) << 48) |
+		((unsigned long long)(material & 0xFFFF) << 32) |
+		((unsigned long long)(mesh & 0xFFFF) << 16) |
+		(unsigned long long)depthBucket;
+}
+
+// --------------------------------------------------------
+// Empties the queue for the next frame, taking both buffers
+// from the frame's arena
+// --------------------------------------------------------
+void RenderQueue::Begin(FrameArena* arena, unsigned int capacity)
+{
+	entries = arena->AllocateArray<RenderQueueEntry>(capacity);
+	scratch = arena->AllocateArray<RenderQueueEntry>(capacity);
+	count = 0;
+	this->capacity = capacity;
+}
+
+// --------------------------------------------------------
+// Queues a draw
+// --------------------------------------------------------
+void RenderQueue::Add(unsigned long long key, unsigned int payload)
+{
+	if (count == capacity)
+		return;
+
+	entries[count].Key = key;
+	entries[count].Payload = payload;
+	count++;
+}
+
+// --------------------------------------------------------
+// Sorts the queue by key with an LSD radix sort, one byte
+// per pass.  All eight histograms are built in a single read
+// of the keys, and passes where every key has the same byte
+// (usually the pass and shader bits) are skipped entirely.
+// The sort is stable, so equal keys keep their queued order.
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	if (count < 2)
+		return;
+
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (unsigned int b = 0; b < 8; b++)
+			histograms[b][(entries[i].Key >> (b * 8)) & 0xFF]++;
+	}
+
+	for (unsigned int b = 0; b < 8; b++)
+	{
+		// Nothing to do if this byte is the same for every key
+		size_t* histogram = histograms[b];
+		if (histogram[(entries[0].Key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		// Turn counts into starting offsets
+		size_t offset = 0;
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			size_t bucketCount = histogram[i];
+			histogram[i] = offset;
+			offset += bucketCount;
+		}
+
+		// Scatter into the other buffer and swap
+		for (unsigned int i = 0; i < count; i++)
+			scratch[histogram[(entries[i].Key >> (b * 8)) & 0xFF]++] = entries[i];
+		std::swap(entries, scratch);
+	}
+}
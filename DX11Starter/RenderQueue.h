@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FrameArena.h"
+
+// --------------------------------------------------------
+// A queued draw - the sort key plus an index into whatever
+// array the caller keeps its per-draw data in
+// --------------------------------------------------------
+struct RenderQueueEntry
+{
+	unsigned long long Key;
+	unsigned int Payload;
+};
+
+// --------------------------------------------------------
+// Collects a frame's draws and sorts them by a 64-bit key so
+// draws sharing state end up next to each other.  Keys are,
+// from the most significant bits down:
+//
+//   pass (4) | shader (12) | material (16) | mesh (16) | depth (16)
+//
+// so within a shader and material, meshes are grouped and
+// then drawn front to back.
+//
+// Entries live in a frame arena, so the queue is only good
+// until that arena is reset.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Packs the key fields (each is masked to its width, depth
+	// is expected to be 0 at the camera and 1 at the far plane)
+	static unsigned long long MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth);
+
+	// Building and sorting - Begin() empties the queue, with
+	// room for capacity draws (any more are dropped)
+	void Begin(FrameArena* arena, unsigned int capacity);
+	void Add(unsigned long long key, unsigned int payload);
+	void Sort();
+
+	// Getters
+	unsigned int GetCount() { return count; }
+	const RenderQueueEntry* GetEntries() { return entries; }
+
+private:
+	RenderQueueEntry* entries;
+	RenderQueueEntry* scratch;	// Ping-pong buffer for the sort
+	unsigned int count;
+	unsigned int capacity;
+};
@@ -0,0 +1,82 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+SceneGraph::SceneGraph()
+{
+	firstChanged = 0;
+}
+
+unsigned int SceneGraph::AddNode(int parent, const XMFLOAT4X4& local)
+{
+	unsigned int node = (unsigned int)parents.size();
+	if (parent >= (int)node)
+		parent = NoParent;
+
+	parents.push_back(parent);
+	localTransforms.push_back(local);
+	worldTransforms.push_back(local);
+	changed.push_back(0);
+	MarkChanged(node);
+	return node;
+}
+
+void SceneGraph::Clear()
+{
+	parents.clear();
+	localTransforms.clear();
+	worldTransforms.clear();
+	changed.clear();
+	firstChanged = 0;
+}
+
+void SceneGraph::Reserve(unsigned int capacity)
+{
+	parents.reserve(capacity);
+	localTransforms.reserve(capacity);
+	worldTransforms.reserve(capacity);
+	changed.reserve(capacity);
+}
+
+void SceneGraph::SetLocalTransform(unsigned int node, const XMFLOAT4X4& local)
+{
+	localTransforms[node] = local;
+	MarkChanged(node);
+}
+
+void SceneGraph::MarkChanged(unsigned int node)
+{
+	changed[node] = 1;
+	firstChanged = std::min(firstChanged, node);
+}
+
+unsigned int SceneGraph::Update()
+{
+	unsigned int count = (unsigned int)parents.size();
+	if (firstChanged >= count)
+		return 0;
+
+	unsigned int recomputed = 0;
+	for (unsigned int i = firstChanged; i < count; i++)
+	{
+		int parent = parents[i];
+		if (parent != NoParent && changed[parent])
+			changed[i] = 1;
+		if (!changed[i])
+			continue;
+
+		if (parent == NoParent)
+			worldTransforms[i] = localTransforms[i];
+		else
+			XMStoreFloat4x4(&worldTransforms[i], XMMatrixMultiply(
+				XMLoadFloat4x4(&localTransforms[i]),
+				XMLoadFloat4x4(&worldTransforms[parent])));
+		recomputed++;
+	}
+
+	std::fill(changed.begin() + firstChanged, changed.end(), 0);
+	firstChanged = count;
+	return recomputed;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Hierarchy of local transforms, flattened into arrays.
+//
+// Nodes are stored parents first, so world transforms can be
+// propagated with one linear pass: each node only needs its
+// parent's world transform, which is always already done.
+// Changing a node flags it, and Update() starts at the first
+// flagged node and only multiplies nodes that are flagged or
+// whose parent changed - so clean subtrees cost one byte
+// test per node.
+//
+// Matrices are row-vector style (not transposed), and a
+// node's world transform is local * parent's world.
+// --------------------------------------------------------
+class SceneGraph
+{
+public:
+	static const int NoParent = -1;
+
+	SceneGraph();
+
+	// Parents must be added before their children.  Returns
+	// the new node's index.
+	unsigned int AddNode(int parent, const DirectX::XMFLOAT4X4& local);
+	void Clear();
+	void Reserve(unsigned int capacity);
+
+	void SetLocalTransform(unsigned int node, const DirectX::XMFLOAT4X4& local);
+
+	// Recomputes the world transforms of changed nodes and
+	// their descendants, and returns how many were recomputed
+	unsigned int Update();
+
+	// Getters
+	int GetParent(unsigned int node) { return parents[node]; }
+	const DirectX::XMFLOAT4X4& GetLocalTransform(unsigned int node) { return localTransforms[node]; }
+	const DirectX::XMFLOAT4X4& GetWorldTransform(unsigned int node) { return worldTransforms[node]; }
+	unsigned int GetNodeCount() { return (unsigned int)parents.size(); }
+
+private:
+	std::vector<int> parents;
+	std::vector<DirectX::XMFLOAT4X4> localTransforms;
+	std::vector<DirectX::XMFLOAT4X4> worldTransforms;
+
+	// Set on changed nodes, and on their descendants during
+	// Update() so the change reaches the whole subtree
+	std::vector<unsigned char> changed;
+	unsigned int firstChanged;
+
+	void MarkChanged(unsigned int node);
+};
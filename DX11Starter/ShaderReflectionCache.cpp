@@ -0,0 +1,204 @@
+#include "ShaderReflectionCache.h"
+
+#include <fstream>
+
+// File layout (all little endian):
+//   "SRFL", version, blob hash
+//   buffer count, then per buffer: name, size, bind index,
+//     variable count, then per variable: name, offset, size
+//   texture count, then per texture: name, bind index
+//   sampler count, then per sampler: name, bind index
+// Strings are a 16-bit length followed by the characters.
+static const unsigned int ReflectionFileMagic = 0x4C465253; // "SRFL"
+static const unsigned int ReflectionFileVersion = 1;
+
+// Anything bigger than this is a damaged file, not a real shader
+static const unsigned int MaxReflectedEntries = 1024;
+
+// D3D 11's register counts and largest constant buffer, so
+// the tables built from a sidecar can be trusted as if they
+// came from D3D itself
+static const unsigned int MaxConstantBufferSlots = 14;
+static const unsigned int MaxTextureSlots = 128;
+static const unsigned int MaxSamplerSlots = 16;
+static const unsigned int MaxConstantBufferSize = 4096 * 16;
+
+// --------------------------------------------------------
+// Small helpers for reading and writing the pieces above
+// --------------------------------------------------------
+template<typename T>
+static void Write(std::ofstream& file, T value)
+{
+	file.write((const char*)&value, sizeof(T));
+}
+
+static void WriteString(std::ofstream& file, const std::string& str)
+{
+	Write(file, (unsigned short)str.size());
+	file.write(str.data(), str.size());
+}
+
+template<typename T>
+static bool Read(std::ifstream& file, T* value)
+{
+	file.read((char*)value, sizeof(T));
+	return file.good();
+}
+
+static bool ReadString(std::ifstream& file, std::string* str)
+{
+	unsigned short length;
+	if (!Read(file, &length)) return false;
+
+	str->resize(length);
+	if (length > 0) file.read(&(*str)[0], length);
+	return file.good();
+}
+
+static bool ReadResources(std::ifstream& file, std::vector<ReflectedResource>* resources, unsigned int slots)
+{
+	unsigned int count;
+	if (!Read(file, &count) || count > MaxReflectedEntries) return false;
+
+	resources->resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!ReadString(file, &(*resources)[i].Name) ||
+			!Read(file, &(*resources)[i].BindIndex) ||
+			(*resources)[i].BindIndex >= slots)
+			return false;
+	}
+	return true;
+}
+
+static void WriteResources(std::ofstream& file, const std::vector<ReflectedResource>& resources)
+{
+	Write(file, (unsigned int)resources.size());
+	for (const ReflectedResource& r : resources)
+	{
+		WriteString(file, r.Name);
+		Write(file, r.BindIndex);
+	}
+}
+
+// --------------------------------------------------------
+// 64-bit FNV-1a hash of a compiled shader blob
+// --------------------------------------------------------
+unsigned long long ShaderReflectionCache::HashBlob(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Loads a reflection sidecar file
+//
+// path     - The sidecar to read
+// blobHash - Hash of the shader blob we want data for
+// data     - Filled in with the cached reflection data
+//
+// Returns false if the file is missing, damaged, from an
+// older version or made from a different blob, or holds
+// offsets or registers D3D would never report, leaving data
+// empty rather than partly filled
+// --------------------------------------------------------
+bool ShaderReflectionCache::Load(const std::string& path, unsigned long long blobHash, ShaderReflectionData* data)
+{
+	*data = ShaderReflectionData();
+	if (LoadEntries(path, blobHash, data))
+		return true;
+
+	*data = ShaderReflectionData();
+	return false;
+}
+
+// --------------------------------------------------------
+// Reads a sidecar into data, stopping at the first problem
+// --------------------------------------------------------
+bool ShaderReflectionCache::LoadEntries(const std::string& path, unsigned long long blobHash, ShaderReflectionData* data)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	// Check the header before anything else
+	unsigned int magic, version;
+	if (!Read(file, &magic) || magic != ReflectionFileMagic) return false;
+	if (!Read(file, &version) || version != ReflectionFileVersion) return false;
+	if (!Read(file, &data->BlobHash) || data->BlobHash != blobHash) return false;
+
+	// Constant buffers and their variables
+	unsigned int bufferCount;
+	if (!Read(file, &bufferCount) || bufferCount > MaxReflectedEntries) return false;
+	data->ConstantBuffers.resize(bufferCount);
+	for (ReflectedConstantBuffer& cb : data->ConstantBuffers)
+	{
+		unsigned int varCount;
+		if (!ReadString(file, &cb.Name) ||
+			!Read(file, &cb.Size) ||
+			!Read(file, &cb.BindIndex) ||
+			!Read(file, &varCount) ||
+			cb.Size > MaxConstantBufferSize ||
+			cb.BindIndex >= MaxConstantBufferSlots ||
+			varCount > MaxReflectedEntries)
+			return false;
+
+		cb.Variables.resize(varCount);
+		for (ReflectedVariable& var : cb.Variables)
+		{
+			// Variables are written straight into a buffer of
+			// cb.Size bytes, so they have to fit inside it
+			if (!ReadString(file, &var.Name) ||
+				!Read(file, &var.ByteOffset) ||
+				!Read(file, &var.Size) ||
+				var.ByteOffset > cb.Size ||
+				var.Size > cb.Size - var.ByteOffset)
+				return false;
+		}
+	}
+
+	// Textures and samplers
+	return
+		ReadResources(file, &data->Textures, MaxTextureSlots) &&
+		ReadResources(file, &data->Samplers, MaxSamplerSlots);
+}
+
+// --------------------------------------------------------
+// Saves reflection data to a sidecar file
+//
+// Returns false if the file couldn't be written
+// --------------------------------------------------------
+bool ShaderReflectionCache::Save(const std::string& path, const ShaderReflectionData& data)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	Write(file, ReflectionFileMagic);
+	Write(file, ReflectionFileVersion);
+	Write(file, data.BlobHash);
+
+	Write(file, (unsigned int)data.ConstantBuffers.size());
+	for (const ReflectedConstantBuffer& cb : data.ConstantBuffers)
+	{
+		WriteString(file, cb.Name);
+		Write(file, cb.Size);
+		Write(file, cb.BindIndex);
+		Write(file, (unsigned int)cb.Variables.size());
+		for (const ReflectedVariable& var : cb.Variables)
+		{
+			WriteString(file, var.Name);
+			Write(file, var.ByteOffset);
+			Write(file, var.Size);
+		}
+	}
+
+	WriteResources(file, data.Textures);
+	WriteResources(file, data.Samplers);
+
+	return file.good();
+}
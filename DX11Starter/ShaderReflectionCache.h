@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from shader reflection,
+// in plain data so it can be saved next to the compiled
+// shader and loaded back without touching D3D at all
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Size;
+	unsigned int BindIndex;
+	std::vector<ReflectedVariable> Variables;
+};
+
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex;
+};
+
+struct ShaderReflectionData
+{
+	unsigned long long BlobHash;	// Hash of the compiled shader this describes
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> Textures;
+	std::vector<ReflectedResource> Samplers;
+};
+
+// --------------------------------------------------------
+// Reads and writes reflection sidecar files.  A sidecar is
+// only used if it was made from a blob with the same hash,
+// so a recompiled shader automatically misses the cache.
+// --------------------------------------------------------
+class ShaderReflectionCache
+{
+public:
+	static unsigned long long HashBlob(const void* data, size_t size);
+
+	static bool Load(const std::string& path, unsigned long long blobHash, ShaderReflectionData* data);
+	static bool Save(const std::string& path, const ShaderReflectionData& data);
+
+private:
+	static bool LoadEntries(const std::string& path, unsigned long long blobHash, ShaderReflectionData* data);
+};
@@ -1,5 +1,16 @@
 #include "SimpleShader.h"
 
+#include <atomic>
+
+// Define the static upload counters shared by all shaders
+SimpleShaderUploadStats ISimpleShader::frameStats = {};
+unsigned int ISimpleShader::frameIndex = 1;
+bool ISimpleShader::uploadEverything = false;
+IRenderDevice* ISimpleShader::renderDevice = 0;
+
+// Next id to hand out, shared by every kind of shader
+static std::atomic<unsigned int> nextId(0);
+
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
@@ -12,11 +23,25 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	// Save the device
 	this->device = device;
 	this->deviceContext = context;
+	id = nextId.fetch_add(1);
 
 	// Set up fields
 	constantBufferCount = 0;
 	constantBuffers = 0;
 	shaderBlob = 0;
+
+	// Partial constant buffer updates require an 11.1 context
+	// and driver support - fall back to whole-buffer copies otherwise
+	deviceContext1 = 0;
+	partialUpdates = false;
+	uploadRing = 0;
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferPartialUpdate &&
+		SUCCEEDED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&deviceContext1)))
+	{
+		partialUpdates = true;
+	}
 }
 
 // --------------------------------------------------------
@@ -27,6 +52,9 @@ ISimpleShader::~ISimpleShader()
 	// Derived class destructors will call this class's CleanUp method
 	if(shaderBlob)
 		shaderBlob->Release();
+
+	if (deviceContext1)
+		deviceContext1->Release();
 }
 
 // --------------------------------------------------------
@@ -87,6 +115,52 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Reflection results are cached next to the compiled shader,
+	// keyed by the blob's hash so stale sidecars are ignored.  The
+	// cache opens files by narrow path, which the CRT treats as
+	// the ANSI code page, so a path that doesn't fit in it (with
+	// characters replaced) skips the cache rather than using the
+	// wrong file.
+	std::string cachePath;
+	BOOL lossyPath = FALSE;
+	int pathLength = WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, shaderFile, -1, 0, 0, 0, &lossyPath);
+	if (pathLength > 0 && !lossyPath)
+	{
+		cachePath.resize(pathLength);
+		WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, shaderFile, -1, &cachePath[0], pathLength, 0, 0);
+		cachePath.resize(pathLength - 1); // Drop the terminator
+		cachePath += ".refl";
+	}
+
+	ShaderReflectionData reflection;
+	unsigned long long blobHash = ShaderReflectionCache::HashBlob(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize());
+
+	if (cachePath.empty() || !ShaderReflectionCache::Load(cachePath, blobHash, &reflection))
+	{
+		// Cache miss, so ask D3D and save the results for next time.
+		// Start from nothing, as a damaged sidecar may have been
+		// partly read before it failed.
+		reflection = ShaderReflectionData();
+		ReflectShader(&reflection);
+		reflection.BlobHash = blobHash;
+		if (!cachePath.empty())
+			ShaderReflectionCache::Save(cachePath, reflection);
+	}
+
+	BuildTables(reflection);
+	return true;
+}
+
+// --------------------------------------------------------
+// Uses D3D shader reflection to gather info about this
+// shader's constant buffers, variables, SRVs and samplers
+//
+// data - Filled in with the results
+// --------------------------------------------------------
+void ISimpleShader::ReflectShader(ShaderReflectionData* data)
+{
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	ID3D11ShaderReflection* refl;
@@ -100,10 +174,6 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -112,37 +182,20 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
-		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
-			break;
-
-		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
-			break;
+		case D3D_SIT_TEXTURE: data->Textures.push_back(resource); break;
+		case D3D_SIT_SAMPLER: data->Samplers.push_back(resource); break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -156,16 +209,90 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
+
+		ReflectedConstantBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
+
+		// Loop through all variables in this buffer
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			// Get this variable
+			ID3D11ShaderReflectionVariable* var =
+				cb->GetVariableByIndex(v);
+			
+			// Get the description of the variable and its type
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			var->GetDesc(&varDesc);
+
+			ReflectedVariable variable;
+			variable.Name = varDesc.Name;
+			variable.ByteOffset = varDesc.StartOffset;
+			variable.Size = varDesc.Size;
+			buffer.Variables.push_back(variable);
+		}
+
+		data->ConstantBuffers.push_back(buffer);
+	}
+
+	// All set
+	refl->Release();
+}
+
+// --------------------------------------------------------
+// Builds the variable, buffer, SRV and sampler tables (and
+// creates the actual constant buffers) from reflection data
+// --------------------------------------------------------
+void ISimpleShader::BuildTables(const ShaderReflectionData& data)
+{
+	// Create resource arrays
+	constantBufferCount = (unsigned int)data.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Textures
+	for (const ReflectedResource& tex : data.Textures)
+	{
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = tex.BindIndex;							// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(tex.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	// Samplers
+	for (const ReflectedResource& sampler : data.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = sampler.BindIndex;				// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(sampler.Name, samp));
+		samplerStates.push_back(samp);
+	}
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& buffer = data.ConstantBuffers[b];
+
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		constantBuffers[b].BindIndex = buffer.BindIndex;
+		constantBuffers[b].Name = buffer.Name;
+		constantBuffers[b].Frequency = FrequencyFromName(buffer.Name);
+		constantBuffers[b].LastUploadFrame = 0;
+		constantBuffers[b].RingFirstConstant = 0;
+		constantBuffers[b].RingNumConstants = 0;
+		constantBuffers[b].RingFrame = 0;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(buffer.Name, &constantBuffers[b]));
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc;
 		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = bufferDesc.Size;
+		newBuffDesc.ByteWidth = buffer.Size;
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		newBuffDesc.CPUAccessFlags = 0;
 		newBuffDesc.MiscFlags = 0;
@@ -173,39 +300,27 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
 
 		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Size = buffer.Size;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[buffer.Size];
+		ZeroMemory(constantBuffers[b].LocalDataBuffer, buffer.Size);
+
+		// The GPU copy starts uninitialized, so the first copy sends everything
+		constantBuffers[b].Changes.MarkAll(buffer.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (const ReflectedVariable& var : buffer.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
 			// Create the variable struct
 			SimpleShaderVariable varStruct;
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			varStruct.ByteOffset = var.ByteOffset;
+			varStruct.Size = var.Size;
 
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(var.Name, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
-
-	// All set
-	refl->Release();
-	return true;
 }
 
 // --------------------------------------------------------
@@ -215,7 +330,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(const std::string& name, int size)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
@@ -239,7 +354,7 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
@@ -261,29 +376,141 @@ void ISimpleShader::SetShader()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
+	// Ring slices only live for a single frame, so anything
+	// left over from an earlier frame needs to go up again
+	if (uploadRing)
+	{
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+		{
+			if (constantBuffers[i].RingNumConstants > 0 &&
+				constantBuffers[i].RingFrame != uploadRing->GetFrame())
+				UploadBuffer(&constantBuffers[i]);
+		}
+	}
+
 	// Set the shader and any relevant constant buffers, which
 	// is an overloaded method in a subclass
 	SetShaderAndCBs();
 }
 
+// --------------------------------------------------------
+// Sends the dirty portion of a constant buffer to the GPU,
+// or skips the copy entirely if nothing has changed
+//
+// When the driver supports partial constant buffer updates,
+// only the 16-byte aligned dirty range is copied.  Otherwise
+// the whole buffer is copied, as D3D 11.0 requires.
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	// Comparing against uploading everything, every time?
+	if (uploadEverything)
+	{
+		cb->Changes.MarkAll(cb->Size);
+	}
+
+	// Using the shared ring?  Its slices only live for one frame
+	if (uploadRing)
+	{
+		if (!cb->Changes.IsDirty() && cb->RingNumConstants > 0 && cb->RingFrame == uploadRing->GetFrame())
+		{
+			frameStats.UploadsSkipped++;
+			return;
+		}
+
+		if (uploadRing->Upload(cb->LocalDataBuffer, cb->Size, &cb->RingFirstConstant, &cb->RingNumConstants))
+		{
+			cb->RingFrame = uploadRing->GetFrame();
+			FinishUpload(cb, cb->Size);
+			return;
+		}
+
+		// Out of ring space (or no 11.1 support), so fall back to
+		// our own buffer, which may be missing everything
+		frameStats.RingOverflows++;
+		if (cb->RingNumConstants > 0)
+		{
+			cb->RingNumConstants = 0;
+			cb->Changes.MarkAll(cb->Size);
+		}
+	}
+
+	// Anything changed since the last copy?
+	unsigned int start;
+	unsigned int end;
+	if (!cb->Changes.GetUploadRange(cb->Size, partialUpdates, &start, &end))
+	{
+		frameStats.UploadsSkipped++;
+		return;
+	}
+
+	unsigned int bytes = cb->Size;
+	if (start > 0 || end < cb->Size)
+	{
+		if (renderDevice)
+		{
+			renderDevice->UpdateBufferRange(cb->ConstantBuffer, cb->LocalDataBuffer + start, start, end);
+		}
+		else
+		{
+			D3D11_BOX box = {};
+			box.left = start;
+			box.right = end;
+			box.bottom = 1;
+			box.back = 1;
+			deviceContext1->UpdateSubresource1(
+				cb->ConstantBuffer, 0, &box,
+				cb->LocalDataBuffer + start, 0, 0, 0);
+		}
+		bytes = end - start;
+	}
+	else if (renderDevice)
+	{
+		renderDevice->UpdateBuffer(cb->ConstantBuffer, cb->LocalDataBuffer, cb->Size);
+	}
+	else
+	{
+		// Copy the entire local data buffer
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer, 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+	}
+	FinishUpload(cb, bytes);
+}
+
+// --------------------------------------------------------
+// Records an upload in the stats and marks the buffer clean
+// --------------------------------------------------------
+void ISimpleShader::FinishUpload(SimpleConstantBuffer* cb, unsigned int bytes)
+{
+	frameStats.BytesUploaded += bytes;
+	frameStats.FrequencyBytes[cb->Frequency] += bytes;
+	frameStats.UploadsIssued++;
+
+	// Per-frame data should only need to go up once
+	if (cb->Frequency == BUFFER_FREQUENCY_PER_FRAME && cb->LastUploadFrame == frameIndex)
+		frameStats.PerFrameReuploads++;
+	cb->LastUploadFrame = frameIndex;
+
+	// All caught up
+	cb->Changes.MarkClean();
+}
+
 // --------------------------------------------------------
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
 // buffer, use CopyBufferData()
+//
+// Buffers whose data hasn't changed are skipped
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any changes
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		UploadBuffer(&constantBuffers[i]);
 }
 
 // --------------------------------------------------------
@@ -311,9 +538,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -323,7 +548,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(const std::string& bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
@@ -333,9 +558,79 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Copies local data to all of the shader's constant buffers
+// with the given update frequency.  Lets the caller upload
+// per-frame buffers once and only per-object buffers per draw.
+// --------------------------------------------------------
+void ISimpleShader::CopyBuffersByFrequency(SimpleBufferFrequency frequency)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (uploadEverything || constantBuffers[i].Frequency == frequency)
+			UploadBuffer(&constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Clears the shared constant buffer traffic counters,
+// usually once at the start of each frame
+// --------------------------------------------------------
+void ISimpleShader::ResetFrameStats()
+{
+	frameStats = {};
+	frameIndex++;
+}
+
+void ISimpleShader::SetUploadEverything(bool enabled)
+{
+	uploadEverything = enabled;
+}
+
+// --------------------------------------------------------
+// Sets (or clears, with null) the render device that vertex
+// and pixel shaders bind and upload through.  Shared by all
+// shaders, since every call on the context goes through it.
+// --------------------------------------------------------
+void ISimpleShader::SetRenderDevice(IRenderDevice* device)
+{
+	renderDevice = device;
+}
+
+// --------------------------------------------------------
+// Sets (or clears, with null) the shared ring this shader's
+// constant data is uploaded into
+// --------------------------------------------------------
+void ISimpleShader::SetUploadRing(ConstantUploadRing* ring)
+{
+	uploadRing = (ring && ring->IsSupported()) ? ring : 0;
+
+	// Our own buffers haven't seen any of the data that went into
+	// the old ring, so they need a full copy on the next upload
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (constantBuffers[i].RingNumConstants == 0)
+			continue;
+
+		constantBuffers[i].RingNumConstants = 0;
+		constantBuffers[i].Changes.MarkAll(constantBuffers[i].Size);
+	}
+}
+
+// --------------------------------------------------------
+// Guesses a buffer's update frequency from its name
+// --------------------------------------------------------
+SimpleBufferFrequency ISimpleShader::FrequencyFromName(const std::string& name)
+{
+	if (name.compare(0, 8, "perFrame") == 0) return BUFFER_FREQUENCY_PER_FRAME;
+	if (name.compare(0, 11, "perMaterial") == 0) return BUFFER_FREQUENCY_PER_MATERIAL;
+	return BUFFER_FREQUENCY_PER_OBJECT;
 }
 
 
@@ -349,18 +644,29 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 // Returns true if data is copied, false if variable doesn't 
 // exist or sizes don't match
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(const std::string& name, const void* data, unsigned int size)
 {
-	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, size);
-	if (var == 0)
+	return SetData(FindVariable(name, size), data, size);
+}
+
+// --------------------------------------------------------
+// Sets a variable from GetVariableInfo() with arbitrary data
+//
+// variable - The shader variable (null fails)
+// data     - The data to set in the buffer
+// size     - The size of the data (this must match the variable's size)
+// --------------------------------------------------------
+bool ISimpleShader::SetData(const SimpleShaderVariable* variable, const void* data, unsigned int size)
+{
+	// Verify the variable
+	if (variable == 0 || variable->Size != size)
 		return false;
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer, skipping the
+	// copy if it already matches
+	SimpleConstantBuffer* cb = &constantBuffers[variable->ConstantBufferIndex];
+	if (!cb->Changes.Write(cb->LocalDataBuffer, variable->ByteOffset, data, size))
+		frameStats.SetsSkipped++;
 
 	// Success
 	return true;
@@ -369,7 +675,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(const std::string& name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -377,7 +683,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(const std::string& name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -385,7 +691,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(const std::string& name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -393,7 +699,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -401,7 +707,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(const std::string& name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -409,7 +715,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -417,7 +723,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(const std::string& name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -425,7 +731,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -433,7 +739,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -441,15 +747,48 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Typed setters for variables from GetVariableInfo()
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(const SimpleShaderVariable* variable, int data)
+{
+	return this->SetData(variable, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(const SimpleShaderVariable* variable, float data)
+{
+	return this->SetData(variable, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(const SimpleShaderVariable* variable, const DirectX::XMFLOAT2 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(const SimpleShaderVariable* variable, const DirectX::XMFLOAT3 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4X4 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(const std::string& name)
 {
 	return FindVariable(name, -1);
 }
@@ -459,7 +798,7 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleSRV*>::iterator result =
@@ -494,7 +833,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleSampler*>::iterator result =
@@ -547,7 +886,7 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(const std::string& name)
 {
 	return FindConstantBuffer(name);
 }
@@ -566,6 +905,20 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 	return &constantBuffers[index];
 }
 
+// --------------------------------------------------------
+// Overrides the update frequency guessed from a buffer's name
+//
+// Returns true if the buffer exists, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferFrequency(const std::string& name, SimpleBufferFrequency frequency)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(name);
+	if (!cb) return false;
+
+	cb->Frequency = frequency;
+	return true;
+}
+
 
 
 
@@ -755,16 +1108,36 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	if (renderDevice)
+	{
+		renderDevice->IASetInputLayout(inputLayout);
+		renderDevice->VSSetShader(shader);
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout);
+		deviceContext->VSSetShader(shader, 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			if (renderDevice)
+				renderDevice->VSSetConstantBuffers1(cb->BindIndex, 1, &ringBuffer, &cb->RingFirstConstant, &cb->RingNumConstants);
+			else
+				uploadRing->GetContext1()->VSSetConstantBuffers1(cb->BindIndex, 1, &ringBuffer, &cb->RingFirstConstant, &cb->RingNumConstants);
+			continue;
+		}
+
+		if (renderDevice)
+			renderDevice->VSSetConstantBuffers(cb->BindIndex, 1, &cb->ConstantBuffer);
+		else
+			deviceContext->VSSetConstantBuffers(cb->BindIndex, 1, &cb->ConstantBuffer);
 	}
 }
 
@@ -776,7 +1149,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleVertexShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -784,7 +1157,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (renderDevice)
+		renderDevice->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -798,7 +1174,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleVertexShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -806,7 +1182,10 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (renderDevice)
+		renderDevice->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -877,15 +1256,30 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	if (renderDevice)
+		renderDevice->PSSetShader(shader);
+	else
+		deviceContext->PSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			if (renderDevice)
+				renderDevice->PSSetConstantBuffers1(cb->BindIndex, 1, &ringBuffer, &cb->RingFirstConstant, &cb->RingNumConstants);
+			else
+				uploadRing->GetContext1()->PSSetConstantBuffers1(cb->BindIndex, 1, &ringBuffer, &cb->RingFirstConstant, &cb->RingNumConstants);
+			continue;
+		}
+
+		if (renderDevice)
+			renderDevice->PSSetConstantBuffers(cb->BindIndex, 1, &cb->ConstantBuffer);
+		else
+			deviceContext->PSSetConstantBuffers(cb->BindIndex, 1, &cb->ConstantBuffer);
 	}
 }
 
@@ -897,7 +1291,7 @@ void SimplePixelShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimplePixelShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -905,7 +1299,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (renderDevice)
+		renderDevice->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -919,7 +1316,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimplePixelShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -927,7 +1324,10 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (renderDevice)
+		renderDevice->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1005,10 +1405,24 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			uploadRing->GetContext1()->DSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingNumConstants);
+			continue;
+		}
+
 		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb->ConstantBuffer);
 	}
 }
 
@@ -1020,7 +1434,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleDomainShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1042,7 +1456,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleDomainShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1127,10 +1541,24 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			uploadRing->GetContext1()->HSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingNumConstants);
+			continue;
+		}
+
 		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb->ConstantBuffer);
 	}
 }
 
@@ -1142,7 +1570,7 @@ void SimpleHullShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleHullShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1164,7 +1592,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleHullShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1371,10 +1799,24 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			uploadRing->GetContext1()->GSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingNumConstants);
+			continue;
+		}
+
 		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb->ConstantBuffer);
 	}
 }
 
@@ -1386,7 +1828,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleGeometryShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1408,7 +1850,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleGeometryShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1556,10 +1998,24 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// Bind a slice of the shared ring if that's where the data is
+		SimpleConstantBuffer* cb = &constantBuffers[i];
+		if (cb->RingNumConstants > 0)
+		{
+			ID3D11Buffer* ringBuffer = uploadRing->GetBuffer();
+			uploadRing->GetContext1()->CSSetConstantBuffers1(
+				cb->BindIndex,
+				1,
+				&ringBuffer,
+				&cb->RingFirstConstant,
+				&cb->RingNumConstants);
+			continue;
+		}
+
 		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			&constantBuffers[i].ConstantBuffer);
+			&cb->ConstantBuffer);
 	}
 }
 
@@ -1624,7 +2080,7 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleComputeShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1646,7 +2102,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleComputeShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1669,7 +2125,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState*
 //
 // Returns true if a UAV of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView * uav, unsigned int appendConsumeOffset)
+bool SimpleComputeShader::SetUnorderedAccessView(const std::string& name, ID3D11UnorderedAccessView * uav, unsigned int appendConsumeOffset)
 {
 	// Look for the variable and verify
 	unsigned int bindIndex = GetUnorderedAccessViewIndex(name);
@@ -1686,7 +2142,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 // --------------------------------------------------------
 // Gets the index of the specified UAV (or -1)
 // --------------------------------------------------------
-int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
+int SimpleComputeShader::GetUnorderedAccessViewIndex(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, unsigned int>::iterator result =
@@ -3,6 +3,7 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
@@ -10,6 +11,11 @@
 #include <vector>
 #include <string>
 
+#include "ConstantUploadRing.h"
+#include "ConstantDirtyRange.h"
+#include "ShaderReflectionCache.h"
+#include "RenderDevice.h"
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -21,6 +27,20 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// How often a constant buffer's contents are expected to
+// change.  Inferred from the buffer's name in the shader
+// ("perFrame...", "perMaterial...", "perObject...") and
+// treated as per object when the name gives no hint.
+// --------------------------------------------------------
+enum SimpleBufferFrequency
+{
+	BUFFER_FREQUENCY_PER_OBJECT,
+	BUFFER_FREQUENCY_PER_MATERIAL,
+	BUFFER_FREQUENCY_PER_FRAME,
+	BUFFER_FREQUENCY_COUNT
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -34,6 +54,32 @@ struct SimpleConstantBuffer
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+	SimpleBufferFrequency Frequency;
+	unsigned int LastUploadFrame;
+
+	// Slice of the shared upload ring holding this buffer's data
+	// (RingNumConstants is 0 when ConstantBuffer is used instead)
+	unsigned int RingFirstConstant;
+	unsigned int RingNumConstants;
+	unsigned long long RingFrame;
+
+	// Bytes changed since the last upload to the GPU
+	ConstantDirtyRange Changes;
+};
+
+// --------------------------------------------------------
+// Constant buffer traffic counters, accumulated across
+// all shaders until ResetFrameStats() is called
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int BytesUploaded;		// Bytes actually sent to the GPU
+	unsigned int UploadsIssued;		// Number of buffer updates issued
+	unsigned int UploadsSkipped;	// Copy requests for buffers with no changes
+	unsigned int SetsSkipped;		// Set calls whose data matched the local buffer
+	unsigned int FrequencyBytes[BUFFER_FREQUENCY_COUNT]; // Bytes uploaded per update frequency
+	unsigned int PerFrameReuploads;	// Per-frame buffers uploaded more than once in a frame
+	unsigned int RingOverflows;		// Uploads that didn't fit in the shared upload ring
 };
 
 // --------------------------------------------------------
@@ -69,58 +115,104 @@ public:
 
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
+	unsigned int GetId() { return id; }	// Small unique number, for sort keys
 
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(const std::string& bufferName);
+	void CopyBuffersByFrequency(SimpleBufferFrequency frequency);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+
+	bool SetInt(const std::string& name, int data);
+	bool SetFloat(const std::string& name, float data);
+	bool SetFloat2(const std::string& name, const float data[2]);
+	bool SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(const std::string& name, const float data[3]);
+	bool SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(const std::string& name, const float data[4]);
+	bool SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(const std::string& name, const float data[16]);
+	bool SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data);
+
+	// The same, for variables found ahead of time with this
+	// shader's GetVariableInfo(), without any name lookup
+	bool SetData(const SimpleShaderVariable* variable, const void* data, unsigned int size);
+	bool SetInt(const SimpleShaderVariable* variable, int data);
+	bool SetFloat(const SimpleShaderVariable* variable, float data);
+	bool SetFloat2(const SimpleShaderVariable* variable, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(const SimpleShaderVariable* variable, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4X4 data);
 
 	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
-	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	virtual bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState) = 0;
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(const std::string& name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(const std::string& name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
 	size_t GetShaderResourceViewCount() { return textureTable.size(); }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(const std::string& name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
 	size_t GetSamplerCount() { return samplerTable.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	const SimpleConstantBuffer* GetBufferInfo(const std::string& name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
+	bool SetBufferFrequency(const std::string& name, SimpleBufferFrequency frequency);
 	
 	// Misc getters
 	ID3DBlob* GetShaderBlob() { return shaderBlob; }
 
+	// Optionally place constant data in a shared upload ring
+	// rather than this shader's own buffers (null to stop)
+	void SetUploadRing(ConstantUploadRing* ring);
+
+	// Optionally route vertex and pixel shader binds and all
+	// constant uploads through a render device (null to stop)
+	static void SetRenderDevice(IRenderDevice* device);
+
+	// Constant buffer traffic statistics (shared by all shaders)
+	static const SimpleShaderUploadStats& GetFrameStats() { return frameStats; }
+	static void ResetFrameStats();
+
+	// Makes every copy send all of a shader's buffers in full,
+	// changed or not, whatever frequency was asked for - the
+	// traffic from before buffers were split and tracked, for
+	// before/after comparisons
+	static void SetUploadEverything(bool enabled);
+
 protected:
 	
+	unsigned int id;
 	bool shaderValid;
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
 
+	// Optional 11.1 context for partial constant buffer updates
+	ID3D11DeviceContext1* deviceContext1;
+	bool partialUpdates;
+
+	// Optional shared ring for constant data
+	ConstantUploadRing* uploadRing;
+
+	static SimpleShaderUploadStats frameStats;
+	static unsigned int frameIndex;
+	static bool uploadEverything;
+
+	// Optional device for vertex and pixel shader binds and uploads
+	static IRenderDevice* renderDevice;
+
 	// Resource counts
 	unsigned int constantBufferCount;
 	
@@ -139,9 +231,18 @@ protected:
 
 	virtual void CleanUp();
 
+	// Building the variable and resource tables
+	void ReflectShader(ShaderReflectionData* data);
+	void BuildTables(const ShaderReflectionData& data);
+
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(const std::string& name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(const std::string& name);
+
+	// Helpers for sending a buffer's dirty range to the GPU
+	void UploadBuffer(SimpleConstantBuffer* cb);
+	void FinishUpload(SimpleConstantBuffer* cb, unsigned int bytes);
+	static SimpleBufferFrequency FrequencyFromName(const std::string& name);
 };
 
 // --------------------------------------------------------
@@ -157,8 +258,8 @@ public:
 	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -180,8 +281,8 @@ public:
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11PixelShader* shader;
@@ -200,8 +301,8 @@ public:
 	~SimpleDomainShader();
 	ID3D11DomainShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11DomainShader* shader;
@@ -220,8 +321,8 @@ public:
 	~SimpleHullShader();
 	ID3D11HullShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11HullShader* shader;
@@ -240,8 +341,8 @@ public:
 	~SimpleGeometryShader();
 	ID3D11GeometryShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -279,11 +380,11 @@ public:
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+	bool SetUnorderedAccessView(const std::string& name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
-	int GetUnorderedAccessViewIndex(std::string name);
+	int GetUnorderedAccessViewIndex(const std::string& name);
 
 protected:
 	ID3D11ComputeShader* shader;
@@ -0,0 +1,454 @@
+#include "StateCache.h"
+
+#include <string.h>
+
+// --------------------------------------------------------
+// Compares a run of slots against the cache and stores the
+// new values, finding the first and last slots that changed
+//
+// mask      - Bits for the slots whose cached values are known
+// maxSlots  - How many slots the cache tracks
+// matches   - matches(i, slot) is true if value i is already in slot
+// store     - store(i, slot) puts value i in the cached slot
+// first     - Receives the index of the first changed value
+// count     - Receives the number of values from first to the last change
+//
+// Returns false if every slot already held its value
+// --------------------------------------------------------
+template<typename Matches, typename Store>
+static bool ChangedSlots(unsigned int* mask, unsigned int maxSlots, unsigned int startSlot, unsigned int numSlots, Matches matches, Store store, unsigned int* first, unsigned int* count)
+{
+	// Too far along to track, so forget what we knew and let it through
+	if (startSlot + numSlots > maxSlots)
+	{
+		for (unsigned int slot = startSlot; slot < maxSlots; slot++)
+			*mask &= ~(1u << slot);
+
+		*first = 0;
+		*count = numSlots;
+		return true;
+	}
+
+	unsigned int firstChanged = numSlots;
+	unsigned int lastChanged = 0;
+	for (unsigned int i = 0; i < numSlots; i++)
+	{
+		unsigned int bit = 1u << (startSlot + i);
+		if ((*mask & bit) && matches(i, startSlot + i))
+			continue;
+
+		store(i, startSlot + i);
+		*mask |= bit;
+
+		if (firstChanged == numSlots) firstChanged = i;
+		lastChanged = i;
+	}
+
+	if (firstChanged == numSlots)
+		return false;
+
+	*first = firstChanged;
+	*count = lastChanged - firstChanged + 1;
+	return true;
+}
+
+// --------------------------------------------------------
+// Constructor - starts with nothing known about the device
+// --------------------------------------------------------
+StateCache::StateCache(IRenderDevice* device)
+{
+	this->device = device;
+	ResetStats();
+	Invalidate();
+}
+
+// --------------------------------------------------------
+// Forgets all cached state
+// --------------------------------------------------------
+void StateCache::Invalidate()
+{
+	inputLayoutKnown = false;
+	topologyKnown = false;
+	vertexBufferMask = 0;
+	indexBufferKnown = false;
+
+	vertexShaderKnown = false;
+	pixelShaderKnown = false;
+	vertexStage.ConstantBufferMask = 0;
+	vertexStage.ShaderResourceMask = 0;
+	vertexStage.SamplerMask = 0;
+	pixelStage.ConstantBufferMask = 0;
+	pixelStage.ShaderResourceMask = 0;
+	pixelStage.SamplerMask = 0;
+
+	rasterizerStateKnown = false;
+	viewportKnown = false;
+	depthStencilStateKnown = false;
+	blendStateKnown = false;
+}
+
+// --------------------------------------------------------
+// Issues every known binding on target, a slot at a time
+// for the per-slot arrays
+// --------------------------------------------------------
+void StateCache::ApplyTo(IRenderDevice* target)
+{
+	if (inputLayoutKnown) target->IASetInputLayout(inputLayout);
+	if (topologyKnown) target->IASetPrimitiveTopology(topology);
+	for (unsigned int slot = 0; slot < MaxVertexBuffers; slot++)
+	{
+		if (vertexBufferMask & (1u << slot))
+			target->IASetVertexBuffers(slot, 1, &vertexBuffers[slot], &vertexStrides[slot], &vertexOffsets[slot]);
+	}
+	if (indexBufferKnown) target->IASetIndexBuffer(indexBuffer, indexFormat, indexOffset);
+
+	if (vertexShaderKnown) target->VSSetShader(vertexShader);
+	if (pixelShaderKnown) target->PSSetShader(pixelShader);
+	const StageState* stages[2] = { &vertexStage, &pixelStage };
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		const StageState& stage = *stages[s];
+		bool vs = s == 0;
+		for (unsigned int slot = 0; slot < MaxConstantBuffers; slot++)
+		{
+			if (!(stage.ConstantBufferMask & (1u << slot)))
+				continue;
+
+			// Whole buffer binds are stored as 0, 0
+			ID3D11Buffer* const* buffer = &stage.ConstantBuffers[slot];
+			if (stage.NumConstants[slot] == 0)
+				vs ? target->VSSetConstantBuffers(slot, 1, buffer) : target->PSSetConstantBuffers(slot, 1, buffer);
+			else if (vs)
+				target->VSSetConstantBuffers1(slot, 1, buffer, &stage.FirstConstants[slot], &stage.NumConstants[slot]);
+			else
+				target->PSSetConstantBuffers1(slot, 1, buffer, &stage.FirstConstants[slot], &stage.NumConstants[slot]);
+		}
+		for (unsigned int slot = 0; slot < MaxShaderResources; slot++)
+		{
+			if (stage.ShaderResourceMask & (1u << slot))
+				vs ? target->VSSetShaderResources(slot, 1, &stage.ShaderResources[slot]) : target->PSSetShaderResources(slot, 1, &stage.ShaderResources[slot]);
+		}
+		for (unsigned int slot = 0; slot < MaxSamplers; slot++)
+		{
+			if (stage.SamplerMask & (1u << slot))
+				vs ? target->VSSetSamplers(slot, 1, &stage.Samplers[slot]) : target->PSSetSamplers(slot, 1, &stage.Samplers[slot]);
+		}
+	}
+
+	if (rasterizerStateKnown) target->RSSetState(rasterizerState);
+	if (viewportKnown) target->RSSetViewports(1, &viewport);
+	if (depthStencilStateKnown) target->OMSetDepthStencilState(depthStencilState, stencilRef);
+	if (blendStateKnown) target->OMSetBlendState(blendState, blendFactor, sampleMask);
+}
+
+// --------------------------------------------------------
+// Zeros the issued/filtered and draw counters
+// --------------------------------------------------------
+void StateCache::ResetStats()
+{
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Bumps the right counter for a call
+// --------------------------------------------------------
+bool StateCache::Track(bool changed)
+{
+	if (changed)
+		stats.CallsIssued++;
+	else
+		stats.CallsFiltered++;
+	return changed;
+}
+
+
+// ------ INPUT ASSEMBLER ---------------------------------
+
+void StateCache::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (!Track(!inputLayoutKnown || this->inputLayout != inputLayout))
+		return;
+
+	inputLayoutKnown = true;
+	this->inputLayout = inputLayout;
+	device->IASetInputLayout(inputLayout);
+}
+
+void StateCache::IASetPrimitiveTopology(unsigned int topology)
+{
+	if (!Track(!topologyKnown || this->topology != topology))
+		return;
+
+	topologyKnown = true;
+	this->topology = topology;
+	device->IASetPrimitiveTopology(topology);
+}
+
+void StateCache::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	unsigned int first, count;
+	bool changed = ChangedSlots(&vertexBufferMask, MaxVertexBuffers, startSlot, numBuffers,
+		[&](unsigned int i, unsigned int slot) {
+			return
+				vertexBuffers[slot] == buffers[i] &&
+				vertexStrides[slot] == strides[i] &&
+				vertexOffsets[slot] == offsets[i]; },
+		[&](unsigned int i, unsigned int slot) {
+			vertexBuffers[slot] = buffers[i];
+			vertexStrides[slot] = strides[i];
+			vertexOffsets[slot] = offsets[i]; },
+		&first, &count);
+
+	if (!Track(changed))
+		return;
+
+	device->IASetVertexBuffers(startSlot + first, count, buffers + first, strides + first, offsets + first);
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset)
+{
+	if (!Track(!indexBufferKnown || indexBuffer != buffer || indexFormat != format || indexOffset != offset))
+		return;
+
+	indexBufferKnown = true;
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	device->IASetIndexBuffer(buffer, format, offset);
+}
+
+
+// ------ SHADER STAGES -----------------------------------
+
+bool StateCache::FilterConstantBuffers(StageState* stage, unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants, unsigned int* first, unsigned int* count)
+{
+	return ChangedSlots(&stage->ConstantBufferMask, MaxConstantBuffers, startSlot, numBuffers,
+		[&](unsigned int i, unsigned int slot) {
+			return
+				stage->ConstantBuffers[slot] == buffers[i] &&
+				stage->FirstConstants[slot] == (firstConstants ? firstConstants[i] : 0) &&
+				stage->NumConstants[slot] == (numConstants ? numConstants[i] : 0); },
+		[&](unsigned int i, unsigned int slot) {
+			stage->ConstantBuffers[slot] = buffers[i];
+			stage->FirstConstants[slot] = firstConstants ? firstConstants[i] : 0;
+			stage->NumConstants[slot] = numConstants ? numConstants[i] : 0; },
+		first, count);
+}
+
+bool StateCache::FilterShaderResources(StageState* stage, unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views, unsigned int* first, unsigned int* count)
+{
+	return ChangedSlots(&stage->ShaderResourceMask, MaxShaderResources, startSlot, numViews,
+		[&](unsigned int i, unsigned int slot) { return stage->ShaderResources[slot] == views[i]; },
+		[&](unsigned int i, unsigned int slot) { stage->ShaderResources[slot] = views[i]; },
+		first, count);
+}
+
+bool StateCache::FilterSamplers(StageState* stage, unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers, unsigned int* first, unsigned int* count)
+{
+	return ChangedSlots(&stage->SamplerMask, MaxSamplers, startSlot, numSamplers,
+		[&](unsigned int i, unsigned int slot) { return stage->Samplers[slot] == samplers[i]; },
+		[&](unsigned int i, unsigned int slot) { stage->Samplers[slot] = samplers[i]; },
+		first, count);
+}
+
+void StateCache::VSSetShader(ID3D11VertexShader* shader)
+{
+	if (!Track(!vertexShaderKnown || vertexShader != shader))
+		return;
+
+	vertexShaderKnown = true;
+	vertexShader = shader;
+	device->VSSetShader(shader);
+}
+
+void StateCache::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	unsigned int first, count;
+	if (Track(FilterConstantBuffers(&vertexStage, startSlot, numBuffers, buffers, 0, 0, &first, &count)))
+		device->VSSetConstantBuffers(startSlot + first, count, buffers + first);
+}
+
+void StateCache::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	unsigned int first, count;
+	if (Track(FilterConstantBuffers(&vertexStage, startSlot, numBuffers, buffers, firstConstants, numConstants, &first, &count)))
+		device->VSSetConstantBuffers1(startSlot + first, count, buffers + first,
+			firstConstants ? firstConstants + first : 0,
+			numConstants ? numConstants + first : 0);
+}
+
+void StateCache::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	unsigned int first, count;
+	if (Track(FilterShaderResources(&vertexStage, startSlot, numViews, views, &first, &count)))
+		device->VSSetShaderResources(startSlot + first, count, views + first);
+}
+
+void StateCache::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	unsigned int first, count;
+	if (Track(FilterSamplers(&vertexStage, startSlot, numSamplers, samplers, &first, &count)))
+		device->VSSetSamplers(startSlot + first, count, samplers + first);
+}
+
+void StateCache::PSSetShader(ID3D11PixelShader* shader)
+{
+	if (!Track(!pixelShaderKnown || pixelShader != shader))
+		return;
+
+	pixelShaderKnown = true;
+	pixelShader = shader;
+	device->PSSetShader(shader);
+}
+
+void StateCache::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	unsigned int first, count;
+	if (Track(FilterConstantBuffers(&pixelStage, startSlot, numBuffers, buffers, 0, 0, &first, &count)))
+		device->PSSetConstantBuffers(startSlot + first, count, buffers + first);
+}
+
+void StateCache::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	unsigned int first, count;
+	if (Track(FilterConstantBuffers(&pixelStage, startSlot, numBuffers, buffers, firstConstants, numConstants, &first, &count)))
+		device->PSSetConstantBuffers1(startSlot + first, count, buffers + first,
+			firstConstants ? firstConstants + first : 0,
+			numConstants ? numConstants + first : 0);
+}
+
+void StateCache::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	unsigned int first, count;
+	if (Track(FilterShaderResources(&pixelStage, startSlot, numViews, views, &first, &count)))
+		device->PSSetShaderResources(startSlot + first, count, views + first);
+}
+
+void StateCache::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	unsigned int first, count;
+	if (Track(FilterSamplers(&pixelStage, startSlot, numSamplers, samplers, &first, &count)))
+		device->PSSetSamplers(startSlot + first, count, samplers + first);
+}
+
+
+// ------ RASTERIZER AND OUTPUT MERGER --------------------
+
+void StateCache::RSSetState(ID3D11RasterizerState* state)
+{
+	if (!Track(!rasterizerStateKnown || rasterizerState != state))
+		return;
+
+	rasterizerStateKnown = true;
+	rasterizerState = state;
+	device->RSSetState(state);
+}
+
+void StateCache::RSSetViewports(unsigned int numViewports, const RenderViewport* viewports)
+{
+	// Only the common single viewport case is worth remembering
+	bool single = numViewports == 1;
+	if (!Track(!single || !viewportKnown || memcmp(&viewport, viewports, sizeof(RenderViewport)) != 0))
+		return;
+
+	viewportKnown = single;
+	if (single) viewport = viewports[0];
+	device->RSSetViewports(numViewports, viewports);
+}
+
+void StateCache::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	if (!Track(!depthStencilStateKnown || depthStencilState != state || this->stencilRef != stencilRef))
+		return;
+
+	depthStencilStateKnown = true;
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	device->OMSetDepthStencilState(state, stencilRef);
+}
+
+void StateCache::OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+	// D3D treats a null blend factor as all ones
+	static const float defaultBlendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (!blendFactor) blendFactor = defaultBlendFactor;
+
+	if (!Track(
+		!blendStateKnown ||
+		blendState != state ||
+		memcmp(this->blendFactor, blendFactor, sizeof(this->blendFactor)) != 0 ||
+		this->sampleMask != sampleMask))
+		return;
+
+	blendStateKnown = true;
+	blendState = state;
+	memcpy(this->blendFactor, blendFactor, sizeof(this->blendFactor));
+	this->sampleMask = sampleMask;
+	device->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void StateCache::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil)
+{
+	// Always issued - any of our cached SRVs that are now
+	// render targets have been unbound by D3D
+	Track(true);
+	vertexStage.ShaderResourceMask = 0;
+	pixelStage.ShaderResourceMask = 0;
+	device->OMSetRenderTargets(numViews, renderTargets, depthStencil);
+}
+
+
+// ------ PASSED STRAIGHT THROUGH -------------------------
+
+void StateCache::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	device->UpdateBuffer(buffer, data, size);
+}
+
+void StateCache::UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end)
+{
+	device->UpdateBufferRange(buffer, data, start, end);
+}
+
+bool StateCache::WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard)
+{
+	return device->WriteBuffer(buffer, offset, data, size, discard);
+}
+
+void StateCache::ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4])
+{
+	device->ClearRenderTargetView(renderTarget, color);
+}
+
+void StateCache::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil)
+{
+	device->ClearDepthStencilView(depthStencil, clearFlags, depth, stencil);
+}
+
+void StateCache::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	stats.DrawCalls++;
+	device->Draw(vertexCount, startVertex);
+}
+
+void StateCache::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	stats.DrawCalls++;
+	device->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCache::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	stats.DrawCalls++;
+	device->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void StateCache::GenerateMips(ID3D11ShaderResourceView* view)
+{
+	device->GenerateMips(view);
+}
+
+void StateCache::Flush()
+{
+	device->Flush();
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Counts of the bind calls that went through the cache
+// --------------------------------------------------------
+struct StateCacheStats
+{
+	unsigned int CallsIssued;	// Calls forwarded to the device
+	unsigned int CallsFiltered;	// Calls dropped because nothing changed
+	unsigned int DrawCalls;		// Draws of any kind
+};
+
+// --------------------------------------------------------
+// Sits in front of another render device and remembers what
+// is currently bound to the input assembler, the vertex and
+// pixel shader stages, the rasterizer and the output merger,
+// dropping any bind call that wouldn't change anything.
+// Uploads, clears and draws are passed straight through.
+//
+// The cache only knows about calls made through it, so call
+// Invalidate() after anything binds state behind its back
+// (or after releasing objects that might still be bound).
+// Binding render targets forgets all cached SRVs, since D3D
+// silently unbinds resources that become render targets.
+// --------------------------------------------------------
+class StateCache : public IRenderDevice
+{
+public:
+	StateCache(IRenderDevice* device);
+
+	// Forget everything, so the next call of each kind is issued
+	void Invalidate();
+
+	// Binds everything the cache knows is bound on another
+	// device, for recording into lists that start out blank.
+	// Render targets aren't tracked, so they're left out.
+	void ApplyTo(IRenderDevice* target);
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer and output merger
+	void RSSetState(ID3D11RasterizerState* state);
+	void RSSetViewports(unsigned int numViewports, const RenderViewport* viewports);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargets, ID3D11DepthStencilView* depthStencil);
+
+	// Uploads
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void UpdateBufferRange(ID3D11Buffer* buffer, const void* data, unsigned int start, unsigned int end);
+	bool WriteBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, unsigned int size, bool discard);
+
+	// Clears
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTarget, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int clearFlags, float depth, unsigned char stencil);
+
+	// Drawing and misc
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void GenerateMips(ID3D11ShaderResourceView* view);
+	void Flush();
+
+	// Getters
+	IRenderDevice* GetDevice() { return device; }
+	const StateCacheStats& GetStats() { return stats; }
+	void ResetStats();
+
+	// Counts draws that went around the cache, in native lists
+	void AddDrawCalls(unsigned int count) { stats.DrawCalls += count; }
+
+private:
+	// Slots we track per stage - calls beyond these go straight through
+	static const unsigned int MaxVertexBuffers = 16;
+	static const unsigned int MaxConstantBuffers = 14;	// All of D3D's API slots
+	static const unsigned int MaxShaderResources = 32;
+	static const unsigned int MaxSamplers = 16;			// All of D3D's slots
+
+	// What's bound to a single shader stage.  The masks have a
+	// bit set for each slot whose cached value is known.
+	struct StageState
+	{
+		ID3D11Buffer* ConstantBuffers[MaxConstantBuffers];
+		unsigned int FirstConstants[MaxConstantBuffers];	// Both 0 when the
+		unsigned int NumConstants[MaxConstantBuffers];		// whole buffer is bound
+		ID3D11ShaderResourceView* ShaderResources[MaxShaderResources];
+		ID3D11SamplerState* Samplers[MaxSamplers];
+		unsigned int ConstantBufferMask;
+		unsigned int ShaderResourceMask;
+		unsigned int SamplerMask;
+	};
+
+	IRenderDevice* device;
+	StateCacheStats stats;
+
+	// Input assembler
+	bool inputLayoutKnown;
+	ID3D11InputLayout* inputLayout;
+	bool topologyKnown;
+	unsigned int topology;
+	unsigned int vertexBufferMask;
+	ID3D11Buffer* vertexBuffers[MaxVertexBuffers];
+	unsigned int vertexStrides[MaxVertexBuffers];
+	unsigned int vertexOffsets[MaxVertexBuffers];
+	bool indexBufferKnown;
+	ID3D11Buffer* indexBuffer;
+	unsigned int indexFormat;
+	unsigned int indexOffset;
+
+	// Shader stages
+	bool vertexShaderKnown;
+	ID3D11VertexShader* vertexShader;
+	bool pixelShaderKnown;
+	ID3D11PixelShader* pixelShader;
+	StageState vertexStage;
+	StageState pixelStage;
+
+	// Rasterizer and output merger
+	bool rasterizerStateKnown;
+	ID3D11RasterizerState* rasterizerState;
+	bool viewportKnown;
+	RenderViewport viewport;
+	bool depthStencilStateKnown;
+	ID3D11DepthStencilState* depthStencilState;
+	unsigned int stencilRef;
+	bool blendStateKnown;
+	ID3D11BlendState* blendState;
+	float blendFactor[4];
+	unsigned int sampleMask;
+
+	// Helpers for the per-slot arrays - each returns false if the
+	// call changes nothing, or the changed run of slots otherwise
+	bool FilterConstantBuffers(StageState* stage, unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants, unsigned int* first, unsigned int* count);
+	bool FilterShaderResources(StageState* stage, unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views, unsigned int* first, unsigned int* count);
+	bool FilterSamplers(StageState* stage, unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers, unsigned int* first, unsigned int* count);
+
+	// Counts the call and passes "changed" back
+	bool Track(bool changed);
+};
@@ -0,0 +1,353 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <bitset>
+
+using namespace DirectX;
+
+// Below this many transforms per job, handing out the work
+// costs more than it saves
+static const unsigned int MinTransformsPerJob = 8192;
+
+TransformSystem::TransformSystem()
+{
+	count = 0;
+}
+
+unsigned int TransformSystem::Create()
+{
+	// Grow a whole dirty word at a time, so ComposeFour()
+	// never reads or writes past the end
+	if (count % 32 == 0)
+	{
+		unsigned int padded = count + 32;
+		positionX.resize(padded, 0.0f);
+		positionY.resize(padded, 0.0f);
+		positionZ.resize(padded, 0.0f);
+		rotationX.resize(padded, 0.0f);
+		rotationY.resize(padded, 0.0f);
+		rotationZ.resize(padded, 0.0f);
+		scaleX.resize(padded, 1.0f);
+		scaleY.resize(padded, 1.0f);
+		scaleZ.resize(padded, 1.0f);
+
+		previousPositionX.resize(padded, 0.0f);
+		previousPositionY.resize(padded, 0.0f);
+		previousPositionZ.resize(padded, 0.0f);
+		previousRotationX.resize(padded, 0.0f);
+		previousRotationY.resize(padded, 0.0f);
+		previousRotationZ.resize(padded, 0.0f);
+		previousScaleX.resize(padded, 1.0f);
+		previousScaleY.resize(padded, 1.0f);
+		previousScaleZ.resize(padded, 1.0f);
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		worldMatrices.resize(padded, identity);
+		dirty.push_back(0);
+		moved.push_back(0);
+		movedBefore.push_back(0);
+	}
+
+	return count++;
+}
+
+void TransformSystem::Clear()
+{
+	count = 0;
+	positionX.clear();
+	positionY.clear();
+	positionZ.clear();
+	rotationX.clear();
+	rotationY.clear();
+	rotationZ.clear();
+	scaleX.clear();
+	scaleY.clear();
+	scaleZ.clear();
+	previousPositionX.clear();
+	previousPositionY.clear();
+	previousPositionZ.clear();
+	previousRotationX.clear();
+	previousRotationY.clear();
+	previousRotationZ.clear();
+	previousScaleX.clear();
+	previousScaleY.clear();
+	previousScaleZ.clear();
+	worldMatrices.clear();
+	dirty.clear();
+	moved.clear();
+	movedBefore.clear();
+}
+
+void TransformSystem::Reserve(unsigned int capacity)
+{
+	capacity = (capacity + 31) & ~31u;
+	positionX.reserve(capacity);
+	positionY.reserve(capacity);
+	positionZ.reserve(capacity);
+	rotationX.reserve(capacity);
+	rotationY.reserve(capacity);
+	rotationZ.reserve(capacity);
+	scaleX.reserve(capacity);
+	scaleY.reserve(capacity);
+	scaleZ.reserve(capacity);
+	previousPositionX.reserve(capacity);
+	previousPositionY.reserve(capacity);
+	previousPositionZ.reserve(capacity);
+	previousRotationX.reserve(capacity);
+	previousRotationY.reserve(capacity);
+	previousRotationZ.reserve(capacity);
+	previousScaleX.reserve(capacity);
+	previousScaleY.reserve(capacity);
+	previousScaleZ.reserve(capacity);
+	worldMatrices.reserve(capacity);
+	dirty.reserve(capacity / 32);
+	moved.reserve(capacity / 32);
+	movedBefore.reserve(capacity / 32);
+}
+
+void TransformSystem::SetPosition(unsigned int transform, float x, float y, float z)
+{
+	positionX[transform] = x;
+	positionY[transform] = y;
+	positionZ[transform] = z;
+	MarkDirty(transform);
+}
+
+void TransformSystem::SetRotation(unsigned int transform, float x, float y, float z)
+{
+	rotationX[transform] = x;
+	rotationY[transform] = y;
+	rotationZ[transform] = z;
+	MarkDirty(transform);
+}
+
+void TransformSystem::SetScale(unsigned int transform, float x, float y, float z)
+{
+	scaleX[transform] = x;
+	scaleY[transform] = y;
+	scaleZ[transform] = z;
+	MarkDirty(transform);
+}
+
+void TransformSystem::Move(unsigned int transform, float x, float y, float z)
+{
+	positionX[transform] += x;
+	positionY[transform] += y;
+	positionZ[transform] += z;
+	MarkDirty(transform);
+}
+
+void TransformSystem::Rotate(unsigned int transform, float x, float y, float z)
+{
+	rotationX[transform] += x;
+	rotationY[transform] += y;
+	rotationZ[transform] += z;
+	MarkDirty(transform);
+}
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int transform)
+{
+	return XMFLOAT3(positionX[transform], positionY[transform], positionZ[transform]);
+}
+
+XMFLOAT3 TransformSystem::GetRotation(unsigned int transform)
+{
+	return XMFLOAT3(rotationX[transform], rotationY[transform], rotationZ[transform]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int transform)
+{
+	return XMFLOAT3(scaleX[transform], scaleY[transform], scaleZ[transform]);
+}
+
+// --------------------------------------------------------
+// Splits the dirty words into chunks for the job system.
+// Chunks never share a word or a matrix, so the jobs don't
+// need to synchronize.
+// --------------------------------------------------------
+unsigned int TransformSystem::Update(JobSystem* jobs)
+{
+	unsigned int words = (unsigned int)dirty.size();
+	if (!jobs || count < MinTransformsPerJob * 2)
+		return UpdateWords(0, words);
+
+	std::atomic<unsigned int> rebuilt(0);
+	jobs->ParallelFor(words, MinTransformsPerJob / 32, [&](unsigned int begin, unsigned int end)
+	{
+		rebuilt.fetch_add(UpdateWords(begin, end));
+	});
+	return rebuilt;
+}
+
+// --------------------------------------------------------
+// Saves the state everything's about to move on from.  Only
+// transforms changed since the last save can differ from
+// their saved state, so only their words are copied.
+// --------------------------------------------------------
+void TransformSystem::BeginStep()
+{
+	for (unsigned int w = 0; w < dirty.size(); w++)
+	{
+		if (moved[w] | dirty[w])
+		{
+			unsigned int first = w * 32;
+			unsigned int end = first + 32;
+			std::copy(positionX.begin() + first, positionX.begin() + end, previousPositionX.begin() + first);
+			std::copy(positionY.begin() + first, positionY.begin() + end, previousPositionY.begin() + first);
+			std::copy(positionZ.begin() + first, positionZ.begin() + end, previousPositionZ.begin() + first);
+			std::copy(rotationX.begin() + first, rotationX.begin() + end, previousRotationX.begin() + first);
+			std::copy(rotationY.begin() + first, rotationY.begin() + end, previousRotationY.begin() + first);
+			std::copy(rotationZ.begin() + first, rotationZ.begin() + end, previousRotationZ.begin() + first);
+			std::copy(scaleX.begin() + first, scaleX.begin() + end, previousScaleX.begin() + first);
+			std::copy(scaleY.begin() + first, scaleY.begin() + end, previousScaleY.begin() + first);
+			std::copy(scaleZ.begin() + first, scaleZ.begin() + end, previousScaleZ.begin() + first);
+		}
+
+		movedBefore[w] = moved[w];
+		moved[w] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Blends the world matrices of anything that moved in the
+// last two steps.  Those that only moved in the one before
+// last have matching saved and current states, so this
+// settles them back on their current matrix.
+// --------------------------------------------------------
+void TransformSystem::Interpolate(float alpha, JobSystem* jobs)
+{
+	unsigned int words = (unsigned int)dirty.size();
+	if (!jobs || count < MinTransformsPerJob * 2)
+	{
+		InterpolateWords(0, words, alpha);
+		return;
+	}
+
+	jobs->ParallelFor(words, MinTransformsPerJob / 32, [&](unsigned int begin, unsigned int end)
+	{
+		InterpolateWords(begin, end, alpha);
+	});
+}
+
+void TransformSystem::InterpolateWords(unsigned int firstWord, unsigned int endWord, float alpha)
+{
+	for (unsigned int w = firstWord; w < endWord; w++)
+	{
+		unsigned int bits = moved[w] | movedBefore[w];
+		for (unsigned int group = 0; bits && group < 8; group++)
+		{
+			if ((bits >> (group * 4)) & 0xF)
+				ComposeFour(w * 32 + group * 4, alpha);
+		}
+	}
+}
+
+unsigned int TransformSystem::UpdateWords(unsigned int firstWord, unsigned int endWord)
+{
+	unsigned int rebuilt = 0;
+	for (unsigned int w = firstWord; w < endWord; w++)
+	{
+		unsigned int bits = dirty[w];
+		if (bits == 0)
+			continue;
+
+		dirty[w] = 0;
+		moved[w] |= bits;
+		rebuilt += (unsigned int)std::bitset<32>(bits).count();
+
+		// Rebuild each group of four with anything dirty in it
+		for (unsigned int group = 0; group < 8; group++)
+		{
+			if ((bits >> (group * 4)) & 0xF)
+				ComposeFour(w * 32 + group * 4);
+		}
+	}
+	return rebuilt;
+}
+
+// --------------------------------------------------------
+// Builds scale * rotZ * rotY * rotX * translation for four
+// transforms at once, one lane each, then transposes the
+// lanes back out into the four matrices.  Below an alpha of
+// one, each component is first blended from its saved state.
+// --------------------------------------------------------
+void TransformSystem::ComposeFour(unsigned int first, float alpha)
+{
+	auto load = [&](const std::vector<float>& current, const std::vector<float>& previous)
+	{
+		XMVECTOR v = XMLoadFloat4((const XMFLOAT4*)&current[first]);
+		if (alpha >= 1.0f)
+			return v;
+		return XMVectorLerp(XMLoadFloat4((const XMFLOAT4*)&previous[first]), v, alpha);
+	};
+
+	XMVECTOR sinX, cosX, sinY, cosY, sinZ, cosZ;
+	XMVectorSinCos(&sinX, &cosX, load(rotationX, previousRotationX));
+	XMVectorSinCos(&sinY, &cosY, load(rotationY, previousRotationY));
+	XMVectorSinCos(&sinZ, &cosZ, load(rotationZ, previousRotationZ));
+
+	XMVECTOR sx = load(scaleX, previousScaleX);
+	XMVECTOR sy = load(scaleY, previousScaleY);
+	XMVECTOR sz = load(scaleZ, previousScaleZ);
+
+	// Rows of rotZ * rotY * rotX
+	XMVECTOR sinYsinX = XMVectorMultiply(sinY, sinX);
+	XMVECTOR sinYcosX = XMVectorMultiply(sinY, cosX);
+	XMVECTOR m00 = XMVectorMultiply(cosZ, cosY);
+	XMVECTOR m01 = XMVectorMultiplyAdd(sinZ, cosX, XMVectorMultiply(cosZ, sinYsinX));
+	XMVECTOR m02 = XMVectorSubtract(XMVectorMultiply(sinZ, sinX), XMVectorMultiply(cosZ, sinYcosX));
+	XMVECTOR m10 = XMVectorNegate(XMVectorMultiply(sinZ, cosY));
+	XMVECTOR m11 = XMVectorSubtract(XMVectorMultiply(cosZ, cosX), XMVectorMultiply(sinZ, sinYsinX));
+	XMVECTOR m12 = XMVectorMultiplyAdd(cosZ, sinX, XMVectorMultiply(sinZ, sinYcosX));
+	XMVECTOR m20 = sinY;
+	XMVECTOR m21 = XMVectorNegate(XMVectorMultiply(cosY, sinX));
+	XMVECTOR m22 = XMVectorMultiply(cosY, cosX);
+
+	// Transposed matrices have the scaled rotation's columns
+	// (and the translation) as their rows, so each of these
+	// holds one row of all four matrices
+	XMMATRIX row0, row1, row2;
+	row0.r[0] = XMVectorMultiply(m00, sx);
+	row0.r[1] = XMVectorMultiply(m10, sy);
+	row0.r[2] = XMVectorMultiply(m20, sz);
+	row0.r[3] = load(positionX, previousPositionX);
+	row1.r[0] = XMVectorMultiply(m01, sx);
+	row1.r[1] = XMVectorMultiply(m11, sy);
+	row1.r[2] = XMVectorMultiply(m21, sz);
+	row1.r[3] = load(positionY, previousPositionY);
+	row2.r[0] = XMVectorMultiply(m02, sx);
+	row2.r[1] = XMVectorMultiply(m12, sy);
+	row2.r[2] = XMVectorMultiply(m22, sz);
+	row2.r[3] = load(positionZ, previousPositionZ);
+	row0 = XMMatrixTranspose(row0);
+	row1 = XMMatrixTranspose(row1);
+	row2 = XMMatrixTranspose(row2);
+
+	XMVECTOR row3 = XMVectorSet(0, 0, 0, 1);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		XMFLOAT4X4& world = worldMatrices[first + i];
+		XMStoreFloat4((XMFLOAT4*)&world._11, row0.r[i]);
+		XMStoreFloat4((XMFLOAT4*)&world._21, row1.r[i]);
+		XMStoreFloat4((XMFLOAT4*)&world._31, row2.r[i]);
+		XMStoreFloat4((XMFLOAT4*)&world._41, row3);
+	}
+}
+
+void TransformSystem::UpdateReference()
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX trans = XMMatrixTranslation(positionX[i], positionY[i], positionZ[i]);
+		XMMATRIX rotX = XMMatrixRotationX(rotationX[i]);
+		XMMATRIX rotY = XMMatrixRotationY(rotationY[i]);
+		XMMATRIX rotZ = XMMatrixRotationZ(rotationZ[i]);
+		XMMATRIX sc = XMMatrixScaling(scaleX[i], scaleY[i], scaleZ[i]);
+
+		XMMATRIX total = sc * rotZ * rotY * rotX * trans;
+		XMStoreFloat4x4(&worldMatrices[i], XMMatrixTranspose(total));
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Positions, rotations and scales of every entity, and the
+// world matrices built from them.
+//
+// Each component is its own array (padded to a multiple of
+// 32) so Update() can compose four transforms at once with
+// plain vector loads.  Setters flag a transform as dirty,
+// one bit each, and Update() only rebuilds groups of four
+// with a dirty bit set - skipping 32 at a time when a whole
+// word is clean.
+//
+// For fixed step simulation, BeginStep() saves every
+// transform's state before each step, and Interpolate()
+// blends world matrices between that and the current state
+// for drawing between steps.
+//
+// Rotations are euler angles in radians, applied Z, then Y,
+// then X, and world matrices are stored transposed for HLSL.
+// Handles are indices, and stay valid until Clear().
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	TransformSystem();
+
+	// Returns the new transform's handle
+	unsigned int Create();
+	void Clear();
+	void Reserve(unsigned int capacity);
+
+	// Transformations
+	void SetPosition(unsigned int transform, float x, float y, float z);
+	void SetRotation(unsigned int transform, float x, float y, float z);
+	void SetScale(unsigned int transform, float x, float y, float z);
+	void Move(unsigned int transform, float x, float y, float z);
+	void Rotate(unsigned int transform, float x, float y, float z);
+
+	// Rebuilds every dirty world matrix, spreading the work
+	// over the job system (if given) when there's enough of it,
+	// and returns how many were dirty
+	unsigned int Update(JobSystem* jobs = 0);
+
+	// Fixed step support - alpha is 0 at the saved state and
+	// 1 at the current one
+	void BeginStep();
+	void Interpolate(float alpha, JobSystem* jobs = 0);
+
+	// Rebuilds every world matrix one at a time with separate
+	// matrices, for checking Update()
+	void UpdateReference();
+
+	// Getters
+	DirectX::XMFLOAT3 GetPosition(unsigned int transform);
+	DirectX::XMFLOAT3 GetRotation(unsigned int transform);
+	DirectX::XMFLOAT3 GetScale(unsigned int transform);
+	DirectX::XMFLOAT4X4* GetWorldMatrix(unsigned int transform) { return &worldMatrices[transform]; }
+	unsigned int GetCount() { return count; }
+
+private:
+	unsigned int count;
+
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> rotationX;
+	std::vector<float> rotationY;
+	std::vector<float> rotationZ;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+
+	// State as of the last BeginStep()
+	std::vector<float> previousPositionX;
+	std::vector<float> previousPositionY;
+	std::vector<float> previousPositionZ;
+	std::vector<float> previousRotationX;
+	std::vector<float> previousRotationY;
+	std::vector<float> previousRotationZ;
+	std::vector<float> previousScaleX;
+	std::vector<float> previousScaleY;
+	std::vector<float> previousScaleZ;
+
+	// One bit per transform each - changed since Update(),
+	// rebuilt since BeginStep(), and rebuilt in the step before
+	std::vector<unsigned int> dirty;
+	std::vector<unsigned int> moved;
+	std::vector<unsigned int> movedBefore;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+	void MarkDirty(unsigned int transform) { dirty[transform >> 5] |= 1u << (transform & 31); }
+	unsigned int UpdateWords(unsigned int firstWord, unsigned int endWord);
+	void InterpolateWords(unsigned int firstWord, unsigned int endWord, float alpha);
+	void ComposeFour(unsigned int first, float alpha = 1.0f);
+};
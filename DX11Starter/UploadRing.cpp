@@ -0,0 +1,126 @@
+#include "UploadRing.h"
+
+// --------------------------------------------------------
+// Constructor
+//
+// capacity  - Size of the region being carved up (rounded
+//             down to a multiple of the alignment)
+// alignment - Every slice starts on and is padded to this
+//             many bytes.  Must be a power of two.
+// --------------------------------------------------------
+UploadRing::UploadRing(unsigned int capacity, unsigned int alignment)
+{
+	this->alignment = alignment;
+	this->capacity = capacity & ~(alignment - 1);
+
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameBytes = 0;
+
+	failedAllocations = 0;
+	wrapCount = 0;
+}
+
+// Nothing to really do
+UploadRing::~UploadRing()
+{ }
+
+// --------------------------------------------------------
+// Grabs the next aligned slice of the ring
+//
+// size   - Bytes needed (rounded up to the alignment)
+// offset - Receives the slice's offset from the start of the region
+//
+// Returns false if there isn't enough contiguous space left
+// without stomping on a frame that hasn't retired yet
+// --------------------------------------------------------
+bool UploadRing::Allocate(unsigned int size, unsigned int* offset)
+{
+	unsigned int aligned = (size + alignment - 1) & ~(alignment - 1);
+	if (aligned == 0 || aligned > capacity || used + aligned > capacity)
+	{
+		failedAllocations++;
+		return false;
+	}
+
+	// Everything is free, so start back at the beginning.  Any
+	// frames still waiting are empty, so they end there too -
+	// otherwise retiring one would move the tail back to where
+	// the head used to be.
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+		for (FrameMark& mark : frames)
+			mark.End = 0;
+	}
+
+	if (head >= tail && used < capacity)
+	{
+		// Not wrapped - free space is [head, capacity) and [0, tail)
+		if (head + aligned <= capacity)
+		{
+			*offset = head;
+		}
+		else if (aligned <= tail)
+		{
+			// Doesn't fit at the end, so waste the tail and wrap
+			unsigned int wasted = capacity - head;
+			used += wasted;
+			frameBytes += wasted;
+			head = 0;
+			wrapCount++;
+			*offset = 0;
+		}
+		else
+		{
+			failedAllocations++;
+			return false;
+		}
+	}
+	else
+	{
+		// Wrapped - free space is only [head, tail)
+		if (head + aligned > tail)
+		{
+			failedAllocations++;
+			return false;
+		}
+		*offset = head;
+	}
+
+	head = *offset + aligned;
+	if (head == capacity) head = 0;
+	used += aligned;
+	frameBytes += aligned;
+	return true;
+}
+
+// --------------------------------------------------------
+// Closes out the current frame's allocations.  They stay
+// reserved until a fence at least this large is retired.
+// --------------------------------------------------------
+void UploadRing::EndFrame(unsigned long long fence)
+{
+	FrameMark mark;
+	mark.Fence = fence;
+	mark.Bytes = frameBytes;
+	mark.End = head;
+	frames.push_back(mark);
+
+	frameBytes = 0;
+}
+
+// --------------------------------------------------------
+// Releases every finished frame whose fence has completed
+// --------------------------------------------------------
+void UploadRing::Retire(unsigned long long completedFence)
+{
+	while (!frames.empty() && frames.front().Fence <= completedFence)
+	{
+		used -= frames.front().Bytes;
+		tail = frames.front().End;
+		frames.pop_front();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+
+// --------------------------------------------------------
+// A linear ring allocator that hands out aligned slices of a
+// fixed-size upload region.  It only does the bookkeeping
+// (offsets, wraparound and frame recycling) - it has no idea
+// what memory it is carving up, so it can run anywhere.
+//
+// Each frame's allocations are tagged with a fence value in
+// EndFrame(), and only become reusable once Retire() is told
+// that fence has completed.
+// --------------------------------------------------------
+class UploadRing
+{
+public:
+	UploadRing(unsigned int capacity, unsigned int alignment = 256);
+	~UploadRing();
+
+	// Allocating slices - returns false if the ring is full
+	bool Allocate(unsigned int size, unsigned int* offset);
+
+	// Frame recycling
+	void EndFrame(unsigned long long fence);
+	void Retire(unsigned long long completedFence);
+
+	// Getters
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetAlignment() { return alignment; }
+	unsigned int GetUsedBytes() { return used; }
+	unsigned int GetFramesInFlight() { return (unsigned int)frames.size(); }
+	unsigned int GetFailedAllocations() { return failedAllocations; }
+	unsigned int GetWrapCount() { return wrapCount; }
+
+private:
+	// A finished frame still waiting on its fence
+	struct FrameMark
+	{
+		unsigned long long Fence;
+		unsigned int Bytes;	// Everything this frame consumed, including wasted tail space
+		unsigned int End;	// Where the head was when the frame ended
+	};
+
+	unsigned int capacity;
+	unsigned int alignment;
+
+	unsigned int head;		// Next free byte
+	unsigned int tail;		// Oldest byte still in use
+	unsigned int used;		// Bytes between tail and head (with wrap)
+	unsigned int frameBytes;// Bytes consumed by the current frame so far
+	std::deque<FrameMark> frames;
+
+	// Stats
+	unsigned int failedAllocations;
+	unsigned int wrapCount;
+};
@@ -1,4 +1,4 @@
-cbuffer externalData : register(b0)
+cbuffer perFrame : register(b0)
 {
 	float2 screenSpaceLightPos;
 	float density;
@@ -1,4 +1,4 @@
-cbuffer externalData : register(b0)
+cbuffer perMaterial : register(b0)
 {
 	float3 color;
 };
@@ -1,12 +1,18 @@
 
-// Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+// Constant Buffers for external (C++) data, split by
+// how often they change so each can be uploaded only
+// as often as it needs to be
+cbuffer perFrame : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
 };
 
+cbuffer perObject : register(b1)
+{
+	matrix world;
+};
+
 // Struct representing a single vertex worth of data
 struct VertexShaderInput
 {
@@ -0,0 +1,375 @@
+#include "TestFramework.h"
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Keeps the same (fattened) boxes the tree should have, so
+// queries can be answered by testing every one of them
+// --------------------------------------------------------
+struct BruteForceBoxes
+{
+	std::vector<XMFLOAT3> Min;
+	std::vector<XMFLOAT3> Max;
+	std::vector<bool> Alive;
+
+	void Set(unsigned int payload, const XMFLOAT3& min, const XMFLOAT3& max, float margin)
+	{
+		if (payload >= Min.size())
+		{
+			Min.resize(payload + 1);
+			Max.resize(payload + 1);
+			Alive.resize(payload + 1, false);
+		}
+		Min[payload] = XMFLOAT3(min.x - margin, min.y - margin, min.z - margin);
+		Max[payload] = XMFLOAT3(max.x + margin, max.y + margin, max.z + margin);
+		Alive[payload] = true;
+	}
+};
+
+static void RandomBox(std::mt19937* random, float range, XMFLOAT3* min, XMFLOAT3* max)
+{
+	std::uniform_real_distribution<float> position(-range, range);
+	std::uniform_real_distribution<float> size(0.1f, 4.0f);
+	*min = XMFLOAT3(position(*random), position(*random), position(*random));
+	*max = XMFLOAT3(min->x + size(*random), min->y + size(*random), min->z + size(*random));
+}
+
+// Entry distance of a ray into a box, the same slab test the tree uses
+static bool RayEntry(const XMFLOAT3& min, const XMFLOAT3& max, const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float* entry)
+{
+	const float* lo = &min.x;
+	const float* hi = &max.x;
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	float enter = 0.0f, exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (d[axis] == 0.0f)
+		{
+			if (o[axis] < lo[axis] || o[axis] > hi[axis])
+				return false;
+			continue;
+		}
+		float t1 = (lo[axis] - o[axis]) / d[axis];
+		float t2 = (hi[axis] - o[axis]) / d[axis];
+		if (t1 > t2) std::swap(t1, t2);
+		enter = std::max(enter, t1);
+		exit = std::min(exit, t2);
+		if (enter > exit)
+			return false;
+	}
+	*entry = enter;
+	return true;
+}
+
+static bool Same(std::vector<unsigned int> a, std::vector<unsigned int> b)
+{
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	return a == b;
+}
+
+// --------------------------------------------------------
+// Inserts, moves and removes random boxes, then checks the
+// frustum, overlap and ray queries against testing every box
+// --------------------------------------------------------
+TEST(AABBTreeMatchesBruteForce)
+{
+	const float margin = 0.5f;
+	const unsigned int count = 4000;
+	AABBTree tree(margin);
+	BruteForceBoxes boxes;
+	std::vector<int> proxies(count);
+	std::mt19937 random(11);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 min, max;
+		RandomBox(&random, 100.0f, &min, &max);
+		proxies[i] = tree.Insert(min, max, i);
+		boxes.Set(i, min, max, margin);
+	}
+
+	// Small moves mostly stay in the fattened box, big ones don't
+	std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+	for (unsigned int frame = 0; frame < 20; frame++)
+	{
+		for (unsigned int i = frame % 3; i < count; i += 3)
+		{
+			if (!boxes.Alive[i])
+				continue;
+			XMFLOAT3 min, max;
+			if (random() % 10 == 0)
+				RandomBox(&random, 100.0f, &min, &max);
+			else
+			{
+				float dx = jitter(random), dy = jitter(random), dz = jitter(random);
+				XMFLOAT3 oldMin(boxes.Min[i].x + margin, boxes.Min[i].y + margin, boxes.Min[i].z + margin);
+				XMFLOAT3 oldMax(boxes.Max[i].x - margin, boxes.Max[i].y - margin, boxes.Max[i].z - margin);
+				min = XMFLOAT3(oldMin.x + dx, oldMin.y + dy, oldMin.z + dz);
+				max = XMFLOAT3(oldMax.x + dx, oldMax.y + dy, oldMax.z + dz);
+			}
+			if (tree.Move(proxies[i], min, max))
+				boxes.Set(i, min, max, margin);
+		}
+	}
+
+	for (unsigned int i = 0; i < count; i += 7)
+	{
+		tree.Remove(proxies[i]);
+		boxes.Alive[i] = false;
+	}
+	CHECK(tree.GetProxyCount() == count - (count + 6) / 7);
+	CHECK(tree.GetHeight() < 40);
+
+	// Frustum, from a few directions
+	std::vector<unsigned int> found, expected;
+	for (float yaw = 0.0f; yaw < 6.28f; yaw += 1.1f)
+	{
+		XMMATRIX viewProj = XMMatrixMultiply(XMMatrixRotationY(yaw), XMMatrixPerspectiveFovLH(1.0f, 1.5f, 0.1f, 80.0f));
+		Frustum frustum = Frustum::FromViewProjection(viewProj);
+		tree.QueryFrustum(frustum, &found);
+
+		FrustumCuller culler;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const XMFLOAT3& min = boxes.Min[i];
+			const XMFLOAT3& max = boxes.Max[i];
+			XMFLOAT3 center((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+			culler.Add(center, XMFLOAT3(max.x - center.x, max.y - center.y, max.z - center.z), 1e30f);
+		}
+		std::vector<unsigned int> visible;
+		culler.CullReference(frustum, &visible);
+		expected.clear();
+		for (unsigned int i : visible)
+		{
+			if (boxes.Alive[i])
+				expected.push_back(i);
+		}
+		CHECK(Same(found, expected));
+		CHECK(!expected.empty());
+	}
+
+	// Overlap
+	for (unsigned int q = 0; q < 50; q++)
+	{
+		XMFLOAT3 min, max;
+		RandomBox(&random, 100.0f, &min, &max);
+		max = XMFLOAT3(max.x + 10.0f, max.y + 10.0f, max.z + 10.0f);
+		tree.QueryOverlap(min, max, &found);
+
+		expected.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (boxes.Alive[i] &&
+				boxes.Min[i].x <= max.x && boxes.Min[i].y <= max.y && boxes.Min[i].z <= max.z &&
+				boxes.Max[i].x >= min.x && boxes.Max[i].y >= min.y && boxes.Max[i].z >= min.z)
+				expected.push_back(i);
+		}
+		CHECK(Same(found, expected));
+	}
+
+	// Rays, every hit and the closest
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	unsigned int hits = 0;
+	for (unsigned int q = 0; q < 200; q++)
+	{
+		XMFLOAT3 origin(axis(random) * 100.0f, axis(random) * 100.0f, axis(random) * 100.0f);
+		XMFLOAT3 direction(axis(random), axis(random), q % 10 == 0 ? 0.0f : axis(random));
+		tree.QueryRay(origin, direction, 150.0f, &found);
+
+		expected.clear();
+		float closest = 150.0f;
+		bool anyHit = false;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float entry;
+			if (boxes.Alive[i] && RayEntry(boxes.Min[i], boxes.Max[i], origin, direction, 150.0f, &entry))
+			{
+				expected.push_back(i);
+				closest = std::min(closest, entry);
+				anyHit = true;
+			}
+		}
+		CHECK(Same(found, expected));
+
+		unsigned int payload;
+		float distance;
+		bool hit = tree.Raycast(origin, direction, 150.0f, &payload, &distance);
+		CHECK(hit == anyHit);
+		if (hit && anyHit)
+		{
+			CHECK(distance == closest);
+			float entry;
+			CHECK(RayEntry(boxes.Min[payload], boxes.Max[payload], origin, direction, 150.0f, &entry) && entry == closest);
+			hits++;
+		}
+	}
+	CHECK(hits > 20);
+}
+
+TEST(AABBTreeSmallMovesStayPut)
+{
+	AABBTree tree(0.5f);
+	int proxy = tree.Insert(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), 7);
+	CHECK(!tree.Move(proxy, XMFLOAT3(0.4f, 0, 0), XMFLOAT3(1.4f, 1, 1)));
+	CHECK(tree.Move(proxy, XMFLOAT3(0.6f, 0, 0), XMFLOAT3(1.6f, 1, 1)));
+	CHECK(tree.GetPayload(proxy) == 7);
+
+	// Ids of removed proxies are reused, others are untouched
+	int other = tree.Insert(XMFLOAT3(5, 5, 5), XMFLOAT3(6, 6, 6), 8);
+	tree.Remove(proxy);
+	int reused = tree.Insert(XMFLOAT3(5, 5, 5), XMFLOAT3(6, 6, 6), 9);
+	CHECK(reused == proxy);
+	CHECK(tree.GetPayload(other) == 8);
+
+	std::vector<unsigned int> found;
+	tree.QueryOverlap(XMFLOAT3(0, 0, 0), XMFLOAT3(2, 2, 2), &found);
+	CHECK(found.empty());
+
+	tree.Clear();
+	unsigned int payload;
+	float distance;
+	CHECK(!tree.Raycast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 100.0f, &payload, &distance));
+	CHECK(tree.GetProxyCount() == 0);
+}
+
+// --------------------------------------------------------
+// 100k proxies with a tenth of them moving every frame, the
+// way the scene's entities update the tree, then frustum,
+// ray and overlap queries against the tree and against
+// every box
+// --------------------------------------------------------
+BENCHMARK(AABBTreeRefit100k)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int count = 100000;
+	AABBTree tree(0.5f);
+	std::vector<int> proxies(count);
+	std::vector<XMFLOAT3> mins(count), maxs(count);
+	std::mt19937 random(5);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		RandomBox(&random, 500.0f, &mins[i], &maxs[i]);
+		proxies[i] = tree.Insert(mins[i], maxs[i], i);
+	}
+
+	std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+	Frustum frustum = Frustum::FromViewProjection(XMMatrixPerspectiveFovLH(1.0f, 1.78f, 0.1f, 300.0f));
+	std::vector<unsigned int> found;
+	double moveMs = 0.0, queryMs = 0.0;
+	unsigned int reinserted = 0;
+	const unsigned int frames = 60;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = frame % 10; i < count; i += 10)
+		{
+			float dx = step(random), dz = step(random);
+			mins[i].x += dx; maxs[i].x += dx;
+			mins[i].z += dz; maxs[i].z += dz;
+			if (tree.Move(proxies[i], mins[i], maxs[i]))
+				reinserted++;
+		}
+		Clock::time_point moved = Clock::now();
+		tree.QueryFrustum(frustum, &found);
+		Clock::time_point queried = Clock::now();
+
+		moveMs += std::chrono::duration<double, std::milli>(moved - start).count();
+		queryMs += std::chrono::duration<double, std::milli>(queried - moved).count();
+	}
+
+	FrustumCuller culler;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 extents((maxs[i].x - mins[i].x) * 0.5f, (maxs[i].y - mins[i].y) * 0.5f, (maxs[i].z - mins[i].z) * 0.5f);
+		culler.Add(XMFLOAT3(mins[i].x + extents.x, mins[i].y + extents.y, mins[i].z + extents.z), extents, 1e30f);
+	}
+	std::vector<unsigned int> visible;
+	Clock::time_point start = Clock::now();
+	culler.CullReference(frustum, &visible);
+	double bruteMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	printf("  Move %.3fms, query %.3fms per frame (every box: %.3fms); %.1f%% of moves reinserted, height %d\n",
+		moveMs / frames, queryMs / frames, bruteMs, 100.0 * reinserted / (frames * count / 10), tree.GetHeight());
+	CHECK(found.size() >= visible.size());
+
+	// Closest hits for rays across the scene, and small box
+	// overlaps, against the tree and (for a few) every box
+	const unsigned int queries = 20000, bruteQueries = 100;
+	std::vector<XMFLOAT3> origins(queries), directions(queries), overlapMins(queries), overlapMaxs(queries);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	for (unsigned int q = 0; q < queries; q++)
+	{
+		origins[q] = XMFLOAT3(axis(random) * 500.0f, axis(random) * 500.0f, axis(random) * 500.0f);
+		directions[q] = XMFLOAT3(axis(random), axis(random), axis(random));
+		RandomBox(&random, 500.0f, &overlapMins[q], &overlapMaxs[q]);
+		overlapMaxs[q] = XMFLOAT3(overlapMaxs[q].x + 20.0f, overlapMaxs[q].y + 20.0f, overlapMaxs[q].z + 20.0f);
+	}
+
+	// The tree's boxes are fattened, so it hits at least as often
+	unsigned int hits = 0, firstHits = 0, bruteHits = 0;
+	start = Clock::now();
+	for (unsigned int q = 0; q < queries; q++)
+	{
+		unsigned int payload;
+		float distance;
+		if (tree.Raycast(origins[q], directions[q], 200.0f, &payload, &distance))
+		{
+			hits++;
+			if (q < bruteQueries)
+				firstHits++;
+		}
+	}
+	double rayMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	start = Clock::now();
+	for (unsigned int q = 0; q < bruteQueries; q++)
+	{
+		bool anyHit = false;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float entry;
+			if (RayEntry(mins[i], maxs[i], origins[q], directions[q], 200.0f, &entry))
+				anyHit = true;
+		}
+		if (anyHit)
+			bruteHits++;
+	}
+	double bruteRayMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	size_t overlaps = 0;
+	start = Clock::now();
+	for (unsigned int q = 0; q < queries; q++)
+	{
+		tree.QueryOverlap(overlapMins[q], overlapMaxs[q], &found);
+		overlaps += found.size();
+	}
+	double overlapMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	start = Clock::now();
+	for (unsigned int q = 0; q < bruteQueries; q++)
+	{
+		const XMFLOAT3& min = overlapMins[q];
+		const XMFLOAT3& max = overlapMaxs[q];
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (mins[i].x <= max.x && mins[i].y <= max.y && mins[i].z <= max.z &&
+				maxs[i].x >= min.x && maxs[i].y >= min.y && maxs[i].z >= min.z)
+				found.push_back(i);
+		}
+	}
+	double bruteOverlapMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	printf("  Raycast %.0fk/s (every box: %.1fk/s), %.1f%% hit; overlap %.0fk/s (every box: %.1fk/s), %.2f found each\n",
+		queries / rayMs, bruteQueries / bruteRayMs, 100.0 * hits / queries,
+		queries / overlapMs, bruteQueries / bruteOverlapMs, (double)overlaps / queries);
+	CHECK(firstHits >= bruteHits);
+}
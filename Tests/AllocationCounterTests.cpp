@@ -0,0 +1,141 @@
+#include "TestFramework.h"
+#include "AllocationCounter.h"
+#include "DrawRun.h"
+#include "NullRenderDevice.h"
+#include "RenderCommandList.h"
+#include "StateCache.h"
+
+#include <cstdint>
+#include <random>
+
+// Where allocations are kept, so the compiler can't leave
+// out a new and delete pair
+static void* volatile escaped;
+
+TEST(AllocationCounterCountsEveryForm)
+{
+	CHECK(AllocationCounter::IsEnabled());
+
+	unsigned long long allocations = AllocationCounter::GetThreadAllocations();
+	unsigned long long bytes = AllocationCounter::GetThreadBytesAllocated();
+	long long live = AllocationCounter::GetThreadBytesLive();
+
+	int* one = new int(5);
+	int* many = new int[10];
+	int* quiet = new (std::nothrow) int[3];
+	escaped = one;
+	escaped = many;
+	escaped = quiet;
+	CHECK(AllocationCounter::GetThreadAllocations() - allocations == 3);
+	CHECK(AllocationCounter::GetThreadBytesAllocated() - bytes == 14 * sizeof(int));
+	CHECK(AllocationCounter::GetThreadBytesLive() - live == 14 * sizeof(int));
+
+	delete one;
+	delete[] many;
+	delete[] quiet;
+	CHECK(AllocationCounter::GetThreadBytesLive() == live);
+}
+
+#ifdef __cpp_aligned_new
+struct alignas(64) CacheLine { char Bytes[64]; };
+struct alignas(4096) Page { char Bytes[4096]; };
+
+// Over-aligned types go through the aligned forms, and must
+// come back aligned as well as counted
+TEST(AllocationCounterCountsAlignedForms)
+{
+	unsigned long long allocations = AllocationCounter::GetThreadAllocations();
+	long long live = AllocationCounter::GetThreadBytesLive();
+
+	CacheLine* line = new CacheLine();
+	CacheLine* lines = new CacheLine[5];
+	Page* page = new (std::nothrow) Page();
+	escaped = line;
+	escaped = lines;
+	escaped = page;
+	CHECK((uintptr_t)line % 64 == 0);
+	CHECK((uintptr_t)lines % 64 == 0);
+	CHECK((uintptr_t)page % 4096 == 0);
+	CHECK(AllocationCounter::GetThreadAllocations() - allocations == 3);
+	CHECK(AllocationCounter::GetThreadBytesLive() - live >= (long long)(6 * sizeof(CacheLine) + sizeof(Page)));
+
+	delete line;
+	delete[] lines;
+	delete page;
+	CHECK(AllocationCounter::GetThreadBytesLive() == live);
+}
+#endif
+
+// --------------------------------------------------------
+// Prepares and draws frames the way Game does - draws queued
+// and sorted in the frame's arena, grouped into runs, then
+// recorded into a list through the state cache and played
+// onto the device.  Once everything has grown to fit, a
+// frame mustn't touch the heap at all.
+// --------------------------------------------------------
+TEST(SteadyFramesDontAllocate)
+{
+	const unsigned int maxDraws = 5000;
+	FrameArena arena;
+	RenderQueue queue;
+	RenderCommandList list;
+	NullRenderDevice device;
+	StateCache cache(&device);
+	std::mt19937 random(9);
+
+	unsigned long long allocatingFrames = 0;
+	unsigned long long allocations = 0;
+	for (unsigned int frame = 0; frame < 110; frame++)
+	{
+		// The first frames are the biggest, so the rest fit
+		unsigned int count = frame < 10 ? maxDraws : maxDraws - random() % 1000;
+		unsigned long long before = AllocationCounter::GetThreadAllocations();
+
+		arena.Reset();
+		queue.Begin(&arena, count);
+		OpaqueDraw* draws = arena.AllocateArray<OpaqueDraw>(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int mesh = random() % 16;
+			draws[i].SubMesh = Fake<Mesh>(mesh);
+			draws[i].Entity = Fake<GameEntity>(16 + i % 8);
+			draws[i].Material = random() % 8;
+			queue.Add(RenderQueue::MakeKey(0, 0, draws[i].Material, mesh, (random() % 1000) / 1000.0f), i);
+		}
+		queue.Sort();
+
+		DirectX::XMFLOAT4X4* instances = arena.AllocateArray<DirectX::XMFLOAT4X4>(count);
+		DrawRun* runs = arena.AllocateArray<DrawRun>(count);
+		unsigned int runCount = BuildDrawRuns(queue.GetEntries(), count, draws, instances, runs);
+
+		IRenderDevice* target = list.Begin();
+		cache.ApplyTo(target);
+		unsigned int stride = 48;
+		unsigned int offset = 0;
+		for (unsigned int r = 0; r < runCount; r++)
+		{
+			ID3D11Buffer* vb = Fake<ID3D11Buffer>(FakeIndex(runs[r].SubMesh));
+			ID3D11ShaderResourceView* view = Fake<ID3D11ShaderResourceView>(32 + runs[r].Material);
+			target->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+			target->PSSetShaderResources(0, 1, &view);
+			target->DrawIndexedInstanced(36, runs[r].InstanceCount, 0, 0, runs[r].FirstInstance);
+		}
+		list.Finish();
+
+		device.Clear();
+		cache.Invalidate();
+		list.Execute(&cache);
+
+		if (frame >= 10)
+		{
+			unsigned long long made = AllocationCounter::GetThreadAllocations() - before;
+			allocations += made;
+			if (made > 0)
+				allocatingFrames++;
+		}
+		CHECK(device.GetStats().DrawCalls == runCount);
+	}
+
+	CHECK(allocations == 0);
+	CHECK(allocatingFrames == 0);
+}
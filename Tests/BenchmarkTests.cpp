@@ -0,0 +1,213 @@
+#include "TestFramework.h"
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static const char* ScriptPath = "BenchmarkTests.txt";
+static const char* ReportPath = "BenchmarkTests.json";
+
+// Writes a script file
+static void WriteScript(const char* text)
+{
+	std::ofstream file(ScriptPath);
+	file << text;
+}
+
+// Reads a whole file back
+static std::string ReadFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+TEST(BenchmarkScriptLoadsScripts)
+{
+	WriteScript(
+		"# A short flight\n"
+		"camera 1 0 0 0 0 0\n"
+		"\n"
+		"camera 3 2 4 6 1 2   # halfway up\n"
+		"entity 2 5\n"
+		"environment 0.5 1\n"
+		"entity 1 3\n");
+
+	BenchmarkScript script;
+	CHECK(script.Load(ScriptPath));
+
+	DirectX::XMFLOAT3 position;
+	float pitch, yaw;
+	script.SampleCamera(2.0f, &position, &pitch, &yaw);
+	CHECK_NEAR(position.x, 1.0f, 1e-5f);
+	CHECK_NEAR(position.y, 2.0f, 1e-5f);
+	CHECK_NEAR(position.z, 3.0f, 1e-5f);
+	CHECK_NEAR(pitch, 0.5f, 1e-5f);
+	CHECK_NEAR(yaw, 1.0f, 1e-5f);
+
+	CHECK(script.GetEntity(1.5f, 0) == 3);
+	CHECK(script.GetEnvironment(0.5f, 0) == 1);
+	remove(ScriptPath);
+}
+
+TEST(BenchmarkScriptRejectsBadScripts)
+{
+	const char* bad[] =
+	{
+		"camera 0 0 0 0 0 0\nfly 1 2 3\n",				// Unknown command
+		"camera 0 0 0 0 0\n",							// Missing yaw
+		"camera 0 0 0 0 0 0\nentity 1\n",				// Missing index
+		"camera 2 0 0 0 0 0\ncamera 1 0 0 0 0 0\n",		// Keys out of order
+		"entity 0 1\n# No camera at all\n",
+		"",
+	};
+
+	for (const char* text : bad)
+	{
+		WriteScript(text);
+		BenchmarkScript script;
+		CHECK(!script.Load(ScriptPath));
+	}
+
+	remove(ScriptPath);
+	BenchmarkScript script;
+	CHECK(!script.Load(ScriptPath));
+}
+
+TEST(BenchmarkScriptClampsTheCamera)
+{
+	WriteScript(
+		"camera 1 0 0 0 0 0\n"
+		"camera 1 5 5 5 0 0\n"	// Same time, so it jumps
+		"camera 3 7 5 5 1 2\n");
+
+	BenchmarkScript script;
+	CHECK(script.Load(ScriptPath));
+
+	// Holds still before the first key, and after the last
+	DirectX::XMFLOAT3 position;
+	float pitch, yaw;
+	script.SampleCamera(0.0f, &position, &pitch, &yaw);
+	CHECK(position.x == 0.0f && pitch == 0.0f && yaw == 0.0f);
+	script.SampleCamera(3.0f, &position, &pitch, &yaw);
+	CHECK(position.x == 7.0f && pitch == 1.0f && yaw == 2.0f);
+	script.SampleCamera(100.0f, &position, &pitch, &yaw);
+	CHECK(position.x == 7.0f && pitch == 1.0f && yaw == 2.0f);
+
+	// At the repeated key, the later one wins
+	script.SampleCamera(1.0f, &position, &pitch, &yaw);
+	CHECK(position.x == 5.0f);
+	script.SampleCamera(2.0f, &position, &pitch, &yaw);
+	CHECK_NEAR(position.x, 6.0f, 1e-5f);
+	CHECK_NEAR(yaw, 1.0f, 1e-5f);
+
+	// An empty script leaves the camera alone
+	BenchmarkScript empty;
+	position = DirectX::XMFLOAT3(9.0f, 9.0f, 9.0f);
+	empty.SampleCamera(1.0f, &position, &pitch, &yaw);
+	CHECK(position.x == 9.0f);
+	remove(ScriptPath);
+}
+
+TEST(BenchmarkScriptOrdersSwitches)
+{
+	// Sorted by time, keeping file order for equal times
+	WriteScript(
+		"camera 0 0 0 0 0 0\n"
+		"entity 2 5\n"
+		"entity 1 3\n"
+		"entity 2 6\n"
+		"environment 4 2\n");
+
+	BenchmarkScript script;
+	CHECK(script.Load(ScriptPath));
+	CHECK(script.GetEntity(0.5f, 42) == 42);
+	CHECK(script.GetEntity(1.0f, 42) == 3);
+	CHECK(script.GetEntity(1.9f, 42) == 3);
+	CHECK(script.GetEntity(2.0f, 42) == 6);
+	CHECK(script.GetEntity(99.0f, 42) == 6);
+	CHECK(script.GetEnvironment(3.0f, 7) == 7);
+	CHECK(script.GetEnvironment(4.0f, 7) == 2);
+	remove(ScriptPath);
+}
+
+TEST(BenchmarkScriptBuildsADefaultLoop)
+{
+	BenchmarkScript script;
+	script.BuildDefault();
+
+	// Starts and ends 5 behind the origin, looking at it
+	DirectX::XMFLOAT3 position;
+	float pitch, yaw;
+	script.SampleCamera(0.0f, &position, &pitch, &yaw);
+	CHECK_NEAR(position.x, 0.0f, 1e-4f);
+	CHECK_NEAR(position.y, 0.0f, 1e-4f);
+	CHECK_NEAR(position.z, -5.0f, 1e-4f);
+	CHECK_NEAR(pitch, 0.0f, 1e-4f);
+	CHECK_NEAR(yaw, 0.0f, 1e-4f);
+	script.SampleCamera(16.0f, &position, &pitch, &yaw);
+	CHECK_NEAR(position.x, 0.0f, 1e-4f);
+	CHECK_NEAR(position.z, -5.0f, 1e-4f);
+
+	// Every environment, and a few entities
+	CHECK(script.GetEnvironment(0.0f, 99) == 0);
+	CHECK(script.GetEnvironment(6.0f, 99) == 1);
+	CHECK(script.GetEnvironment(15.0f, 99) == 2);
+	CHECK(script.GetEntity(0.0f, 99) == 1);
+	CHECK(script.GetEntity(4.0f, 99) == 3);
+	CHECK(script.GetEntity(15.0f, 99) == 7);
+
+	// Loading over it starts afresh
+	WriteScript("camera 0 1 2 3 0 0\n");
+	CHECK(script.Load(ScriptPath));
+	CHECK(script.GetEntity(15.0f, 99) == 99);
+	remove(ScriptPath);
+}
+
+TEST(BenchmarkWritesAReport)
+{
+	BenchmarkScript script;
+	script.BuildDefault();
+	Benchmark benchmark(script, 10, 1.0f / 60.0f);
+
+	// The first call only starts the clock, and calls after
+	// the last frame are ignored
+	Profiler::SetEnabled(true);
+	Profiler::EndFrame();
+	for (unsigned int i = 0; i <= 12; i++)
+	{
+		{
+			PROFILE_SCOPE("Update");
+			PROFILE_SCOPE("Physics");
+		}
+		if (i % 2 == 0)
+		{
+			PROFILE_SCOPE("Draw");
+		}
+		Profiler::EndFrame();
+		benchmark.RecordFrame(i, i * 256, 0);
+	}
+	CHECK(benchmark.IsFinished());
+
+	CHECK(benchmark.WriteReport(ReportPath));
+	std::string report = ReadFile(ReportPath);
+	CHECK(IsWellFormedJson(report));
+	CHECK(report.find("\"frames\":10,") != std::string::npos);
+	CHECK(report.find("\"drawCalls\":{\"average\":5.5,\"p50\":5,\"p95\":10,\"p99\":10,\"max\":10}") != std::string::npos);
+	CHECK(report.find("\"bytesUploaded\":{\"average\":1408,\"p50\":1280,") != std::string::npos);
+	CHECK((report.find("\"heapAllocations\"") != std::string::npos) == AllocationCounter::IsEnabled());
+
+	// Passes in the order they first finished, per frame
+	size_t physics = report.find("{\"name\":\"Physics\",\"depth\":1,\"callsPerFrame\":1,");
+	size_t update = report.find("{\"name\":\"Update\",\"depth\":0,\"callsPerFrame\":1,");
+	size_t draw = report.find("{\"name\":\"Draw\",\"depth\":0,\"callsPerFrame\":0.5,");
+	CHECK(physics != std::string::npos && update != std::string::npos && draw != std::string::npos);
+	CHECK(physics < update && update < draw);
+
+	Profiler::SetEnabled(false);
+	Profiler::Shutdown();
+	remove(ReportPath);
+}
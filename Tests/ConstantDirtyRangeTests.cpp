@@ -0,0 +1,116 @@
+#include "TestFramework.h"
+#include "ConstantDirtyRange.h"
+#include "NullRenderDevice.h"
+
+#include <cstring>
+
+TEST(ConstantDirtyRangeSkipsUnchangedWrites)
+{
+	unsigned char buffer[64] = {};
+	ConstantDirtyRange changes;
+	CHECK(!changes.IsDirty());
+
+	// Zeros over zeros changes nothing
+	float zero[4] = {};
+	CHECK(!changes.Write(buffer, 16, zero, sizeof(zero)));
+	CHECK(!changes.IsDirty());
+
+	float value[4] = { 1, 2, 3, 4 };
+	CHECK(changes.Write(buffer, 16, value, sizeof(value)));
+	CHECK(changes.IsDirty());
+	CHECK(changes.GetStart() == 16 && changes.GetEnd() == 32);
+	CHECK(memcmp(buffer + 16, value, sizeof(value)) == 0);
+
+	// The same again doesn't widen anything
+	changes.MarkClean();
+	CHECK(!changes.Write(buffer, 16, value, sizeof(value)));
+	CHECK(!changes.IsDirty());
+}
+
+TEST(ConstantDirtyRangeCoversEveryChange)
+{
+	unsigned char buffer[256] = {};
+	ConstantDirtyRange changes;
+
+	int a = 1;
+	int b = 2;
+	changes.Write(buffer, 100, &a, sizeof(a));
+	changes.Write(buffer, 20, &b, sizeof(b));
+	changes.Write(buffer, 60, &a, sizeof(a));
+	CHECK(changes.GetStart() == 20 && changes.GetEnd() == 104);
+
+	// Whole constants when partial uploads work, else everything
+	unsigned int start = 0;
+	unsigned int end = 0;
+	CHECK(changes.GetUploadRange(256, true, &start, &end));
+	CHECK(start == 16 && end == 112);
+	CHECK(changes.GetUploadRange(256, false, &start, &end));
+	CHECK(start == 0 && end == 256);
+
+	// Rounding up never runs off the end
+	changes.MarkClean();
+	changes.Write(buffer, 250, &a, sizeof(a));
+	CHECK(changes.GetUploadRange(254, true, &start, &end));
+	CHECK(start == 240 && end == 254);
+
+	changes.MarkClean();
+	CHECK(!changes.GetUploadRange(256, true, &start, &end));
+	changes.MarkAll(256);
+	CHECK(changes.GetUploadRange(256, true, &start, &end));
+	CHECK(start == 0 && end == 256);
+}
+
+// --------------------------------------------------------
+// Shaped like RenderGeometry's per-object buffer: each draw
+// sets its world matrix and the (unchanging) light values,
+// then uploads whatever changed through the device, the way
+// ISimpleShader::UploadBuffer does
+// --------------------------------------------------------
+static void Upload(IRenderDevice* device, ID3D11Buffer* buffer, const unsigned char* local, unsigned int size, ConstantDirtyRange* changes, bool partial)
+{
+	unsigned int start;
+	unsigned int end;
+	if (!changes->GetUploadRange(size, partial, &start, &end))
+		return;
+
+	if (start > 0 || end < size)
+		device->UpdateBufferRange(buffer, local + start, start, end);
+	else
+		device->UpdateBuffer(buffer, local, size);
+	changes->MarkClean();
+}
+
+TEST(ConstantDirtyRangeOnlyUploadsWhatDrawsChange)
+{
+	const unsigned int size = 256;
+	const unsigned int draws = 100;
+	static char buffer;
+	NullRenderDevice device;
+
+	for (unsigned int partial = 0; partial < 2; partial++)
+	{
+		unsigned char local[size] = {};
+		ConstantDirtyRange changes;
+		changes.MarkAll(size);
+		device.Clear();
+
+		float light[8] = { 1, 2, 3, 1, 1, 1, 1, 1 };
+		for (unsigned int d = 0; d < draws; d++)
+		{
+			float world[16] = {};
+			world[5] = world[10] = world[15] = 1.0f;
+			world[0] = 1.0f + d / 4;	// Four draws per entity
+			world[12] = (float)(d / 4);
+			changes.Write(local, 0, world, sizeof(world));
+			changes.Write(local, 128, light, sizeof(light));
+			Upload(&device, (ID3D11Buffer*)&buffer, local, size, &changes, partial != 0);
+		}
+
+		// The first draw sends everything, then only each new
+		// entity's matrix goes up
+		const RenderCommandStats& stats = device.GetStats();
+		CHECK(stats.Uploads == 1 + draws / 4 - 1);
+		unsigned int perEntity = partial ? 64 : size;
+		CHECK(stats.BytesUploaded == size + (draws / 4 - 1) * perEntity);
+	}
+}
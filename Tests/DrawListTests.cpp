@@ -0,0 +1,316 @@
+#include "TestFramework.h"
+#include "DrawLists.h"
+#include "NullRenderDevice.h"
+#include "RenderCommandList.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <thread>
+
+static const unsigned int TriangleList = 4;
+
+// --------------------------------------------------------
+// Stands in for a deferred context: records like our own
+// lists, but plays back onto a context reset to defaults, so
+// its draws only see what was recorded into it
+// --------------------------------------------------------
+class BlankCommandList : public IRenderCommandList
+{
+public:
+	IRenderDevice* Begin() { return list.Begin(); }
+	void Finish() {}
+	bool StartsBlank() { return true; }
+
+	void Execute(IRenderDevice* target)
+	{
+		ID3D11Buffer* buffers[2] = {};
+		unsigned int zeros[2] = {};
+		ID3D11ShaderResourceView* views[3] = {};
+		ID3D11SamplerState* sampler = 0;
+		RenderViewport viewport = {};
+		target->IASetInputLayout(0);
+		target->IASetPrimitiveTopology(0);
+		target->IASetVertexBuffers(0, 2, buffers, zeros, zeros);
+		target->IASetIndexBuffer(0, 0, 0);
+		target->VSSetShader(0);
+		target->VSSetConstantBuffers1(0, 2, buffers, zeros, zeros);
+		target->PSSetShader(0);
+		target->PSSetShaderResources(0, 3, views);
+		target->PSSetSamplers(0, 1, &sampler);
+		target->RSSetViewports(1, &viewport);
+		target->OMSetRenderTargets(0, 0, 0);
+		list.Execute(target);
+	}
+
+private:
+	RenderCommandList list;
+};
+
+// A run of instances of one mesh with one material
+struct TestRun
+{
+	unsigned int Mesh;
+	unsigned int Material;
+	unsigned int StartInstance;
+	unsigned int InstanceCount;
+};
+
+// Binds and draws like Game::RecordDrawRuns
+static void RecordRuns(IRenderDevice* target, const std::vector<TestRun>& runs, unsigned int first, unsigned int last)
+{
+	unsigned int stride = 48;
+	unsigned int offset = 0;
+	unsigned int currentMaterial = 0xFFFFFFFF;
+	unsigned int currentMesh = 0xFFFFFFFF;
+	for (unsigned int r = first; r < last; r++)
+	{
+		const TestRun& run = runs[r];
+		if (run.Material != currentMaterial)
+		{
+			currentMaterial = run.Material;
+			ID3D11ShaderResourceView* views[3] =
+			{
+				Fake<ID3D11ShaderResourceView>(100 + run.Material),
+				Fake<ID3D11ShaderResourceView>(140 + run.Material),
+				Fake<ID3D11ShaderResourceView>(180),
+			};
+			target->PSSetShaderResources(0, 3, views);
+		}
+		if (run.Mesh != currentMesh)
+		{
+			currentMesh = run.Mesh;
+			ID3D11Buffer* vb = Fake<ID3D11Buffer>(run.Mesh);
+			target->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+			target->IASetIndexBuffer(Fake<ID3D11Buffer>(40 + run.Mesh), 42, 0);
+		}
+		target->DrawIndexedInstanced(36, run.InstanceCount, 0, 0, run.StartInstance);
+	}
+}
+
+// --------------------------------------------------------
+// Everything bound when each draw in a log was made, along
+// with the draw itself.  Binding nothing to a slot is the
+// same as never having bound it.
+// --------------------------------------------------------
+typedef std::vector<unsigned int> DrawState;
+
+static bool IsSlotCommand(RenderCommandType type)
+{
+	return type == RENDER_COMMAND_VERTEX_BUFFER || type == RENDER_COMMAND_VS_CONSTANT_BUFFER ||
+		type == RENDER_COMMAND_VS_SHADER_RESOURCE || type == RENDER_COMMAND_VS_SAMPLER ||
+		type == RENDER_COMMAND_PS_CONSTANT_BUFFER || type == RENDER_COMMAND_PS_SHADER_RESOURCE ||
+		type == RENDER_COMMAND_PS_SAMPLER || type == RENDER_COMMAND_VIEWPORT;
+}
+
+static std::vector<DrawState> StateAtDraws(const std::vector<RenderCommand>& commands)
+{
+	std::map<unsigned int, RenderCommand> bound;
+	std::vector<DrawState> draws;
+	for (const RenderCommand& command : commands)
+	{
+		if (command.Type == RENDER_COMMAND_DRAW_INDEXED_INSTANCED)
+		{
+			DrawState state(command.Args, command.Args + 5);
+			for (const auto& b : bound)
+			{
+				state.push_back(b.first);
+				state.insert(state.end(), b.second.Args, b.second.Args + 5);
+			}
+			draws.push_back(state);
+			continue;
+		}
+
+		bool slotted = IsSlotCommand(command.Type);
+		unsigned int key = command.Type * 64 + (slotted ? command.Args[0] : 0);
+		bool empty = true;
+		for (unsigned int a = slotted ? 1 : 0; a < 5; a++)
+			empty = empty && command.Args[a] == 0;
+		if (empty)
+			bound.erase(key);
+		else
+			bound[key] = command;
+	}
+	return draws;
+}
+
+// --------------------------------------------------------
+// Binds what Game does at startup, then optionally forgets
+// it the way a resize or a new instance buffer does
+// --------------------------------------------------------
+static void StartUp(StateCache* cache, bool invalidate)
+{
+	cache->IASetPrimitiveTopology(TriangleList);
+	if (invalidate)
+		cache->Invalidate();
+}
+
+// The per-frame binds Draw() and RenderGeometry() make before any runs
+static void BeginPass(StateCache* cache)
+{
+	RenderViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	ID3D11RenderTargetView* renderTarget = Fake<ID3D11RenderTargetView>(200);
+	ID3D11Buffer* instances = Fake<ID3D11Buffer>(201);
+	ID3D11Buffer* perFrame = Fake<ID3D11Buffer>(202);
+	ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(203);
+	unsigned int stride = 64;
+	unsigned int offset = 0;
+	unsigned int first = 0;
+	unsigned int count = 16;
+
+	cache->RSSetViewports(1, &viewport);
+	cache->OMSetRenderTargets(1, &renderTarget, Fake<ID3D11DepthStencilView>(204));
+	cache->IASetInputLayout(Fake<ID3D11InputLayout>(205));
+	cache->IASetVertexBuffers(1, 1, &instances, &stride, &offset);
+	cache->VSSetShader(Fake<ID3D11VertexShader>(206));
+	cache->VSSetConstantBuffers1(0, 1, &perFrame, &first, &count);
+	cache->PSSetShader(Fake<ID3D11PixelShader>(207));
+	cache->PSSetSamplers(0, 1, &sampler);
+}
+
+static std::vector<TestRun> MakeRuns(unsigned int count)
+{
+	std::mt19937 random(5);
+	std::vector<TestRun> runs(count);
+	unsigned int instance = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		runs[i].Material = (i / 7) % 30;
+		runs[i].Mesh = random() % 32;
+		runs[i].StartInstance = instance;
+		runs[i].InstanceCount = 1 + random() % 50;
+		instance += runs[i].InstanceCount;
+	}
+	return runs;
+}
+
+static std::vector<DrawState> DrawSerially(const std::vector<TestRun>& runs, bool invalidate)
+{
+	NullRenderDevice device;
+	StateCache cache(&device);
+	StartUp(&cache, invalidate);
+	BeginPass(&cache);
+	RecordRuns(&cache, runs, 0, (unsigned int)runs.size());
+	return StateAtDraws(device.GetCommands());
+}
+
+static std::vector<DrawState> DrawInLists(JobSystem* jobs, const std::vector<TestRun>& runs, unsigned int listCount, bool invalidate)
+{
+	NullRenderDevice device;
+	StateCache cache(&device);
+	StartUp(&cache, invalidate);
+	BeginPass(&cache);
+
+	std::vector<IRenderCommandList*> lists;
+	for (unsigned int i = 0; i < listCount; i++)
+		lists.push_back(new BlankCommandList());
+
+	DrawListSetup setup = { &cache, Fake<ID3D11RenderTargetView>(200), Fake<ID3D11DepthStencilView>(204), TriangleList };
+	RecordDrawLists(jobs, lists, setup, (unsigned int)runs.size(), [&](IRenderDevice* target, unsigned int first, unsigned int last)
+	{
+		RecordRuns(target, runs, first, last);
+	});
+
+	// Deferred contexts go around the cache
+	for (IRenderCommandList* list : lists)
+	{
+		list->Execute(&device);
+		delete list;
+	}
+	return StateAtDraws(device.GetCommands());
+}
+
+// --------------------------------------------------------
+// Recording across any number of blank lists must draw the
+// same things with the same state as recording serially -
+// including after the cache has forgotten the topology
+// --------------------------------------------------------
+TEST(DrawListsDrawLikeSerialRecording)
+{
+	JobSystem jobs(4);
+	std::vector<TestRun> runs = MakeRuns(1000);
+	const unsigned int listCounts[5] = { 1, 2, 4, 8, 16 };
+	for (unsigned int invalidate = 0; invalidate < 2; invalidate++)
+	{
+		std::vector<DrawState> serial = DrawSerially(runs, invalidate != 0);
+		CHECK(serial.size() == runs.size());
+		for (unsigned int c = 0; c < 5; c++)
+			CHECK(DrawInLists(&jobs, runs, listCounts[c], invalidate != 0) == serial);
+	}
+}
+
+// More lists than runs leaves some empty, which mustn't matter
+TEST(DrawListsHandleMoreListsThanRuns)
+{
+	JobSystem jobs(4);
+	std::vector<TestRun> runs = MakeRuns(3);
+	CHECK(DrawInLists(&jobs, runs, 8, true) == DrawSerially(runs, true));
+}
+
+// --------------------------------------------------------
+// Recording 50k runs on 1 list per thread, for 4, 8 and 16
+// threads, against recording them through the cache on one.
+// Playing the lists back is still serial, so it's timed on
+// its own.
+// --------------------------------------------------------
+BENCHMARK(DrawListScaling)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int frames = 20;
+	std::vector<TestRun> runs = MakeRuns(50000);
+	unsigned int runCount = (unsigned int)runs.size();
+
+	NullRenderDevice device;
+	StateCache cache(&device);
+	StartUp(&cache, false);
+	Clock::time_point start = Clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		device.Clear();
+		cache.Invalidate();
+		BeginPass(&cache);
+		RecordRuns(&cache, runs, 0, runCount);
+	}
+	double serialMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+	CHECK(device.GetStats().DrawCalls == runCount);
+	printf("  Serial %.3fms per frame; %u hardware threads\n", serialMs, std::thread::hardware_concurrency());
+
+	const unsigned int threadCounts[3] = { 4, 8, 16 };
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		JobSystem jobs(threadCounts[t]);
+		std::vector<IRenderCommandList*> lists;
+		for (unsigned int i = 0; i < threadCounts[t]; i++)
+			lists.push_back(new BlankCommandList());
+
+		double recordMs = 0.0, executeMs = 0.0;
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			device.Clear();
+			cache.Invalidate();
+			BeginPass(&cache);
+			DrawListSetup setup = { &cache, Fake<ID3D11RenderTargetView>(200), Fake<ID3D11DepthStencilView>(204), TriangleList };
+
+			Clock::time_point begin = Clock::now();
+			RecordDrawLists(&jobs, lists, setup, runCount, [&](IRenderDevice* target, unsigned int first, unsigned int last)
+			{
+				RecordRuns(target, runs, first, last);
+			});
+			Clock::time_point recorded = Clock::now();
+			for (IRenderCommandList* list : lists)
+				list->Execute(&device);
+			Clock::time_point executed = Clock::now();
+
+			recordMs += std::chrono::duration<double, std::milli>(recorded - begin).count();
+			executeMs += std::chrono::duration<double, std::milli>(executed - recorded).count();
+		}
+
+		printf("  %2u threads: record %.3fms (%.2fx serial), execute %.3fms per frame\n",
+			threadCounts[t], recordMs / frames, serialMs * frames / recordMs, executeMs / frames);
+		CHECK(device.GetStats().DrawCalls == runCount);
+
+		for (IRenderCommandList* list : lists)
+			delete list;
+	}
+}
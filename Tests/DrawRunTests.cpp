@@ -0,0 +1,113 @@
+#include "TestFramework.h"
+#include "DrawRun.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+
+#include <random>
+
+// --------------------------------------------------------
+// A scene of 10k spheres in four materials plus one entity
+// made of four meshes, queued and sorted as the opaque pass
+// does, should come out as eight instanced draws
+// --------------------------------------------------------
+TEST(DrawRunsInstanceTenThousandSpheres)
+{
+	const unsigned int spheres = 10000;
+	std::vector<OpaqueDraw> draws;
+	std::mt19937 random(3);
+	for (unsigned int i = 0; i < spheres; i++)
+	{
+		OpaqueDraw draw = { Fake<Mesh>(0), Fake<GameEntity>(10 + i % 8), (i % 4) << 4, DirectX::XMFLOAT4X4() };
+		draw.World._14 = (float)i;	// Tags the matrix with its draw
+		draws.push_back(draw);
+	}
+	for (unsigned int m = 0; m < 4; m++)
+	{
+		OpaqueDraw draw = { Fake<Mesh>(1 + m), Fake<GameEntity>(20), 5 << 4, DirectX::XMFLOAT4X4() };
+		draw.World._14 = (float)draws.size();
+		draws.push_back(draw);
+	}
+
+	FrameArena arena;
+	RenderQueue queue;
+	unsigned int count = (unsigned int)draws.size();
+	queue.Begin(&arena, count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int mesh = FakeIndex(draws[i].SubMesh);
+		queue.Add(RenderQueue::MakeKey(0, 0, draws[i].Material, mesh, (random() % 1000) / 1000.0f), i);
+	}
+	queue.Sort();
+
+	std::vector<DirectX::XMFLOAT4X4> instances(count);
+	std::vector<DrawRun> runs(count);
+	unsigned int runCount = BuildDrawRuns(queue.GetEntries(), count, draws.data(), instances.data(), runs.data());
+	CHECK(runCount == 8);
+
+	// Every instance is in exactly one run, and matches it
+	std::vector<unsigned int> seen(count, 0);
+	unsigned int next = 0;
+	for (unsigned int r = 0; r < runCount; r++)
+	{
+		const DrawRun& run = runs[r];
+		CHECK(run.FirstInstance == next);
+		next += run.InstanceCount;
+		for (unsigned int i = run.FirstInstance; i < next; i++)
+		{
+			const OpaqueDraw& draw = draws[(unsigned int)instances[i]._14];
+			CHECK(draw.SubMesh == run.SubMesh && draw.Material == run.Material);
+			seen[(unsigned int)instances[i]._14]++;
+		}
+	}
+	CHECK(next == count);
+	bool once = true;
+	for (unsigned int s : seen)
+		once = once && s == 1;
+	CHECK(once);
+
+	// Recorded as the opaque pass does, through the state cache
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+	unsigned int stride = 48, offset = 0;
+	Mesh* currentMesh = 0;
+	for (unsigned int r = 0; r < runCount; r++)
+	{
+		if (runs[r].SubMesh != currentMesh)
+		{
+			currentMesh = runs[r].SubMesh;
+			ID3D11Buffer* vb = (ID3D11Buffer*)currentMesh;
+			cache.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+		}
+		cache.DrawIndexedInstanced(960, runs[r].InstanceCount, 0, 0, runs[r].FirstInstance);
+	}
+
+	const RenderCommandStats& stats = recorder.GetStats();
+	CHECK(stats.DrawCalls == 8);
+	CHECK(stats.InstancesDrawn == count);
+	CHECK(stats.VerticesDrawn == 960ull * count);
+}
+
+TEST(DrawRunsSplitOnMeshOrMaterial)
+{
+	// Same mesh, different material, then back - three runs,
+	// since only adjacent draws are merged
+	OpaqueDraw draws[5] =
+	{
+		{ Fake<Mesh>(0), Fake<GameEntity>(10), 1, DirectX::XMFLOAT4X4() },
+		{ Fake<Mesh>(0), Fake<GameEntity>(11), 1, DirectX::XMFLOAT4X4() },
+		{ Fake<Mesh>(0), Fake<GameEntity>(12), 2, DirectX::XMFLOAT4X4() },
+		{ Fake<Mesh>(0), Fake<GameEntity>(13), 1, DirectX::XMFLOAT4X4() },
+		{ Fake<Mesh>(1), Fake<GameEntity>(14), 1, DirectX::XMFLOAT4X4() },
+	};
+	RenderQueueEntry queued[5] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 } };
+
+	DirectX::XMFLOAT4X4 instances[5];
+	DrawRun runs[5];
+	CHECK(BuildDrawRuns(queued, 5, draws, instances, runs) == 4);
+	CHECK(runs[0].InstanceCount == 2 && runs[0].Entity == Fake<GameEntity>(10));
+	CHECK(runs[1].FirstInstance == 2 && runs[1].Material == 2);
+	CHECK(runs[3].SubMesh == Fake<Mesh>(1));
+
+	// Nothing queued, nothing drawn
+	CHECK(BuildDrawRuns(queued, 0, draws, instances, runs) == 0);
+}
@@ -0,0 +1,98 @@
+#include "TestFramework.h"
+#include "FixedStepLoop.h"
+
+// Runs frames of the given length, completing every step,
+// and returns how many steps there were
+static unsigned int RunFrames(FixedStepLoop* loop, unsigned int frames, double elapsed)
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		unsigned int steps = loop->Advance(elapsed);
+		for (unsigned int s = 0; s < steps; s++)
+			loop->CompleteStep();
+		total += steps;
+		if (loop->IsInterpolating())
+			CHECK(loop->GetAlpha() >= 0.0f && loop->GetAlpha() < 1.0f);
+		else
+			CHECK(loop->GetAlpha() == 1.0f);
+	}
+	return total;
+}
+
+TEST(FixedStepLoopKeepsSimulationTimeWithRealTime)
+{
+	// Whatever the frame rate, ten seconds is 600 steps, give
+	// or take the one in progress
+	double frameRates[5] = { 30.0, 59.94, 60.0, 144.0, 1000.0 };
+	for (unsigned int r = 0; r < 5; r++)
+	{
+		FixedStepLoop loop(60.0f);
+		unsigned int frames = (unsigned int)(frameRates[r] * 10.0);
+		unsigned int steps = RunFrames(&loop, frames, 1.0 / frameRates[r]);
+		CHECK(steps >= 599 && steps <= 600);
+		CHECK(loop.GetStepCount() == steps);
+		CHECK_NEAR(loop.GetTime(), steps / 60.0, 1e-4);
+		CHECK(loop.GetDroppedSteps() == 0);
+	}
+}
+
+TEST(FixedStepLoopCarriesLeftoverTime)
+{
+	FixedStepLoop loop(100.0f);
+	CHECK(loop.Advance(0.0075) == 0);
+	CHECK_NEAR(loop.GetAlpha(), 0.75f, 1e-4f);
+	CHECK(loop.Advance(0.0075) == 1);
+	CHECK_NEAR(loop.GetAlpha(), 0.5f, 1e-4f);
+	CHECK(loop.Advance(0.025) == 3);
+	CHECK_NEAR(loop.GetAlpha(), 0.0f, 1e-4f);
+
+	// Time doesn't run backwards
+	CHECK(loop.Advance(-1.0) == 0);
+	CHECK_NEAR(loop.GetAlpha(), 0.0f, 1e-4f);
+
+	// Changing the rate starts over
+	loop.Advance(0.005);
+	loop.SetRate(50.0f);
+	CHECK(loop.GetStep() == 1.0f / 50.0f);
+	CHECK(loop.Advance(0.019) == 0);
+}
+
+TEST(FixedStepLoopCapsStepsPerFrame)
+{
+	// A one second hitch at 60hz is 60 steps - only 8 run
+	FixedStepLoop loop(60.0f);
+	CHECK(loop.Advance(1.0 + 0.5 / 60.0) == 8);
+	CHECK(loop.GetDroppedSteps() == 52);
+	CHECK_NEAR(loop.GetAlpha(), 0.5f, 1e-3f);
+
+	// And it doesn't try to catch up afterwards
+	CHECK(loop.Advance(1.0 / 60.0) == 1);
+	CHECK(loop.GetDroppedSteps() == 52);
+
+	FixedStepLoop small(60.0f, 2);
+	CHECK(small.Advance(0.105) == 2);
+	CHECK(small.GetDroppedSteps() == 4);
+}
+
+TEST(FixedStepLoopVariableAndLockstep)
+{
+	// No rate - one step per frame, as long as the frame
+	FixedStepLoop variable(0.0f);
+	CHECK(!variable.IsInterpolating());
+	CHECK(variable.Advance(0.05) == 1);
+	CHECK_NEAR(variable.GetStep(), 0.05f, 1e-6f);
+	CHECK(variable.GetAlpha() == 1.0f);
+
+	// Lockstep - one fixed step per frame, however long it took
+	FixedStepLoop lockstep(60.0f);
+	lockstep.SetLockstep(true);
+	CHECK(!lockstep.IsInterpolating());
+	CHECK(RunFrames(&lockstep, 100, 0.5) == 100);
+	CHECK(RunFrames(&lockstep, 100, 0.0001) == 100);
+	CHECK_NEAR(lockstep.GetTime(), 200.0 / 60.0, 1e-4);
+	CHECK(lockstep.GetDroppedSteps() == 0);
+
+	lockstep.SetLockstep(false);
+	CHECK(lockstep.IsInterpolating());
+}
@@ -0,0 +1,338 @@
+#include "TestFramework.h"
+#include "DrawRun.h"
+#include "FrameArena.h"
+#include "FramePipeline.h"
+#include "FrustumCuller.h"
+#include "NullRenderDevice.h"
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// A game in miniature: preparing fills a slot with its frame
+// number, and drawing checks it sees the previous frame's,
+// whole and unchanging while the next is prepared
+// --------------------------------------------------------
+struct PipelinedGame
+{
+	static const unsigned int PayloadSize = 4096;
+
+	struct Frame
+	{
+		unsigned int Number;
+		unsigned int Payload[PayloadSize];
+	};
+
+	FramePipeline Pipeline;
+	JobSystem* Jobs;
+	Frame Frames[2];
+	unsigned int Prepared;
+	unsigned int Drawn;
+	unsigned int Mismatches;
+	std::mt19937 Random;
+
+	PipelinedGame(JobSystem* jobs) : Jobs(jobs), Frames(), Prepared(0), Drawn(0), Mismatches(0), Random(3) { }
+
+	static void PrepareJob(void* data)
+	{
+		PipelinedGame* game = (PipelinedGame*)data;
+		Frame& frame = game->Frames[game->Pipeline.GetPrepareSlot()];
+		game->Prepared++;
+		frame.Number = game->Prepared;
+		for (unsigned int i = 0; i < PayloadSize; i++)
+			frame.Payload[i] = game->Prepared;
+	}
+
+	// Draws the submit slot, expecting the given frame.  The
+	// draw fans out over the job system itself, so waiting
+	// on it can end up running the prepare job here too.
+	void Draw(unsigned int expected)
+	{
+		const Frame& frame = Frames[Pipeline.GetSubmitSlot()];
+		unsigned int number = frame.Number;
+		std::atomic<unsigned int> wrong(0);
+		Jobs->ParallelFor(PayloadSize, 256, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				if (frame.Payload[i] != number)
+					wrong++;
+			}
+		});
+		if (number != expected || wrong != 0 || frame.Number != number)
+			Mismatches++;
+		Drawn++;
+	}
+
+	void RunPipelinedFrame()
+	{
+		unsigned int expected = Prepared;
+		bool draw = Pipeline.BeginFrame(Jobs, PrepareJob, this);
+
+		// Vary how far ahead drawing gets of preparing
+		if (Random() % 4 == 0)
+			std::this_thread::yield();
+		if (draw)
+			Draw(expected);
+		Pipeline.EndFrame(Jobs);
+	}
+
+	void RunSerialFrame()
+	{
+		Pipeline.BeginSerialFrame();
+		PrepareJob(this);
+		Draw(Prepared);
+	}
+};
+
+TEST(FramePipelineDrawsTheFrameBefore)
+{
+	const unsigned int threads[3] = { 1, 4, 8 };
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		JobSystem jobs(threads[t]);
+		PipelinedGame game(&jobs);
+
+		// Nothing is prepared yet for the first frame
+		game.RunPipelinedFrame();
+		CHECK(game.Drawn == 0);
+		CHECK(game.Prepared == 1);
+
+		for (unsigned int frame = 1; frame < 500; frame++)
+		{
+			unsigned int submitted = game.Pipeline.GetSubmitSlot();
+			game.RunPipelinedFrame();
+			CHECK(game.Pipeline.GetSubmitSlot() == (submitted ^ 1));
+			CHECK(game.Pipeline.GetPrepareSlot() == game.Pipeline.GetSubmitSlot());
+		}
+		CHECK(game.Prepared == 500);
+		CHECK(game.Drawn == 499);
+		CHECK(game.Mismatches == 0);
+	}
+}
+
+// --------------------------------------------------------
+// Switching modes: serial frames use slot 0 and leave nothing
+// behind, and a reset drops the frame waiting to be drawn
+// --------------------------------------------------------
+TEST(FramePipelineSwitchesToAndFromSerial)
+{
+	JobSystem jobs(4);
+	PipelinedGame game(&jobs);
+
+	for (unsigned int frame = 0; frame < 10; frame++)
+		game.RunPipelinedFrame();
+	CHECK(game.Drawn == 9);
+
+	// The last pipelined frame is never drawn...
+	game.RunSerialFrame();
+	CHECK(game.Pipeline.GetPrepareSlot() == 0 && game.Pipeline.GetSubmitSlot() == 0);
+	CHECK(game.Drawn == 10);
+
+	// ...and the serial one isn't drawn again by a pipelined one
+	game.RunPipelinedFrame();
+	CHECK(game.Drawn == 10);
+	CHECK(game.Pipeline.GetSubmitSlot() == 1);
+	game.RunPipelinedFrame();
+	CHECK(game.Drawn == 11);
+
+	// A reset drops the prepared frame the same way
+	game.Pipeline.Reset();
+	game.RunPipelinedFrame();
+	CHECK(game.Drawn == 11);
+	game.RunPipelinedFrame();
+	CHECK(game.Drawn == 12);
+	CHECK(game.Mismatches == 0);
+}
+
+// --------------------------------------------------------
+// A synthetic scene shaped like the game's frame: preparing
+// spins every entity, updates the transforms, culls, sorts
+// and builds draw runs into the slot's arena, and drawing
+// uploads the instances and submits the runs to a null
+// device
+// --------------------------------------------------------
+struct SyntheticScene
+{
+	static const unsigned int Meshes = 64;
+	static const unsigned int Materials = 16;
+
+	struct Frame
+	{
+		FrameArena Arena;
+		XMFLOAT4X4* Instances;
+		unsigned int InstanceCount;
+		DrawRun* Runs;
+		unsigned int RunCount;
+	};
+
+	FramePipeline Pipeline;
+	JobSystem* Jobs;
+	Frame Frames[2];
+	TransformSystem Transforms;
+	FrustumCuller Culler;
+	RenderQueue Queue;
+	Frustum View;
+	std::vector<unsigned int> Visible;
+	NullRenderDevice Device;
+	unsigned int Drawn;
+	unsigned int DrawCalls;
+
+	SyntheticScene(JobSystem* jobs, unsigned int count) : Jobs(jobs), Drawn(0), DrawCalls(0)
+	{
+		std::mt19937 random(8);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		Transforms.Reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int t = Transforms.Create();
+			Transforms.SetPosition(t, position(random), position(random), position(random) + 100.0f);
+		}
+		View = Frustum::FromViewProjection(XMMatrixPerspectiveFovLH(1.0f, 1.78f, 0.1f, 150.0f));
+	}
+
+	static void PrepareJob(void* data)
+	{
+		SyntheticScene* scene = (SyntheticScene*)data;
+		scene->Prepare(&scene->Frames[scene->Pipeline.GetPrepareSlot()]);
+	}
+
+	void Prepare(Frame* frame)
+	{
+		frame->Arena.Reset();
+
+		unsigned int count = Transforms.GetCount();
+		for (unsigned int i = 0; i < count; i++)
+			Transforms.Rotate(i, 0.0f, 0.01f, 0.0f);
+		Transforms.Update();
+
+		Culler.Clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(Transforms.GetWorldMatrix(i)));
+			Culler.AddTransformed(XMFLOAT3(0, 0, 0), XMFLOAT3(0.5f, 0.5f, 0.5f), 0.87f, world);
+		}
+		Culler.Cull(View, &Visible);
+
+		unsigned int visibleCount = (unsigned int)Visible.size();
+		Queue.Begin(&frame->Arena, visibleCount);
+		OpaqueDraw* draws = frame->Arena.AllocateArray<OpaqueDraw>(visibleCount);
+		for (unsigned int v = 0; v < visibleCount; v++)
+		{
+			unsigned int i = Visible[v];
+			OpaqueDraw draw = { Fake<Mesh>(i % Meshes), 0, i % Materials, *Transforms.GetWorldMatrix(i) };
+			draws[v] = draw;
+			Queue.Add(RenderQueue::MakeKey(0, 0, draw.Material, i % Meshes, draw.World._43), v);
+		}
+		Queue.Sort();
+
+		unsigned int queued = Queue.GetCount();
+		frame->Instances = frame->Arena.AllocateArray<XMFLOAT4X4>(queued);
+		frame->InstanceCount = queued;
+		frame->Runs = frame->Arena.AllocateArray<DrawRun>(queued);
+		frame->RunCount = BuildDrawRuns(Queue.GetEntries(), queued, draws, frame->Instances, frame->Runs);
+	}
+
+	// Binds and draws like Game::RenderGeometry
+	void Draw(const Frame& frame)
+	{
+		Device.Clear();
+		ID3D11Buffer* instances = Fake<ID3D11Buffer>(0);
+		Device.WriteBuffer(instances, 0, frame.Instances, frame.InstanceCount * sizeof(XMFLOAT4X4), true);
+
+		unsigned int stride = 48;
+		unsigned int offset = 0;
+		unsigned int currentMaterial = 0xFFFFFFFF;
+		Mesh* currentMesh = 0;
+		for (unsigned int r = 0; r < frame.RunCount; r++)
+		{
+			const DrawRun& run = frame.Runs[r];
+			if (run.Material != currentMaterial)
+			{
+				currentMaterial = run.Material;
+				ID3D11ShaderResourceView* views[4] =
+				{
+					Fake<ID3D11ShaderResourceView>(run.Material),
+					Fake<ID3D11ShaderResourceView>(Materials + run.Material),
+					Fake<ID3D11ShaderResourceView>(2 * Materials + run.Material),
+					Fake<ID3D11ShaderResourceView>(3 * Materials + run.Material),
+				};
+				Device.PSSetShaderResources(0, 4, views);
+			}
+			if (run.SubMesh != currentMesh)
+			{
+				currentMesh = run.SubMesh;
+				ID3D11Buffer* vb = Fake<ID3D11Buffer>(1 + FakeIndex(currentMesh));
+				ID3D11Buffer* ib = Fake<ID3D11Buffer>(1 + Meshes + FakeIndex(currentMesh));
+				Device.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+				Device.IASetIndexBuffer(ib, 0, 0);
+			}
+			Device.DrawIndexedInstanced(36, run.InstanceCount, 0, 0, run.FirstInstance);
+		}
+		DrawCalls += Device.GetStats().DrawCalls;
+		Drawn++;
+	}
+
+	void RunPipelinedFrame()
+	{
+		if (Pipeline.BeginFrame(Jobs, PrepareJob, this))
+			Draw(Frames[Pipeline.GetSubmitSlot()]);
+		Pipeline.EndFrame(Jobs);
+	}
+
+	void RunSerialFrame()
+	{
+		Pipeline.BeginSerialFrame();
+		Prepare(&Frames[0]);
+		Draw(Frames[0]);
+	}
+};
+
+// --------------------------------------------------------
+// 50k entities, preparing and drawing one after the other
+// against preparing the next frame on a worker while this
+// one's drawn.  The gain is bounded by the shorter of the
+// two stages, and needs a second core to show up at all.
+// --------------------------------------------------------
+BENCHMARK(FramePipeline50kEntities)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int count = 50000, frames = 120;
+	JobSystem jobs(2);
+
+	SyntheticScene serial(&jobs, count);
+	Clock::time_point start = Clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+		serial.RunSerialFrame();
+	double serialMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+	unsigned int serialDrawCalls = serial.DrawCalls;
+
+	// Time the draws on their own, for the ideal overlap
+	start = Clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+		serial.Draw(serial.Frames[0]);
+	double drawMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+	// One more frame to fill the pipeline, so as many are drawn
+	SyntheticScene pipelined(&jobs, count);
+	start = Clock::now();
+	for (unsigned int frame = 0; frame <= frames; frame++)
+		pipelined.RunPipelinedFrame();
+	double pipelinedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+
+	printf("  Serial %.3fms, pipelined %.3fms per frame (%.2fx, at best %.2fx); %u draws of %u visible, %u threads\n",
+		serialMs, pipelinedMs, serialMs / pipelinedMs, serialMs / std::max(drawMs, serialMs - drawMs),
+		serial.Device.GetStats().DrawCalls, serial.Frames[0].InstanceCount, std::thread::hardware_concurrency());
+
+	// Both drew the same frames, the pipeline one behind
+	CHECK(pipelined.Drawn == frames);
+	CHECK(pipelined.DrawCalls == serialDrawCalls);
+	CHECK(pipelined.Device.GetStats().InstancesDrawn == serial.Frames[0].InstanceCount);
+	CHECK(serial.Frames[0].InstanceCount > 0 && serial.Frames[0].InstanceCount < count);
+}
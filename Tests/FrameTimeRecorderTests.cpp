@@ -0,0 +1,150 @@
+#include "TestFramework.h"
+#include "FrameTimeRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+TEST(FrameTimeRecorderFindsSpikes)
+{
+	FrameTimeRecorder recorder;
+	std::mt19937 random(12);
+	std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+
+	// Nothing can be a spike before there's a median to beat
+	for (unsigned int i = 0; i < FrameTimeRecorder::MedianWindow; i++)
+		CHECK(!recorder.Record(i == 10 ? 500.0f : 16.6f + jitter(random), 8.0f));
+
+	std::vector<unsigned int> expected;
+	for (unsigned int i = FrameTimeRecorder::MedianWindow; i < 3000; i++)
+	{
+		bool stutter = i % 500 == 0;
+		if (stutter)
+			expected.push_back(i);
+		CHECK(recorder.Record(stutter ? 50.0f : 16.6f + jitter(random), 8.0f) == stutter);
+	}
+
+	const std::vector<FrameSpike>& spikes = recorder.GetSpikes();
+	CHECK(spikes.size() == expected.size());
+	for (unsigned int i = 0; i < spikes.size() && i < expected.size(); i++)
+	{
+		CHECK(spikes[i].Frame == expected[i]);
+		CHECK(spikes[i].FrameTime == 50.0f);
+		CHECK_NEAR(spikes[i].Median, 16.6f, 1.0f);
+	}
+}
+
+TEST(FrameTimeRecorderSpikesAreRelativeToTheMedian)
+{
+	FrameTimeRecorder recorder;
+	recorder.SetSpikeMultiplier(3.0f);
+	for (unsigned int i = 0; i < FrameTimeRecorder::MedianWindow; i++)
+		recorder.Record(10.0f, 5.0f);
+
+	CHECK(!recorder.Record(30.0f, 5.0f));	// Exactly 3x
+	CHECK(recorder.Record(30.5f, 5.0f));
+
+	// A slow stretch raises the median, so it stops counting
+	unsigned int spikes = 0;
+	for (unsigned int i = 0; i < 1000; i++)
+		spikes += recorder.Record(40.0f, 5.0f) ? 1 : 0;
+	CHECK(spikes < FrameTimeRecorder::MedianWindow / 2 + 1);
+	CHECK(!recorder.Record(40.0f, 5.0f));
+
+	// Only the newest are kept
+	for (unsigned int i = 0; i < FrameTimeRecorder::MaxSpikes + 10; i++)
+	{
+		recorder.Record(1000.0f, 5.0f);
+		for (unsigned int k = 0; k < FrameTimeRecorder::MedianWindow; k++)
+			recorder.Record(40.0f, 5.0f);
+	}
+	CHECK(recorder.GetSpikes().size() == FrameTimeRecorder::MaxSpikes);
+	CHECK(recorder.GetSpikes().back().FrameTime == 1000.0f);
+}
+
+TEST(FrameTimeRecorderHistogramCountsEveryFrame)
+{
+	FrameTimeRecorder recorder;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> exponent(-6.0f, 14.0f);
+	unsigned int misplaced = 0;
+	for (unsigned int i = 0; i < 10000; i++)
+	{
+		float time = powf(2.0f, exponent(random));
+		unsigned int before[FrameTimeRecorder::BinCount];
+		std::copy(recorder.GetHistogram(), recorder.GetHistogram() + FrameTimeRecorder::BinCount, before);
+		recorder.Record(time, 1.0f);
+
+		// The bin that grew must hold this time, unless it's
+		// clamped into the first or last
+		for (unsigned int bin = 0; bin < FrameTimeRecorder::BinCount; bin++)
+		{
+			if (recorder.GetHistogram()[bin] == before[bin])
+				continue;
+			bool low = bin == 0 || time >= FrameTimeRecorder::GetBinStart(bin) * 0.9999f;
+			bool high = bin == FrameTimeRecorder::BinCount - 1 || time < FrameTimeRecorder::GetBinStart(bin + 1) * 1.0001f;
+			if (!low || !high)
+				misplaced++;
+		}
+	}
+	CHECK(misplaced == 0);
+
+	// Way under and way over
+	recorder.Record(0.0f, 0.0f);
+	recorder.Record(1e9f, 0.0f);
+
+	unsigned int total = 0;
+	for (unsigned int bin = 0; bin < FrameTimeRecorder::BinCount; bin++)
+		total += recorder.GetHistogram()[bin];
+	CHECK(total == 10002);
+	CHECK(recorder.GetFrameCount() == 10002);
+	CHECK(recorder.GetHistogram()[FrameTimeRecorder::BinCount - 1] > 0);
+}
+
+// --------------------------------------------------------
+// Past capacity, the CSV has the newest frames only, still
+// numbered from the first frame ever recorded
+// --------------------------------------------------------
+TEST(FrameTimeRecorderWritesTheNewestFrames)
+{
+	FrameTimeRecorder recorder;
+	const unsigned int extra = 100;
+	for (unsigned int i = 0; i < FrameTimeRecorder::Capacity + extra; i++)
+		recorder.Record(i == FrameTimeRecorder::Capacity + 50 ? 100.0f : 16.0f, 8.0f);
+	CHECK(recorder.GetSpikes().size() == 1);
+
+	const char* framePath = "FrameTimeRecorderTests.csv";
+	const char* histogramPath = "FrameTimeRecorderTests.histogram.csv";
+	CHECK(recorder.WriteCSV(framePath, histogramPath));
+
+	std::ifstream frames(framePath);
+	std::string line;
+	unsigned int rows = 0;
+	unsigned int spikeRows = 0;
+	std::string firstRow;
+	std::getline(frames, line);
+	CHECK(line == "Frame,FrameMs,CpuMs,Spike,Scopes");
+	while (std::getline(frames, line))
+	{
+		if (rows++ == 0)
+			firstRow = line;
+		if (line.find(",1,") != std::string::npos)
+			spikeRows++;
+	}
+	CHECK(rows == FrameTimeRecorder::Capacity);
+	CHECK(firstRow.compare(0, 4, "100,") == 0);
+	CHECK(spikeRows == 1);
+
+	std::ifstream histogram(histogramPath);
+	rows = 0;
+	while (std::getline(histogram, line))
+		rows++;
+	CHECK(rows == FrameTimeRecorder::BinCount + 1);
+
+	frames.close();
+	histogram.close();
+	remove(framePath);
+	remove(histogramPath);
+}
@@ -0,0 +1,168 @@
+#include "TestFramework.h"
+#include "FrustumCuller.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+// A camera at the origin looking down +Z, turned by yaw
+static Frustum MakeFrustum(float yaw)
+{
+	XMMATRIX view = XMMatrixRotationY(yaw);
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(1.2f, 16.0f / 9.0f, 0.1f, 200.0f);
+	return Frustum::FromViewProjection(XMMatrixMultiply(view, proj));
+}
+
+// Fills the culler with random bounds scattered around the camera
+static void AddRandomBounds(FrustumCuller* culler, unsigned int count, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+	std::uniform_real_distribution<float> size(0.05f, 8.0f);
+	culler->Reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(random), position(random), position(random));
+		XMFLOAT3 extents(size(random), size(random), size(random));
+		float radius = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+		culler->Add(center, extents, radius * size(random) / 8.0f);
+	}
+}
+
+TEST(FrustumCullerMatchesReference)
+{
+	// Counts that do and don't fill the last group of four
+	unsigned int counts[4] = { 1, 7, 1000, 100003 };
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		FrustumCuller culler;
+		AddRandomBounds(&culler, counts[c], c);
+		for (float yaw = 0.0f; yaw < 6.28f; yaw += 0.7f)
+		{
+			std::vector<unsigned int> simd, reference;
+			Frustum frustum = MakeFrustum(yaw);
+			culler.Cull(frustum, &simd);
+			culler.CullReference(frustum, &reference);
+			CHECK(simd == reference);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Only bounds entirely outside the frustum may be culled, so
+// every culled box must have all eight corners behind one
+// plane.  Far away and behind the camera must go.
+// --------------------------------------------------------
+TEST(FrustumCullerIsConservative)
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+	std::uniform_real_distribution<float> size(0.05f, 8.0f);
+	std::vector<XMFLOAT3> centers, extents;
+	FrustumCuller culler;
+	for (unsigned int i = 0; i < 20000; i++)
+	{
+		XMFLOAT3 c(position(random), position(random), position(random));
+		XMFLOAT3 e(size(random), size(random), size(random));
+		culler.Add(c, e, sqrtf(e.x * e.x + e.y * e.y + e.z * e.z));
+		centers.push_back(c);
+		extents.push_back(e);
+	}
+
+	culler.Add(XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1), 1.8f);
+	culler.Add(XMFLOAT3(0, 0, -10), XMFLOAT3(1, 1, 1), 1.8f);
+	culler.Add(XMFLOAT3(0, 0, 500), XMFLOAT3(1, 1, 1), 1.8f);
+	culler.Add(XMFLOAT3(0, 0, 0), XMFLOAT3(50, 50, 50), 90.0f);	// Around the camera
+
+	Frustum frustum = MakeFrustum(0.0f);
+	std::vector<unsigned int> visible;
+	culler.Cull(frustum, &visible);
+	std::vector<bool> isVisible(culler.GetCount(), false);
+	for (unsigned int i : visible)
+		isVisible[i] = true;
+
+	unsigned int n = culler.GetCount();
+	CHECK(isVisible[n - 4]);
+	CHECK(!isVisible[n - 3]);
+	CHECK(!isVisible[n - 2]);
+	CHECK(isVisible[n - 1]);
+
+	unsigned int wronglyCulled = 0;
+	for (unsigned int i = 0; i < 20000; i++)
+	{
+		if (isVisible[i])
+			continue;
+
+		const XMFLOAT3& c = centers[i];
+		const XMFLOAT3& e = extents[i];
+		bool behindOne = false;
+		for (int p = 0; p < 6 && !behindOne; p++)
+		{
+			const XMFLOAT4& plane = frustum.Planes[p];
+			bool allBehind = true;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float x = c.x + ((corner & 1) ? e.x : -e.x);
+				float y = c.y + ((corner & 2) ? e.y : -e.y);
+				float z = c.z + ((corner & 4) ? e.z : -e.z);
+				allBehind = allBehind && plane.x * x + plane.y * y + plane.z * z + plane.w < 0.001f;
+			}
+			behindOne = allBehind;
+		}
+		if (!behindOne)
+			wronglyCulled++;
+	}
+	CHECK(wronglyCulled == 0);
+	CHECK(visible.size() > 100 && visible.size() < 20000);
+}
+
+TEST(FrustumCullerTransformsBoxes)
+{
+	// A unit box turned 45 degrees about Y reaches sqrt(2) in
+	// x and z, and a scale of 3 triples the sphere
+	XMFLOAT3 center, extents;
+	FrustumCuller::TransformBox(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), XMMatrixRotationY(XM_PIDIV4), &center, &extents);
+	CHECK_NEAR(extents.x, 1.41421f, 0.0001f);
+	CHECK_NEAR(extents.y, 1.0f, 0.0001f);
+	CHECK_NEAR(extents.z, 1.41421f, 0.0001f);
+
+	FrustumCuller culler;
+	XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(3, 1, 1), XMMatrixTranslation(0, 0, 10));
+	culler.AddTransformed(XMFLOAT3(1, 0, 0), XMFLOAT3(1, 1, 1), 1.0f, world);
+	std::vector<unsigned int> visible;
+	CHECK(culler.Cull(MakeFrustum(0.0f), &visible) == 1);
+}
+
+// --------------------------------------------------------
+// 1M bounds against one frustum, four at a time and one at
+// a time
+// --------------------------------------------------------
+BENCHMARK(FrustumCuller1MBounds)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	FrustumCuller culler;
+	AddRandomBounds(&culler, 1000000, 1);
+	Frustum frustum = MakeFrustum(0.3f);
+
+	std::vector<unsigned int> visible;
+	visible.reserve(1000000);
+	double best[2] = { 1e30, 1e30 };
+	unsigned int found[2] = { 0, 0 };
+	for (unsigned int run = 0; run < 10; run++)
+	{
+		for (unsigned int path = 0; path < 2; path++)
+		{
+			Clock::time_point start = Clock::now();
+			found[path] = path == 0 ? culler.Cull(frustum, &visible) : culler.CullReference(frustum, &visible);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (ms < best[path])
+				best[path] = ms;
+		}
+	}
+
+	printf("  SIMD %.2fms, scalar %.2fms (%.1fx), %u of 1000000 visible\n",
+		best[0], best[1], best[1] / best[0], found[0]);
+	CHECK(found[0] == found[1]);
+}
@@ -0,0 +1,179 @@
+#include "TestFramework.h"
+#include "Input.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+static const char* StreamPath = "InputTests.input";
+
+// Keyboard state with just the given keys held
+static void HoldKeys(unsigned char keyStates[256], const char* keys)
+{
+	memset(keyStates, 0, 256);
+	for (const char* key = keys; *key; key++)
+		keyStates[(unsigned char)*key] = 0x80;
+}
+
+TEST(InputDetectsEdgesPerStep)
+{
+	Input input;
+	unsigned char keys[256];
+
+	HoldKeys(keys, "W");
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.IsKeyDown('W') && input.WasKeyPressed('W'));
+	CHECK(!input.IsKeyDown('S') && !input.WasKeyReleased('S'));
+
+	// No simulation step ran, so the press is still new
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.WasKeyPressed('W'));
+	input.ConsumeFrame();
+
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.IsKeyDown('W') && !input.WasKeyPressed('W'));
+	input.ConsumeFrame();
+
+	HoldKeys(keys, "S");
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.WasKeyReleased('W') && input.WasKeyPressed('S'));
+	input.ConsumeFrame();
+
+	// Keys past the first word of bits
+	HoldKeys(keys, "");
+	keys[0xA0] = 0x80;
+	keys[0xFF] = 0x80;
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.IsKeyDown(0xA0) && input.IsKeyDown(0xFF) && !input.IsKeyDown(0x9F));
+}
+
+TEST(InputMeasuresTheMouseFromTheLastStep)
+{
+	Input input;
+	unsigned char keys[256] = {};
+
+	input.OnMouseMove(100, 50);
+	input.BeginFrame(keys, 0.016f);
+	input.ConsumeFrame();
+
+	// Two frames without a step - movement and wheel add up
+	input.OnMouseMove(110, 45);
+	input.OnMouseWheel(1.0f);
+	input.OnMouseButton(MOUSE_RIGHT, true);
+	input.BeginFrame(keys, 0.016f);
+	input.OnMouseMove(120, 40);
+	input.OnMouseWheel(2.0f);
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.GetMouseDeltaX() == 20 && input.GetMouseDeltaY() == -10);
+	CHECK(input.GetWheelDelta() == 3.0f);
+	CHECK(input.IsButtonDown(MOUSE_RIGHT) && input.WasButtonPressed(MOUSE_RIGHT));
+	CHECK(!input.IsButtonDown(MOUSE_LEFT));
+	input.ConsumeFrame();
+
+	// Seen once, then gone
+	input.BeginFrame(keys, 0.016f);
+	CHECK(input.GetMouseDeltaX() == 0 && input.GetWheelDelta() == 0.0f);
+	CHECK(input.IsButtonDown(MOUSE_RIGHT) && !input.WasButtonPressed(MOUSE_RIGHT));
+
+	input.OnMouseButton(MOUSE_RIGHT, false);
+	input.BeginFrame(keys, 0.016f);
+	CHECK(!input.IsButtonDown(MOUSE_RIGHT));
+}
+
+// What the game would see in a frame
+struct Observed
+{
+	bool Pressed;
+	bool Held;
+	bool Released;
+	int MouseDeltaX;
+	float Wheel;
+	float DeltaTime;
+
+	bool operator==(const Observed& other) const
+	{
+		return Pressed == other.Pressed && Held == other.Held && Released == other.Released &&
+			MouseDeltaX == other.MouseDeltaX && Wheel == other.Wheel && DeltaTime == other.DeltaTime;
+	}
+};
+
+static Observed Observe(Input* input)
+{
+	Observed seen = { input->WasKeyPressed('A'), input->IsKeyDown('A'), input->WasKeyReleased('A'),
+		input->GetMouseDeltaX(), input->GetWheelDelta(), input->GetDeltaTime() };
+	return seen;
+}
+
+// --------------------------------------------------------
+// A replay must show the game exactly what the recording
+// did - keys, mouse and frame times - whatever the live
+// input is doing meanwhile, then hand back to live input
+// --------------------------------------------------------
+TEST(InputReplaysWhatWasRecorded)
+{
+	const unsigned int frames = 300;
+	std::mt19937 random(23);
+	std::vector<Observed> recorded;
+
+	// Not every frame runs a step
+	std::vector<bool> steps(frames);
+	for (unsigned int i = 0; i < frames; i++)
+		steps[i] = random() % 4 != 0;
+	{
+		Input input;
+		CHECK(input.StartRecording(StreamPath));
+		unsigned char keys[256];
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			HoldKeys(keys, random() % 3 == 0 ? "A" : "");
+			input.OnMouseMove((int)(random() % 640), 0);
+			if (random() % 5 == 0)
+				input.OnMouseWheel(1.0f);
+			input.BeginFrame(keys, 0.01f + (random() % 100) / 10000.0f);
+			recorded.push_back(Observe(&input));
+			if (steps[i])
+				input.ConsumeFrame();
+		}
+	}
+
+	// Replay with the same steps, while "holding" other keys
+	Input input;
+	CHECK(input.StartReplay(StreamPath));
+	CHECK(input.IsReplaying());
+	unsigned char keys[256];
+	HoldKeys(keys, "AZ");
+	unsigned int different = 0;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		input.OnMouseMove(9999, 9999);
+		input.OnMouseWheel(5.0f);
+		input.BeginFrame(keys, 1.0f);
+		if (!(Observe(&input) == recorded[i]))
+			different++;
+		if (steps[i])
+			input.ConsumeFrame();
+		CHECK(!input.IsKeyDown('Z'));
+	}
+	CHECK(different == 0);
+
+	// The recording's over - live input again
+	input.BeginFrame(keys, 1.0f);
+	CHECK(!input.IsReplaying() && input.ReplayFinished());
+	CHECK(input.IsKeyDown('Z') && input.GetDeltaTime() == 1.0f);
+	CHECK(input.GetWheelDelta() == 0.0f);	// Not the wheel moved during the replay
+
+	remove(StreamPath);
+}
+
+TEST(InputRejectsOtherFiles)
+{
+	Input input;
+	CHECK(!input.StartReplay("InputTests.missing"));
+
+	FILE* file = fopen(StreamPath, "wb");
+	fwrite("NOPE", 1, 4, file);
+	fclose(file);
+	CHECK(!input.StartReplay(StreamPath));
+	CHECK(!input.IsReplaying());
+	remove(StreamPath);
+}
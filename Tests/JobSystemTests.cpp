@@ -0,0 +1,270 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+// --------------------------------------------------------
+// Splits itself in two until it runs out of depth, waiting
+// on its halves each time - every level is a fork and join
+// --------------------------------------------------------
+struct ForkJoinTask
+{
+	JobSystem* Jobs;
+	unsigned int Depth;
+	std::atomic<unsigned int>* Leaves;
+
+	static void Run(void* data)
+	{
+		ForkJoinTask* task = (ForkJoinTask*)data;
+		if (task->Depth == 0)
+		{
+			task->Leaves->fetch_add(1);
+			return;
+		}
+
+		ForkJoinTask halves[2] =
+		{
+			{ task->Jobs, task->Depth - 1, task->Leaves },
+			{ task->Jobs, task->Depth - 1, task->Leaves },
+		};
+		JobCounter counter(0);
+		task->Jobs->Run(&ForkJoinTask::Run, &halves[0], &counter);
+		task->Jobs->Run(&ForkJoinTask::Run, &halves[1], &counter);
+		task->Jobs->Wait(&counter);
+	}
+};
+
+static void CountJob(void* data)
+{
+	((std::atomic<unsigned int>*)data)->fetch_add(1);
+}
+
+TEST(JobSystemRunsNestedForkJoin)
+{
+	unsigned int threadCounts[3] = { 1, 4, 8 };
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		JobSystem jobs(threadCounts[t]);
+		CHECK(jobs.GetThreadCount() == threadCounts[t]);
+		for (unsigned int round = 0; round < 10; round++)
+		{
+			std::atomic<unsigned int> leaves(0);
+			ForkJoinTask root = { &jobs, 13, &leaves };
+			JobCounter counter(0);
+			jobs.Run(&ForkJoinTask::Run, &root, &counter);
+			jobs.Wait(&counter);
+			CHECK(leaves == 1u << 13);
+			CHECK(counter == 0);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// More jobs than a queue holds - the rest run right away on
+// the thread queuing them, but every one still runs once
+// --------------------------------------------------------
+TEST(JobSystemRunsJobsPastQueueCapacity)
+{
+	JobSystem jobs(4);
+	std::atomic<unsigned int> ran(0);
+	JobCounter counter(0);
+	const unsigned int count = JobQueue::Capacity * 3;
+	for (unsigned int i = 0; i < count; i++)
+		jobs.Run(&CountJob, &ran, &counter);
+	jobs.Wait(&counter);
+	CHECK(ran == count);
+
+	// Jobs without a counter, and from a thread the system
+	// doesn't own, which runs them inline
+	jobs.Run(&CountJob, &ran, 0);
+	std::thread outside([&]()
+	{
+		JobCounter outsideCounter(0);
+		jobs.Run(&CountJob, &ran, &outsideCounter);
+		CHECK(outsideCounter == 0);
+	});
+	outside.join();
+	JobCounter drain(0);
+	jobs.Run(&CountJob, &ran, &drain);
+	jobs.Wait(&drain);
+	while (ran < count + 3)
+		std::this_thread::yield();
+	CHECK(ran == count + 3);
+}
+
+TEST(JobSystemParallelForCoversEachIndexOnce)
+{
+	JobSystem jobs(4);
+	unsigned int counts[5] = { 0, 1, 7, 1000, 100003 };
+	unsigned int grains[4] = { 0, 1, 64, 200000 };
+	for (unsigned int c = 0; c < 5; c++)
+	{
+		for (unsigned int g = 0; g < 4; g++)
+		{
+			std::vector<std::atomic<unsigned int> > hits(counts[c]);
+			for (std::atomic<unsigned int>& hit : hits)
+				hit = 0;
+
+			bool inRange = true;
+			jobs.ParallelFor(counts[c], grains[g], [&](unsigned int begin, unsigned int end)
+			{
+				if (begin >= end || end > counts[c])
+					inRange = false;
+				for (unsigned int i = begin; i < end; i++)
+					hits[i].fetch_add(1);
+			});
+
+			bool once = true;
+			for (std::atomic<unsigned int>& hit : hits)
+				once = once && hit == 1;
+			CHECK(once);
+			CHECK(inRange);
+		}
+	}
+
+	// Nested inside another ParallelFor's chunks
+	std::atomic<unsigned int> total(0);
+	jobs.ParallelFor(16, 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			jobs.ParallelFor(1000, 10, [&](unsigned int innerBegin, unsigned int innerEnd)
+			{
+				total.fetch_add(innerEnd - innerBegin);
+			});
+		}
+	});
+	CHECK(total == 16000);
+}
+
+TEST(JobQueuePopsNewestAndStealsOldest)
+{
+	JobQueue* queue = new JobQueue();	// Too big for the stack
+	Job job = { &CountJob, 0, 0 };
+	for (unsigned int i = 0; i < JobQueue::Capacity; i++)
+	{
+		job.Data = (void*)(size_t)(i + 1);
+		CHECK(queue->Push(job));
+	}
+	CHECK(!queue->Push(job));
+
+	Job taken;
+	CHECK(queue->Pop(&taken) && taken.Data == (void*)(size_t)JobQueue::Capacity);
+	CHECK(queue->Steal(&taken) && taken.Data == (void*)(size_t)1);
+	CHECK(queue->Push(job));
+
+	unsigned int left = 0;
+	while (queue->Pop(&taken))
+		left++;
+	CHECK(left == JobQueue::Capacity - 1);
+	CHECK(!queue->Steal(&taken));
+	delete queue;
+}
+
+// --------------------------------------------------------
+// The owner pushes and pops while three thieves steal, and
+// every job must come out exactly once
+// --------------------------------------------------------
+TEST(JobQueueHandsEachJobOutOnce)
+{
+	JobQueue* queue = new JobQueue();
+	const unsigned int count = 200000;
+	std::vector<std::atomic<unsigned int> > taken(count);
+	for (std::atomic<unsigned int>& t : taken)
+		t = 0;
+
+	std::atomic<bool> done(false);
+	std::vector<std::thread> thieves;
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		thieves.push_back(std::thread([&]()
+		{
+			Job job;
+			while (!done.load())
+			{
+				if (queue->Steal(&job))
+					taken[(size_t)job.Data].fetch_add(1);
+			}
+		}));
+	}
+
+	Job job = { &CountJob, 0, 0 };
+	unsigned int next = 0;
+	while (next < count)
+	{
+		// Push a few, pop one, so the queue is often nearly empty
+		for (unsigned int i = 0; i < 3 && next < count; i++)
+		{
+			job.Data = (void*)(size_t)next;
+			if (queue->Push(job))
+				next++;
+		}
+		Job popped;
+		if (queue->Pop(&popped))
+			taken[(size_t)popped.Data].fetch_add(1);
+	}
+	Job popped;
+	while (queue->Pop(&popped))
+		taken[(size_t)popped.Data].fetch_add(1);
+	done = true;
+	for (std::thread& thief : thieves)
+		thief.join();
+
+	bool once = true;
+	for (std::atomic<unsigned int>& t : taken)
+		once = once && t == 1;
+	CHECK(once);
+	delete queue;
+}
+
+// --------------------------------------------------------
+// The same work spread over 1 to 8 workers - a parallel loop
+// of uneven chunks, and a deep fork/join tree
+// --------------------------------------------------------
+BENCHMARK(JobSystemScaling)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	std::vector<float> results(1 << 20);
+
+	double baseLoop = 0.0, baseTree = 0.0;
+	for (unsigned int threads = 1; threads <= 8; threads *= 2)
+	{
+		JobSystem jobs(threads);
+		double loop = 1e30, tree = 1e30;
+		for (unsigned int run = 0; run < 5; run++)
+		{
+			Clock::time_point start = Clock::now();
+			jobs.ParallelFor((unsigned int)results.size(), 4096, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int i = begin; i < end; i++)
+				{
+					float x = (float)i;
+					for (unsigned int k = 0; k < (i >> 17) + 8; k++)
+						x = sqrtf(x + k);
+					results[i] = x;
+				}
+			});
+			loop = std::min(loop, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+			std::atomic<unsigned int> leaves(0);
+			ForkJoinTask root = { &jobs, 16, &leaves };
+			JobCounter counter(0);
+			start = Clock::now();
+			jobs.Run(&ForkJoinTask::Run, &root, &counter);
+			jobs.Wait(&counter);
+			tree = std::min(tree, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			CHECK(leaves == 1u << 16);
+		}
+
+		if (threads == 1)
+		{
+			baseLoop = loop;
+			baseTree = tree;
+		}
+		printf("  %u threads: loop %.2fms (%.2fx), 64k job fork/join %.2fms (%.2fx)\n",
+			threads, loop, baseLoop / loop, tree, baseTree / tree);
+	}
+}
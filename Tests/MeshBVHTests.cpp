@@ -0,0 +1,180 @@
+#include "TestFramework.h"
+#include "MeshBVH.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// A cloud of small random triangles in a 10 unit box, which
+// gives the tree plenty of overlapping boxes to sort out
+// --------------------------------------------------------
+static void BuildCloud(MeshGeometry* geometry, unsigned int triangles, bool quantize, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < triangles; i++)
+	{
+		XMFLOAT3 center(unit(random) * 5.0f, unit(random) * 5.0f, unit(random) * 5.0f);
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			positions.push_back(XMFLOAT3(center.x + unit(random) * 0.3f, center.y + unit(random) * 0.3f, center.z + unit(random) * 0.3f));
+			indices.push_back((unsigned int)positions.size() - 1);
+		}
+	}
+	geometry->Build(positions.data(), sizeof(XMFLOAT3), (unsigned int)positions.size(), indices.data(), (unsigned int)indices.size(), quantize);
+}
+
+// --------------------------------------------------------
+// Casts rays between random points in and around the cloud,
+// checking the tree finds the same nearest hit as testing
+// every triangle.  Returns the number of mismatches.
+// --------------------------------------------------------
+static unsigned int CompareRays(const MeshGeometry& geometry, const MeshBVH& bvh, unsigned int rays, float maxDistance, unsigned int* hits)
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < rays; i++)
+	{
+		XMFLOAT3 origin(unit(random) * 8.0f, unit(random) * 8.0f, unit(random) * 8.0f);
+		XMFLOAT3 target(unit(random) * 4.0f, unit(random) * 4.0f, unit(random) * 4.0f);
+		XMFLOAT3 direction(target.x - origin.x, target.y - origin.y, target.z - origin.z);
+
+		MeshRayHit expected;
+		MeshRayHit found;
+		bool hit = geometry.Raycast(origin, direction, maxDistance, &expected);
+		if (hit != bvh.Raycast(origin, direction, maxDistance, &found) ||
+			(hit && (expected.Triangle != found.Triangle || fabsf(expected.Distance - found.Distance) > 1e-5f)))
+			mismatches++;
+		if (hit)
+			(*hits)++;
+	}
+	return mismatches;
+}
+
+TEST(MeshBVHMatchesBruteForce)
+{
+	JobSystem jobs(4);
+	const unsigned int sizes[2] = { 300, 20000 };
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		for (unsigned int quantize = 0; quantize < 2; quantize++)
+		{
+			MeshGeometry geometry;
+			BuildCloud(&geometry, sizes[s], quantize != 0, 7 + s);
+			CHECK(geometry.IsQuantized() == (quantize != 0));
+
+			// Built on this thread and on the job system
+			for (unsigned int threaded = 0; threaded < 2; threaded++)
+			{
+				MeshBVH bvh;
+				bvh.Build(&geometry, threaded ? &jobs : 0);
+				CHECK(!bvh.IsEmpty());
+
+				unsigned int hits = 0;
+				CHECK(CompareRays(geometry, bvh, 5000, 1e30f, &hits) == 0);
+				CHECK(hits > 200);
+
+				// Short rays, which stop before most of what they'd hit
+				hits = 0;
+				CHECK(CompareRays(geometry, bvh, 5000, 0.5f, &hits) == 0);
+			}
+		}
+	}
+}
+
+// The same triangles must give the same tree, however it's built
+TEST(MeshBVHBuildsTheSameTreeOnAnyThreadCount)
+{
+	MeshGeometry geometry;
+	BuildCloud(&geometry, 20000, false, 3);
+
+	MeshBVH serial;
+	serial.Build(&geometry, 0);
+	const unsigned int threads[3] = { 1, 4, 8 };
+	for (unsigned int t = 0; t < 3; t++)
+	{
+		JobSystem jobs(threads[t]);
+		MeshBVH threaded;
+		threaded.Build(&geometry, &jobs);
+		CHECK(threaded.GetNodeCount() == serial.GetNodeCount());
+		CHECK(threaded.GetMemoryUsage() == serial.GetMemoryUsage());
+	}
+}
+
+TEST(MeshBVHHandlesEmptyGeometry)
+{
+	MeshGeometry geometry;
+	MeshBVH bvh;
+	bvh.Build(&geometry, 0);
+	CHECK(bvh.IsEmpty());
+
+	MeshRayHit hit;
+	CHECK(!bvh.Raycast(XMFLOAT3(0, 0, -5), XMFLOAT3(0, 0, 1), 1e30f, &hit));
+
+	// Clearing a built tree empties it too
+	BuildCloud(&geometry, 50, false, 1);
+	bvh.Build(&geometry, 0);
+	CHECK(!bvh.IsEmpty());
+	bvh.Clear();
+	CHECK(bvh.IsEmpty());
+	CHECK(!bvh.Raycast(XMFLOAT3(0, 0, -5), XMFLOAT3(0, 0, 1), 1e30f, &hit));
+}
+
+// --------------------------------------------------------
+// Build time, then rays per millisecond through the tree
+// against testing every triangle
+// --------------------------------------------------------
+BENCHMARK(MeshBVHRaycast)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	MeshGeometry geometry;
+	BuildCloud(&geometry, 100000, false, 5);
+
+	JobSystem jobs;
+	MeshBVH bvh;
+	Clock::time_point start = Clock::now();
+	bvh.Build(&geometry, 0);
+	double serialBuild = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	start = Clock::now();
+	bvh.Build(&geometry, &jobs);
+	double threadedBuild = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	const unsigned int rays = 100000;
+	const unsigned int bruteRays = 100;
+	std::vector<XMFLOAT3> origins(rays);
+	std::vector<XMFLOAT3> directions(rays);
+	for (unsigned int i = 0; i < rays; i++)
+	{
+		origins[i] = XMFLOAT3(unit(random) * 8.0f, unit(random) * 8.0f, unit(random) * 8.0f);
+		directions[i] = XMFLOAT3(unit(random) * 4.0f - origins[i].x, unit(random) * 4.0f - origins[i].y, unit(random) * 4.0f - origins[i].z);
+	}
+
+	unsigned int hits = 0;
+	MeshRayHit hit;
+	start = Clock::now();
+	for (unsigned int i = 0; i < rays; i++)
+		hits += bvh.Raycast(origins[i], directions[i], 1e30f, &hit) ? 1 : 0;
+	double tree = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	unsigned int bruteHits = 0;
+	start = Clock::now();
+	for (unsigned int i = 0; i < bruteRays; i++)
+		bruteHits += geometry.Raycast(origins[i], directions[i], 1e30f, &hit) ? 1 : 0;
+	double brute = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	printf("  Build %.1fms, %.1fms with jobs (%u threads), %u nodes, %zu bytes\n",
+		serialBuild, threadedBuild, jobs.GetThreadCount(), bvh.GetNodeCount(), bvh.GetMemoryUsage());
+	printf("  Tree %.0f rays/ms, brute force %.1f rays/ms, %u of %u hit\n",
+		rays / tree, bruteRays / brute, hits, rays);
+	CHECK(hits > 0 && bruteHits > 0);
+}
@@ -0,0 +1,344 @@
+#include "TestFramework.h"
+#include "AllocationCounter.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#pragma comment(lib, "d3d11.lib")
+
+static const char* ObjPath = "MeshImportTests.obj";
+
+// A device with no GPU behind it - it can still make the
+// buffers a mesh needs
+static ID3D11Device* CreateNullDevice()
+{
+	ID3D11Device* device = 0;
+	D3D11CreateDevice(0, D3D_DRIVER_TYPE_NULL, 0, 0, 0, 0, D3D11_SDK_VERSION, &device, 0, 0);
+	return device;
+}
+
+// --------------------------------------------------------
+// Writes a size x size grid of points as an OBJ, with every
+// cell a quad except each third, which is one triangle.
+// Returns how many verts the mesh should end up with.
+// --------------------------------------------------------
+static unsigned int WriteGrid(unsigned int size)
+{
+	FILE* file = fopen(ObjPath, "w");
+	fprintf(file, "# Grid\r\n");
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			fprintf(file, "v %u %u %u\n", x, y, (x * y) % 7);
+			fprintf(file, "vt %f %f\n", x / (float)size, y / (float)size);
+		}
+	}
+	fprintf(file, "vn 0 0 1\n");
+
+	unsigned int verts = 0;
+	for (unsigned int y = 0; y + 1 < size; y++)
+	{
+		for (unsigned int x = 0; x + 1 < size; x++)
+		{
+			unsigned int a = y * size + x + 1;
+			unsigned int b = a + 1;
+			unsigned int c = a + size + 1;
+			unsigned int d = a + size;
+			if ((x + y) % 3 == 0)
+			{
+				fprintf(file, "f %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, b, b, c, c);
+				verts += 3;
+			}
+			else
+			{
+				fprintf(file, "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\r\n", a, a, b, b, c, c, d, d);
+				verts += 6;
+			}
+		}
+	}
+	fclose(file);
+	return verts;
+}
+
+static bool SameGeometry(Mesh* a, Mesh* b)
+{
+	const MeshGeometry& x = a->GetGeometry();
+	const MeshGeometry& y = b->GetGeometry();
+	if (x.GetVertexCount() != y.GetVertexCount() || x.GetIndexCount() != y.GetIndexCount())
+		return false;
+
+	for (unsigned int i = 0; i < x.GetIndexCount(); i++)
+	{
+		if (x.GetIndex(i) != y.GetIndex(i))
+			return false;
+	}
+	for (unsigned int v = 0; v < x.GetVertexCount(); v++)
+	{
+		DirectX::XMFLOAT3 p = x.GetPosition(v);
+		DirectX::XMFLOAT3 q = y.GetPosition(v);
+		if (p.x != q.x || p.y != q.y || p.z != q.z)
+			return false;
+	}
+	return a->GetBoundsRadius() == b->GetBoundsRadius();
+}
+
+TEST(MeshImportReadsObjFiles)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	unsigned int verts = WriteGrid(4);
+	Mesh mesh(ObjPath, device);
+	const MeshGeometry& geometry = mesh.GetGeometry();
+	CHECK(mesh.GetIndexCount() == (int)verts);
+	CHECK(geometry.GetVertexCount() == verts);
+
+	// The first cell is a triangle: its corners come out with
+	// Z flipped and the winding reversed
+	DirectX::XMFLOAT3 first = geometry.GetPosition(geometry.GetIndex(0));
+	DirectX::XMFLOAT3 second = geometry.GetPosition(geometry.GetIndex(1));
+	CHECK(first.x == 0.0f && first.y == 0.0f && first.z == 0.0f);
+	CHECK(second.x == 1.0f && second.y == 1.0f && second.z == -1.0f);
+
+	DirectX::XMFLOAT3 extents = mesh.GetBoundsExtents();
+	CHECK_NEAR(extents.x, 1.5f, 1e-5f);
+	CHECK_NEAR(extents.y, 1.5f, 1e-5f);
+
+	// Missing files make empty meshes
+	remove(ObjPath);
+	Mesh missing(ObjPath, device);
+	CHECK(missing.GetIndexCount() == 0);
+	CHECK(missing.GetGeometry().IsEmpty());
+	device->Release();
+}
+
+// --------------------------------------------------------
+// Once a scratch has grown to fit, importing again only
+// allocates what the mesh keeps, and reused scratch gives
+// the same meshes as fresh - including for a smaller file
+// after a bigger one
+// --------------------------------------------------------
+TEST(MeshImportReusesScratch)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	WriteGrid(64);
+	MeshImportScratch scratch;
+
+	unsigned long long allocations = AllocationCounter::GetThreadAllocations();
+	unsigned long long bytes = AllocationCounter::GetThreadBytesAllocated();
+	Mesh fresh(ObjPath, device, &scratch);
+	unsigned long long firstAllocations = AllocationCounter::GetThreadAllocations() - allocations;
+	unsigned long long firstBytes = AllocationCounter::GetThreadBytesAllocated() - bytes;
+	size_t capacity = scratch.GetCapacity();
+	CHECK(capacity > 0);
+
+	allocations = AllocationCounter::GetThreadAllocations();
+	bytes = AllocationCounter::GetThreadBytesAllocated();
+	Mesh reused(ObjPath, device, &scratch);
+	unsigned long long secondAllocations = AllocationCounter::GetThreadAllocations() - allocations;
+	unsigned long long secondBytes = AllocationCounter::GetThreadBytesAllocated() - bytes;
+
+	CHECK(scratch.GetCapacity() == capacity);
+	CHECK(secondAllocations + 5 <= firstAllocations);
+	CHECK(secondBytes + capacity <= firstBytes);
+	CHECK(SameGeometry(&fresh, &reused));
+
+	unsigned int verts = WriteGrid(5);
+	Mesh small(ObjPath, device);
+	Mesh smallReused(ObjPath, device, &scratch);
+	CHECK(smallReused.GetIndexCount() == (int)verts);
+	CHECK(SameGeometry(&small, &smallReused));
+	CHECK(scratch.GetCapacity() == capacity);
+
+	remove(ObjPath);
+	device->Release();
+}
+
+// --------------------------------------------------------
+// Models load in parallel, so meshes made on many threads at
+// once still have to get ids no other mesh has
+// --------------------------------------------------------
+TEST(MeshIdsAreUniqueAcrossThreads)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	Vertex verts[3] = {};
+	verts[1].Position.x = 1.0f;
+	verts[2].Position.y = 1.0f;
+	unsigned int indices[3] = { 0, 1, 2 };
+
+	const unsigned int count = 512;
+	std::vector<Mesh*> meshes(count);
+	JobSystem jobs(4);
+	jobs.ParallelFor(count, 8, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++)
+			meshes[i] = new Mesh(verts, 3, indices, 3, device, MESH_RESIDENCY_NONE);
+	});
+
+	std::vector<unsigned int> ids(count);
+	for (unsigned int i = 0; i < count; i++)
+		ids[i] = meshes[i]->GetId();
+	std::sort(ids.begin(), ids.end());
+	CHECK(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+	CHECK(ids[count - 1] - ids[0] == count - 1);
+
+	for (unsigned int i = 0; i < count; i++)
+		delete meshes[i];
+	device->Release();
+}
+
+// --------------------------------------------------------
+// Makes a triangle soup mesh of count verts, as the one
+// asked for or whatever the budget leaves room for
+// --------------------------------------------------------
+static Mesh* MakeSoup(ID3D11Device* device, unsigned int count, MeshResidency residency)
+{
+	std::vector<Vertex> verts(count, Vertex());
+	std::vector<unsigned int> indices(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		verts[i].Position = DirectX::XMFLOAT3((float)(i % 7), (float)(i % 5), (float)(i / 3));
+		indices[i] = i;
+	}
+	return new Mesh(verts.data(), count, indices.data(), count, device, residency);
+}
+
+// --------------------------------------------------------
+// Meshes that don't fit the CPU budget are quantized, then
+// dropped, each takes exactly what it reports holding, and
+// deleting one gives its share back
+// --------------------------------------------------------
+TEST(MeshBudgetFallsBackToQuantizedThenNothing)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	const unsigned int verts = 300;
+	size_t full = MeshGeometry::GetMemoryUsage(verts, verts, false);
+	size_t quantized = MeshGeometry::GetMemoryUsage(verts, verts, true);
+	size_t start = Mesh::GetTotalCpuBytes();
+	Mesh::SetCpuBudget(start + full + quantized + 16);
+
+	Mesh* first = MakeSoup(device, verts, MESH_RESIDENCY_FULL);
+	Mesh* second = MakeSoup(device, verts, MESH_RESIDENCY_FULL);
+	Mesh* third = MakeSoup(device, verts, MESH_RESIDENCY_FULL);
+	CHECK(first->GetResidency() == MESH_RESIDENCY_FULL);
+	CHECK(second->GetResidency() == MESH_RESIDENCY_QUANTIZED);
+	CHECK(third->GetResidency() == MESH_RESIDENCY_NONE);
+	CHECK(second->GetGeometry().IsQuantized());
+	CHECK(third->GetGeometry().IsEmpty());
+
+	CHECK(first->GetCpuBytes() == full);
+	CHECK(second->GetCpuBytes() == quantized);
+	CHECK(third->GetCpuBytes() == 0);
+	CHECK(Mesh::GetTotalCpuBytes() == start + full + quantized);
+
+	// Asking for less than full is respected even with room
+	delete first;
+	CHECK(Mesh::GetTotalCpuBytes() == start + quantized);
+	Mesh* asked = MakeSoup(device, verts, MESH_RESIDENCY_QUANTIZED);
+	CHECK(asked->GetResidency() == MESH_RESIDENCY_QUANTIZED);
+	CHECK(Mesh::GetTotalCpuBytes() == start + quantized * 2);
+
+	delete second;
+	delete third;
+	delete asked;
+	CHECK(Mesh::GetTotalCpuBytes() == start);
+	Mesh::SetCpuBudget(std::numeric_limits<size_t>::max());
+	device->Release();
+}
+
+// --------------------------------------------------------
+// A mesh's tree comes out of the same budget, and a tree
+// that doesn't fit is dropped without touching the geometry
+// --------------------------------------------------------
+TEST(MeshBudgetCountsTheBVH)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	size_t start = Mesh::GetTotalCpuBytes();
+	Mesh* mesh = MakeSoup(device, 3000, MESH_RESIDENCY_FULL);
+	size_t geometry = Mesh::GetTotalCpuBytes() - start;
+	mesh->BuildBVH(0);
+	CHECK(!mesh->GetBVH().IsEmpty());
+	CHECK(Mesh::GetTotalCpuBytes() == start + mesh->GetCpuBytes());
+	CHECK(mesh->GetCpuBytes() == geometry + mesh->GetBVH().GetMemoryUsage());
+
+	// Only room for the geometry
+	Mesh::SetCpuBudget(Mesh::GetTotalCpuBytes() + geometry + 16);
+	Mesh* tight = MakeSoup(device, 3000, MESH_RESIDENCY_FULL);
+	Mesh::SetCpuBudget(Mesh::GetTotalCpuBytes() + 16);
+	tight->BuildBVH(0);
+	CHECK(tight->GetResidency() == MESH_RESIDENCY_FULL);
+	CHECK(tight->GetBVH().IsEmpty());
+	CHECK(tight->GetCpuBytes() == geometry);
+
+	delete mesh;
+	delete tight;
+	CHECK(Mesh::GetTotalCpuBytes() == start);
+	Mesh::SetCpuBudget(std::numeric_limits<size_t>::max());
+	device->Release();
+}
+
+// --------------------------------------------------------
+// Imported meshes, and others made from an index list, hand
+// the list over to the geometry - which must not keep more
+// than the budget was charged for
+// --------------------------------------------------------
+TEST(MeshBudgetMatchesKeptGeometry)
+{
+	ID3D11Device* device = CreateNullDevice();
+	CHECK(device != 0);
+	if (!device)
+		return;
+
+	size_t start = Mesh::GetTotalCpuBytes();
+	WriteGrid(300);
+	Mesh* mesh = new Mesh(ObjPath, device);
+	CHECK(mesh->GetGeometry().GetVertexCount() > 65536);
+	CHECK(mesh->GetCpuBytes() == Mesh::GetTotalCpuBytes() - start);
+	delete mesh;
+	CHECK(Mesh::GetTotalCpuBytes() == start);
+
+	// The same goes for index lists handed over with room to
+	// spare
+	const unsigned int count = 70002;
+	std::vector<Vertex> verts(count, Vertex());
+	std::vector<unsigned int> indices;
+	indices.reserve(count * 2);
+	for (unsigned int i = 0; i < count; i++)
+		indices.push_back(i);
+	Mesh* spare = new Mesh(verts.data(), count, std::move(indices), device);
+	CHECK(spare->GetCpuBytes() == Mesh::GetTotalCpuBytes() - start);
+	CHECK(spare->GetCpuBytes() == MeshGeometry::GetMemoryUsage(count, count, false));
+	delete spare;
+
+	// Meshes with no vertices keep nothing, without reading
+	// their (empty) arrays
+	Mesh empty(0, 0, 0, 0, device);
+	CHECK(empty.GetResidency() == MESH_RESIDENCY_NONE);
+	CHECK(empty.GetCpuBytes() == 0);
+	CHECK(Mesh::GetTotalCpuBytes() == start);
+
+	remove(ObjPath);
+	device->Release();
+}
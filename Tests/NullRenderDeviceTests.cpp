@@ -0,0 +1,145 @@
+#include "TestFramework.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+
+#include <chrono>
+#include <cstdio>
+
+TEST(NullRenderDeviceRecordsBaseVertex)
+{
+	NullRenderDevice device;
+	device.DrawIndexed(36, 0, 0);
+	device.DrawIndexed(36, 0, 24);
+	device.DrawIndexedInstanced(36, 10, 0, 0, 0);
+	device.DrawIndexedInstanced(36, 10, 0, 24, 0);
+
+	const std::vector<RenderCommand>& commands = device.GetCommands();
+	CHECK(commands.size() == 4);
+	CHECK(commands[1].Args[2] == 24);
+	CHECK(commands[3].Type == RENDER_COMMAND_DRAW_INDEXED_INSTANCED);
+	CHECK(commands[3].Args[3] == 24);
+
+	// Draws that only differ in base vertex must not log the same
+	for (unsigned int i = 0; i < 4; i += 2)
+	{
+		bool same = true;
+		for (unsigned int a = 0; a < 5; a++)
+			same = same && commands[i].Args[a] == commands[i + 1].Args[a];
+		CHECK(!same);
+	}
+
+	const RenderCommandStats& stats = device.GetStats();
+	CHECK(stats.DrawCalls == 4);
+	CHECK(stats.InstancesDrawn == 22);
+	CHECK(stats.VerticesDrawn == 36 * 22);
+}
+
+TEST(NullRenderDeviceNumbersObjectsInFirstSeenOrder)
+{
+	NullRenderDevice device;
+	device.VSSetShader(Fake<ID3D11VertexShader>(5));
+	device.PSSetShader(Fake<ID3D11PixelShader>(3));
+	device.VSSetShader(Fake<ID3D11VertexShader>(5));
+	device.VSSetShader(0);
+
+	// Handles outlive Clear(), so frames can be compared
+	device.Clear();
+	device.PSSetShader(Fake<ID3D11PixelShader>(3));
+
+	const std::vector<RenderCommand>& commands = device.GetCommands();
+	CHECK(commands.size() == 1);
+	CHECK(commands[0].Args[0] == 2);
+	CHECK(device.GetStats().Binds == 1);
+}
+
+TEST(NullRenderDeviceCountsUploads)
+{
+	NullRenderDevice device;
+	unsigned char data[256] = {};
+	device.UpdateBuffer(Fake<ID3D11Buffer>(0), data, 256);
+	device.UpdateBufferRange(Fake<ID3D11Buffer>(0), data + 16, 16, 48);
+	data[20] = 1;
+	device.UpdateBufferRange(Fake<ID3D11Buffer>(0), data + 16, 16, 48);
+
+	const std::vector<RenderCommand>& commands = device.GetCommands();
+	CHECK(device.GetStats().Uploads == 3);
+	CHECK(device.GetStats().BytesUploaded == 256 + 32 + 32);
+
+	// Different data, different hash
+	CHECK(commands[1].Args[3] != commands[2].Args[3]);
+}
+
+// --------------------------------------------------------
+// Issues a frame shaped like the opaque pass: each draw binds
+// its mesh, shaders, per-object constants and textures, with
+// meshes and materials shared by runs of draws
+// --------------------------------------------------------
+static void IssueFrame(IRenderDevice* device, unsigned int draws)
+{
+	unsigned int stride = 48;
+	unsigned int offset = 0;
+	unsigned int firstConstant[1];
+	unsigned int numConstants[1] = { 16 };
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		unsigned int mesh = (i / 16) % 8;
+		unsigned int material = (i / 64) % 4;
+
+		ID3D11Buffer* vb = Fake<ID3D11Buffer>(mesh);
+		ID3D11Buffer* cb = Fake<ID3D11Buffer>(20);
+		ID3D11ShaderResourceView* views[3] =
+		{
+			Fake<ID3D11ShaderResourceView>(30 + material),
+			Fake<ID3D11ShaderResourceView>(34 + material),
+			Fake<ID3D11ShaderResourceView>(38 + material),
+		};
+		ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(50);
+
+		device->IASetInputLayout(Fake<ID3D11InputLayout>(60));
+		device->IASetPrimitiveTopology(4);
+		device->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+		device->IASetIndexBuffer(Fake<ID3D11Buffer>(8 + mesh), 42, 0);
+		device->VSSetShader(Fake<ID3D11VertexShader>(61));
+		firstConstant[0] = i * 16;
+		device->VSSetConstantBuffers1(1, 1, &cb, firstConstant, numConstants);
+		device->PSSetShader(Fake<ID3D11PixelShader>(62));
+		device->PSSetShaderResources(0, 3, views);
+		device->PSSetSamplers(0, 1, &sampler);
+		device->DrawIndexed(36, 0, 0);
+	}
+}
+
+// --------------------------------------------------------
+// What recording a 10k draw frame costs, straight into the
+// null device and through the state cache in front of it
+// --------------------------------------------------------
+BENCHMARK(NullRenderDeviceRecordingCost)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int draws = 10000;
+
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+	IRenderDevice* paths[2] = { &recorder, &cache };
+	const char* names[2] = { "Direct", "State cache" };
+
+	for (unsigned int p = 0; p < 2; p++)
+	{
+		double best = 1e30;
+		for (unsigned int frame = 0; frame < 20; frame++)
+		{
+			recorder.Clear();
+			cache.Invalidate();
+			Clock::time_point start = Clock::now();
+			IssueFrame(paths[p], draws);
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			if (seconds < best)
+				best = seconds;
+		}
+
+		const RenderCommandStats& stats = recorder.GetStats();
+		printf("  %-12s %7.3fms per frame, %5.1fns per draw, %u commands (%u binds)\n",
+			names[p], best * 1000.0, best * 1e9 / draws, stats.Commands, stats.Binds);
+		CHECK(stats.DrawCalls == draws);
+	}
+}
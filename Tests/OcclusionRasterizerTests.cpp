@@ -0,0 +1,277 @@
+#include "TestFramework.h"
+#include "OcclusionRasterizer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+// A camera at the origin looking down +Z
+static XMMATRIX MakeViewProjection()
+{
+	return XMMatrixPerspectiveFovLH(1.2f, 16.0f / 9.0f, 0.1f, 100.0f);
+}
+
+// A wall of two triangles facing the camera, at z
+static void DrawWall(OcclusionRasterizer* rasterizer, float x0, float y0, float x1, float y1, float z, bool flipWinding)
+{
+	XMFLOAT3 corners[4] = { XMFLOAT3(x0, y0, z), XMFLOAT3(x1, y0, z), XMFLOAT3(x1, y1, z), XMFLOAT3(x0, y1, z) };
+	unsigned int clockwise[6] = { 0, 1, 2, 0, 2, 3 };
+	unsigned int counter[6] = { 0, 2, 1, 0, 3, 2 };
+	rasterizer->RenderOccluder(corners, flipWinding ? counter : clockwise, 6, XMMatrixIdentity());
+}
+
+TEST(OcclusionRasterizerWallHidesWhatsBehindIt)
+{
+	for (int winding = 0; winding < 2; winding++)
+	{
+		OcclusionRasterizer rasterizer;
+		rasterizer.Begin(MakeViewProjection());
+
+		// Covers the left half of the screen at z = 10
+		DrawWall(&rasterizer, -100.0f, -100.0f, 0.0f, 100.0f, 10.0f, winding == 1);
+
+		CHECK(!rasterizer.IsVisible(XMFLOAT3(-3, -1, 20), XMFLOAT3(-1, 1, 22)));		// Behind
+		CHECK(rasterizer.IsVisible(XMFLOAT3(-3, -1, 5), XMFLOAT3(-1, 1, 7)));			// In front
+		CHECK(rasterizer.IsVisible(XMFLOAT3(1, -1, 20), XMFLOAT3(3, 1, 22)));			// Beside
+		CHECK(rasterizer.IsVisible(XMFLOAT3(-1, -1, 20), XMFLOAT3(1, 1, 22)));			// Partly beside
+		CHECK(rasterizer.IsVisible(XMFLOAT3(-3, -1, 8), XMFLOAT3(-1, 1, 12)));			// Through it
+		CHECK(rasterizer.IsVisible(XMFLOAT3(-3, -1, -1), XMFLOAT3(-1, 1, 22)));		// Reaching past the near plane
+
+		const OcclusionStats& stats = rasterizer.GetStats();
+		CHECK(stats.TrianglesRasterized + stats.TrianglesSkipped == 2);
+		CHECK(stats.TrianglesRasterized >= 1);
+		CHECK(stats.BoxesTested == 6);
+		CHECK(stats.BoxesHidden == 1);
+	}
+}
+
+TEST(OcclusionRasterizerDrawsBothWindingsAlike)
+{
+	OcclusionRasterizer a, b;
+	a.Begin(XMMatrixIdentity());
+	b.Begin(XMMatrixIdentity());
+
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> position(-1.2f, 1.2f);
+	std::uniform_real_distribution<float> depth(0.1f, 0.9f);
+	for (unsigned int i = 0; i < 200; i++)
+	{
+		XMFLOAT3 v[3];
+		for (int k = 0; k < 3; k++)
+			v[k] = XMFLOAT3(position(random), position(random), depth(random));
+		unsigned int forward[3] = { 0, 1, 2 };
+		unsigned int backward[3] = { 0, 2, 1 };
+		a.RenderOccluder(v, forward, 3, XMMatrixIdentity());
+		b.RenderOccluder(v, backward, 3, XMMatrixIdentity());
+	}
+
+	unsigned int different = 0;
+	for (unsigned int y = 0; y < a.GetHeight(); y++)
+	{
+		for (unsigned int x = 0; x < a.GetWidth(); x++)
+		{
+			if (a.GetDepth(x, y) != b.GetDepth(x, y))
+				different++;
+		}
+	}
+	CHECK(different == 0);
+}
+
+// --------------------------------------------------------
+// Two triangles sharing an edge must cover every pixel of
+// their quad exactly once - no cracks along the diagonal -
+// and nothing outside it
+// --------------------------------------------------------
+TEST(OcclusionRasterizerHasNoCracks)
+{
+	std::mt19937 random(8);
+	std::uniform_real_distribution<float> position(-0.9f, 0.9f);
+	unsigned int cracks = 0;
+	unsigned int spills = 0;
+	unsigned int covered = 0;
+	for (unsigned int q = 0; q < 100; q++)
+	{
+		// A random convex quad, split along a diagonal
+		OcclusionRasterizer rasterizer;
+		rasterizer.Begin(XMMatrixIdentity());
+		XMFLOAT3 v[4] =
+		{
+			XMFLOAT3(position(random) * 0.5f - 0.5f, position(random) * 0.5f - 0.5f, 0.5f),
+			XMFLOAT3(position(random) * 0.5f + 0.5f, position(random) * 0.5f - 0.5f, 0.5f),
+			XMFLOAT3(position(random) * 0.5f + 0.5f, position(random) * 0.5f + 0.5f, 0.5f),
+			XMFLOAT3(position(random) * 0.5f - 0.5f, position(random) * 0.5f + 0.5f, 0.5f),
+		};
+		unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+		rasterizer.RenderOccluder(v, indices, 6, XMMatrixIdentity());
+
+		// Screen space corners, to test pixel centers against,
+		// skipping quads that came out concave
+		float sx[4], sy[4];
+		for (int k = 0; k < 4; k++)
+		{
+			sx[k] = (v[k].x * 0.5f + 0.5f) * rasterizer.GetWidth();
+			sy[k] = (0.5f - v[k].y * 0.5f) * rasterizer.GetHeight();
+		}
+		bool convex = true;
+		for (int k = 0; k < 4; k++)
+		{
+			int n = (k + 1) % 4, m = (k + 2) % 4;
+			convex = convex && (sx[n] - sx[k]) * (sy[m] - sy[n]) - (sy[n] - sy[k]) * (sx[m] - sx[n]) < 0.0f;
+		}
+		if (!convex)
+			continue;
+
+		for (unsigned int y = 0; y < rasterizer.GetHeight(); y++)
+		{
+			for (unsigned int x = 0; x < rasterizer.GetWidth(); x++)
+			{
+				// Signed distance from each edge, in pixels
+				double px = x + 0.5, py = y + 0.5;
+				bool inside = true, outside = false;
+				for (int k = 0; k < 4; k++)
+				{
+					double ex = sx[(k + 1) % 4] - sx[k], ey = sy[(k + 1) % 4] - sy[k];
+					double d = (ex * (py - sy[k]) - ey * (px - sx[k])) / sqrt(ex * ex + ey * ey);
+					inside = inside && d < -0.01;
+					outside = outside || d > 0.01;
+				}
+
+				float z = rasterizer.GetDepth(x, y);
+				if (inside)
+					covered++;
+				if (inside && z != 0.5f)
+					cracks++;
+				if (outside && z != 1.0f)
+					spills++;
+			}
+		}
+	}
+	CHECK(cracks == 0);
+	CHECK(spills == 0);
+	CHECK(covered > 100000);
+}
+
+TEST(OcclusionRasterizerSkipsNearPlaneAndDegenerateTriangles)
+{
+	OcclusionRasterizer rasterizer;
+	rasterizer.Begin(MakeViewProjection());
+
+	// Crosses the near plane, then has no area
+	XMFLOAT3 crossing[3] = { XMFLOAT3(-5, -5, -1), XMFLOAT3(5, -5, 10), XMFLOAT3(0, 5, 10) };
+	XMFLOAT3 flat[3] = { XMFLOAT3(-5, 0, 10), XMFLOAT3(0, 0, 10), XMFLOAT3(5, 0, 10) };
+	unsigned int indices[3] = { 0, 1, 2 };
+	rasterizer.RenderOccluder(crossing, indices, 3, XMMatrixIdentity());
+	rasterizer.RenderOccluder(flat, indices, 3, XMMatrixIdentity());
+
+	// Entirely off screen
+	DrawWall(&rasterizer, 100.0f, 100.0f, 110.0f, 110.0f, 10.0f, false);
+
+	CHECK(rasterizer.GetStats().TrianglesRasterized == 0);
+	CHECK(rasterizer.GetStats().TrianglesSkipped == 4);
+	CHECK(rasterizer.IsVisible(XMFLOAT3(-1, -1, 50), XMFLOAT3(1, 1, 51)));
+}
+
+// --------------------------------------------------------
+// The same occluder kept as floats and quantized must hide
+// the same boxes, and the nearest depth must always win
+// --------------------------------------------------------
+TEST(OcclusionRasterizerDrawsMeshGeometry)
+{
+	XMFLOAT3 corners[8];
+	for (int c = 0; c < 8; c++)
+		corners[c] = XMFLOAT3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+	unsigned int cube[36] =
+	{
+		0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,	0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,	0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5,
+	};
+
+	MeshGeometry full, quantized;
+	full.Build(corners, sizeof(XMFLOAT3), 8, cube, 36, false);
+	quantized.Build(corners, sizeof(XMFLOAT3), 8, cube, 36, true);
+
+	XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(6, 6, 1), XMMatrixTranslation(0, 0, 15));
+	const MeshGeometry* geometries[2] = { &full, &quantized };
+	bool hidden[2][3];
+	for (int g = 0; g < 2; g++)
+	{
+		OcclusionRasterizer rasterizer;
+		rasterizer.Begin(MakeViewProjection());
+		DrawWall(&rasterizer, -100.0f, -100.0f, 100.0f, 100.0f, 90.0f, false);
+		rasterizer.RenderOccluder(*geometries[g], world);
+		CHECK(rasterizer.GetStats().TrianglesRasterized >= 2);
+
+		hidden[g][0] = !rasterizer.IsVisible(XMFLOAT3(-1, -1, 30), XMFLOAT3(1, 1, 31));
+		hidden[g][1] = !rasterizer.IsVisible(XMFLOAT3(-1, -1, 10), XMFLOAT3(1, 1, 11));
+		hidden[g][2] = !rasterizer.IsVisible(XMFLOAT3(20, -1, 30), XMFLOAT3(22, 1, 31));
+	}
+
+	for (int g = 0; g < 2; g++)
+	{
+		CHECK(hidden[g][0]);
+		CHECK(!hidden[g][1]);
+		CHECK(!hidden[g][2]);
+	}
+}
+
+// --------------------------------------------------------
+// Rasterizing a scene's worth of occluders - a few hundred
+// randomly placed walls of 512 triangles each
+// --------------------------------------------------------
+BENCHMARK(OcclusionRasterizerTrianglesPerMs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// A 16x16 grid of quads
+	const unsigned int grid = 16;
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y <= grid; y++)
+	{
+		for (unsigned int x = 0; x <= grid; x++)
+			positions.push_back(XMFLOAT3(x / (float)grid - 0.5f, y / (float)grid - 0.5f, 0.0f));
+	}
+	for (unsigned int y = 0; y < grid; y++)
+	{
+		for (unsigned int x = 0; x < grid; x++)
+		{
+			unsigned int i = y * (grid + 1) + x;
+			unsigned int quad[6] = { i, i + grid + 1, i + 1, i + 1, i + grid + 1, i + grid + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> spread(-30.0f, 30.0f);
+	std::uniform_real_distribution<float> distance(5.0f, 80.0f);
+	std::uniform_real_distribution<float> angle(-1.0f, 1.0f);
+	std::vector<XMFLOAT4X4> walls(300);
+	for (XMFLOAT4X4& wall : walls)
+	{
+		XMMATRIX world = XMMatrixMultiply(XMMatrixScaling(8, 4, 1), XMMatrixRotationY(angle(random)));
+		world = XMMatrixMultiply(world, XMMatrixTranslation(spread(random), spread(random) * 0.2f, distance(random)));
+		XMStoreFloat4x4(&wall, world);
+	}
+
+	OcclusionRasterizer rasterizer;
+	double best = 1e30;
+	for (unsigned int run = 0; run < 20; run++)
+	{
+		rasterizer.ResetStats();
+		Clock::time_point start = Clock::now();
+		rasterizer.Begin(MakeViewProjection());
+		for (const XMFLOAT4X4& wall : walls)
+			rasterizer.RenderOccluder(positions.data(), indices.data(), (unsigned int)indices.size(), XMLoadFloat4x4(&wall));
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		best = std::min(best, ms);
+	}
+
+	const OcclusionStats& stats = rasterizer.GetStats();
+	unsigned int triangles = stats.TrianglesRasterized + stats.TrianglesSkipped;
+	printf("  %.3fms for %u triangles (%u rasterized, %u tiles) - %.0f triangles/ms\n",
+		best, triangles, stats.TrianglesRasterized, stats.TilesRasterized, triangles / best);
+	CHECK(stats.TrianglesRasterized > 0);
+}
@@ -0,0 +1,285 @@
+#include "TestFramework.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+static const char* TracePath = "ProfilerTests.json";
+
+// Reads a whole file back
+static std::string ReadFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+// Counts the times a pattern appears in some text
+static unsigned int CountOf(const std::string& text, const char* pattern)
+{
+	unsigned int count = 0;
+	for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+		count++;
+	return count;
+}
+
+TEST(FrameTimeHistorySummarizesByNearestRank)
+{
+	FrameTimeHistory history;
+	CHECK(history.Summarize(0).Frames == 0);
+
+	// 1 to 100ms, in any order
+	std::vector<float> times;
+	for (unsigned int i = 1; i <= 100; i++)
+		times.push_back((float)i);
+	std::shuffle(times.begin(), times.end(), std::mt19937(4));
+	for (float t : times)
+		history.Add(t);
+
+	FrameTimeSummary summary = history.Summarize(0);
+	CHECK(summary.Frames == 100);
+	CHECK_NEAR(summary.Average, 50.5f, 1e-4f);
+	CHECK(summary.P50 == 50.0f);
+	CHECK(summary.P95 == 95.0f);
+	CHECK(summary.P99 == 99.0f);
+	CHECK(summary.Max == 100.0f);
+
+	// Only the newest frames, when asked for fewer
+	for (unsigned int i = 1; i <= 10; i++)
+		history.Add(200.0f + i);
+	summary = history.Summarize(10);
+	CHECK(summary.Frames == 10);
+	CHECK(summary.P50 == 205.0f);
+	CHECK(summary.P95 == 210.0f);
+	CHECK(summary.Max == 210.0f);
+	CHECK(history.Summarize(1000).Frames == 110);
+
+	// A single frame is every percentile
+	FrameTimeHistory single;
+	single.Add(16.0f);
+	summary = single.Summarize(0);
+	CHECK(summary.P50 == 16.0f && summary.P99 == 16.0f && summary.Max == 16.0f);
+
+	// The shared helper rounds ranks up
+	float sorted[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	CHECK(NearestRank(sorted, 4, 0.0f) == 1.0f);
+	CHECK(NearestRank(sorted, 4, 0.25f) == 1.0f);
+	CHECK(NearestRank(sorted, 4, 0.26f) == 2.0f);
+	CHECK(NearestRank(sorted, 4, 1.0f) == 4.0f);
+}
+
+TEST(FrameTimeHistoryWrapsAround)
+{
+	FrameTimeHistory history;
+	for (unsigned int i = 0; i < FrameTimeHistory::Capacity; i++)
+		history.Add(10.0f);
+	for (unsigned int i = 0; i < 100; i++)
+		history.Add(50.0f);
+
+	// The oldest frames made room, and the newest are in order
+	FrameTimeSummary summary = history.Summarize(0);
+	CHECK(history.GetCount() == FrameTimeHistory::Capacity);
+	CHECK(summary.Frames == FrameTimeHistory::Capacity);
+	CHECK(summary.Max == 50.0f);
+	CHECK_NEAR(summary.Average, (10.0f * (FrameTimeHistory::Capacity - 100) + 50.0f * 100) / FrameTimeHistory::Capacity, 1e-2f);
+	summary = history.Summarize(100);
+	CHECK(summary.P50 == 50.0f && summary.Average == 50.0f);
+	summary = history.Summarize(101);
+	CHECK(summary.P50 == 50.0f && summary.Average < 50.0f);
+
+	// Going all the way round again leaves none of the above
+	for (unsigned int i = 0; i < FrameTimeHistory::Capacity; i++)
+		history.Add(20.0f);
+	summary = history.Summarize(0);
+	CHECK(summary.Max == 20.0f && summary.P50 == 20.0f);
+
+	history.Clear();
+	CHECK(history.GetCount() == 0);
+	CHECK(history.Summarize(0).Frames == 0);
+}
+
+TEST(ProfilerKeepsFrameTimesOnlyWhileEnabled)
+{
+	Profiler::SetEnabled(false);
+	for (unsigned int i = 0; i < 5; i++)
+		Profiler::EndFrame();
+	CHECK(Profiler::GetFrameTimeSummary().Frames == 0);
+
+	// The first frame only starts the clock
+	Profiler::SetEnabled(true);
+	for (unsigned int i = 0; i < 5; i++)
+		Profiler::EndFrame();
+	FrameTimeSummary summary = Profiler::GetFrameTimeSummary();
+	CHECK(summary.Frames == 4);
+	CHECK(summary.Max >= summary.P50 && summary.P50 >= 0.0f);
+	CHECK(Profiler::GetFrameTimeSummary(2).Frames == 2);
+
+	// Turning it off and on starts the clock again
+	Profiler::SetEnabled(false);
+	Profiler::EndFrame();
+	Profiler::SetEnabled(true);
+	Profiler::EndFrame();
+	CHECK(Profiler::GetFrameTimeSummary().Frames == 4);
+
+	Profiler::SetEnabled(false);
+	Profiler::Shutdown();
+	CHECK(Profiler::GetFrameTimeSummary().Frames == 0);
+}
+
+TEST(ProfilerReturnsTheLastFrameScopes)
+{
+	std::vector<ProfileEvent> scopes;
+	Profiler::SetEnabled(true);
+	Profiler::EndFrame();
+	{
+		PROFILE_SCOPE("Outer");
+		PROFILE_SCOPE("Inner");
+	}
+	Profiler::EndFrame();
+	Profiler::GetLastFrameScopes(&scopes);
+
+	// Scopes finish innermost first
+	CHECK(scopes.size() == 2);
+	if (scopes.size() == 2)
+	{
+		CHECK(strcmp(scopes[0].Name, "Inner") == 0 && scopes[0].Depth == 1);
+		CHECK(strcmp(scopes[1].Name, "Outer") == 0 && scopes[1].Depth == 0);
+		CHECK(scopes[1].Start <= scopes[0].Start && scopes[0].End <= scopes[1].End);
+	}
+
+	// Only the last frame, and scopes made while disabled aren't kept
+	{
+		PROFILE_SCOPE("Next");
+	}
+	Profiler::SetEnabled(false);
+	{
+		PROFILE_SCOPE("Hidden");
+	}
+	Profiler::SetEnabled(true);
+	Profiler::EndFrame();
+	Profiler::GetLastFrameScopes(&scopes);
+	CHECK(scopes.size() == 1 && strcmp(scopes[0].Name, "Next") == 0);
+
+	// A frame with more scopes than the buffer holds keeps
+	// the newest
+	const unsigned int count = ProfileThreadBuffer::Capacity + 100;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		PROFILE_SCOPE(i + 1 == count ? "Last" : "Many");
+	}
+	Profiler::EndFrame();
+	Profiler::GetLastFrameScopes(&scopes);
+	CHECK(scopes.size() == ProfileThreadBuffer::Capacity);
+	CHECK(!scopes.empty() && strcmp(scopes.back().Name, "Last") == 0);
+
+	Profiler::SetEnabled(false);
+	Profiler::Shutdown();
+}
+
+TEST(ProfilerWritesWellFormedChromeTraces)
+{
+	// The checker itself
+	CHECK(IsWellFormedJson("{\"a\":[1,-2.5e3,\"\\\"\",true,null],\"b\":{}}"));
+	CHECK(!IsWellFormedJson("{\"a\":[1,2,]}"));
+	CHECK(!IsWellFormedJson("{\"a\":1} {"));
+	CHECK(!IsWellFormedJson("{\"a\":0.-5}"));
+
+	Profiler::SetEnabled(true);
+	Profiler::SetThreadName("Main \"Thread\"");
+	{
+		PROFILE_SCOPE("Frame");
+		for (unsigned int i = 0; i < 10; i++)
+		{
+			PROFILE_SCOPE("Say \"hi\"\\");
+		}
+	}
+	std::thread worker([]()
+	{
+		Profiler::SetThreadName("Worker");
+		for (unsigned int i = 0; i < 5; i++)
+		{
+			PROFILE_SCOPE("Job");
+		}
+	});
+	worker.join();
+
+	CHECK(Profiler::WriteChromeTrace(TracePath));
+	std::string trace = ReadFile(TracePath);
+	CHECK(IsWellFormedJson(trace));
+	CHECK(CountOf(trace, "\"ph\":\"X\"") == 16);
+	CHECK(CountOf(trace, "\"ph\":\"M\"") == 2);
+	CHECK(CountOf(trace, "\"name\":\"Job\"") == 5);
+	CHECK(CountOf(trace, "\"name\":\"Main \\\"Thread\\\"\"") == 1);
+	CHECK(CountOf(trace, "\"name\":\"Worker\"") == 1);
+
+	// Cut short, it isn't
+	CHECK(!IsWellFormedJson(trace.substr(0, trace.size() / 2)));
+
+	Profiler::SetEnabled(false);
+	Profiler::Shutdown();
+	remove(TracePath);
+}
+
+// --------------------------------------------------------
+// Saving while another thread keeps recording (and keeps
+// overwriting its oldest events) still gives valid traces
+// --------------------------------------------------------
+TEST(ProfilerWritesTracesWhileThreadsRecord)
+{
+	Profiler::SetEnabled(true);
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned int> recorded(0);
+	std::thread worker([&]()
+	{
+		static const char* names[3] = { "A", "Longer name", "" };
+		for (unsigned int i = 0; !stop; i++)
+		{
+			PROFILE_SCOPE(names[i % 3]);
+			recorded.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	for (unsigned int pass = 0; pass < 4; pass++)
+	{
+		// Wait for at least one wrap around the worker's buffer
+		unsigned int target = recorded + ProfileThreadBuffer::Capacity;
+		while (recorded < target)
+			std::this_thread::yield();
+
+		CHECK(Profiler::WriteChromeTrace(TracePath));
+		std::string trace = ReadFile(TracePath);
+		CHECK(IsWellFormedJson(trace));
+		CHECK(CountOf(trace, "\"ph\":\"X\"") <= ProfileThreadBuffer::Capacity);
+		CHECK(CountOf(trace, "\"ph\":\"X\"") > 0);
+		CHECK(CountOf(trace, "\"dur\":-") == 0);
+
+		// Events come out oldest first, so an event from a lap
+		// ahead (one that overwrote the slot mid-copy) shows
+		// up as time going backwards
+		double lastEnd = 0.0;
+		bool ordered = true;
+		for (size_t at = trace.find(",\"ts\":"); at != std::string::npos; at = trace.find(",\"ts\":", at + 1))
+		{
+			char* next;
+			double start = strtod(trace.c_str() + at + 6, &next);
+			double end = start + strtod(strstr(next, ",\"dur\":") + 7, 0);
+			ordered = ordered && end >= lastEnd - 0.2;
+			lastEnd = end;
+		}
+		CHECK(ordered);
+	}
+
+	stop = true;
+	worker.join();
+	Profiler::SetEnabled(false);
+	Profiler::Shutdown();
+	remove(TracePath);
+}
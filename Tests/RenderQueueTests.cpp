@@ -0,0 +1,161 @@
+#include "TestFramework.h"
+#include "RenderQueue.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Sorts the queue and checks it against std::stable_sort, by
+// key and by payload, since equal keys must keep their order
+static bool SortsLikeStableSort(RenderQueue* queue)
+{
+	std::vector<RenderQueueEntry> expected(queue->GetEntries(), queue->GetEntries() + queue->GetCount());
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.Key < b.Key; });
+
+	queue->Sort();
+	const RenderQueueEntry* sorted = queue->GetEntries();
+	for (unsigned int i = 0; i < expected.size(); i++)
+	{
+		if (sorted[i].Key != expected[i].Key || sorted[i].Payload != expected[i].Payload)
+			return false;
+	}
+	return true;
+}
+
+TEST(RenderQueueSortsLikeStableSort)
+{
+	FrameArena arena;
+	RenderQueue queue;
+	std::mt19937_64 random(7);
+
+	// Fully random keys
+	queue.Begin(&arena, 50000);
+	for (unsigned int i = 0; i < 50000; i++)
+		queue.Add(random(), i);
+	CHECK(SortsLikeStableSort(&queue));
+
+	// Realistic keys - few shaders, lots of repeats, so most
+	// bytes are skipped and equal keys are common
+	arena.Reset();
+	queue.Begin(&arena, 50000);
+	for (unsigned int i = 0; i < 50000; i++)
+		queue.Add(RenderQueue::MakeKey(0, random() % 3, random() % 16, random() % 40, (random() % 8) / 8.0f), i);
+	CHECK(SortsLikeStableSort(&queue));
+
+	// Every key the same, so nothing should move
+	arena.Reset();
+	queue.Begin(&arena, 1000);
+	for (unsigned int i = 0; i < 1000; i++)
+		queue.Add(42, i);
+	CHECK(SortsLikeStableSort(&queue));
+
+	// Nothing, and just one
+	arena.Reset();
+	queue.Begin(&arena, 4);
+	queue.Sort();
+	CHECK(queue.GetCount() == 0);
+	queue.Add(9, 3);
+	queue.Sort();
+	CHECK(queue.GetCount() == 1 && queue.GetEntries()[0].Payload == 3);
+}
+
+TEST(RenderQueueKeysOrderByPassShaderMaterialMeshDepth)
+{
+	unsigned long long base = RenderQueue::MakeKey(1, 1, 1, 1, 0.5f);
+	CHECK(RenderQueue::MakeKey(0, 9, 9, 9, 1.0f) < base);
+	CHECK(RenderQueue::MakeKey(1, 0, 9, 9, 1.0f) < base);
+	CHECK(RenderQueue::MakeKey(1, 1, 0, 9, 1.0f) < base);
+	CHECK(RenderQueue::MakeKey(1, 1, 1, 0, 1.0f) < base);
+	CHECK(RenderQueue::MakeKey(1, 1, 1, 1, 0.25f) < base);
+
+	// Depth is clamped to the frustum, and fields to their widths
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0, -5.0f) == RenderQueue::MakeKey(0, 0, 0, 0, 0.0f));
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 5.0f) == RenderQueue::MakeKey(0, 0, 0, 0, 1.0f));
+	CHECK(RenderQueue::MakeKey(0, 0x1000, 0, 0, 0.0f) == RenderQueue::MakeKey(0, 0, 0, 0, 0.0f));
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0x10002, 0.0f) == RenderQueue::MakeKey(0, 0, 0, 2, 0.0f));
+}
+
+TEST(RenderQueueDropsDrawsPastCapacity)
+{
+	FrameArena arena;
+	RenderQueue queue;
+	queue.Begin(&arena, 3);
+	for (unsigned int i = 0; i < 5; i++)
+		queue.Add(10 - i, i);
+	CHECK(queue.GetCount() == 3);
+
+	queue.Sort();
+	CHECK(queue.GetEntries()[0].Payload == 2);
+	CHECK(queue.GetEntries()[2].Payload == 0);
+}
+
+// --------------------------------------------------------
+// 100k random draws queued, sorted and submitted through the
+// state cache over the null device, as in RenderGeometry
+// --------------------------------------------------------
+BENCHMARK(RenderQueue100kDraws)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int draws = 100000;
+
+	std::mt19937 random(1);
+	std::vector<unsigned int> meshes(draws);
+	std::vector<unsigned int> materials(draws);
+	std::vector<float> depths(draws);
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		meshes[i] = random() % 500;
+		materials[i] = random() % 64;
+		depths[i] = (random() % 1000) / 1000.0f;
+	}
+
+	// Fake D3D objects - only their addresses are used
+	std::vector<char> objects(1024);
+
+	FrameArena arena;
+	RenderQueue queue;
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+	double build = 0.0, sort = 0.0, submit = 0.0;
+	const unsigned int frames = 10;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		arena.Reset();
+		recorder.Clear();
+		cache.ResetStats();
+
+		Clock::time_point start = Clock::now();
+		queue.Begin(&arena, draws);
+		for (unsigned int i = 0; i < draws; i++)
+			queue.Add(RenderQueue::MakeKey(0, 0, materials[i], meshes[i], depths[i]), i);
+		Clock::time_point built = Clock::now();
+		queue.Sort();
+		Clock::time_point sorted = Clock::now();
+
+		const RenderQueueEntry* entries = queue.GetEntries();
+		unsigned int stride = 32, offset = 0;
+		for (unsigned int i = 0; i < queue.GetCount(); i++)
+		{
+			unsigned int draw = entries[i].Payload;
+			ID3D11Buffer* vb = (ID3D11Buffer*)&objects[meshes[draw]];
+			ID3D11ShaderResourceView* view = (ID3D11ShaderResourceView*)&objects[512 + materials[draw]];
+			cache.PSSetShaderResources(0, 1, &view);
+			cache.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+			cache.DrawIndexed(36, 0, 0);
+		}
+		Clock::time_point submitted = Clock::now();
+
+		build += std::chrono::duration<double, std::milli>(built - start).count();
+		sort += std::chrono::duration<double, std::milli>(sorted - built).count();
+		submit += std::chrono::duration<double, std::milli>(submitted - sorted).count();
+	}
+
+	const StateCacheStats& stats = cache.GetStats();
+	printf("  Build %.2fms, sort %.2fms, submit %.2fms per frame; %u binds issued, %u filtered\n",
+		build / frames, sort / frames, submit / frames, stats.CallsIssued, stats.CallsFiltered);
+	CHECK(recorder.GetStats().DrawCalls == draws);
+}
@@ -0,0 +1,180 @@
+#include "TestFramework.h"
+#include "SceneGraph.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+static XMFLOAT4X4 RandomLocal(std::mt19937* random)
+{
+	std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> angle(-0.5f, 0.5f);
+	XMMATRIX local = XMMatrixMultiply(
+		XMMatrixRotationRollPitchYaw(angle(*random), angle(*random), angle(*random)),
+		XMMatrixTranslation(offset(*random), offset(*random), offset(*random)));
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, local);
+	return result;
+}
+
+// A random tree - each node's parent is one of the nodes
+// just before it, with the odd new root
+static void BuildTree(SceneGraph* graph, unsigned int count, std::mt19937* random)
+{
+	graph->Reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		int parent = SceneGraph::NoParent;
+		if (i > 0 && (*random)() % 100 != 0)
+			parent = (int)(i - 1 - (*random)() % std::min(i, 8u));
+		graph->AddNode(parent, RandomLocal(random));
+	}
+}
+
+// Multiplies a node's local transform by each ancestor's in turn
+static XMMATRIX WalkParents(SceneGraph* graph, unsigned int node)
+{
+	XMMATRIX world = XMLoadFloat4x4(&graph->GetLocalTransform(node));
+	for (int parent = graph->GetParent(node); parent != SceneGraph::NoParent; parent = graph->GetParent(parent))
+		world = XMMatrixMultiply(world, XMLoadFloat4x4(&graph->GetLocalTransform(parent)));
+	return world;
+}
+
+static float MaxError(SceneGraph* graph)
+{
+	float worst = 0.0f;
+	for (unsigned int i = 0; i < graph->GetNodeCount(); i++)
+	{
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, WalkParents(graph, i));
+		const float* x = &graph->GetWorldTransform(i)._11;
+		const float* y = &expected._11;
+		for (int e = 0; e < 16; e++)
+			worst = std::max(worst, fabsf(x[e] - y[e]) / std::max(1.0f, fabsf(y[e])));
+	}
+	return worst;
+}
+
+// Nodes in a subtree, which are always after its root
+static unsigned int CountSubtrees(SceneGraph* graph, const std::vector<unsigned int>& roots)
+{
+	std::vector<bool> inside(graph->GetNodeCount(), false);
+	for (unsigned int root : roots)
+		inside[root] = true;
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < graph->GetNodeCount(); i++)
+	{
+		int parent = graph->GetParent(i);
+		if (parent != SceneGraph::NoParent && inside[parent])
+			inside[i] = true;
+		if (inside[i])
+			total++;
+	}
+	return total;
+}
+
+TEST(SceneGraphMatchesWalkingParents)
+{
+	SceneGraph graph;
+	std::mt19937 random(21);
+	BuildTree(&graph, 5000, &random);
+	CHECK(graph.Update() == 5000);
+	CHECK(MaxError(&graph) < 1e-4f);
+	CHECK(graph.Update() == 0);
+
+	// Change a few nodes at a time, checking only their subtrees
+	// are recomputed and everything still matches
+	for (unsigned int round = 0; round < 20; round++)
+	{
+		std::vector<unsigned int> changed;
+		for (unsigned int c = 0; c < 1 + round % 4; c++)
+		{
+			unsigned int node = random() % graph.GetNodeCount();
+			graph.SetLocalTransform(node, RandomLocal(&random));
+			changed.push_back(node);
+		}
+
+		CHECK(graph.Update() == CountSubtrees(&graph, changed));
+		CHECK(MaxError(&graph) < 1e-4f);
+	}
+}
+
+TEST(SceneGraphTreatsBadParentsAsRoots)
+{
+	SceneGraph graph;
+	XMFLOAT4X4 shifted;
+	XMStoreFloat4x4(&shifted, XMMatrixTranslation(1, 0, 0));
+	graph.AddNode(SceneGraph::NoParent, shifted);
+	graph.AddNode(5, shifted);	// Not added yet
+	graph.AddNode(1, shifted);	// Itself
+	graph.AddNode(0, shifted);
+	CHECK(graph.GetParent(1) == SceneGraph::NoParent);
+	CHECK(graph.GetParent(2) == 1);
+
+	graph.Update();
+	CHECK(graph.GetWorldTransform(1)._41 == 1.0f);
+	CHECK(graph.GetWorldTransform(2)._41 == 2.0f);
+	CHECK(graph.GetWorldTransform(3)._41 == 2.0f);
+
+	// Added after an update, only the new node is computed
+	graph.AddNode(3, shifted);
+	CHECK(graph.Update() == 1);
+	CHECK(graph.GetWorldTransform(4)._41 == 3.0f);
+
+	graph.Clear();
+	CHECK(graph.Update() == 0);
+}
+
+// --------------------------------------------------------
+// 50k nodes - every node changed, a few deep nodes changed,
+// and nothing changed - against walking every node's parent
+// chain
+// --------------------------------------------------------
+BENCHMARK(SceneGraph50kNodes)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int count = 50000;
+	SceneGraph graph;
+	std::mt19937 random(6);
+	BuildTree(&graph, count, &random);
+	graph.Update();
+
+	double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+	unsigned int sparse = 0;
+	float checksum = 0.0f;	// Keeps the walk from being optimized out
+	for (unsigned int run = 0; run < 10; run++)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			graph.SetLocalTransform(i, graph.GetLocalTransform(i));
+		Clock::time_point start = Clock::now();
+		graph.Update();
+		best[0] = std::min(best[0], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+		for (unsigned int i = 0; i < 50; i++)
+		{
+			unsigned int node = count - 1 - (unsigned int)(random() % 5000);
+			graph.SetLocalTransform(node, graph.GetLocalTransform(node));
+		}
+		start = Clock::now();
+		sparse = graph.Update();
+		best[1] = std::min(best[1], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+		start = Clock::now();
+		graph.Update();
+		best[2] = std::min(best[2], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+		start = Clock::now();
+		XMVECTOR sum = XMVectorZero();
+		for (unsigned int i = 0; i < count; i++)
+			sum = XMVectorAdd(sum, WalkParents(&graph, i).r[3]);
+		checksum += XMVectorGetX(sum);
+		best[3] = std::min(best[3], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	printf("  All changed %.3fms, %u changed %.3fms, none %.4fms; walking parents %.3fms (%g)\n",
+		best[0], sparse, best[1], best[2], best[3], checksum);
+	CHECK(best[0] < best[3]);
+}
@@ -0,0 +1,205 @@
+#include "TestFramework.h"
+#include "ShaderReflectionCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+static const char* SidecarPath = "ShaderReflectionCacheTests.refl";
+
+// Shaped like a real shader - a couple of buffers, textures and a sampler
+static ShaderReflectionData MakeReflection()
+{
+	ShaderReflectionData data;
+	data.BlobHash = ShaderReflectionCache::HashBlob("compiled shader", 15);
+
+	ReflectedConstantBuffer perFrame;
+	perFrame.Name = "perFrame";
+	perFrame.Size = 128;
+	perFrame.BindIndex = 0;
+	perFrame.Variables.push_back({ "view", 0, 64 });
+	perFrame.Variables.push_back({ "projection", 64, 64 });
+	data.ConstantBuffers.push_back(perFrame);
+
+	ReflectedConstantBuffer perObject;
+	perObject.Name = "perObject";
+	perObject.Size = 64;
+	perObject.BindIndex = 1;
+	perObject.Variables.push_back({ "world", 0, 64 });
+	data.ConstantBuffers.push_back(perObject);
+
+	data.Textures.push_back({ "albedoMap", 0 });
+	data.Textures.push_back({ "normalMap", 3 });
+	data.Samplers.push_back({ "basicSampler", 0 });
+	return data;
+}
+
+static bool SameReflection(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (a.BlobHash != b.BlobHash ||
+		a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.Textures.size() != b.Textures.size() ||
+		a.Samplers.size() != b.Samplers.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const ReflectedConstantBuffer& x = a.ConstantBuffers[i];
+		const ReflectedConstantBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Size != y.Size || x.BindIndex != y.BindIndex || x.Variables.size() != y.Variables.size())
+			return false;
+		for (size_t v = 0; v < x.Variables.size(); v++)
+		{
+			if (x.Variables[v].Name != y.Variables[v].Name ||
+				x.Variables[v].ByteOffset != y.Variables[v].ByteOffset ||
+				x.Variables[v].Size != y.Variables[v].Size)
+				return false;
+		}
+	}
+
+	for (size_t i = 0; i < a.Textures.size(); i++)
+	{
+		if (a.Textures[i].Name != b.Textures[i].Name || a.Textures[i].BindIndex != b.Textures[i].BindIndex)
+			return false;
+	}
+	for (size_t i = 0; i < a.Samplers.size(); i++)
+	{
+		if (a.Samplers[i].Name != b.Samplers[i].Name || a.Samplers[i].BindIndex != b.Samplers[i].BindIndex)
+			return false;
+	}
+	return true;
+}
+
+static bool IsEmpty(const ShaderReflectionData& data)
+{
+	return data.ConstantBuffers.empty() && data.Textures.empty() && data.Samplers.empty();
+}
+
+static std::vector<char> ReadFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const char* path, const std::vector<char>& bytes, size_t size)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(bytes.data(), size);
+}
+
+TEST(ShaderReflectionCacheRoundTrips)
+{
+	ShaderReflectionData saved = MakeReflection();
+	CHECK(ShaderReflectionCache::Save(SidecarPath, saved));
+
+	ShaderReflectionData loaded;
+	CHECK(ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded));
+	CHECK(SameReflection(saved, loaded));
+
+	// Loading over old results replaces them rather than adding to them
+	CHECK(ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded));
+	CHECK(SameReflection(saved, loaded));
+
+	remove(SidecarPath);
+}
+
+TEST(ShaderReflectionCacheMissesStaleSidecars)
+{
+	ShaderReflectionData saved = MakeReflection();
+	CHECK(ShaderReflectionCache::Save(SidecarPath, saved));
+
+	// A recompiled shader hashes differently
+	ShaderReflectionData loaded = MakeReflection();
+	CHECK(!ShaderReflectionCache::Load(SidecarPath, saved.BlobHash + 1, &loaded));
+	CHECK(IsEmpty(loaded));
+
+	remove(SidecarPath);
+	CHECK(!ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded));
+}
+
+// --------------------------------------------------------
+// Cutting the file short anywhere, or damaging its header
+// or counts, must fail without leaving anything half read
+// --------------------------------------------------------
+TEST(ShaderReflectionCacheRejectsDamagedSidecars)
+{
+	ShaderReflectionData saved = MakeReflection();
+	CHECK(ShaderReflectionCache::Save(SidecarPath, saved));
+	std::vector<char> bytes = ReadFile(SidecarPath);
+	CHECK(bytes.size() > 16);
+
+	unsigned int accepted = 0;
+	unsigned int partial = 0;
+	for (size_t size = 0; size < bytes.size(); size++)
+	{
+		WriteFile(SidecarPath, bytes, size);
+		ShaderReflectionData loaded = MakeReflection();
+		if (ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded))
+			accepted++;
+		if (!IsEmpty(loaded))
+			partial++;
+	}
+	CHECK(accepted == 0);
+	CHECK(partial == 0);
+
+	// Wrong magic, then a newer version
+	for (size_t byte = 0; byte < 8; byte += 4)
+	{
+		std::vector<char> damaged = bytes;
+		damaged[byte] ^= 0x55;
+		WriteFile(SidecarPath, damaged, damaged.size());
+		ShaderReflectionData loaded;
+		CHECK(!ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded));
+	}
+
+	// A buffer count (right after the 16 byte header) that
+	// would have it allocating millions of entries
+	std::vector<char> damaged = bytes;
+	damaged[19] = 0x7F;
+	WriteFile(SidecarPath, damaged, damaged.size());
+	ShaderReflectionData loaded;
+	CHECK(!ShaderReflectionCache::Load(SidecarPath, saved.BlobHash, &loaded));
+	CHECK(IsEmpty(loaded));
+
+	remove(SidecarPath);
+}
+
+// --------------------------------------------------------
+// A sidecar with the right hash can still be damaged in ways
+// the counts don't show - offsets past a buffer's end, or
+// registers D3D doesn't have - which would have SetData
+// writing outside the local buffer
+// --------------------------------------------------------
+TEST(ShaderReflectionCacheRejectsOutOfRangeEntries)
+{
+	ShaderReflectionData bad[7];
+	for (ShaderReflectionData& data : bad)
+		data = MakeReflection();
+	bad[0].ConstantBuffers[1].Variables[0].ByteOffset = 16;			// Runs past the end
+	bad[1].ConstantBuffers[0].Variables[1].ByteOffset = 0xFFFFFFF0;	// Wraps around
+	bad[2].ConstantBuffers[1].Size = 4096 * 16 + 16;
+	bad[3].ConstantBuffers[0].BindIndex = 14;
+	bad[4].Textures[1].BindIndex = 128;
+	bad[5].Samplers[0].BindIndex = 16;
+	bad[6].ConstantBuffers[1].Variables[0].Size = 0xFFFFFFFF;
+
+	for (const ShaderReflectionData& data : bad)
+	{
+		CHECK(ShaderReflectionCache::Save(SidecarPath, data));
+		ShaderReflectionData loaded = MakeReflection();
+		CHECK(!ShaderReflectionCache::Load(SidecarPath, data.BlobHash, &loaded));
+		CHECK(IsEmpty(loaded));
+	}
+
+	// Right up to the limits is fine
+	ShaderReflectionData edge = MakeReflection();
+	edge.ConstantBuffers[0].BindIndex = 13;
+	edge.Textures[1].BindIndex = 127;
+	edge.Samplers[0].BindIndex = 15;
+	CHECK(ShaderReflectionCache::Save(SidecarPath, edge));
+	ShaderReflectionData loaded;
+	CHECK(ShaderReflectionCache::Load(SidecarPath, edge.BlobHash, &loaded));
+	CHECK(SameReflection(edge, loaded));
+
+	remove(SidecarPath);
+}
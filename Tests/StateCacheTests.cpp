@@ -0,0 +1,351 @@
+#include "TestFramework.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// --------------------------------------------------------
+// Counts recorded commands of one type
+// --------------------------------------------------------
+static unsigned int CountOf(NullRenderDevice& device, RenderCommandType type)
+{
+	return device.GetStats().CommandCounts[type];
+}
+
+TEST(StateCacheFiltersRedundantBinds)
+{
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+
+	RenderViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	float blendFactor[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+	for (unsigned int pass = 0; pass < 3; pass++)
+	{
+		cache.IASetInputLayout(Fake<ID3D11InputLayout>(0));
+		cache.IASetPrimitiveTopology(4);
+		cache.IASetIndexBuffer(Fake<ID3D11Buffer>(1), 42, 0);
+		cache.VSSetShader(Fake<ID3D11VertexShader>(2));
+		cache.PSSetShader(Fake<ID3D11PixelShader>(3));
+		cache.RSSetState(Fake<ID3D11RasterizerState>(4));
+		cache.RSSetViewports(1, &viewport);
+		cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(5), 1);
+		cache.OMSetBlendState(Fake<ID3D11BlendState>(6), blendFactor, 0xffffffff);
+		cache.DrawIndexed(36, 0, 0);
+	}
+
+	// Only the first pass reaches the device
+	CHECK(recorder.GetStats().Binds == 9);
+	CHECK(recorder.GetStats().DrawCalls == 3);
+
+	const StateCacheStats& stats = cache.GetStats();
+	CHECK(stats.CallsIssued == 9);
+	CHECK(stats.CallsFiltered == 18);
+	CHECK(stats.DrawCalls == 3);
+
+	// Any part of a compound state changing lets the call through
+	cache.IASetIndexBuffer(Fake<ID3D11Buffer>(1), 42, 64);
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(5), 2);
+	blendFactor[3] = 1.0f;
+	cache.OMSetBlendState(Fake<ID3D11BlendState>(6), blendFactor, 0xffffffff);
+	viewport.Width = 640.0f;
+	cache.RSSetViewports(1, &viewport);
+	CHECK(recorder.GetStats().Binds == 13);
+	CHECK(stats.CallsIssued == 13);
+
+	// A null blend factor is the same as all ones
+	cache.OMSetBlendState(Fake<ID3D11BlendState>(6), 0, 0xffffffff);
+	float ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	cache.OMSetBlendState(Fake<ID3D11BlendState>(6), ones, 0xffffffff);
+	CHECK(stats.CallsIssued == 14);
+	CHECK(stats.CallsFiltered == 19);
+
+	cache.ResetStats();
+	CHECK(stats.CallsIssued == 0);
+	CHECK(stats.CallsFiltered == 0);
+	CHECK(stats.DrawCalls == 0);
+}
+
+TEST(StateCacheForwardsOnlyTheChangedSlots)
+{
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+
+	ID3D11ShaderResourceView* views[4] =
+	{
+		Fake<ID3D11ShaderResourceView>(10),
+		Fake<ID3D11ShaderResourceView>(11),
+		Fake<ID3D11ShaderResourceView>(12),
+		Fake<ID3D11ShaderResourceView>(13),
+	};
+	cache.PSSetShaderResources(0, 4, views);
+	CHECK(CountOf(recorder, RENDER_COMMAND_PS_SHADER_RESOURCE) == 4);
+
+	// Slots 1 and 2 change, so only they go through
+	recorder.Clear();
+	views[1] = Fake<ID3D11ShaderResourceView>(14);
+	views[2] = Fake<ID3D11ShaderResourceView>(15);
+	cache.PSSetShaderResources(0, 4, views);
+	const std::vector<RenderCommand>& commands = recorder.GetCommands();
+	CHECK(commands.size() == 2);
+	CHECK(commands[0].Args[0] == 1);
+	CHECK(commands[1].Args[0] == 2);
+
+	// Unchanged slots between two changes are sent again, as
+	// part of one contiguous call
+	recorder.Clear();
+	views[0] = Fake<ID3D11ShaderResourceView>(16);
+	views[3] = Fake<ID3D11ShaderResourceView>(17);
+	cache.PSSetShaderResources(0, 4, views);
+	CHECK(commands.size() == 4);
+	CHECK(cache.GetStats().CallsIssued == 3);
+
+	// The same goes for vertex buffers, where the stride or
+	// offset changing counts as a change
+	ID3D11Buffer* buffers[3] = { Fake<ID3D11Buffer>(20), Fake<ID3D11Buffer>(21), Fake<ID3D11Buffer>(22) };
+	unsigned int strides[3] = { 12, 16, 32 };
+	unsigned int offsets[3] = { 0, 0, 0 };
+	cache.IASetVertexBuffers(0, 3, buffers, strides, offsets);
+	recorder.Clear();
+	offsets[2] = 256;
+	cache.IASetVertexBuffers(0, 3, buffers, strides, offsets);
+	CHECK(commands.size() == 1);
+	CHECK(commands[0].Type == RENDER_COMMAND_VERTEX_BUFFER);
+	CHECK(commands[0].Args[0] == 2);
+	CHECK(commands[0].Args[3] == 256);
+
+	// Slots past what the cache tracks go straight through,
+	// every time
+	recorder.Clear();
+	cache.PSSetShaderResources(31, 2, views);
+	cache.PSSetShaderResources(31, 2, views);
+	CHECK(commands.size() == 4);
+}
+
+TEST(StateCacheTracksConstantBufferRanges)
+{
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+
+	ID3D11Buffer* buffers[2] = { Fake<ID3D11Buffer>(30), Fake<ID3D11Buffer>(31) };
+	unsigned int firstConstants[2] = { 0, 16 };
+	unsigned int numConstants[2] = { 16, 16 };
+	cache.VSSetConstantBuffers1(0, 2, buffers, firstConstants, numConstants);
+	cache.VSSetConstantBuffers1(0, 2, buffers, firstConstants, numConstants);
+	CHECK(CountOf(recorder, RENDER_COMMAND_VS_CONSTANT_BUFFER) == 2);
+
+	// Only the second slot's range moves
+	recorder.Clear();
+	firstConstants[1] = 32;
+	cache.VSSetConstantBuffers1(0, 2, buffers, firstConstants, numConstants);
+	const std::vector<RenderCommand>& commands = recorder.GetCommands();
+	CHECK(commands.size() == 1);
+	CHECK(commands[0].Args[0] == 1);
+	CHECK(commands[0].Args[2] == 32);
+	CHECK(commands[0].Args[3] == 16);
+
+	// Binding the whole buffer is a change from binding a range
+	recorder.Clear();
+	cache.VSSetConstantBuffers(0, 2, buffers);
+	CHECK(commands.size() == 2);
+
+	// Null ranges mean the whole buffer too, and only the
+	// changed part of the run is forwarded - without offsetting
+	// the null arrays
+	recorder.Clear();
+	buffers[1] = Fake<ID3D11Buffer>(32);
+	cache.VSSetConstantBuffers1(0, 2, buffers, 0, 0);
+	cache.PSSetConstantBuffers1(4, 2, buffers, 0, 0);
+	buffers[1] = Fake<ID3D11Buffer>(33);
+	cache.PSSetConstantBuffers1(4, 2, buffers, 0, 0);
+	CHECK(commands.size() == 4);
+	CHECK(commands[0].Type == RENDER_COMMAND_VS_CONSTANT_BUFFER);
+	CHECK(commands[0].Args[0] == 1);
+	CHECK(commands[0].Args[2] == 0 && commands[0].Args[3] == 0);
+	CHECK(commands[3].Type == RENDER_COMMAND_PS_CONSTANT_BUFFER);
+	CHECK(commands[3].Args[0] == 5);
+
+	// ...so they match a later whole buffer bind
+	recorder.Clear();
+	buffers[1] = Fake<ID3D11Buffer>(32);
+	cache.VSSetConstantBuffers(0, 2, buffers);
+	CHECK(commands.empty());
+}
+
+TEST(StateCacheForgetsViewsWhenRenderTargetsChange)
+{
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+
+	// A texture that's about to be rendered into
+	ID3D11ShaderResourceView* view = Fake<ID3D11ShaderResourceView>(40);
+	ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(41);
+	cache.VSSetShaderResources(0, 1, &view);
+	cache.PSSetShaderResources(0, 1, &view);
+	cache.PSSetSamplers(0, 1, &sampler);
+
+	// Binding targets is always issued, and D3D will have
+	// unbound any view of them, so rebinding has to go through
+	ID3D11RenderTargetView* target = Fake<ID3D11RenderTargetView>(42);
+	cache.OMSetRenderTargets(1, &target, Fake<ID3D11DepthStencilView>(43));
+	cache.OMSetRenderTargets(1, &target, Fake<ID3D11DepthStencilView>(43));
+	CHECK(CountOf(recorder, RENDER_COMMAND_RENDER_TARGETS) == 2);
+
+	recorder.Clear();
+	cache.VSSetShaderResources(0, 1, &view);
+	cache.PSSetShaderResources(0, 1, &view);
+	cache.PSSetSamplers(0, 1, &sampler);
+	CHECK(CountOf(recorder, RENDER_COMMAND_VS_SHADER_RESOURCE) == 1);
+	CHECK(CountOf(recorder, RENDER_COMMAND_PS_SHADER_RESOURCE) == 1);
+
+	// Samplers can't alias a target, so they're still known
+	CHECK(CountOf(recorder, RENDER_COMMAND_PS_SAMPLER) == 0);
+}
+
+TEST(StateCacheInvalidateAndApplyTo)
+{
+	NullRenderDevice recorder;
+	StateCache cache(&recorder);
+
+	ID3D11Buffer* vb = Fake<ID3D11Buffer>(50);
+	ID3D11Buffer* cb = Fake<ID3D11Buffer>(51);
+	ID3D11ShaderResourceView* view = Fake<ID3D11ShaderResourceView>(52);
+	ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(53);
+	unsigned int stride = 48;
+	unsigned int offset = 0;
+	unsigned int firstConstant = 16;
+	unsigned int numConstants = 16;
+	RenderViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+
+	cache.IASetInputLayout(Fake<ID3D11InputLayout>(54));
+	cache.IASetPrimitiveTopology(4);
+	cache.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+	cache.IASetIndexBuffer(Fake<ID3D11Buffer>(55), 42, 0);
+	cache.VSSetShader(Fake<ID3D11VertexShader>(56));
+	cache.VSSetConstantBuffers1(1, 1, &cb, &firstConstant, &numConstants);
+	cache.PSSetShader(Fake<ID3D11PixelShader>(57));
+	cache.PSSetConstantBuffers(0, 1, &cb);
+	cache.PSSetShaderResources(2, 1, &view);
+	cache.PSSetSamplers(0, 1, &sampler);
+	cache.RSSetState(Fake<ID3D11RasterizerState>(58));
+	cache.RSSetViewports(1, &viewport);
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(59), 0);
+	cache.OMSetBlendState(Fake<ID3D11BlendState>(60), 0, 0xffffffff);
+
+	// Applying binds the same things the cache passed through,
+	// slot for slot.  It goes back onto the same recorder, so
+	// objects keep their handles.
+	std::vector<RenderCommand> issued = recorder.GetCommands();
+	recorder.Clear();
+	cache.ApplyTo(&recorder);
+	const std::vector<RenderCommand>& applied = recorder.GetCommands();
+	CHECK(applied.size() == issued.size());
+	for (size_t i = 0; i < issued.size(); i++)
+	{
+		bool found = false;
+		for (size_t j = 0; j < applied.size() && !found; j++)
+		{
+			found = applied[j].Type == issued[i].Type;
+			for (unsigned int a = 0; a < 5; a++)
+				found = found && applied[j].Args[a] == issued[i].Args[a];
+		}
+		CHECK(found);
+	}
+
+	// Applying isn't binding, so the counters don't move
+	CHECK(cache.GetStats().CallsIssued == 14);
+
+	// After invalidating, nothing is known: nothing to apply,
+	// and the same binds go through again
+	cache.Invalidate();
+	recorder.Clear();
+	cache.ApplyTo(&recorder);
+	CHECK(applied.empty());
+
+	cache.IASetPrimitiveTopology(4);
+	cache.PSSetSamplers(0, 1, &sampler);
+	cache.IASetPrimitiveTopology(4);
+	CHECK(recorder.GetStats().Binds == 2);
+	CHECK(cache.GetStats().CallsIssued == 16);
+	CHECK(cache.GetStats().CallsFiltered == 1);
+}
+
+// --------------------------------------------------------
+// Issues one draw per entry in order, each binding its mesh,
+// shaders and textures - entries are material * 16 + mesh
+// --------------------------------------------------------
+static void IssueDraws(IRenderDevice* device, const std::vector<unsigned int>& order)
+{
+	unsigned int stride = 48;
+	unsigned int offset = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		unsigned int mesh = order[i] % 16;
+		unsigned int material = order[i] / 16 % 8;
+
+		ID3D11Buffer* vb = Fake<ID3D11Buffer>(mesh);
+		ID3D11ShaderResourceView* views[2] =
+		{
+			Fake<ID3D11ShaderResourceView>(100 + material),
+			Fake<ID3D11ShaderResourceView>(110 + material),
+		};
+		ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(120);
+
+		device->IASetInputLayout(Fake<ID3D11InputLayout>(121));
+		device->IASetPrimitiveTopology(4);
+		device->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+		device->IASetIndexBuffer(Fake<ID3D11Buffer>(20 + mesh), 42, 0);
+		device->VSSetShader(Fake<ID3D11VertexShader>(122 + material % 2));
+		device->PSSetShader(Fake<ID3D11PixelShader>(124 + material % 2));
+		device->PSSetShaderResources(0, 2, views);
+		device->PSSetSamplers(0, 1, &sampler);
+		device->DrawIndexed(36, 0, 0);
+	}
+}
+
+// --------------------------------------------------------
+// How much the cache filters, and what it costs, with draws
+// sorted by material and mesh and with them shuffled
+// --------------------------------------------------------
+BENCHMARK(StateCacheFiltering)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int draws = 10000;
+
+	std::vector<unsigned int> sorted(draws);
+	for (unsigned int i = 0; i < draws; i++)
+		sorted[i] = i * 128 / draws;
+	std::vector<unsigned int> shuffled = sorted;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+
+	const std::vector<unsigned int>* orders[2] = { &sorted, &shuffled };
+	const char* names[2] = { "Sorted", "Shuffled" };
+	for (unsigned int o = 0; o < 2; o++)
+	{
+		NullRenderDevice recorder;
+		StateCache cache(&recorder);
+		double best[2] = { 1e30, 1e30 };
+		for (unsigned int frame = 0; frame < 20; frame++)
+		{
+			for (unsigned int cached = 0; cached < 2; cached++)
+			{
+				recorder.Clear();
+				cache.Invalidate();
+				cache.ResetStats();
+				Clock::time_point start = Clock::now();
+				IssueDraws(cached ? (IRenderDevice*)&cache : &recorder, *orders[o]);
+				double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+				best[cached] = std::min(best[cached], seconds);
+			}
+		}
+
+		const StateCacheStats& stats = cache.GetStats();
+		unsigned int calls = stats.CallsIssued + stats.CallsFiltered;
+		printf("  %-9s %5.1f%% of %u binds filtered, %6.3fms direct, %6.3fms through the cache\n",
+			names[o], 100.0 * stats.CallsFiltered / calls, calls, best[0] * 1000.0, best[1] * 1000.0);
+		CHECK(stats.DrawCalls == draws);
+		CHECK(recorder.GetStats().DrawCalls == draws);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Just enough of a test runner for the engine's plain C++
+// pieces - anything that doesn't need a window or a GPU.
+//
+// TEST(Name) { ... } registers a test, and CHECK() records a
+// failure (with its file and line) without stopping the rest
+// of the test.  BENCHMARK(Name) registers something that's
+// only run, and printed, with "-bench".
+// --------------------------------------------------------
+typedef void(*TestFunction)();
+
+struct TestCase
+{
+	const char* Name;
+	TestFunction Function;
+	bool IsBenchmark;
+};
+
+class TestRegistry
+{
+public:
+	static bool Add(const char* name, TestFunction function, bool isBenchmark);
+	static std::vector<TestCase>& GetTests();
+
+	// Marks the running test as failed
+	static void Fail(const char* file, int line, const char* expression);
+	static unsigned int GetFailures() { return failures; }
+
+private:
+	static unsigned int failures;
+};
+
+#define TEST(name) \
+	static void name(); \
+	static bool name##Registered = TestRegistry::Add(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static bool name##Registered = TestRegistry::Add(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) TestRegistry::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_NEAR(a, b, epsilon) \
+	CHECK(std::fabs((double)(a) - (double)(b)) <= (epsilon))
+
+// --------------------------------------------------------
+// True if text is exactly one JSON value (with whitespace
+// around it allowed), for checking files the engine writes
+// --------------------------------------------------------
+bool IsWellFormedJson(const std::string& text);
+
+// --------------------------------------------------------
+// Stand-ins for D3D objects, meshes and entities in tests
+// that only ever use their addresses - Fake<T>(i) is the same
+// pointer every time, and a different one for each index
+// --------------------------------------------------------
+static const unsigned int FakeObjectCount = 256;
+
+inline char* FakeObjects()
+{
+	static char objects[FakeObjectCount];
+	return objects;
+}
+
+template<typename T>
+T* Fake(unsigned int index)
+{
+	return (T*)&FakeObjects()[index];
+}
+
+// Which index a Fake<T>() pointer was made from
+inline unsigned int FakeIndex(const void* object)
+{
+	return (unsigned int)((const char*)object - FakeObjects());
+}
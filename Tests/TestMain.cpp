@@ -0,0 +1,211 @@
+#include "TestFramework.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+unsigned int TestRegistry::failures = 0;
+
+std::vector<TestCase>& TestRegistry::GetTests()
+{
+	// Built on first use, as tests register during static init
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+bool TestRegistry::Add(const char* name, TestFunction function, bool isBenchmark)
+{
+	TestCase test;
+	test.Name = name;
+	test.Function = function;
+	test.IsBenchmark = isBenchmark;
+	GetTests().push_back(test);
+	return true;
+}
+
+void TestRegistry::Fail(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failures++;
+}
+
+// --------------------------------------------------------
+// A recursive descent JSON parser that only says whether it
+// could parse - each function skips over one thing and
+// returns false if it isn't there
+// --------------------------------------------------------
+static void SkipSpace(const char** p)
+{
+	while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')
+		(*p)++;
+}
+
+static bool SkipJsonValue(const char** p, unsigned int depth);
+
+static bool SkipJsonString(const char** p)
+{
+	if (**p != '"')
+		return false;
+	for ((*p)++; **p != '"'; (*p)++)
+	{
+		if ((unsigned char)**p < 0x20)
+			return false;
+		if (**p != '\\')
+			continue;
+
+		(*p)++;
+		if (**p == 'u')
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				(*p)++;
+				if (!isxdigit((unsigned char)**p))
+					return false;
+			}
+		}
+		else if (**p == 0 || !strchr("\"\\/bfnrt", **p))
+			return false;
+	}
+	(*p)++;
+	return true;
+}
+
+static bool SkipJsonNumber(const char** p)
+{
+	const char* start = *p;
+	if (**p == '-')
+		(*p)++;
+	if (**p == '0')
+		(*p)++;
+	else if (isdigit((unsigned char)**p))
+		while (isdigit((unsigned char)**p)) (*p)++;
+	else
+		return false;
+
+	if (**p == '.')
+	{
+		(*p)++;
+		if (!isdigit((unsigned char)**p))
+			return false;
+		while (isdigit((unsigned char)**p)) (*p)++;
+	}
+	if (**p == 'e' || **p == 'E')
+	{
+		(*p)++;
+		if (**p == '+' || **p == '-')
+			(*p)++;
+		if (!isdigit((unsigned char)**p))
+			return false;
+		while (isdigit((unsigned char)**p)) (*p)++;
+	}
+	return *p > start;
+}
+
+// Objects and arrays: open, comma separated items, close
+static bool SkipJsonList(const char** p, char close, bool keys, unsigned int depth)
+{
+	(*p)++;
+	SkipSpace(p);
+	if (**p == close)
+	{
+		(*p)++;
+		return true;
+	}
+
+	for (;;)
+	{
+		if (keys)
+		{
+			if (!SkipJsonString(p))
+				return false;
+			SkipSpace(p);
+			if (**p != ':')
+				return false;
+			(*p)++;
+		}
+		if (!SkipJsonValue(p, depth + 1))
+			return false;
+
+		if (**p == close)
+		{
+			(*p)++;
+			return true;
+		}
+		if (**p != ',')
+			return false;
+		(*p)++;
+		SkipSpace(p);
+	}
+}
+
+static bool SkipJsonValue(const char** p, unsigned int depth)
+{
+	if (depth > 64)
+		return false;
+
+	SkipSpace(p);
+	bool valid;
+	if (**p == '{')
+		valid = SkipJsonList(p, '}', true, depth);
+	else if (**p == '[')
+		valid = SkipJsonList(p, ']', false, depth);
+	else if (**p == '"')
+		valid = SkipJsonString(p);
+	else if (strncmp(*p, "true", 4) == 0 || strncmp(*p, "null", 4) == 0)
+	{
+		*p += 4;
+		valid = true;
+	}
+	else if (strncmp(*p, "false", 5) == 0)
+	{
+		*p += 5;
+		valid = true;
+	}
+	else
+		valid = SkipJsonNumber(p);
+
+	SkipSpace(p);
+	return valid;
+}
+
+bool IsWellFormedJson(const std::string& text)
+{
+	const char* p = text.c_str();
+	return SkipJsonValue(&p, 0) && *p == 0 && p == text.c_str() + text.size();
+}
+
+// --------------------------------------------------------
+// Runs every test, or every benchmark with "-bench".  Any
+// other argument only runs names containing it.  Returns
+// the number of tests that failed.
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	const char* filter = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-bench") == 0)
+			benchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	unsigned int run = 0;
+	unsigned int failed = 0;
+	for (const TestCase& test : TestRegistry::GetTests())
+	{
+		if (test.IsBenchmark != benchmarks || (filter && !strstr(test.Name, filter)))
+			continue;
+
+		printf("%s\n", test.Name);
+		unsigned int failuresBefore = TestRegistry::GetFailures();
+		test.Function();
+		run++;
+		if (TestRegistry::GetFailures() != failuresBefore)
+			failed++;
+	}
+
+	printf("\n%u of %u %s passed\n", run - failed, run, benchmarks ? "benchmarks" : "tests");
+	return (int)failed;
+}
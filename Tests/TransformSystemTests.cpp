@@ -0,0 +1,183 @@
+#include "TestFramework.h"
+#include "TransformSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+static void Randomize(TransformSystem* transforms, unsigned int transform, std::mt19937* random)
+{
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(-6.3f, 6.3f);
+	std::uniform_real_distribution<float> scale(0.1f, 5.0f);
+	transforms->SetPosition(transform, position(*random), position(*random), position(*random));
+	transforms->SetRotation(transform, angle(*random), angle(*random), angle(*random));
+	transforms->SetScale(transform, scale(*random), scale(*random), scale(*random));
+}
+
+static std::vector<XMFLOAT4X4> CopyMatrices(TransformSystem* transforms)
+{
+	std::vector<XMFLOAT4X4> matrices;
+	for (unsigned int i = 0; i < transforms->GetCount(); i++)
+		matrices.push_back(*transforms->GetWorldMatrix(i));
+	return matrices;
+}
+
+// Largest difference between any two elements, relative to
+// the matrix's scale
+static float MaxError(const std::vector<XMFLOAT4X4>& a, const std::vector<XMFLOAT4X4>& b)
+{
+	float worst = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		const float* x = &a[i]._11;
+		const float* y = &b[i]._11;
+		for (int e = 0; e < 16; e++)
+			worst = std::max(worst, fabsf(x[e] - y[e]) / std::max(1.0f, fabsf(y[e])));
+	}
+	return worst;
+}
+
+// --------------------------------------------------------
+// Four at a time against one at a time, for counts that do
+// and don't fill the last group and word, on one thread and
+// spread over the job system
+// --------------------------------------------------------
+TEST(TransformSystemMatchesReference)
+{
+	JobSystem jobs(4);
+	unsigned int counts[4] = { 1, 37, 1000, 20003 };
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			TransformSystem transforms;
+			std::mt19937 random(c);
+			for (unsigned int i = 0; i < counts[c]; i++)
+				Randomize(&transforms, transforms.Create(), &random);
+
+			CHECK(transforms.Update(threaded ? &jobs : 0) == counts[c]);
+			std::vector<XMFLOAT4X4> updated = CopyMatrices(&transforms);
+			transforms.UpdateReference();
+			CHECK(MaxError(updated, CopyMatrices(&transforms)) < 1e-4f);
+
+			// Nothing's dirty any more
+			CHECK(transforms.Update(threaded ? &jobs : 0) == 0);
+		}
+	}
+}
+
+TEST(TransformSystemOnlyRebuildsDirtyTransforms)
+{
+	TransformSystem transforms;
+	std::mt19937 random(17);
+	for (unsigned int i = 0; i < 5000; i++)
+		Randomize(&transforms, transforms.Create(), &random);
+	transforms.Update();
+
+	// Poison every matrix, then move a scattered few - only
+	// the groups of four they're in may be rebuilt
+	for (unsigned int i = 0; i < transforms.GetCount(); i++)
+		transforms.GetWorldMatrix(i)->_44 = 7.0f;
+	unsigned int touched[5] = { 0, 31, 32, 2048, 4999 };
+	for (unsigned int t : touched)
+		transforms.Move(t, 1.0f, 2.0f, 3.0f);
+	transforms.Rotate(31, 0.5f, 0.0f, 0.0f);
+	CHECK(transforms.Update() == 5);
+
+	unsigned int rebuilt = 0;
+	for (unsigned int i = 0; i < transforms.GetCount(); i++)
+	{
+		if (transforms.GetWorldMatrix(i)->_44 == 1.0f)
+			rebuilt++;
+	}
+	CHECK(rebuilt == 5 * 4);
+
+	std::vector<XMFLOAT4X4> sparse;
+	for (unsigned int t : touched)
+		sparse.push_back(*transforms.GetWorldMatrix(t));
+	transforms.UpdateReference();
+	std::vector<XMFLOAT4X4> reference;
+	for (unsigned int t : touched)
+		reference.push_back(*transforms.GetWorldMatrix(t));
+	CHECK(MaxError(sparse, reference) < 1e-4f);
+}
+
+// --------------------------------------------------------
+// Stepping saves the state moved away from, and blending
+// lands on it at 0 and the current state at 1
+// --------------------------------------------------------
+TEST(TransformSystemInterpolatesSteps)
+{
+	TransformSystem transforms;
+	for (unsigned int i = 0; i < 10; i++)
+		transforms.Create();
+	transforms.SetPosition(3, 10.0f, 0.0f, 0.0f);
+	transforms.Update();
+
+	transforms.BeginStep();
+	transforms.Move(3, 10.0f, 0.0f, -4.0f);
+	transforms.Update();
+
+	transforms.Interpolate(0.0f);
+	CHECK(transforms.GetWorldMatrix(3)->_14 == 10.0f);
+	transforms.Interpolate(0.25f);
+	CHECK_NEAR(transforms.GetWorldMatrix(3)->_14, 12.5f, 1e-5f);
+	CHECK_NEAR(transforms.GetWorldMatrix(3)->_34, -1.0f, 1e-5f);
+	transforms.Interpolate(1.0f);
+	CHECK(transforms.GetWorldMatrix(3)->_14 == 20.0f);
+
+	// A step later with no movement, it settles on the current state
+	transforms.BeginStep();
+	transforms.Update();
+	transforms.Interpolate(0.0f);
+	CHECK(transforms.GetWorldMatrix(3)->_14 == 20.0f);
+}
+
+// --------------------------------------------------------
+// 100k transforms - all of them dirty, then 1% of them, on
+// one thread and over the job system, against the one at a
+// time reference
+// --------------------------------------------------------
+BENCHMARK(TransformSystem100k)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int count = 100000;
+	TransformSystem transforms;
+	transforms.Reserve(count);
+	std::mt19937 random(3);
+	for (unsigned int i = 0; i < count; i++)
+		Randomize(&transforms, transforms.Create(), &random);
+
+	JobSystem jobs;
+	JobSystem* paths[2] = { 0, &jobs };
+	double best[5] = { 1e30, 1e30, 1e30, 1e30, 1e30 };
+	for (unsigned int run = 0; run < 10; run++)
+	{
+		for (unsigned int p = 0; p < 2; p++)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				transforms.Move(i, 0.01f, 0.0f, 0.0f);
+			Clock::time_point start = Clock::now();
+			transforms.Update(paths[p]);
+			best[p] = std::min(best[p], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+			for (unsigned int i = 0; i < count; i += 100)
+				transforms.Move((i * 7919) % count, 0.01f, 0.0f, 0.0f);
+			start = Clock::now();
+			transforms.Update(paths[p]);
+			best[2 + p] = std::min(best[2 + p], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+
+		Clock::time_point start = Clock::now();
+		transforms.UpdateReference();
+		best[4] = std::min(best[4], std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	printf("  All dirty: %.3fms, %.3fms on %u threads; 1%% dirty: %.3fms, %.3fms; reference %.3fms\n",
+		best[0], best[1], jobs.GetThreadCount(), best[2], best[3], best[4]);
+	CHECK(best[0] < best[4]);
+}
@@ -0,0 +1,154 @@
+#include "TestFramework.h"
+#include "UploadRing.h"
+
+#include <deque>
+#include <random>
+
+TEST(UploadRingAlignsSlices)
+{
+	UploadRing ring(4096, 256);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(1, &offset) && offset == 0);
+	CHECK(ring.Allocate(256, &offset) && offset == 256);
+	CHECK(ring.Allocate(257, &offset) && offset == 512);
+	CHECK(ring.Allocate(16, &offset) && offset == 1024);
+	CHECK(ring.GetUsedBytes() == 1280);
+
+	// Nothing to hand out for nothing
+	CHECK(!ring.Allocate(0, &offset));
+}
+
+TEST(UploadRingRoundsCapacityDown)
+{
+	UploadRing ring(1000, 256);
+	unsigned int offset;
+
+	CHECK(ring.GetCapacity() == 768);
+	CHECK(!ring.Allocate(1000, &offset));
+	CHECK(ring.Allocate(768, &offset) && offset == 0);
+}
+
+TEST(UploadRingWrapsAroundRetiredSpace)
+{
+	UploadRing ring(1024, 256);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(512, &offset) && offset == 0);
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(256, &offset) && offset == 512);
+	ring.EndFrame(2);
+
+	// Frame 1's space is free, but there's only 256 bytes left
+	// at the end, so the end is wasted and the slice wraps
+	ring.Retire(1);
+	CHECK(ring.Allocate(512, &offset) && offset == 0);
+	CHECK(ring.GetWrapCount() == 1);
+	CHECK(ring.GetUsedBytes() == 1024);
+
+	// Frame 2 (at 512) is still in flight
+	CHECK(!ring.Allocate(256, &offset));
+
+	// The wasted end goes back with the frame that wasted it
+	ring.EndFrame(3);
+	ring.Retire(2);
+	CHECK(ring.GetUsedBytes() == 768);
+	ring.Retire(3);
+	CHECK(ring.GetUsedBytes() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+}
+
+TEST(UploadRingRefusesToOverwriteFramesInFlight)
+{
+	UploadRing ring(1024, 256);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(768, &offset));
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(256, &offset) && offset == 768);
+	CHECK(!ring.Allocate(256, &offset));
+	CHECK(!ring.Allocate(2048, &offset));
+	CHECK(ring.GetFailedAllocations() == 2);
+
+	// An old fence doesn't free anything newer
+	ring.Retire(0);
+	CHECK(!ring.Allocate(256, &offset));
+	ring.Retire(1);
+	CHECK(ring.Allocate(256, &offset) && offset == 0);
+}
+
+TEST(UploadRingEmptyFramesDontMoveTheTailBack)
+{
+	UploadRing ring(1024, 256);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(512, &offset) && offset == 0);
+	ring.EndFrame(1);
+	ring.EndFrame(2);	// Nothing uploaded
+	ring.Retire(1);
+
+	// Empty, so this starts over at 0 while frame 2 is pending
+	CHECK(ring.Allocate(256, &offset) && offset == 0);
+	ring.Retire(2);
+
+	// Frame 2 ended at 512 before the restart - if the tail went
+	// back there, only [256, 512) would look free
+	CHECK(ring.Allocate(768, &offset) && offset == 256);
+	CHECK(ring.GetUsedBytes() == 1024);
+}
+
+// --------------------------------------------------------
+// Runs frames of random uploads with the GPU a few frames
+// behind, checking no live slice is ever handed out twice
+// --------------------------------------------------------
+TEST(UploadRingNeverOverlapsLiveSlices)
+{
+	const unsigned int capacity = 64 * 1024;
+	UploadRing ring(capacity, 256);
+	std::vector<unsigned int> owner(capacity / 256, 0);
+	std::deque<std::vector<unsigned int> > inFlight;
+	std::mt19937 random(42);
+	std::uniform_int_distribution<unsigned int> sizes(1, 4096);
+	std::uniform_int_distribution<unsigned int> counts(0, 24);
+
+	unsigned int overlaps = 0;
+	unsigned int allocated = 0;
+	for (unsigned int frame = 1; frame <= 2000; frame++)
+	{
+		std::vector<unsigned int> slots;
+		unsigned int uploads = counts(random);
+		for (unsigned int i = 0; i < uploads; i++)
+		{
+			unsigned int size = sizes(random);
+			unsigned int offset;
+			if (!ring.Allocate(size, &offset))
+				continue;
+
+			CHECK(offset % 256 == 0);
+			CHECK(offset + size <= capacity);
+			for (unsigned int s = offset / 256; s < (offset + size + 255) / 256; s++)
+			{
+				if (owner[s] != 0)
+					overlaps++;
+				owner[s] = frame;
+				slots.push_back(s);
+			}
+			allocated++;
+		}
+		ring.EndFrame(frame);
+		inFlight.push_back(slots);
+
+		// Three frames of latency
+		if (frame > 3)
+		{
+			ring.Retire(frame - 3);
+			for (unsigned int s : inFlight.front())
+				owner[s] = 0;
+			inFlight.pop_front();
+		}
+	}
+
+	CHECK(overlaps == 0);
+	CHECK(allocated > 10000);
+	CHECK(ring.GetWrapCount() > 0);
+}